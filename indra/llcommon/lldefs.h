@@ -30,6 +30,10 @@
 #include "stdtypes.h"
 #include <type_traits>
 
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
 // Often used array indices
 const U32	VX			= 0;
 const U32	VY			= 1;
@@ -230,5 +234,18 @@ inline void llswap(LLDATATYPE& lhs, LLDATATYPE& rhs)
 	std::swap(lhs, rhs);
 }
 
+// Index of the lowest bit set in mask, which must not be 0. Turns the mask
+// from _mm_movemask_epi8() into the offset of the first matching byte.
+inline S32 ll_lowest_set_bit(U32 mask)
+{
+#if defined(_MSC_VER)
+	unsigned long index;
+	_BitScanForward(&index, mask);
+	return (S32)index;
+#else
+	return __builtin_ctz(mask);
+#endif
+}
+
 #endif // LL_LLDEFS_H
 
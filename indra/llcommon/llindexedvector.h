@@ -31,26 +31,35 @@
 
 #include <vector>
 #include <map>
+#include <memory>
 
 //--------------------------------------------------------
 // LLIndexedVector
 //--------------------------------------------------------
 
-template <typename Type, typename Key, int BlockSize = 32> 
+template <typename Type, typename Key, int BlockSize = 32, typename Allocator = std::allocator<Type> >
 class LLIndexedVector
 {
+	typedef std::vector<Type, Allocator> vector_t;
+	typedef typename std::allocator_traits<Allocator>::template rebind_alloc<std::pair<const Key, U32> > map_allocator_t;
+	typedef std::map<Key, U32, std::less<Key>, map_allocator_t> map_t;
 public:
-	typedef typename std::vector<Type>::iterator iterator;
-	typedef typename std::vector<Type>::const_iterator const_iterator;
-	typedef typename std::vector<Type>::reverse_iterator reverse_iterator;
-	typedef typename std::vector<Type>::const_reverse_iterator const_reverse_iterator;
-	typedef typename std::vector<Type>::size_type size_type;
+	typedef typename vector_t::iterator iterator;
+	typedef typename vector_t::const_iterator const_iterator;
+	typedef typename vector_t::reverse_iterator reverse_iterator;
+	typedef typename vector_t::const_reverse_iterator const_reverse_iterator;
+	typedef typename vector_t::size_type size_type;
 protected:
-	std::vector<Type> mVector;
-	std::map<Key, U32> mIndexMap;
+	vector_t mVector;
+	map_t mIndexMap;
 	
 public:
-	LLIndexedVector() { mVector.reserve(BlockSize); }
+	LLIndexedVector(const Allocator& allocator = Allocator()) :
+		mVector(allocator),
+		mIndexMap(std::less<Key>(), map_allocator_t(allocator))
+	{
+		mVector.reserve(BlockSize);
+	}
 	
 	iterator begin() { return mVector.begin(); }
 	const_iterator begin() const { return mVector.begin(); }
@@ -68,7 +77,7 @@ public:
 	
 	Type& operator[](const Key& k)
 	{
-		typename std::map<Key, U32>::const_iterator iter = mIndexMap.find(k);
+		typename map_t::const_iterator iter = mIndexMap.find(k);
 		if (iter == mIndexMap.end())
 		{
 			U32 n = mVector.size();
@@ -85,7 +94,7 @@ public:
 
 	const_iterator find(const Key& k) const
 	{
-		typename std::map<Key, U32>::const_iterator iter = mIndexMap.find(k);
+		typename map_t::const_iterator iter = mIndexMap.find(k);
 		if(iter == mIndexMap.end())
 		{
 			return mVector.end();
@@ -0,0 +1,163 @@
+/**
+ * @file llindexlist.h
+ * @brief Intrusive doubly linked list of small integer indices.
+ *
+ * $LicenseInfo:firstyear=2024&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2024, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#ifndef LL_LLINDEXLIST_H
+#define LL_LLINDEXLIST_H
+
+#include "stdtypes.h"
+
+#include <vector>
+
+/**
+ * LLIndexList orders a set of indices into some external array (cache
+ * entries, slots...), with O(1) insertion, removal and membership test and
+ * no allocation once the node array has grown to the highest index used.
+ * It is meant for LRU lists and free lists over entry tables.
+ */
+class LLIndexList
+{
+public:
+    static constexpr S32 NONE = -1;
+
+    LLIndexList()
+    :   mHead(NONE),
+        mTail(NONE),
+        mSize(0)
+    {}
+
+    U32 size() const        { return mSize; }
+    bool empty() const      { return mSize == 0; }
+    S32 front() const       { return mHead; }
+    S32 back() const        { return mTail; }
+
+    bool contains(S32 idx) const
+    {
+        return idx >= 0 && idx < (S32)mNodes.size() && mNodes[idx].mInList;
+    }
+
+    // Appends idx, or moves it to the back if it is already in the list
+    void pushBack(S32 idx)
+    {
+        if (idx >= (S32)mNodes.size())
+        {
+            mNodes.resize(idx + 1);
+        }
+        else if (mNodes[idx].mInList)
+        {
+            if (idx == mTail)
+            {
+                return;
+            }
+            unlink(idx);
+        }
+
+        Node& node = mNodes[idx];
+        node.mPrev = mTail;
+        node.mNext = NONE;
+        node.mInList = true;
+        if (mTail != NONE)
+        {
+            mNodes[mTail].mNext = idx;
+        }
+        else
+        {
+            mHead = idx;
+        }
+        mTail = idx;
+        ++mSize;
+    }
+
+    void remove(S32 idx)
+    {
+        if (contains(idx))
+        {
+            unlink(idx);
+        }
+    }
+
+    // Returns NONE if the list is empty
+    S32 popFront()
+    {
+        S32 idx = mHead;
+        if (idx != NONE)
+        {
+            unlink(idx);
+        }
+        return idx;
+    }
+
+    S32 next(S32 idx) const
+    {
+        return mNodes[idx].mNext;
+    }
+
+    void clear()
+    {
+        mNodes.clear();
+        mHead = mTail = NONE;
+        mSize = 0;
+    }
+
+private:
+    void unlink(S32 idx)
+    {
+        Node& node = mNodes[idx];
+        if (node.mPrev != NONE)
+        {
+            mNodes[node.mPrev].mNext = node.mNext;
+        }
+        else
+        {
+            mHead = node.mNext;
+        }
+        if (node.mNext != NONE)
+        {
+            mNodes[node.mNext].mPrev = node.mPrev;
+        }
+        else
+        {
+            mTail = node.mPrev;
+        }
+        node.mPrev = node.mNext = NONE;
+        node.mInList = false;
+        --mSize;
+    }
+
+    struct Node
+    {
+        Node() : mPrev(NONE), mNext(NONE), mInList(false) {}
+        S32 mPrev;
+        S32 mNext;
+        bool mInList;
+    };
+
+    std::vector<Node> mNodes;
+    S32 mHead;
+    S32 mTail;
+    U32 mSize;
+};
+
+#endif // LL_LLINDEXLIST_H
@@ -0,0 +1,357 @@
+/**
+ * @file llmappedfile.cpp
+ * @brief Cross-platform memory-mapped file.
+ *
+ * $LicenseInfo:firstyear=2024&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2024, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#if LL_WINDOWS
+#include "llwin32headerslean.h"
+#else
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "linden_common.h"
+#include "llmappedfile.h"
+#include "llstring.h"
+
+LLMappedFile::LLMappedFile()
+:	mData(nullptr),
+	mSize(0),
+	mReadOnly(false),
+#if LL_WINDOWS
+	mFileHandle(INVALID_HANDLE_VALUE),
+	mMappingHandle(NULL),
+	mLocked(false)
+#else
+	mFD(-1)
+#endif
+{
+}
+
+LLMappedFile::~LLMappedFile()
+{
+	close();
+}
+
+#if LL_WINDOWS
+
+namespace
+{
+	// The lock covers one byte far past the end of any file we map rather
+	// than the data itself: Windows locks are mandatory, so locking the
+	// data would get in the way of reading the file.
+	const DWORD LOCK_OFFSET_HIGH = 0x7fffffff;
+}
+
+bool LLMappedFile::open(const std::string& filename, size_t size, bool read_only, bool exclusive)
+{
+	close();
+
+	mFilename = filename;
+	mReadOnly = read_only;
+
+	llutf16string utf16filename = utf8str_to_utf16str(filename);
+	HANDLE file = CreateFileW(utf16filename.c_str(),
+							  read_only ? GENERIC_READ : GENERIC_READ | GENERIC_WRITE,
+							  FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+							  NULL,
+							  read_only ? OPEN_EXISTING : OPEN_ALWAYS,
+							  FILE_ATTRIBUTE_NORMAL,
+							  NULL);
+	if (file == INVALID_HANDLE_VALUE)
+	{
+		LL_DEBUGS("MappedFile") << "Unable to open " << filename << ": " << GetLastError() << LL_ENDL;
+		return false;
+	}
+	mFileHandle = file;
+
+	if (exclusive)
+	{
+		OVERLAPPED overlapped = { 0 };
+		overlapped.OffsetHigh = LOCK_OFFSET_HIGH;
+		if (LockFileEx(file, LOCKFILE_EXCLUSIVE_LOCK | LOCKFILE_FAIL_IMMEDIATELY, 0, 1, 0, &overlapped))
+		{
+			mLocked = true;
+		}
+		else if (GetLastError() == ERROR_LOCK_VIOLATION)
+		{
+			LL_INFOS("MappedFile") << filename << " is locked by another process" << LL_ENDL;
+			close();
+			return false;
+		}
+		else
+		{
+			// Filesystem without locks: better unprotected than unusable
+			LL_WARNS("MappedFile") << "Unable to lock " << filename << ": " << GetLastError() << LL_ENDL;
+		}
+	}
+
+	LARGE_INTEGER file_size;
+	if (!GetFileSizeEx(file, &file_size))
+	{
+		close();
+		return false;
+	}
+
+	size_t map_size = (size_t)file_size.QuadPart;
+	if (!read_only && size > map_size)
+	{
+		map_size = size;
+	}
+	if (!map(map_size))
+	{
+		close();
+		return false;
+	}
+	return true;
+}
+
+bool LLMappedFile::map(size_t size)
+{
+	if (!size)
+	{
+		return false;
+	}
+
+	// For a writable mapping, CreateFileMapping() extends the file to 'size'.
+	LARGE_INTEGER map_size;
+	map_size.QuadPart = (LONGLONG)size;
+	HANDLE mapping = CreateFileMappingW((HANDLE)mFileHandle,
+									   NULL,
+									   mReadOnly ? PAGE_READONLY : PAGE_READWRITE,
+									   map_size.HighPart,
+									   map_size.LowPart,
+									   NULL);
+	if (!mapping)
+	{
+		LL_WARNS("MappedFile") << "CreateFileMapping failed for " << mFilename << ": " << GetLastError() << LL_ENDL;
+		return false;
+	}
+
+	void* data = MapViewOfFile(mapping, mReadOnly ? FILE_MAP_READ : FILE_MAP_WRITE, 0, 0, size);
+	if (!data)
+	{
+		LL_WARNS("MappedFile") << "MapViewOfFile failed for " << mFilename << ": " << GetLastError() << LL_ENDL;
+		CloseHandle(mapping);
+		return false;
+	}
+
+	mMappingHandle = mapping;
+	mData = (U8*)data;
+	mSize = size;
+	return true;
+}
+
+void LLMappedFile::unmap()
+{
+	if (mData)
+	{
+		UnmapViewOfFile(mData);
+		mData = nullptr;
+	}
+	if (mMappingHandle)
+	{
+		CloseHandle((HANDLE)mMappingHandle);
+		mMappingHandle = NULL;
+	}
+	mSize = 0;
+}
+
+bool LLMappedFile::resize(size_t size)
+{
+	if (mReadOnly || mFileHandle == INVALID_HANDLE_VALUE || !size)
+	{
+		return false;
+	}
+
+	unmap();
+
+	// A mapping can only grow a file; truncate explicitly when shrinking.
+	LARGE_INTEGER new_size;
+	new_size.QuadPart = (LONGLONG)size;
+	if (!SetFilePointerEx((HANDLE)mFileHandle, new_size, NULL, FILE_BEGIN) ||
+		!SetEndOfFile((HANDLE)mFileHandle))
+	{
+		LL_WARNS("MappedFile") << "Unable to resize " << mFilename << ": " << GetLastError() << LL_ENDL;
+		return false;
+	}
+	return map(size);
+}
+
+bool LLMappedFile::flush(bool wait)
+{
+	if (!mData || mReadOnly)
+	{
+		return false;
+	}
+	bool success = FlushViewOfFile(mData, 0) != 0;
+	if (success && wait)
+	{
+		success = FlushFileBuffers((HANDLE)mFileHandle) != 0;
+	}
+	return success;
+}
+
+void LLMappedFile::close()
+{
+	unmap();
+	if (mLocked)
+	{
+		OVERLAPPED overlapped = { 0 };
+		overlapped.OffsetHigh = LOCK_OFFSET_HIGH;
+		UnlockFileEx((HANDLE)mFileHandle, 0, 1, 0, &overlapped);
+		mLocked = false;
+	}
+	if (mFileHandle != INVALID_HANDLE_VALUE)
+	{
+		CloseHandle((HANDLE)mFileHandle);
+		mFileHandle = INVALID_HANDLE_VALUE;
+	}
+}
+
+#else // LL_WINDOWS
+
+bool LLMappedFile::open(const std::string& filename, size_t size, bool read_only, bool exclusive)
+{
+	close();
+
+	mFilename = filename;
+	mReadOnly = read_only;
+
+	int fd = ::open(filename.c_str(), read_only ? O_RDONLY : O_RDWR | O_CREAT, 0666);
+	if (fd < 0)
+	{
+		LL_DEBUGS("MappedFile") << "Unable to open " << filename << ": " << strerror(errno) << LL_ENDL;
+		return false;
+	}
+	mFD = fd;
+
+	// Released when the descriptor is closed
+	if (exclusive && flock(fd, LOCK_EX | LOCK_NB) != 0)
+	{
+		if (errno == EWOULDBLOCK)
+		{
+			LL_INFOS("MappedFile") << filename << " is locked by another process" << LL_ENDL;
+			close();
+			return false;
+		}
+		// Filesystem without locks: better unprotected than unusable
+		LL_WARNS("MappedFile") << "Unable to lock " << filename << ": " << strerror(errno) << LL_ENDL;
+	}
+
+	struct stat file_stat;
+	if (fstat(fd, &file_stat) != 0)
+	{
+		close();
+		return false;
+	}
+
+	size_t map_size = (size_t)file_stat.st_size;
+	if (!read_only && size > map_size)
+	{
+		if (ftruncate(fd, (off_t)size) != 0)
+		{
+			LL_WARNS("MappedFile") << "Unable to extend " << filename << ": " << strerror(errno) << LL_ENDL;
+			close();
+			return false;
+		}
+		map_size = size;
+	}
+	if (!map(map_size))
+	{
+		close();
+		return false;
+	}
+	return true;
+}
+
+bool LLMappedFile::map(size_t size)
+{
+	if (!size)
+	{
+		return false;
+	}
+
+	void* data = ::mmap(NULL, size, mReadOnly ? PROT_READ : PROT_READ | PROT_WRITE, MAP_SHARED, mFD, 0);
+	if (data == MAP_FAILED)
+	{
+		LL_WARNS("MappedFile") << "mmap failed for " << mFilename << ": " << strerror(errno) << LL_ENDL;
+		return false;
+	}
+
+	mData = (U8*)data;
+	mSize = size;
+	return true;
+}
+
+void LLMappedFile::unmap()
+{
+	if (mData)
+	{
+		::munmap(mData, mSize);
+		mData = nullptr;
+	}
+	mSize = 0;
+}
+
+bool LLMappedFile::resize(size_t size)
+{
+	if (mReadOnly || mFD < 0 || !size)
+	{
+		return false;
+	}
+
+	unmap();
+	if (ftruncate(mFD, (off_t)size) != 0)
+	{
+		LL_WARNS("MappedFile") << "Unable to resize " << mFilename << ": " << strerror(errno) << LL_ENDL;
+		return false;
+	}
+	return map(size);
+}
+
+bool LLMappedFile::flush(bool wait)
+{
+	if (!mData || mReadOnly)
+	{
+		return false;
+	}
+	return ::msync(mData, mSize, wait ? MS_SYNC : MS_ASYNC) == 0;
+}
+
+void LLMappedFile::close()
+{
+	unmap();
+	if (mFD >= 0)
+	{
+		::close(mFD);
+		mFD = -1;
+	}
+}
+
+#endif // LL_WINDOWS
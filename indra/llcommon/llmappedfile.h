@@ -0,0 +1,100 @@
+/**
+ * @file llmappedfile.h
+ * @brief Cross-platform memory-mapped file.
+ *
+ * $LicenseInfo:firstyear=2024&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2024, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#ifndef LL_LLMAPPEDFILE_H
+#define LL_LLMAPPEDFILE_H
+
+#include <boost/noncopyable.hpp>
+
+/**
+ * @class LLMappedFile
+ * @brief Maps a whole file into the address space of the process.
+ *
+ * The mapping is shared with the file: stores into getData() of a writable
+ * mapping end up in the file without any explicit write call. Pointers into
+ * the mapping are invalidated by resize() and close().
+ *
+ * Instances are not thread safe; callers must provide their own locking.
+ */
+class LL_COMMON_API LLMappedFile : private boost::noncopyable
+{
+public:
+	LLMappedFile();
+	~LLMappedFile();
+
+	/**
+	 * @brief Open and map a file.
+	 * @param[in] filename - UTF-8 path of the file.
+	 * @param[in] size - Minimum size of the mapping. A writable file shorter
+	 * than this is extended (zero-filled); 0 maps the file at its current size.
+	 * @param[in] read_only - Map the file read-only. The file must exist.
+	 * @param[in] exclusive - Also take an exclusive lock on the file, held
+	 * until close(). If another process (or another LLMappedFile) holds it,
+	 * open() fails without changing the file. On a filesystem that can't
+	 * lock, the file is opened unlocked.
+	 * @return Returns true if the file is mapped.
+	 */
+	bool open(const std::string& filename, size_t size, bool read_only = false, bool exclusive = false);
+
+	/**
+	 * @brief Grow or shrink a writable mapping, remapping as needed.
+	 * Any previously returned getData() pointer becomes invalid.
+	 */
+	bool resize(size_t size);
+
+	/**
+	 * @brief Ask the OS to write dirty pages back to the file.
+	 * @param[in] wait - Block until the pages have been written.
+	 */
+	bool flush(bool wait = false);
+
+	void close();
+
+	bool isOpen() const				{ return mData != nullptr; }
+	bool isReadOnly() const			{ return mReadOnly; }
+	U8* getData() const				{ return mData; }
+	size_t getSize() const			{ return mSize; }
+	const std::string& getFilename() const { return mFilename; }
+
+private:
+	bool map(size_t size);
+	void unmap();
+
+private:
+	std::string	mFilename;
+	U8*			mData;
+	size_t		mSize;
+	bool		mReadOnly;
+#if LL_WINDOWS
+	void*		mFileHandle;
+	void*		mMappingHandle;
+	bool		mLocked;
+#else
+	int			mFD;
+#endif
+};
+
+#endif // LL_LLMAPPEDFILE_H
@@ -36,7 +36,12 @@
 #include "llsdserialize.h"
 #include "stringize.h"
 
+#include <algorithm>
+#include <atomic>
 #include <limits>
+#include <mutex>
+#include <string_view>
+#include <unordered_map>
 
 // Defend against a caller forcibly passing a negative number into an unsigned
 // size_t index param
@@ -154,7 +159,7 @@ public:
 	virtual const LLSD& ref(size_t) const		{ return undef(); }
 
 	virtual LLSD::map_const_iterator beginMap() const { return endMap(); }
-	virtual LLSD::map_const_iterator endMap() const { static const std::map<String, LLSD> empty; return empty.end(); }
+	virtual LLSD::map_const_iterator endMap() const { return LLSD::map_const_iterator(nullptr); }
 	virtual LLSD::array_const_iterator beginArray() const { return endArray(); }
 	virtual LLSD::array_const_iterator endArray() const { static const std::vector<LLSD> empty; return empty.end(); }
 
@@ -368,24 +373,138 @@ namespace
 	};
 
 
+	// Map keys, each held once however many maps use it, as LLStringTable
+	// holds message names. A key goes away with the last entry using it.
+	// Maps are built on many threads, so the table is split into shards,
+	// each with its own lock.
+	class KeyTable
+	{
+	public:
+		struct Key : public LLSD::String
+		{
+			Key(const LLSD::String& key, U32 shard) : LLSD::String(key), mRefs(1), mShard(shard) { }
+
+			std::atomic<U32>	mRefs;
+			const U32			mShard;
+		};
+
+		// Returns the key with a reference added
+		static const Key& add(const LLSD::String& key);
+		static void addRef(const Key& key);
+		static void release(const Key& key);
+
+	private:
+		static const U32 SHARDS = 16;
+
+		struct Shard
+		{
+			std::mutex								mMutex;
+			// views of the keys' own strings
+			std::unordered_map<std::string_view, Key*>	mKeys;
+		};
+
+		static Shard* shards();
+	};
+
+	KeyTable::Shard* KeyTable::shards()
+	{
+		// never destroyed: static LLSD maps may outlive any static table
+		static Shard* sShards = new Shard[SHARDS];
+		return sShards;
+	}
+
+	const KeyTable::Key& KeyTable::add(const LLSD::String& key)
+	{
+		std::string_view view(key);
+		U32 index = U32(std::hash<std::string_view>()(view) % SHARDS);
+		Shard& shard = shards()[index];
+		std::lock_guard<std::mutex> lock(shard.mMutex);
+		auto found = shard.mKeys.find(view);
+		if (found != shard.mKeys.end())
+		{
+			found->second->mRefs.fetch_add(1, std::memory_order_relaxed);
+			return *found->second;
+		}
+		Key* added = new Key(key, index);
+		shard.mKeys.emplace(std::string_view(*added), added);
+		return *added;
+	}
+
+	void KeyTable::addRef(const Key& key)
+	{
+		// the caller already holds a reference, so the key can't go away
+		const_cast<Key&>(key).mRefs.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	void KeyTable::release(const Key& key)
+	{
+		Key& mutable_key = const_cast<Key&>(key);
+		U32 refs = mutable_key.mRefs.load(std::memory_order_relaxed);
+		while (refs > 1)
+		{
+			if (mutable_key.mRefs.compare_exchange_weak(refs, refs - 1, std::memory_order_release,
+														std::memory_order_relaxed))
+			{
+				return;
+			}
+		}
+		// Maybe the last reference. add() can only find the key under the
+		// lock, so once the count reaches zero under it, nothing else can
+		// revive the key.
+		Shard& shard = shards()[key.mShard];
+		std::lock_guard<std::mutex> lock(shard.mMutex);
+		if (mutable_key.mRefs.fetch_sub(1, std::memory_order_acq_rel) == 1)
+		{
+			shard.mKeys.erase(std::string_view(key));
+			delete &mutable_key;
+		}
+	}
+
+	// A map keeps a sorted index of pointers to its entries, for lookups
+	// and in order iteration. The entries live in blocks that never move,
+	// so a reference to a value stays valid as the map grows, as it did
+	// when this was a std::map. Each new block holds as many entries as
+	// the ones before it, plus the index, moved up from the last block, so
+	// filling a map takes about log2(n) allocations rather than one per
+	// entry. An entry is its key's address and the value, 16 bytes where a
+	// std::map node with its own key string took 72.
 	class ImplMap : public LLSD::Impl
 	{
 	private:
-		typedef std::map<LLSD::String, LLSD>	DataMap;
-		
-		DataMap mData;
-		
+		typedef std::pair<const LLSD::String&, LLSD>	Entry;
+
+		struct Block
+		{
+			Block*	mPrevious;
+			U32		mCapacity;
+			U32		mUsed;
+			U32		mIndexCapacity;
+
+			// The index follows, with room for every entry in this block
+			// and the ones before it, then the entries
+			Entry** index()				{ return reinterpret_cast<Entry**>(this + 1); }
+			Entry* entries()			{ return reinterpret_cast<Entry*>(index() + mIndexCapacity); }
+		};
+		static_assert(sizeof(Block) % alignof(Entry) == 0, "Block must keep the index and entries aligned");
+
+		static const U32 MIN_BLOCK_CAPACITY = 4;
+
+		Block*	mBlocks;	// newest first
+		U32		mSize;
+		void*	mFree;		// erased entries' storage, each pointing to the next
+
 	protected:
-		ImplMap(const DataMap& data) : mData(data) { }
-		
+		ImplMap(const ImplMap& other);
+
 	public:
-		ImplMap() { }
-		
+		ImplMap() : mBlocks(NULL), mSize(0), mFree(NULL) { }
+		~ImplMap();
+
 		virtual ImplMap& makeMap(LLSD::Impl*&);
 
 		virtual LLSD::Type type() const { return LLSD::TypeMap; }
 
-		virtual LLSD::Boolean asBoolean() const { return !mData.empty(); }
+		virtual LLSD::Boolean asBoolean() const { return mSize != 0; }
 
 		virtual bool has(const LLSD::String&) const; 
 
@@ -399,23 +518,66 @@ namespace
 		              LLSD& ref(const LLSD::String&);
 		virtual const LLSD& ref(const LLSD::String&) const;
 
-		virtual size_t size() const { return mData.size(); }
+		virtual size_t size() const { return mSize; }
 
-		LLSD::map_iterator beginMap() { return mData.begin(); }
-		LLSD::map_iterator endMap() { return mData.end(); }
-		virtual LLSD::map_const_iterator beginMap() const { return mData.begin(); }
-		virtual LLSD::map_const_iterator endMap() const { return mData.end(); }
+		LLSD::map_iterator beginMap() { return LLSD::map_iterator(index()); }
+		LLSD::map_iterator endMap() { return LLSD::map_iterator(index() + mSize); }
+		virtual LLSD::map_const_iterator beginMap() const { return LLSD::map_const_iterator(index()); }
+		virtual LLSD::map_const_iterator endMap() const { return LLSD::map_const_iterator(index() + mSize); }
 
 		virtual void dumpStats() const;
 		virtual void calcStats(S32 type_counts[], S32 share_counts[]) const;
+
+	private:
+		Entry** index() const { return mBlocks ? mBlocks->index() : NULL; }
+		// Where k is or would go in the index
+		Entry** lowerBound(const LLSD::String& k) const;
+		const Entry* find(const LLSD::String& k) const;
+		void addBlock(U32 capacity);
+		Entry* add(Entry** where, const KeyTable::Key& k, const LLSD& v);
+		static void destroy(Entry* entry);
 	};
-	
+
+	ImplMap::ImplMap(const ImplMap& other) :
+		LLSD::Impl(),
+		mBlocks(NULL),
+		mSize(0),
+		mFree(NULL)
+	{
+		if (other.mSize)
+		{
+			addBlock(other.mSize);
+			Entry** other_index = other.index();
+			for (U32 i = 0; i < other.mSize; ++i)
+			{
+				const KeyTable::Key& key = static_cast<const KeyTable::Key&>(other_index[i]->first);
+				KeyTable::addRef(key);
+				add(index() + i, key, other_index[i]->second);
+			}
+		}
+	}
+
+	ImplMap::~ImplMap()
+	{
+		Entry** entries = index();
+		for (U32 i = 0; i < mSize; ++i)
+		{
+			destroy(entries[i]);
+		}
+		while (mBlocks)
+		{
+			Block* previous = mBlocks->mPrevious;
+			::operator delete(mBlocks);
+			mBlocks = previous;
+		}
+	}
+
 	ImplMap& ImplMap::makeMap(LLSD::Impl*& var)
 	{
         LL_PROFILE_ZONE_SCOPED_CATEGORY_LLSD;
 		if (shared())
 		{
-			ImplMap* i = new ImplMap(mData);
+			ImplMap* i = new ImplMap(*this);
 			Impl::assign(var, i);
 			return *i;
 		}
@@ -424,30 +586,95 @@ namespace
 			return *this;
 		}
 	}
-	
+
+	ImplMap::Entry** ImplMap::lowerBound(const LLSD::String& k) const
+	{
+		Entry** entries = index();
+		return std::lower_bound(entries, entries + mSize, k,
+								[](const Entry* entry, const LLSD::String& key)
+								{
+									return entry->first < key;
+								});
+	}
+
+	const ImplMap::Entry* ImplMap::find(const LLSD::String& k) const
+	{
+		Entry** i = lowerBound(k);
+		return (i != index() + mSize && (*i)->first == k) ? *i : NULL;
+	}
+
+	void ImplMap::addBlock(U32 capacity)
+	{
+		U32 index_capacity = (mBlocks ? mBlocks->mIndexCapacity : 0) + capacity;
+		Block* block = static_cast<Block*>(::operator new(sizeof(Block) + index_capacity * sizeof(Entry*)
+														  + capacity * sizeof(Entry)));
+		block->mPrevious = mBlocks;
+		block->mCapacity = capacity;
+		block->mUsed = 0;
+		block->mIndexCapacity = index_capacity;
+		if (mSize)
+		{
+			memcpy(block->index(), mBlocks->index(), mSize * sizeof(Entry*));		/* Flawfinder: ignore */
+		}
+		mBlocks = block;
+	}
+
+	ImplMap::Entry* ImplMap::add(Entry** where, const KeyTable::Key& k, const LLSD& v)
+	{
+		// addBlock() moves the index
+		size_t offset = where - index();
+		void* storage;
+		if (mFree)
+		{
+			storage = mFree;
+			mFree = *static_cast<void**>(storage);
+		}
+		else
+		{
+			if (!mBlocks || mBlocks->mUsed == mBlocks->mCapacity)
+			{
+				// every entry is in use
+				addBlock(llmax(MIN_BLOCK_CAPACITY, mSize));
+			}
+			storage = mBlocks->entries() + mBlocks->mUsed++;
+		}
+		Entry* entry = new (storage) Entry(k, v);
+
+		Entry** entries = index();
+		memmove(entries + offset + 1, entries + offset, (mSize - offset) * sizeof(Entry*));
+		entries[offset] = entry;
+		++mSize;
+		return entry;
+	}
+
+	void ImplMap::destroy(Entry* entry)
+	{
+		const KeyTable::Key& key = static_cast<const KeyTable::Key&>(entry->first);
+		entry->~Entry();
+		KeyTable::release(key);
+	}
+
 	bool ImplMap::has(const LLSD::String& k) const
 	{
         LL_PROFILE_ZONE_SCOPED_CATEGORY_LLSD;
-		DataMap::const_iterator i = mData.find(k);
-		return i != mData.end();
+		return find(k) != NULL;
 	}
 	
 	LLSD ImplMap::get(const LLSD::String& k) const
 	{
         LL_PROFILE_ZONE_SCOPED_CATEGORY_LLSD;
-		DataMap::const_iterator i = mData.find(k);
-		return (i != mData.end()) ? i->second : LLSD();
+		const Entry* entry = find(k);
+		return entry ? entry->second : LLSD();
 	}
 
 	LLSD ImplMap::getKeys() const
 	{ 
         LL_PROFILE_ZONE_SCOPED_CATEGORY_LLSD;
 		LLSD keys = LLSD::emptyArray();
-		DataMap::const_iterator iter = mData.begin();
-		while (iter != mData.end())
+		Entry** entries = index();
+		for (U32 i = 0; i < mSize; ++i)
 		{
-			keys.append((*iter).first);
-			iter++;
+			keys.append(entries[i]->first);
 		}
 		return keys;
 	}
@@ -455,34 +682,49 @@ namespace
 	void ImplMap::insert(const LLSD::String& k, const LLSD& v)
 	{
         LL_PROFILE_ZONE_SCOPED_CATEGORY_LLSD;
-		mData.insert(DataMap::value_type(k, v));
+		// as std::map::insert(), leaves an existing entry alone
+		Entry** i = lowerBound(k);
+		if (i == index() + mSize || (*i)->first != k)
+		{
+			add(i, KeyTable::add(k), v);
+		}
 	}
 	
 	void ImplMap::erase(const LLSD::String& k)
 	{
         LL_PROFILE_ZONE_SCOPED_CATEGORY_LLSD;
-		mData.erase(k);
+		Entry** i = lowerBound(k);
+		Entry** end = index() + mSize;
+		if (i != end && (*i)->first == k)
+		{
+			Entry* entry = *i;
+			memmove(i, i + 1, (end - i - 1) * sizeof(Entry*));
+			--mSize;
+			destroy(entry);
+			*reinterpret_cast<void**>(entry) = mFree;
+			mFree = entry;
+		}
 	}
 	
 	LLSD& ImplMap::ref(const LLSD::String& k)
 	{
-		return mData[k];
+		Entry** i = lowerBound(k);
+		if (i != index() + mSize && (*i)->first == k)
+		{
+			return (*i)->second;
+		}
+		return add(i, KeyTable::add(k), LLSD())->second;
 	}
 	
 	const LLSD& ImplMap::ref(const LLSD::String& k) const
 	{
-		DataMap::const_iterator i = mData.lower_bound(k);
-		if (i == mData.end()  ||  mData.key_comp()(k, i->first))
-		{
-			return undef();
-		}
-		
-		return i->second;
+		const Entry* entry = find(k);
+		return entry ? entry->second : undef();
 	}
 
 	void ImplMap::dumpStats() const
 	{
-		std::cout << "Map size: " << mData.size() << std::endl;
+		std::cout << "Map size: " << mSize << std::endl;
 
 		std::cout << "LLSD Net Objects: " << llsd::sLLSDNetObjects << std::endl;
 		std::cout << "LLSD allocations: " << llsd::sLLSDAllocationCount << std::endl;
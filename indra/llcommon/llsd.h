@@ -30,6 +30,7 @@
 #include <map>
 #include <string>
 #include <vector>
+#include <boost/iterator/indirect_iterator.hpp>
 
 #include "stdtypes.h"
 
@@ -342,8 +343,11 @@ public:
 	//@{
 		size_t size() const;
 
-		typedef std::map<String, LLSD>::iterator		map_iterator;
-		typedef std::map<String, LLSD>::const_iterator	map_const_iterator;
+		// Dereference to a std::pair of key and value, in key order. Maps
+		// share their keys, so the pair holds a reference to its key.
+		typedef boost::indirect_iterator<std::pair<const String&, LLSD>* const*>	map_iterator;
+		typedef boost::indirect_iterator<std::pair<const String&, LLSD>* const*,
+										 const std::pair<const String&, LLSD> >	map_const_iterator;
 		
 		map_iterator		beginMap();
 		map_iterator		endMap();
@@ -0,0 +1,1063 @@
+/**
+ * @file llsdsaxparser.cpp
+ * @brief Streaming parsers for binary and notation LLSD.
+ *
+ * $LicenseInfo:firstyear=2024&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2024, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+
+#include "llsdsaxparser.h"
+
+#include <charconv>
+#include <sstream>
+
+#include "apr_base64.h"
+
+#include "lldate.h"
+#include "llstring.h"
+#include "lluri.h"
+
+namespace
+{
+	// Receives the values of skipped subtrees
+	LLSDSAXHandler sSkipHandler;
+
+	// LLSDBinaryParser reads the sizes of strings, maps and so on as
+	// network order S32s
+	S32 read_s32_nbo(const char* p)
+	{
+		const U8* bytes = (const U8*)p;
+		return (S32)((U32(bytes[0]) << 24) | (U32(bytes[1]) << 16) | (U32(bytes[2]) << 8) | U32(bytes[3]));
+	}
+
+	F64 read_f64_nbo(const char* p)
+	{
+		const U8* bytes = (const U8*)p;
+		U64 bits = 0;
+		for (S32 i = 0; i < 8; ++i)
+		{
+			bits = (bits << 8) | bytes[i];
+		}
+		F64 value;
+		memcpy(&value, &bits, sizeof(value));		/* Flawfinder: ignore */
+		return value;
+	}
+
+	bool is_space(char c)
+	{
+		return isspace((unsigned char)c) != 0;
+	}
+
+	S32 hex_value(char c)
+	{
+		if (c >= '0' && c <= '9')
+		{
+			return c - '0';
+		}
+		if (c >= 'a' && c <= 'f')
+		{
+			return c - 'a' + 10;
+		}
+		if (c >= 'A' && c <= 'F')
+		{
+			return c - 'A' + 10;
+		}
+		return -1;
+	}
+
+	// Reads a UUID in the usual 8-4-4-4-12 form without the std::string
+	// LLUUID::set() makes. Anything else is left to LLUUID::set().
+	bool parse_canonical_uuid(const char* buf, LLUUID& id)
+	{
+		for (S32 i = 0; i < UUID_BYTES; ++i)
+		{
+			if (4 == i || 6 == i || 8 == i || 10 == i)
+			{
+				if (*buf++ != '-')
+				{
+					return false;
+				}
+			}
+			S32 high = hex_value(buf[0]);
+			S32 low = hex_value(buf[1]);
+			if (high < 0 || low < 0)
+			{
+				return false;
+			}
+			id.mData[i] = (U8)((high << 4) | low);
+			buf += 2;
+		}
+		return true;
+	}
+}
+
+/**
+ * LLSDSAXBuilder
+ */
+LLSDSAXBuilder::LLSDSAXBuilder(LLSD& result) :
+	mResult(result),
+	mComplete(false)
+{
+}
+
+LLSD* LLSDSAXBuilder::add(const LLSD& value)
+{
+	if (mContainers.empty())
+	{
+		mResult = value;
+		mComplete = !value.isMap() && !value.isArray();
+		return &mResult;
+	}
+
+	LLSD* container = mContainers.back();
+	if (container->isArray())
+	{
+		return &container->append(value);
+	}
+	if (container->has(mKey))
+	{
+		return NULL;
+	}
+	LLSD& entry = (*container)[mKey];
+	entry = value;
+	return &entry;
+}
+
+LLSDSAXHandler::EAction LLSDSAXBuilder::undefined()
+{
+	add(LLSD());
+	return CONTINUE;
+}
+
+LLSDSAXHandler::EAction LLSDSAXBuilder::boolean(bool value)
+{
+	add(LLSD(value));
+	return CONTINUE;
+}
+
+LLSDSAXHandler::EAction LLSDSAXBuilder::integer(S32 value)
+{
+	add(LLSD(value));
+	return CONTINUE;
+}
+
+LLSDSAXHandler::EAction LLSDSAXBuilder::real(F64 value)
+{
+	add(LLSD(value));
+	return CONTINUE;
+}
+
+LLSDSAXHandler::EAction LLSDSAXBuilder::uuid(const LLUUID& value)
+{
+	add(LLSD(value));
+	return CONTINUE;
+}
+
+LLSDSAXHandler::EAction LLSDSAXBuilder::string(std::string_view value)
+{
+	add(LLSD(std::string(value)));
+	return CONTINUE;
+}
+
+LLSDSAXHandler::EAction LLSDSAXBuilder::date(const LLDate& value)
+{
+	add(LLSD(value));
+	return CONTINUE;
+}
+
+LLSDSAXHandler::EAction LLSDSAXBuilder::uri(std::string_view value)
+{
+	add(LLSD(LLURI(std::string(value))));
+	return CONTINUE;
+}
+
+LLSDSAXHandler::EAction LLSDSAXBuilder::binary(const U8* data, size_t size)
+{
+	add(LLSD(LLSD::Binary(data, data + size)));
+	return CONTINUE;
+}
+
+LLSDSAXHandler::EAction LLSDSAXBuilder::beginMap(S32 size)
+{
+	LLSD* map = add(LLSD::emptyMap());
+	if (!map)
+	{
+		return SKIP;
+	}
+	mContainers.push_back(map);
+	return CONTINUE;
+}
+
+LLSDSAXHandler::EAction LLSDSAXBuilder::key(std::string_view key)
+{
+	mKey.assign(key.data(), key.size());
+	return CONTINUE;
+}
+
+LLSDSAXHandler::EAction LLSDSAXBuilder::endMap()
+{
+	mContainers.pop_back();
+	mComplete = mContainers.empty();
+	return CONTINUE;
+}
+
+LLSDSAXHandler::EAction LLSDSAXBuilder::beginArray(S32 size)
+{
+	LLSD* array = add(LLSD::emptyArray());
+	if (!array)
+	{
+		return SKIP;
+	}
+	mContainers.push_back(array);
+	return CONTINUE;
+}
+
+LLSDSAXHandler::EAction LLSDSAXBuilder::endArray()
+{
+	mContainers.pop_back();
+	mComplete = mContainers.empty();
+	return CONTINUE;
+}
+
+/**
+ * LLSDSAXParser
+ */
+LLSDSAXParser::LLSDSAXParser() :
+	mStart(NULL),
+	mPos(NULL),
+	mEnd(NULL),
+	mCount(0),
+	mStopped(false)
+{
+}
+
+S32 LLSDSAXParser::finishParse(bool success)
+{
+	return (success || mStopped) ? mCount : S32(PARSE_FAILURE);
+}
+
+bool LLSDSAXParser::call(LLSDSAXHandler::EAction action)
+{
+	if (LLSDSAXHandler::STOP == action)
+	{
+		mStopped = true;
+		return false;
+	}
+	return true;
+}
+
+bool LLSDSAXParser::readDelimitedString(char delim, std::string_view& value)
+{
+	// Without escapes the string can stay in the buffer
+	const char* start = mPos;
+	const char* p = start;
+	while (p < mEnd && *p != delim && *p != '\\')
+	{
+		++p;
+	}
+	if (p >= mEnd)
+	{
+		return false;
+	}
+	if (*p == delim)
+	{
+		value = std::string_view(start, p - start);
+		mPos = p + 1;
+		return true;
+	}
+
+	// Unescape the way deserialize_string_delim() does
+	mScratch.assign(start, p - start);
+	mPos = p;
+	while (true)
+	{
+		if (mPos >= mEnd)
+		{
+			return false;
+		}
+		char c = *mPos++;
+		if (c == delim)
+		{
+			break;
+		}
+		if (c != '\\')
+		{
+			mScratch += c;
+			continue;
+		}
+
+		if (mPos >= mEnd)
+		{
+			return false;
+		}
+		c = *mPos++;
+		switch (c)
+		{
+		case 'x':
+			if (mEnd - mPos < 2)
+			{
+				return false;
+			}
+			mScratch += (char)((hex_as_nybble(mPos[0]) << 4) | hex_as_nybble(mPos[1]));
+			mPos += 2;
+			break;
+		case 'a':
+			mScratch += '\a';
+			break;
+		case 'b':
+			mScratch += '\b';
+			break;
+		case 'f':
+			mScratch += '\f';
+			break;
+		case 'n':
+			mScratch += '\n';
+			break;
+		case 'r':
+			mScratch += '\r';
+			break;
+		case 't':
+			mScratch += '\t';
+			break;
+		case 'v':
+			mScratch += '\v';
+			break;
+		default:
+			mScratch += c;
+			break;
+		}
+	}
+	value = mScratch;
+	return true;
+}
+
+/**
+ * Binary
+ */
+S32 LLSDSAXParser::parseBinary(const char* buf, llssize size, LLSDSAXHandler& handler, S32 max_depth)
+{
+	LL_PROFILE_ZONE_SCOPED_CATEGORY_LLSD;
+	mStart = mPos = buf;
+	mEnd = buf + size;
+	mCount = 0;
+	mStopped = false;
+	if (mPos >= mEnd)
+	{
+		return 0;
+	}
+	return finishParse(parseBinaryValue(handler, max_depth));
+}
+
+bool LLSDSAXParser::readBinarySize(S32& size)
+{
+	if (mEnd - mPos < 4)
+	{
+		return false;
+	}
+	size = read_s32_nbo(mPos);
+	mPos += 4;
+	return true;
+}
+
+bool LLSDSAXParser::readBinaryString(std::string_view& value)
+{
+	S32 size = 0;
+	if (!readBinarySize(size) || size < 0 || size > mEnd - mPos)
+	{
+		return false;
+	}
+	value = std::string_view(mPos, size);
+	mPos += size;
+	return true;
+}
+
+bool LLSDSAXParser::parseBinaryValue(LLSDSAXHandler& handler, S32 max_depth)
+{
+	// See LLSDBinaryParser::doParse() for the format
+	if (mPos >= mEnd || 0 == max_depth)
+	{
+		return false;
+	}
+	++mCount;
+
+	char c = *mPos++;
+	switch (c)
+	{
+	case '{':
+		return parseBinaryMap(handler, max_depth - 1);
+
+	case '[':
+		return parseBinaryArray(handler, max_depth - 1);
+
+	case '!':
+		return call(handler.undefined());
+
+	case '0':
+		return call(handler.boolean(false));
+
+	case '1':
+		return call(handler.boolean(true));
+
+	case 'i':
+	{
+		S32 value = 0;
+		return readBinarySize(value) && call(handler.integer(value));
+	}
+
+	case 'r':
+	{
+		if (mEnd - mPos < 8)
+		{
+			return false;
+		}
+		F64 value = read_f64_nbo(mPos);
+		mPos += 8;
+		return call(handler.real(value));
+	}
+
+	case 'u':
+	{
+		if (mEnd - mPos < UUID_BYTES)
+		{
+			return false;
+		}
+		LLUUID id;
+		memcpy(id.mData, mPos, UUID_BYTES);		/* Flawfinder: ignore */
+		mPos += UUID_BYTES;
+		return call(handler.uuid(id));
+	}
+
+	case '\'':
+	case '"':
+	{
+		std::string_view value;
+		return readDelimitedString(c, value) && call(handler.string(value));
+	}
+
+	case 's':
+	{
+		std::string_view value;
+		return readBinaryString(value) && call(handler.string(value));
+	}
+
+	case 'l':
+	{
+		std::string_view value;
+		return readBinaryString(value) && call(handler.uri(value));
+	}
+
+	case 'd':
+	{
+		// dates go in host order
+		if (mEnd - mPos < 8)
+		{
+			return false;
+		}
+		F64 seconds;
+		memcpy(&seconds, mPos, sizeof(seconds));		/* Flawfinder: ignore */
+		mPos += 8;
+		return call(handler.date(LLDate(seconds)));
+	}
+
+	case 'b':
+	{
+		S32 size = 0;
+		if (!readBinarySize(size) || size < 0 || size > mEnd - mPos)
+		{
+			return false;
+		}
+		const U8* data = (const U8*)mPos;
+		mPos += size;
+		return call(handler.binary(data, size));
+	}
+
+	default:
+		return false;
+	}
+}
+
+bool LLSDSAXParser::parseBinaryMap(LLSDSAXHandler& handler, S32 max_depth)
+{
+	S32 size = 0;
+	if (!readBinarySize(size))
+	{
+		return false;
+	}
+	LLSDSAXHandler::EAction action = handler.beginMap(llmax(size, 0));
+	if (!call(action))
+	{
+		return false;
+	}
+	LLSDSAXHandler& entries = (LLSDSAXHandler::SKIP == action) ? sSkipHandler : handler;
+
+	for (S32 i = 0; i < size; ++i)
+	{
+		if (mPos >= mEnd)
+		{
+			return false;
+		}
+		char c = *mPos++;
+		std::string_view key;
+		switch (c)
+		{
+		case 'k':
+			if (!readBinaryString(key))
+			{
+				return false;
+			}
+			break;
+		case '\'':
+		case '"':
+			if (!readDelimitedString(c, key))
+			{
+				return false;
+			}
+			break;
+		case '}':
+			// fewer entries than it said
+			return false;
+		default:
+			// LLSDBinaryParser takes anything else for an empty key
+			break;
+		}
+
+		LLSDSAXHandler::EAction key_action = entries.key(key);
+		if (!call(key_action)
+			|| !parseBinaryValue((LLSDSAXHandler::SKIP == key_action) ? sSkipHandler : entries, max_depth))
+		{
+			return false;
+		}
+	}
+
+	if (mPos >= mEnd || *mPos++ != '}')
+	{
+		return false;
+	}
+	return LLSDSAXHandler::SKIP == action || call(handler.endMap());
+}
+
+bool LLSDSAXParser::parseBinaryArray(LLSDSAXHandler& handler, S32 max_depth)
+{
+	S32 size = 0;
+	if (!readBinarySize(size))
+	{
+		return false;
+	}
+	LLSDSAXHandler::EAction action = handler.beginArray(llmax(size, 0));
+	if (!call(action))
+	{
+		return false;
+	}
+	LLSDSAXHandler& elements = (LLSDSAXHandler::SKIP == action) ? sSkipHandler : handler;
+
+	for (S32 i = 0; i < size; ++i)
+	{
+		if (mPos >= mEnd || *mPos == ']' || !parseBinaryValue(elements, max_depth))
+		{
+			return false;
+		}
+	}
+
+	if (mPos >= mEnd || *mPos++ != ']')
+	{
+		return false;
+	}
+	return LLSDSAXHandler::SKIP == action || call(handler.endArray());
+}
+
+/**
+ * Notation
+ */
+S32 LLSDSAXParser::parseNotation(const char* buf, llssize size, LLSDSAXHandler& handler, S32 max_depth)
+{
+	LL_PROFILE_ZONE_SCOPED_CATEGORY_LLSD;
+	mStart = mPos = buf;
+	mEnd = buf + size;
+	mCount = 0;
+	mStopped = false;
+	if (0 == max_depth)
+	{
+		return PARSE_FAILURE;
+	}
+	while (mPos < mEnd && is_space(*mPos))
+	{
+		++mPos;
+	}
+	if (mPos >= mEnd)
+	{
+		return 0;
+	}
+	return finishParse(parseNotationValue(handler, max_depth));
+}
+
+bool LLSDSAXParser::parseNotationValue(LLSDSAXHandler& handler, S32 max_depth)
+{
+	// See LLSDNotationParser::doParse() for the format
+	if (0 == max_depth)
+	{
+		return false;
+	}
+	while (mPos < mEnd && is_space(*mPos))
+	{
+		++mPos;
+	}
+	if (mPos >= mEnd)
+	{
+		return false;
+	}
+	++mCount;
+
+	switch (*mPos)
+	{
+	case '{':
+		++mPos;
+		return parseNotationMap(handler, max_depth - 1);
+
+	case '[':
+		++mPos;
+		return parseNotationArray(handler, max_depth - 1);
+
+	case '!':
+		++mPos;
+		return call(handler.undefined());
+
+	case '0':
+		++mPos;
+		return call(handler.boolean(false));
+
+	case '1':
+		++mPos;
+		return call(handler.boolean(true));
+
+	case 'F':
+	case 'f':
+		++mPos;
+		return parseNotationBoolean(handler, false);
+
+	case 'T':
+	case 't':
+		++mPos;
+		return parseNotationBoolean(handler, true);
+
+	case 'i':
+		++mPos;
+		return parseNotationInteger(handler);
+
+	case 'r':
+		++mPos;
+		return parseNotationReal(handler);
+
+	case 'u':
+		++mPos;
+		return parseNotationUUID(handler);
+
+	case '"':
+	case '\'':
+	case 's':
+	{
+		std::string_view value;
+		return readNotationString(value) && call(handler.string(value));
+	}
+
+	case 'l':
+	case 'd':
+	{
+		// l"escaped" and d"YYYY-MM-DDTHH:MM:SS.FFZ", with whatever
+		// follows the type as the delimiter
+		char type = *mPos++;
+		if (mPos >= mEnd)
+		{
+			return false;
+		}
+		char delim = *mPos++;
+		std::string_view value;
+		if (!readDelimitedString(delim, value))
+		{
+			return false;
+		}
+		if ('l' == type)
+		{
+			return call(handler.uri(value));
+		}
+		return call(handler.date(LLDate(std::string(value))));
+	}
+
+	case 'b':
+		return parseNotationBinary(handler);
+
+	default:
+		return false;
+	}
+}
+
+bool LLSDSAXParser::parseNotationMap(LLSDSAXHandler& handler, S32 max_depth)
+{
+	// { string:object, string:object }
+	LLSDSAXHandler::EAction action = handler.beginMap(-1);
+	if (!call(action))
+	{
+		return false;
+	}
+	LLSDSAXHandler& entries = (LLSDSAXHandler::SKIP == action) ? sSkipHandler : handler;
+
+	// Like LLSDNotationParser, passes over anything but a key until it
+	// finds one, then anything but whitespace and ':' is the value
+	bool found_key = false;
+	std::string_view key;
+	while (true)
+	{
+		if (mPos >= mEnd)
+		{
+			return false;
+		}
+		char c = *mPos;
+		if ('}' == c)
+		{
+			++mPos;
+			break;
+		}
+		if (!found_key)
+		{
+			if (('"' == c) || ('\'' == c) || ('s' == c))
+			{
+				if (!readNotationString(key))
+				{
+					return false;
+				}
+				found_key = true;
+			}
+			else
+			{
+				++mPos;
+			}
+		}
+		else if (is_space(c) || (':' == c))
+		{
+			++mPos;
+		}
+		else
+		{
+			LLSDSAXHandler::EAction key_action = entries.key(key);
+			if (!call(key_action)
+				|| !parseNotationValue((LLSDSAXHandler::SKIP == key_action) ? sSkipHandler : entries, max_depth))
+			{
+				return false;
+			}
+			found_key = false;
+		}
+	}
+	return LLSDSAXHandler::SKIP == action || call(handler.endMap());
+}
+
+bool LLSDSAXParser::parseNotationArray(LLSDSAXHandler& handler, S32 max_depth)
+{
+	// [ object, object, object ]
+	LLSDSAXHandler::EAction action = handler.beginArray(-1);
+	if (!call(action))
+	{
+		return false;
+	}
+	LLSDSAXHandler& elements = (LLSDSAXHandler::SKIP == action) ? sSkipHandler : handler;
+
+	while (true)
+	{
+		if (mPos >= mEnd)
+		{
+			return false;
+		}
+		char c = *mPos;
+		if (']' == c)
+		{
+			++mPos;
+			break;
+		}
+		if (is_space(c) || (',' == c))
+		{
+			++mPos;
+			continue;
+		}
+		if (!parseNotationValue(elements, max_depth))
+		{
+			return false;
+		}
+	}
+	return LLSDSAXHandler::SKIP == action || call(handler.endArray());
+}
+
+bool LLSDSAXParser::parseNotationBoolean(LLSDSAXHandler& handler, bool value)
+{
+	// t and f can be spelled out, in any case
+	if (mPos < mEnd && isalpha((unsigned char)*mPos))
+	{
+		const char* word = value ? "true" : "false";
+		for (const char* p = word + 1; *p; ++p)
+		{
+			if (mPos >= mEnd || tolower((unsigned char)*mPos) != *p)
+			{
+				return false;
+			}
+			++mPos;
+		}
+	}
+	return call(handler.boolean(value));
+}
+
+bool LLSDSAXParser::parseNotationInteger(LLSDSAXHandler& handler)
+{
+	// What operator>> takes for an S32
+	while (mPos < mEnd && is_space(*mPos))
+	{
+		++mPos;
+	}
+	bool negative = false;
+	if (mPos < mEnd && (('-' == *mPos) || ('+' == *mPos)))
+	{
+		negative = ('-' == *mPos);
+		++mPos;
+	}
+	const char* digits = mPos;
+	S64 value = 0;
+	while (mPos < mEnd && isdigit((unsigned char)*mPos))
+	{
+		value = value * 10 + (*mPos++ - '0');
+		if (value > S64(S32_MAX) + 1)
+		{
+			return false;
+		}
+	}
+	if (mPos == digits)
+	{
+		return false;
+	}
+	if (negative)
+	{
+		value = -value;
+	}
+	if (value > S32_MAX)
+	{
+		return false;
+	}
+	return call(handler.integer((S32)value));
+}
+
+bool LLSDSAXParser::parseNotationReal(LLSDSAXHandler& handler)
+{
+	// What operator>> takes for an F64, which doesn't include nan, inf or
+	// hex. Whatever the C locale, '.' is the decimal point.
+	while (mPos < mEnd && is_space(*mPos))
+	{
+		++mPos;
+	}
+	const char* start = mPos;
+	if (start < mEnd && '+' == *start)
+	{
+		++start;
+	}
+	const char* number = start;
+	if (number < mEnd && '-' == *number)
+	{
+		++number;
+	}
+	if (number >= mEnd || !(isdigit((unsigned char)*number) || '.' == *number))
+	{
+		return false;
+	}
+
+	F64 value = 0.0;
+#if defined(__cpp_lib_to_chars) && __cpp_lib_to_chars >= 201611L
+	std::from_chars_result result = std::from_chars(start, mEnd, value);
+	if (result.ec != std::errc())
+	{
+		return false;
+	}
+	mPos = result.ptr;
+#else
+	const char* end = start;
+	while (end < mEnd && (isdigit((unsigned char)*end) || ('.' == *end) || ('e' == *end) || ('E' == *end)
+						  || ('+' == *end) || ('-' == *end)))
+	{
+		++end;
+	}
+	mScratch.assign(start, end - start);
+	std::istringstream stream(mScratch);
+	stream.imbue(std::locale::classic());
+	stream >> value;
+	if (stream.fail())
+	{
+		return false;
+	}
+	std::streampos used = stream.tellg();
+	mPos = start + ((used < 0) ? mScratch.size() : (size_t)used);
+#endif
+	return call(handler.real(value));
+}
+
+bool LLSDSAXParser::parseNotationUUID(LLSDSAXHandler& handler)
+{
+	// 36 characters, skipping whitespace as operator>> does
+	char buf[UUID_STR_LENGTH];		/* Flawfinder: ignore */
+	S32 length = 0;
+	while (length < UUID_STR_LENGTH - 1)
+	{
+		if (mPos >= mEnd)
+		{
+			return false;
+		}
+		char c = *mPos++;
+		if (!is_space(c))
+		{
+			buf[length++] = c;
+		}
+	}
+	buf[length] = '\0';
+	LLUUID id;
+	if (!parse_canonical_uuid(buf, id))
+	{
+		id.set(buf);
+	}
+	return call(handler.uuid(id));
+}
+
+bool LLSDSAXParser::readNotationString(std::string_view& value)
+{
+	// "g'day" | 'have a "nice" day' | s(size)"raw data"
+	if (mPos >= mEnd)
+	{
+		return false;
+	}
+	char c = *mPos++;
+	if (('"' == c) || ('\'' == c))
+	{
+		return readDelimitedString(c, value);
+	}
+	return ('s' == c) && readRawString(value);
+}
+
+bool LLSDSAXParser::readRawString(std::string_view& value)
+{
+	// (size)"raw data", read as deserialize_string_raw() does: up to 18
+	// characters to the ')', skip one, and then the quote
+	const S32 MAX_SIZE_LENGTH = 18;
+	const char* open = mPos;
+	const char* close = open;
+	while (close < mEnd && close - open < MAX_SIZE_LENGTH && *close != ')')
+	{
+		++close;
+	}
+	if (mEnd - close < 2 || close == open || *open != '(')
+	{
+		return false;
+	}
+	char quote = close[1];
+	if (('"' != quote) && ('\'' != quote))
+	{
+		return false;
+	}
+
+	char size_buf[MAX_SIZE_LENGTH + 1];		/* Flawfinder: ignore */
+	memcpy(size_buf, open + 1, close - open - 1);		/* Flawfinder: ignore */
+	size_buf[close - open - 1] = '\0';
+	long size = strtol(size_buf, NULL, 0);
+
+	mPos = close + 2;
+	// the data and a closing quote
+	if (size < 0 || size >= mEnd - mPos)
+	{
+		return false;
+	}
+	value = std::string_view(mPos, size);
+	mPos += size;
+	char end_quote = *mPos++;
+	return ('"' == end_quote) || ('\'' == end_quote);
+}
+
+bool LLSDSAXParser::parseNotationBinary(LLSDSAXHandler& handler)
+{
+	// b(size)"raw data" | b64"base 64" | b16"ff3120ab1"; as in
+	// LLSDNotationParser::parseBinary(), the part up to the first quote
+	// says which
+	const S32 MAX_HEADER_LENGTH = 254;
+	const char* header = mPos;
+	const char* quote = header;
+	while (quote < mEnd && quote - header < MAX_HEADER_LENGTH && *quote != '"')
+	{
+		++quote;
+	}
+	if (quote >= mEnd || *quote != '"')
+	{
+		return false;
+	}
+	size_t header_length = quote - header;
+	mPos = quote + 1;
+
+	if (header_length >= 2 && !strncmp(header, "b(", 2))
+	{
+		char size_buf[MAX_HEADER_LENGTH + 1];		/* Flawfinder: ignore */
+		memcpy(size_buf, header + 2, header_length - 2);		/* Flawfinder: ignore */
+		size_buf[header_length - 2] = '\0';
+		long size = strtol(size_buf, NULL, 0);
+		// the data, and a closing quote LLSDNotationParser doesn't check
+		if (size < 0 || size >= mEnd - mPos)
+		{
+			return false;
+		}
+		const U8* data = (const U8*)mPos;
+		mPos += size + 1;
+		return call(handler.binary(data, size));
+	}
+
+	if (header_length < 3 || (strncmp(header, "b64", 3) && strncmp(header, "b16", 3)))
+	{
+		return false;
+	}
+	const char* end = (const char*)memchr(mPos, '"', mEnd - mPos);
+	if (!end)
+	{
+		return false;
+	}
+
+	if ('6' == header[1])
+	{
+		mScratch.assign(mPos, end - mPos);
+		mPos = end + 1;
+		S32 size = apr_base64_decode_len(mScratch.c_str());
+		mBinaryScratch.resize(size);
+		if (size)
+		{
+			size = apr_base64_decode_binary(&mBinaryScratch[0], mScratch.c_str());
+		}
+		return call(handler.binary(mBinaryScratch.data(), size));
+	}
+
+	if ((end - mPos) % 2)
+	{
+		return false;
+	}
+	mBinaryScratch.clear();
+	for (; mPos < end; mPos += 2)
+	{
+		mBinaryScratch.push_back((U8)((hex_as_nybble(mPos[0]) << 4) | hex_as_nybble(mPos[1])));
+	}
+	++mPos;
+	return call(handler.binary(mBinaryScratch.data(), mBinaryScratch.size()));
+}
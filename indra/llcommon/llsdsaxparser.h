@@ -0,0 +1,222 @@
+/**
+ * @file llsdsaxparser.h
+ * @brief Streaming parsers for binary and notation LLSD.
+ *
+ * @Description:
+ * LLSDBinaryParser and LLSDNotationParser always build a whole LLSD tree,
+ * with a map node and a std::string per key, even when the caller wants a
+ * handful of fields out of it. LLSDSAXParser walks the same formats in a
+ * buffer and reports each value to an LLSDSAXHandler as it goes, so a
+ * handler can decode straight into its own structures and skip subtrees
+ * it has no use for. Strings, keys and binary values are passed as views
+ * into the buffer wherever the format allows; a parser keeps its scratch
+ * space between parses, so reusing one makes parsing allocation free.
+ *
+ * $LicenseInfo:firstyear=2024&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2024, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#ifndef LL_LLSDSAXPARSER_H
+#define LL_LLSDSAXPARSER_H
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "llsd.h"
+
+/**
+ * @class LLSDSAXHandler
+ * @brief Receives the values LLSDSAXParser finds, in document order.
+ *
+ * Every callback does nothing by default, so a handler overrides only
+ * what it's interested in. The views passed to string(), uri(), key() and
+ * binary() are only valid until the callback returns.
+ */
+class LL_COMMON_API LLSDSAXHandler
+{
+public:
+	enum EAction
+	{
+		CONTINUE,
+		// From key(): skip the value. From beginMap() or beginArray():
+		// skip the contents, and the endMap() or endArray(). Elsewhere
+		// the same as CONTINUE.
+		SKIP,
+		// End the parse here
+		STOP
+	};
+
+	virtual ~LLSDSAXHandler() {}
+
+	virtual EAction undefined()							{ return CONTINUE; }
+	virtual EAction boolean(bool value)					{ return CONTINUE; }
+	virtual EAction integer(S32 value)					{ return CONTINUE; }
+	virtual EAction real(F64 value)						{ return CONTINUE; }
+	virtual EAction uuid(const LLUUID& value)			{ return CONTINUE; }
+	virtual EAction string(std::string_view value)		{ return CONTINUE; }
+	virtual EAction date(const LLDate& value)			{ return CONTINUE; }
+	virtual EAction uri(std::string_view value)			{ return CONTINUE; }
+	virtual EAction binary(const U8* data, size_t size)	{ return CONTINUE; }
+
+	/**
+	 * @brief Starts a map; key() and a value follow for each entry.
+	 *
+	 * @param size The number of entries, or -1 where the format doesn't
+	 * say (notation).
+	 */
+	virtual EAction beginMap(S32 size)					{ return CONTINUE; }
+	virtual EAction key(std::string_view key)			{ return CONTINUE; }
+	virtual EAction endMap()							{ return CONTINUE; }
+
+	/**
+	 * @brief Starts an array.
+	 *
+	 * @param size The number of elements, or -1 where the format doesn't
+	 * say (notation).
+	 */
+	virtual EAction beginArray(S32 size)				{ return CONTINUE; }
+	virtual EAction endArray()							{ return CONTINUE; }
+};
+
+/**
+ * @class LLSDSAXBuilder
+ * @brief Handler that builds the LLSD LLSDBinaryParser or
+ * LLSDNotationParser would have.
+ *
+ * Handy for the parts of a document a handler does want as LLSD: forward
+ * the callbacks for that subtree to a builder.
+ */
+class LL_COMMON_API LLSDSAXBuilder : public LLSDSAXHandler
+{
+public:
+	LLSDSAXBuilder(LLSD& result);
+
+	EAction undefined() override;
+	EAction boolean(bool value) override;
+	EAction integer(S32 value) override;
+	EAction real(F64 value) override;
+	EAction uuid(const LLUUID& value) override;
+	EAction string(std::string_view value) override;
+	EAction date(const LLDate& value) override;
+	EAction uri(std::string_view value) override;
+	EAction binary(const U8* data, size_t size) override;
+	EAction beginMap(S32 size) override;
+	EAction key(std::string_view key) override;
+	EAction endMap() override;
+	EAction beginArray(S32 size) override;
+	EAction endArray() override;
+
+	// True once a whole value has been built
+	bool isComplete() const								{ return mComplete; }
+
+private:
+	// Adds value where the next value goes, and returns it, or NULL if
+	// its key is already in the map, which keeps the first value
+	LLSD* add(const LLSD& value);
+
+	LLSD&				mResult;
+	std::vector<LLSD*>	mContainers;
+	std::string			mKey;
+	bool				mComplete;
+};
+
+/**
+ * @class LLSDSAXParser
+ * @brief Parses binary or notation LLSD in a buffer, calling a handler.
+ *
+ * Accepts what LLSDBinaryParser and LLSDNotationParser accept, including
+ * notation style strings and keys inside binary LLSD.
+ */
+class LL_COMMON_API LLSDSAXParser
+{
+public:
+	enum
+	{
+		PARSE_FAILURE = -1
+	};
+
+	LLSDSAXParser();
+
+	/**
+	 * @brief Parses one binary LLSD value from the start of buf.
+	 *
+	 * @param buf The data; no header.
+	 * @param size The size of buf.
+	 * @param handler Receives the values.
+	 * @param max_depth Max depth parser will check before exiting
+	 *  with parse error, -1 - unlimited.
+	 * @return Returns the number of LLSD values parsed, skipped ones
+	 * included, as LLSDParser::parse() counts them, or PARSE_FAILURE
+	 * (-1). A parse the handler stopped returns the count so far.
+	 */
+	S32 parseBinary(const char* buf, llssize size, LLSDSAXHandler& handler, S32 max_depth = -1);
+
+	/**
+	 * @brief Parses one notation LLSD value from the start of buf.
+	 *
+	 * As parseBinary().
+	 */
+	S32 parseNotation(const char* buf, llssize size, LLSDSAXHandler& handler, S32 max_depth = -1);
+
+	/**
+	 * @brief How much of the buffer the last parse used.
+	 */
+	llssize getBytesParsed() const						{ return mPos - mStart; }
+
+private:
+	S32 finishParse(bool success);
+	bool stop();
+
+	bool parseBinaryValue(LLSDSAXHandler& handler, S32 max_depth);
+	bool parseBinaryMap(LLSDSAXHandler& handler, S32 max_depth);
+	bool parseBinaryArray(LLSDSAXHandler& handler, S32 max_depth);
+	bool readBinarySize(S32& size);
+	bool readBinaryString(std::string_view& value);
+
+	bool parseNotationValue(LLSDSAXHandler& handler, S32 max_depth);
+	bool parseNotationMap(LLSDSAXHandler& handler, S32 max_depth);
+	bool parseNotationArray(LLSDSAXHandler& handler, S32 max_depth);
+	bool parseNotationBoolean(LLSDSAXHandler& handler, bool value);
+	bool parseNotationInteger(LLSDSAXHandler& handler);
+	bool parseNotationReal(LLSDSAXHandler& handler);
+	bool parseNotationUUID(LLSDSAXHandler& handler);
+	bool parseNotationBinary(LLSDSAXHandler& handler);
+	// A quoted string or a s(size)"raw" one
+	bool readNotationString(std::string_view& value);
+	bool readRawString(std::string_view& value);
+
+	// Reads to the closing delim, after the opening one. Unescapes into
+	// mScratch if it has to.
+	bool readDelimitedString(char delim, std::string_view& value);
+
+	bool call(LLSDSAXHandler::EAction action);
+
+	const char*			mStart;
+	const char*			mPos;
+	const char*			mEnd;
+	S32					mCount;
+	bool				mStopped;
+	std::string			mScratch;
+	std::vector<U8>		mBinaryScratch;
+};
+
+#endif // LL_LLSDSAXPARSER_H
@@ -31,7 +31,10 @@
 #include "llpointer.h"
 #include "llstreamtools.h" // for fullread
 
+#include <charconv>
+#include <clocale>
 #include <iostream>
+#include <locale>
 #include "apr_base64.h"
 
 #include <boost/iostreams/device/array.hpp>
@@ -53,6 +56,10 @@
 #include "llstring.h"
 #include "lluri.h"
 
+// SSE2 is the baseline on every platform. llsimdmath.h is out of reach in
+// llcommon, so the intrinsics come straight from their header.
+#include <emmintrin.h>
+
 // File constants
 static const size_t MAX_HDR_LEN = 20;
 static const S32 UNZIP_LLSD_MAX_DEPTH = 96;
@@ -356,14 +363,6 @@ llssize deserialize_boolean(
 	const std::string& compare,
 	bool value);
 
-/**
- * @brief Do notation escaping of a string to an ostream.
- *
- * @param value The string to escape and serialize
- * @param str The stream to serialize to.
- */
-void serialize_string(const std::string& value, std::ostream& str);
-
 
 /**
  * Local constants.
@@ -1331,12 +1330,32 @@ S32 LLSDFormatter::format(const LLSD& data, std::ostream& ostr, EFormatterOption
     return format_impl(data, ostr, options, 0);
 }
 
+S32 LLSDFormatter::format(const LLSD& data, LLSDFormatBuffer& buffer) const
+{
+	// pass options captured by constructor
+	return format(data, buffer, mOptions);
+}
+
+// virtual
+S32 LLSDFormatter::format(const LLSD& data, LLSDFormatBuffer& buffer, EFormatterOptions options) const
+{
+	std::ostringstream ostr;
+	S32 rv = format(data, ostr, options);
+	buffer.write(ostr.str());
+	return rv;
+}
+
 void LLSDFormatter::formatReal(LLSD::Real real, std::ostream& ostr) const
 {
 	std::string buffer = llformat(mRealFormat.c_str(), real);
 	ostr << buffer;
 }
 
+void LLSDFormatter::formatReal(LLSD::Real real, LLSDFormatBuffer& buffer) const
+{
+	buffer.write(llformat(mRealFormat.c_str(), real));
+}
+
 /**
  * LLSDNotationFormatter
  */
@@ -1353,171 +1372,178 @@ LLSDNotationFormatter::~LLSDNotationFormatter()
 // static
 std::string LLSDNotationFormatter::escapeString(const std::string& in)
 {
-	std::ostringstream ostr;
-	serialize_string(in, ostr);
-	return ostr.str();
+	LLSDFormatBuffer buffer;
+	buffer.writeNotationEscaped(in);
+	return buffer.str();
+}
+
+// virtual
+S32 LLSDNotationFormatter::format(const LLSD& data, LLSDFormatBuffer& buffer,
+								  EFormatterOptions options) const
+{
+	return format_impl(data, buffer, options, 0);
 }
 
 S32 LLSDNotationFormatter::format_impl(const LLSD& data, std::ostream& ostr,
 									   EFormatterOptions options, U32 level) const
 {
-	S32 format_count = 1;
-	std::string pre;
-	std::string post;
+	LLSDFormatBuffer buffer(ostr);
+	S32 format_count = format_impl(data, buffer, options, level);
+	buffer.flush();
+	return format_count;
+}
 
-	if (options & LLSDFormatter::OPTIONS_PRETTY)
-	{
-		for (U32 i = 0; i < level; i++)
-		{
-			pre += "    ";
-		}
-		post = "\n";
-	}
+S32 LLSDNotationFormatter::format_impl(const LLSD& data, LLSDFormatBuffer& buffer,
+									   EFormatterOptions options, U32 level) const
+{
+	S32 format_count = 1;
+	bool pretty = (options & LLSDFormatter::OPTIONS_PRETTY) != 0;
 
 	switch(data.type())
 	{
 	case LLSD::TypeMap:
 	{
-		if (0 != level) ostr << post << pre;
-		ostr << "{";
-		std::string inner_pre;
-		if (options & LLSDFormatter::OPTIONS_PRETTY)
+		if (0 != level && pretty)
 		{
-			inner_pre = pre + "    ";
+			buffer.put('\n');
+			buffer.writeIndent(level);
 		}
+		buffer.put('{');
 
 		bool need_comma = false;
 		LLSD::map_const_iterator iter = data.beginMap();
 		LLSD::map_const_iterator end = data.endMap();
 		for(; iter != end; ++iter)
 		{
-			if(need_comma) ostr << ",";
+			if(need_comma) buffer.put(',');
 			need_comma = true;
-			ostr << post << inner_pre << '\'';
-			serialize_string((*iter).first, ostr);
-			ostr << "':";
-			format_count += format_impl((*iter).second, ostr, options, level + 2);
+			if (pretty)
+			{
+				buffer.put('\n');
+				buffer.writeIndent(level + 1);
+			}
+			buffer.put('\'');
+			buffer.writeNotationEscaped((*iter).first);
+			buffer.write("':");
+			format_count += format_impl((*iter).second, buffer, options, level + 2);
+		}
+		if (pretty)
+		{
+			buffer.put('\n');
+			buffer.writeIndent(level);
 		}
-		ostr << post << pre << "}";
+		buffer.put('}');
 		break;
 	}
 
 	case LLSD::TypeArray:
 	{
-		ostr << post << pre << "[";
+		if (pretty)
+		{
+			buffer.put('\n');
+			buffer.writeIndent(level);
+		}
+		buffer.put('[');
 		bool need_comma = false;
 		LLSD::array_const_iterator iter = data.beginArray();
 		LLSD::array_const_iterator end = data.endArray();
 		for(; iter != end; ++iter)
 		{
-			if(need_comma) ostr << ",";
+			if(need_comma) buffer.put(',');
 			need_comma = true;
-			format_count += format_impl(*iter, ostr, options, level + 1);
+			format_count += format_impl(*iter, buffer, options, level + 1);
 		}
-		ostr << "]";
+		buffer.put(']');
 		break;
 	}
 
 	case LLSD::TypeUndefined:
-		ostr << "!";
+		buffer.put('!');
 		break;
 
 	case LLSD::TypeBoolean:
-		if(mBoolAlpha ||
-#if( LL_WINDOWS || __GNUC__ > 2)
-		   (ostr.flags() & std::ios::boolalpha)
-#else
-		   (ostr.flags() & 0x0100)
-#endif
-			)
+		if(mBoolAlpha || buffer.boolalpha())
 		{
-			ostr << (data.asBoolean()
-					 ? NOTATION_TRUE_SERIAL : NOTATION_FALSE_SERIAL);
+			buffer.write(data.asBoolean()
+						 ? NOTATION_TRUE_SERIAL : NOTATION_FALSE_SERIAL);
 		}
 		else
 		{
-			ostr << (data.asBoolean() ? 1 : 0);
+			buffer.writeInteger(data.asBoolean() ? 1 : 0);
 		}
 		break;
 
 	case LLSD::TypeInteger:
-		ostr << "i" << data.asInteger();
+		buffer.put('i');
+		buffer.writeInteger(data.asInteger());
 		break;
 
 	case LLSD::TypeReal:
-		ostr << "r";
+		buffer.put('r');
 		if(mRealFormat.empty())
 		{
-			ostr << data.asReal();
+			buffer.writeReal(data.asReal());
 		}
 		else
 		{
-			formatReal(data.asReal(), ostr);
+			formatReal(data.asReal(), buffer);
 		}
 		break;
 
 	case LLSD::TypeUUID:
-		ostr << "u" << data.asUUID();
+		buffer.put('u');
+		buffer.writeUUID(data.asUUID());
 		break;
 
 	case LLSD::TypeString:
-		ostr << '\'';
-		serialize_string(data.asStringRef(), ostr);
-		ostr << '\'';
+		buffer.put('\'');
+		buffer.writeNotationEscaped(data.asStringRef());
+		buffer.put('\'');
 		break;
 
 	case LLSD::TypeDate:
-		ostr << "d\"" << data.asDate() << "\"";
+		buffer.write("d\"");
+		buffer.writeDate(data.asDate());
+		buffer.put('"');
 		break;
 
 	case LLSD::TypeURI:
-		ostr << "l\"";
-		serialize_string(data.asString(), ostr);
-		ostr << "\"";
+		buffer.write("l\"");
+		buffer.writeNotationEscaped(data.asString());
+		buffer.put('"');
 		break;
 
 	case LLSD::TypeBinary:
 	{
-		// *FIX: memory inefficient.
-		const std::vector<U8>& buffer = data.asBinary();
+		const std::vector<U8>& binary = data.asBinary();
 		if (options & LLSDFormatter::OPTIONS_PRETTY_BINARY)
 		{
-			ostr << "b16\"";
-			if (! buffer.empty())
+			buffer.write("b16\"");
+			if (! binary.empty())
 			{
-				std::ios_base::fmtflags old_flags = ostr.flags();
-				ostr.setf( std::ios::hex, std::ios::basefield );
 				// It shouldn't strictly matter whether the emitted hex digits
 				// are uppercase; LLSDNotationParser handles either; but as of
 				// 2020-05-13, Python's llbase.llsd requires uppercase hex.
-				ostr << std::uppercase;
-				auto oldfill(ostr.fill('0'));
-				auto oldwidth(ostr.width());
-				for (size_t i = 0; i < buffer.size(); i++)
-				{
-					// have to restate setw() before every conversion
-					ostr << std::setw(2) << (int) buffer[i];
-				}
-				ostr.width(oldwidth);
-				ostr.fill(oldfill);
-				ostr.flags(old_flags);
+				buffer.writeHex(&binary[0], binary.size());
 			}
 		}
 		else                        // ! OPTIONS_PRETTY_BINARY
 		{
-			ostr << "b(" << buffer.size() << ")\"";
-			if (! buffer.empty())
+			buffer.write("b(");
+			buffer.writeSize(binary.size());
+			buffer.write(")\"");
+			if (! binary.empty())
 			{
-				ostr.write((const char*)&buffer[0], buffer.size());
+				buffer.write((const char*)&binary[0], binary.size());
 			}
 		}
-		ostr << "\"";
+		buffer.put('"');
 		break;
 	}
 
 	default:
 		// *NOTE: This should never happen.
-		ostr << "!";
+		buffer.put('!');
 		break;
 	}
 	return format_count;
@@ -2090,15 +2116,353 @@ static const char* NOTATION_STRING_CHARACTERS[256] =
 	"\\xff"		// 255
 };
 
-void serialize_string(const std::string& value, std::ostream& str)
+/**
+ * LLSDFormatBuffer
+ */
+
+// Once a buffer on a stream holds this much it hands it on, rather than
+// growing further
+static const size_t FORMAT_BUFFER_CHUNK = 64 * 1024;
+
+// The most digits the fast writeReal() handles; its text buffer has room
+// for the sign, point and exponent besides
+static const S32 MAX_FAST_REAL_PRECISION = 40;
+
+static const char LOWER_HEX_DIGITS[] = "0123456789abcdef";
+static const char UPPER_HEX_DIGITS[] = "0123456789ABCDEF";
+
+// printf() formats reals as std::ostream does, in the "C" locale
+static bool printf_numbers_are_plain()
+{
+	const std::lconv* conv = std::localeconv();
+	return conv && conv->decimal_point
+		&& '.' == conv->decimal_point[0] && '\0' == conv->decimal_point[1];
+}
+
+// Whether ostr formats numbers with no more than a minus sign and a
+// decimal point
+static bool stream_numbers_are_plain(const std::ostream& ostr)
+{
+	const std::ios::fmtflags unusual = std::ios::oct | std::ios::hex
+		| std::ios::floatfield | std::ios::showbase | std::ios::showpoint
+		| std::ios::showpos | std::ios::uppercase;
+	if (ostr.flags() & unusual)
+	{
+		return false;
+	}
+	const std::numpunct<char>& punct = std::use_facet<std::numpunct<char> >(ostr.getloc());
+	return '.' == punct.decimal_point() && punct.grouping().empty();
+}
+
+// Whether the XML formatter replaces c with an entity
+static inline bool is_xml_special(char c)
+{
+	return '<' == c || '>' == c || '&' == c || '\'' == c || '"' == c;
+}
+
+// The first character at or after p the XML formatter escapes, or end
+static inline const char* find_xml_special(const char* p, const char* end)
+{
+	// '<' and '>' differ in bit 1 only, '&' and '\'' in bit 0 only
+	const __m128i bit0 = _mm_set1_epi8(0x01);
+	const __m128i bit1 = _mm_set1_epi8(0x02);
+	const __m128i angle = _mm_set1_epi8('>');
+	const __m128i amp_apos = _mm_set1_epi8('\'');
+	const __m128i quot = _mm_set1_epi8('"');
+	while (end - p >= 16)
+	{
+		__m128i chunk = _mm_loadu_si128((const __m128i*)p);
+		__m128i hits = _mm_or_si128(
+			_mm_or_si128(_mm_cmpeq_epi8(_mm_or_si128(chunk, bit1), angle),
+						 _mm_cmpeq_epi8(_mm_or_si128(chunk, bit0), amp_apos)),
+			_mm_cmpeq_epi8(chunk, quot));
+		U32 mask = _mm_movemask_epi8(hits);
+		if (mask)
+		{
+			return p + ll_lowest_set_bit(mask);
+		}
+		p += 16;
+	}
+	while (p < end && !is_xml_special(*p))
+	{
+		++p;
+	}
+	return p;
+}
+
+// Whether the notation formatter escapes c
+static inline bool is_notation_special(char c)
+{
+	U8 u = (U8)c;
+	return u < 0x20 || u >= 0x7f || '\'' == c || '\\' == c;
+}
+
+// The first character at or after p the notation formatter escapes, or
+// end
+static inline const char* find_notation_special(const char* p, const char* end)
+{
+	// The signed compare with space takes in 0x80 and up too
+	const __m128i space = _mm_set1_epi8(0x20);
+	const __m128i del = _mm_set1_epi8(0x7f);
+	const __m128i apos = _mm_set1_epi8('\'');
+	const __m128i backslash = _mm_set1_epi8('\\');
+	while (end - p >= 16)
+	{
+		__m128i chunk = _mm_loadu_si128((const __m128i*)p);
+		__m128i hits = _mm_or_si128(
+			_mm_or_si128(_mm_cmplt_epi8(chunk, space), _mm_cmpeq_epi8(chunk, del)),
+			_mm_or_si128(_mm_cmpeq_epi8(chunk, apos), _mm_cmpeq_epi8(chunk, backslash)));
+		U32 mask = _mm_movemask_epi8(hits);
+		if (mask)
+		{
+			return p + ll_lowest_set_bit(mask);
+		}
+		p += 16;
+	}
+	while (p < end && !is_notation_special(*p))
+	{
+		++p;
+	}
+	return p;
+}
+
+LLSDFormatBuffer::LLSDFormatBuffer() :
+	mData(mInline),
+	mSize(0),
+	mCapacity(sizeof(mInline)),
+	mStream(NULL),
+	mPrecision(6),
+	mBoolAlpha(false),
+	mPlainNumbers(printf_numbers_are_plain())
+{
+}
+
+LLSDFormatBuffer::LLSDFormatBuffer(std::ostream& ostr) :
+	mData(mInline),
+	mSize(0),
+	mCapacity(sizeof(mInline)),
+	mStream(&ostr),
+	mPrecision((S32)ostr.precision()),
+	mBoolAlpha(0 != (ostr.flags() & std::ios::boolalpha)),
+	mPlainNumbers(printf_numbers_are_plain() && stream_numbers_are_plain(ostr))
+{
+}
+
+LLSDFormatBuffer::~LLSDFormatBuffer()
+{
+	if (mData != mInline)
+	{
+		delete[] mData;
+	}
+}
+
+void LLSDFormatBuffer::flush()
+{
+	if (mStream && mSize)
+	{
+		mStream->write(mData, mSize);
+		mSize = 0;
+	}
+}
+
+void LLSDFormatBuffer::precision(S32 precision)
+{
+	mPrecision = precision;
+	if (mStream)
+	{
+		mStream->precision(precision);
+	}
+}
+
+void LLSDFormatBuffer::grow(size_t size)
+{
+	if (mStream && mSize >= FORMAT_BUFFER_CHUNK)
+	{
+		flush();
+		if (size <= mCapacity)
+		{
+			return;
+		}
+	}
+	size_t capacity = llmax(mCapacity * 2, mSize + size);
+	char* data = new char[capacity];
+	memcpy(data, mData, mSize);		/* Flawfinder: ignore */
+	if (mData != mInline)
+	{
+		delete[] mData;
+	}
+	mData = data;
+	mCapacity = capacity;
+}
+
+template <typename T>
+void LLSDFormatBuffer::writeFormatted(const T& value)
+{
+	if (mStream)
+	{
+		// Keep the order, and anything it does to the stream's state
+		flush();
+		*mStream << value;
+	}
+	else
+	{
+		std::ostringstream ostr;
+		ostr.imbue(std::locale::classic());
+		ostr.precision(mPrecision);
+		ostr << value;
+		write(ostr.str());
+	}
+}
+
+void LLSDFormatBuffer::writeIndent(U32 level)
+{
+	size_t size = (size_t)level * 4;
+	memset(reserve(size), ' ', size);
+	commit(size);
+}
+
+void LLSDFormatBuffer::writeInteger(S32 value)
+{
+	if (!mPlainNumbers)
+	{
+		writeFormatted(value);
+		return;
+	}
+	char* out = reserve(16);
+	commit((size_t)(std::to_chars(out, out + 16, value).ptr - out));
+}
+
+void LLSDFormatBuffer::writeSize(size_t value)
 {
-	std::string::const_iterator it = value.begin();
-	std::string::const_iterator end = value.end();
-	U8 c;
-	for(; it != end; ++it)
+	if (!mPlainNumbers)
 	{
-		c = (U8)(*it);
-		str << NOTATION_STRING_CHARACTERS[c];
+		writeFormatted(value);
+		return;
+	}
+	char* out = reserve(24);
+	commit((size_t)(std::to_chars(out, out + 24, value).ptr - out));
+}
+
+void LLSDFormatBuffer::writeReal(F64 value)
+{
+	// MSVC's std::ostream and printf() disagree about precision 0
+	if (!mPlainNumbers || mPrecision <= 0 || mPrecision > MAX_FAST_REAL_PRECISION)
+	{
+		writeFormatted(value);
+		return;
+	}
+	char* out = reserve(MAX_FAST_REAL_PRECISION + 16);
+	int length = snprintf(out, MAX_FAST_REAL_PRECISION + 16, "%.*g", (int)mPrecision, value);
+	if (length > 0)
+	{
+		commit((size_t)length);
+	}
+}
+
+void LLSDFormatBuffer::writeUUID(const LLUUID& value)
+{
+	char* out = reserve(UUID_STR_LENGTH - 1);
+	for (S32 i = 0; i < UUID_BYTES; ++i)
+	{
+		if (4 == i || 6 == i || 8 == i || 10 == i)
+		{
+			*out++ = '-';
+		}
+		*out++ = LOWER_HEX_DIGITS[value.mData[i] >> 4];
+		*out++ = LOWER_HEX_DIGITS[value.mData[i] & 0x0f];
+	}
+	commit(UUID_STR_LENGTH - 1);
+}
+
+void LLSDFormatBuffer::writeDate(const LLDate& value)
+{
+	if (!mPlainNumbers)
+	{
+		writeFormatted(value);
+		return;
+	}
+	write(value.asString());
+}
+
+void LLSDFormatBuffer::writeHex(const U8* data, size_t size)
+{
+	if (mStream && !mPlainNumbers)
+	{
+		// As the notation formatter always did it
+		flush();
+		std::ostream& ostr = *mStream;
+		std::ios_base::fmtflags old_flags = ostr.flags();
+		ostr.setf( std::ios::hex, std::ios::basefield );
+		ostr << std::uppercase;
+		auto oldfill(ostr.fill('0'));
+		auto oldwidth(ostr.width());
+		for (size_t i = 0; i < size; i++)
+		{
+			// have to restate setw() before every conversion
+			ostr << std::setw(2) << (int) data[i];
+		}
+		ostr.width(oldwidth);
+		ostr.fill(oldfill);
+		ostr.flags(old_flags);
+		return;
+	}
+	char* out = reserve(size * 2);
+	for (size_t i = 0; i < size; ++i)
+	{
+		*out++ = UPPER_HEX_DIGITS[data[i] >> 4];
+		*out++ = UPPER_HEX_DIGITS[data[i] & 0x0f];
+	}
+	commit(size * 2);
+}
+
+void LLSDFormatBuffer::writeXMLEscaped(std::string_view str)
+{
+	const char* p = str.data();
+	const char* end = p + str.size();
+	while (p < end)
+	{
+		const char* special = find_xml_special(p, end);
+		write(p, (size_t)(special - p));
+		if (special == end)
+		{
+			break;
+		}
+		switch(*special)
+		{
+		case '<':
+			write("&lt;");
+			break;
+		case '>':
+			write("&gt;");
+			break;
+		case '&':
+			write("&amp;");
+			break;
+		case '\'':
+			write("&apos;");
+			break;
+		default:
+			write("&quot;");
+			break;
+		}
+		p = special + 1;
+	}
+}
+
+void LLSDFormatBuffer::writeNotationEscaped(std::string_view str)
+{
+	const char* p = str.data();
+	const char* end = p + str.size();
+	while (p < end)
+	{
+		const char* special = find_notation_special(p, end);
+		write(p, (size_t)(special - p));
+		if (special == end)
+		{
+			break;
+		}
+		write(NOTATION_STRING_CHARACTERS[(U8)*special]);
+		p = special + 1;
 	}
 }
 
@@ -2253,98 +2617,107 @@ LLUZipHelper::EZipRresult LLUZipHelper::unzip_llsd(LLSD& data, std::istream& is,
 
 LLUZipHelper::EZipRresult LLUZipHelper::unzip_llsd(LLSD& data, const U8* in, S32 size)
 {
-	U8* result = NULL;
-	llssize cur_size = 0;
-	z_stream strm;
+	Segment segment = { in, (size_t)size };
+	return unzip_llsd(data, &segment, 1);
+}
 
-	constexpr U32 CHUNK = 1024 * 512;
+LLUZipHelper::EZipRresult LLUZipHelper::unzip_llsd(LLSD& data, const Segment* segments, size_t count)
+{
+	// The inflated block is parsed right away, so each thread keeps one
+	// buffer for all its blocks
+	static thread_local std::vector<U8> result;
 
-	static thread_local std::unique_ptr<U8[]> out;
-	if (!out)
+	EZipRresult zip_result = unzip(result, segments, count);
+	if (zip_result != ZR_OK)
 	{
-		out = std::unique_ptr<U8[]>(new(std::nothrow) U8[CHUNK]);
+		return zip_result;
 	}
-		
+
+	//result now holds the decompressed LLSD block
+	llssize cur_size = result.size();
+	char* result_ptr = strip_deprecated_header((char*)result.data(), cur_size);
+
+	boost::iostreams::stream<boost::iostreams::array_source> istrm(result_ptr, cur_size);
+
+	if (!LLSDSerialize::fromBinary(data, istrm, cur_size, UNZIP_LLSD_MAX_DEPTH))
+	{
+		return ZR_PARSE_ERROR;
+	}
+	return ZR_OK;
+}
+
+LLUZipHelper::EZipRresult LLUZipHelper::unzip(std::vector<U8>& out, const Segment* segments, size_t count)
+{
+	// Start from whatever capacity earlier calls left, or a guess
+	// from the compressed size
+	size_t in_size = 0;
+	for (size_t i = 0; i < count; ++i)
+	{
+		in_size += segments[i].mSize;
+	}
+
+	z_stream strm;
 	strm.zalloc = Z_NULL;
 	strm.zfree = Z_NULL;
 	strm.opaque = Z_NULL;
-	strm.avail_in = size;
-	strm.next_in = const_cast<U8*>(in);
+	strm.avail_in = 0;
+	strm.next_in = Z_NULL;
 
-	S32 ret = inflateInit(&strm);
-	
-	do
+	if (inflateInit(&strm) != Z_OK)
 	{
-		strm.avail_out = CHUNK;
-		strm.next_out = out.get();
-		ret = inflate(&strm, Z_NO_FLUSH);
-		switch (ret)
-		{
-		case Z_NEED_DICT:
-		case Z_DATA_ERROR:
-		{
-			inflateEnd(&strm);
-			free(result);
-			return ZR_DATA_ERROR;
-		}
-		case Z_STREAM_ERROR:
-		case Z_BUF_ERROR:
-		{
-			inflateEnd(&strm);
-			free(result);
-			return ZR_BUFFER_ERROR;
-		}
-
-		case Z_MEM_ERROR:
-		{
-			inflateEnd(&strm);
-			free(result);
-			return ZR_MEM_ERROR;
-		}
-		}
+		return ZR_MEM_ERROR;
+	}
 
-		U32 have = CHUNK-strm.avail_out;
+	size_t used = 0;
+	size_t next_segment = 0;
+	S32 ret = Z_OK;
+	try
+	{
+		out.resize(llmax(out.capacity(), in_size * 4, (size_t)1024));
 
-		U8* new_result = (U8*)realloc(result, cur_size + have);
-		if (new_result == NULL)
+		while (ret == Z_OK)
 		{
-			inflateEnd(&strm);
-			if (result)
+			if (strm.avail_in == 0 && next_segment < count)
 			{
-				free(result);
+				strm.next_in = const_cast<U8*>(segments[next_segment].mData);
+				strm.avail_in = (uInt)segments[next_segment].mSize;
+				++next_segment;
+				continue;
 			}
-			return ZR_MEM_ERROR;
-		}
-		result = new_result;
-		memcpy(result+cur_size, out.get(), have);
-		cur_size += have;
 
-	} while (ret == Z_OK && ret != Z_STREAM_END);
+			if (used == out.size())
+			{
+				out.resize(out.size() * 2);
+			}
+			strm.next_out = &out[used];
+			strm.avail_out = (uInt)(out.size() - used);
+			ret = inflate(&strm, Z_NO_FLUSH);
+			used = out.size() - strm.avail_out;
+		}
+	}
+	catch (const std::bad_alloc&)
+	{
+		ret = Z_MEM_ERROR;
+	}
 
 	inflateEnd(&strm);
 
-	if (ret != Z_STREAM_END)
+	switch (ret)
 	{
-		free(result);
+	case Z_STREAM_END:
+		out.resize(used);
+		return ZR_OK;
+	case Z_STREAM_ERROR:
+	case Z_BUF_ERROR:
+		// Z_BUF_ERROR here means the input ended before the stream did
+		return ZR_BUFFER_ERROR;
+	case Z_MEM_ERROR:
+		return ZR_MEM_ERROR;
+	default:
 		return ZR_DATA_ERROR;
 	}
-
-	//result now points to the decompressed LLSD block
-	{
-		char* result_ptr = strip_deprecated_header((char*)result, cur_size);
-
-		boost::iostreams::stream<boost::iostreams::array_source> istrm(result_ptr, cur_size);
-		
-		if (!LLSDSerialize::fromBinary(data, istrm, cur_size, UNZIP_LLSD_MAX_DEPTH))
-		{
-			free(result);
-			return ZR_PARSE_ERROR;
-		}
-	}
-
-	free(result);
-	return ZR_OK;
 }
+
 //This unzip function will only work with a gzip header and trailer - while the contents
 //of the actual compressed data is the same for either format (gzip vs zlib ), the headers
 //and trailers are different for the formats.
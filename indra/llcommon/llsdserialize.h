@@ -29,7 +29,9 @@
 #ifndef LL_LLSDSERIALIZE_H
 #define LL_LLSDSERIALIZE_H
 
+#include <cstring>
 #include <iosfwd>
+#include <string_view>
 #include "llpointer.h"
 #include "llrefcount.h"
 #include "llsd.h"
@@ -409,7 +411,134 @@ private:
 };
 
 
-/** 
+/**
+ * @class LLSDFormatBuffer
+ * @brief Growable output buffer for the XML and notation formatters.
+ *
+ * The formatters write each token into contiguous memory, rather than
+ * through an std::ostream, and scan strings for the characters they
+ * escape 16 bytes at a time. A buffer made on a stream formats numbers
+ * the way that stream would and passes its contents on a large chunk at
+ * a time; call flush() when done. A free standing one formats numbers the
+ * way a default std::ostream would and keeps everything until clear(),
+ * so reusing one saves the allocations.
+ */
+class LL_COMMON_API LLSDFormatBuffer
+{
+public:
+	LLSDFormatBuffer();
+
+	/**
+	 * @brief Constructor for a buffer which writes to ostr.
+	 *
+	 * Takes the precision and boolalpha flag from ostr.
+	 */
+	explicit LLSDFormatBuffer(std::ostream& ostr);
+
+	~LLSDFormatBuffer();
+
+	LLSDFormatBuffer(const LLSDFormatBuffer&) = delete;
+	LLSDFormatBuffer& operator=(const LLSDFormatBuffer&) = delete;
+
+	const char* data() const						{ return mData; }
+	size_t size() const								{ return mSize; }
+	bool empty() const								{ return 0 == mSize; }
+	std::string_view view() const					{ return std::string_view(mData, mSize); }
+	std::string str() const							{ return std::string(mData, mSize); }
+	void clear()									{ mSize = 0; }
+
+	/**
+	 * @brief Writes what is buffered to the stream, if there is one.
+	 */
+	void flush();
+
+	/**
+	 * @brief The number of significant digits for reals, as for
+	 * std::ostream::precision().
+	 */
+	S32 precision() const							{ return mPrecision; }
+	void precision(S32 precision);
+
+	// True if the stream has std::ios::boolalpha set
+	bool boolalpha() const							{ return mBoolAlpha; }
+
+	void put(char c)
+	{
+		if (mSize == mCapacity)
+		{
+			grow(1);
+		}
+		mData[mSize++] = c;
+	}
+
+	void write(const char* data, size_t size)
+	{
+		if (size > mCapacity - mSize)
+		{
+			grow(size);
+		}
+		memcpy(mData + mSize, data, size);		/* Flawfinder: ignore */
+		mSize += size;
+	}
+
+	void write(std::string_view str)				{ write(str.data(), str.size()); }
+
+	/**
+	 * @brief Makes room for size more bytes.
+	 *
+	 * @return Returns where they go. Call commit() with the number
+	 * actually written.
+	 */
+	char* reserve(size_t size)
+	{
+		if (size > mCapacity - mSize)
+		{
+			grow(size);
+		}
+		return mData + mSize;
+	}
+	void commit(size_t size)						{ mSize += size; }
+
+	// Four spaces a level, as the pretty formats indent
+	void writeIndent(U32 level);
+
+	void writeInteger(S32 value);
+	void writeSize(size_t value);
+	void writeReal(F64 value);
+	void writeUUID(const LLUUID& value);
+	void writeDate(const LLDate& value);
+
+	// Upper case hex, two digits a byte
+	void writeHex(const U8* data, size_t size);
+
+	// Escapes the way LLSDXMLFormatter::escapeString() does
+	void writeXMLEscaped(std::string_view str);
+
+	// Escapes the way LLSDNotationFormatter::escapeString() does
+	void writeNotationEscaped(std::string_view str);
+
+private:
+	// Flushes or grows to fit size more bytes
+	void grow(size_t size);
+
+	// Numbers fall back on this when the stream formats them unusually
+	template <typename T>
+	void writeFormatted(const T& value);
+
+	char* mData;
+	size_t mSize;
+	size_t mCapacity;
+	std::ostream* mStream;
+	S32 mPrecision;
+	bool mBoolAlpha;
+	// Whether the fast number formatting gives what mStream would
+	bool mPlainNumbers;
+	// Enough for most LLSD written to a stream in a log line
+	char mInline[256];
+};
+
+
+/**
  * @class LLSDFormatter
  * @brief Abstract base class for formatting LLSD.
  */
@@ -480,6 +609,28 @@ public:
 	 */
 	virtual S32 format(const LLSD& data, std::ostream& ostr, EFormatterOptions options) const;
 
+	/**
+	 * @brief Call this method to append formatted LLSD to a buffer, with
+	 * options as set by the constructor.
+	 *
+	 * @param data The data to write.
+	 * @param buffer The destination for the data.
+	 * @return Returns The number of LLSD objects formatted out
+	 */
+	S32 format(const LLSD& data, LLSDFormatBuffer& buffer) const;
+
+	/**
+	 * @brief Call this method to append formatted LLSD to a buffer,
+	 * passing options explicitly.
+	 *
+	 * The default goes through an std::ostringstream.
+	 * @param data The data to write.
+	 * @param buffer The destination for the data.
+	 * @param options OPTIONS_NONE to emit LLSD::Binary as raw bytes
+	 * @return Returns The number of LLSD objects formatted out
+	 */
+	virtual S32 format(const LLSD& data, LLSDFormatBuffer& buffer, EFormatterOptions options) const;
+
 protected:
 	/** 
 	 * @brief Implementation to format the data. This is called recursively.
@@ -498,6 +649,7 @@ protected:
 	 * @param ostr The destination stream for the data.
 	 */
 	void formatReal(LLSD::Real real, std::ostream& ostr) const;
+	void formatReal(LLSD::Real real, LLSDFormatBuffer& buffer) const;
 
 	bool mBoolAlpha;
 	std::string mRealFormat;
@@ -536,16 +688,25 @@ public:
 	 */
 	static std::string escapeString(const std::string& in);
 
+	S32 format(const LLSD& data, LLSDFormatBuffer& buffer, EFormatterOptions options) const override;
+
+	// also pull down base-class format() methods that aren't overridden
+	using LLSDFormatter::format;
+
 protected:
 	/** 
 	 * @brief Implementation to format the data. This is called recursively.
 	 *
+	 * Formats through an LLSDFormatBuffer on ostr.
 	 * @param data The data to write.
 	 * @param ostr The destination stream for the data.
 	 * @return Returns The number of LLSD objects formatted out
 	 */
 	S32 format_impl(const LLSD& data, std::ostream& ostr, EFormatterOptions options,
 					U32 level) const override;
+
+	S32 format_impl(const LLSD& data, LLSDFormatBuffer& buffer, EFormatterOptions options,
+					U32 level) const;
 };
 
 
@@ -585,19 +746,25 @@ public:
 	 */
 	S32 format(const LLSD& data, std::ostream& ostr, EFormatterOptions options) const override;
 
-	// also pull down base-class format() method that isn't overridden
+	S32 format(const LLSD& data, LLSDFormatBuffer& buffer, EFormatterOptions options) const override;
+
+	// also pull down base-class format() methods that aren't overridden
 	using LLSDFormatter::format;
 
 protected:
 	/** 
 	 * @brief Implementation to format the data. This is called recursively.
 	 *
+	 * Formats through an LLSDFormatBuffer on ostr.
 	 * @param data The data to write.
 	 * @param ostr The destination stream for the data.
 	 * @return Returns The number of LLSD objects formatted out
 	 */
 	S32 format_impl(const LLSD& data, std::ostream& ostr, EFormatterOptions options,
 					U32 level) const override;
+
+	S32 format_impl(const LLSD& data, LLSDFormatBuffer& buffer, EFormatterOptions options,
+					U32 level) const;
 };
 
 
@@ -861,9 +1028,23 @@ public:
 		ZR_BUFFER_ERROR,
 		ZR_VERSION_ERROR
     } EZipRresult;
+    // A piece of a compressed block, which may arrive split across several
+    // buffers, like the blocks of an HTTP response body
+    struct Segment
+    {
+        const U8* mData;
+        size_t mSize;
+    };
+
     // return OK or reason for failure
     static EZipRresult unzip_llsd(LLSD& data, std::istream& is, S32 size);
 	static EZipRresult unzip_llsd(LLSD& data, const U8* in, S32 size);
+    static EZipRresult unzip_llsd(LLSD& data, const Segment* segments, size_t count);
+
+    // Inflates the segments, in order, into out without gathering them
+    // first. out is resized to the inflated size, but keeps its capacity,
+    // so reusing one vector across calls avoids reallocating it.
+    static EZipRresult unzip(std::vector<U8>& out, const Segment* segments, size_t count);
 };
 
 //dirty little zip functions -- yell at davep
@@ -62,32 +62,52 @@ S32 LLSDXMLFormatter::format(const LLSD& data, std::ostream& ostr,
 {
 	std::streamsize old_precision = ostr.precision(25);
 
-	std::string post;
+	LLSDFormatBuffer buffer(ostr);
+	S32 rv = format(data, buffer, options);
+	buffer.flush();
+
+	ostr.precision(old_precision);
+	return rv;
+}
+
+// virtual
+S32 LLSDXMLFormatter::format(const LLSD& data, LLSDFormatBuffer& buffer,
+							 EFormatterOptions options) const
+{
+	S32 old_precision = buffer.precision();
+	buffer.precision(25);
+
+	buffer.write("<llsd>");
 	if (options & LLSDFormatter::OPTIONS_PRETTY)
 	{
-		post = "\n";
+		buffer.put('\n');
 	}
-	ostr << "<llsd>" << post;
-	S32 rv = format_impl(data, ostr, options, 1);
-	ostr << "</llsd>\n";
+	S32 rv = format_impl(data, buffer, options, 1);
+	buffer.write("</llsd>\n");
 
-	ostr.precision(old_precision);
+	buffer.precision(old_precision);
 	return rv;
 }
 
 S32 LLSDXMLFormatter::format_impl(const LLSD& data, std::ostream& ostr,
 								  EFormatterOptions options, U32 level) const
+{
+	LLSDFormatBuffer buffer(ostr);
+	S32 format_count = format_impl(data, buffer, options, level);
+	buffer.flush();
+	return format_count;
+}
+
+S32 LLSDXMLFormatter::format_impl(const LLSD& data, LLSDFormatBuffer& buffer,
+								  EFormatterOptions options, U32 level) const
 {
 	S32 format_count = 1;
-	std::string pre;
-	std::string post;
+	U32 indent = 0;
+	std::string_view post = "";
 
 	if (options & LLSDFormatter::OPTIONS_PRETTY)
 	{
-		for (U32 i = 0; i < level; i++)
-		{
-			pre += "    ";
-		}
+		indent = level;
 		post = "\n";
 	}
 
@@ -96,121 +116,181 @@ S32 LLSDXMLFormatter::format_impl(const LLSD& data, std::ostream& ostr,
 	case LLSD::TypeMap:
 		if(0 == data.size())
 		{
-			ostr << pre << "<map />" << post;
+			buffer.writeIndent(indent);
+			buffer.write("<map />");
+			buffer.write(post);
 		}
 		else
 		{
-			ostr << pre << "<map>" << post;
+			buffer.writeIndent(indent);
+			buffer.write("<map>");
+			buffer.write(post);
 			LLSD::map_const_iterator iter = data.beginMap();
 			LLSD::map_const_iterator end = data.endMap();
 			for(; iter != end; ++iter)
 			{
-				ostr << pre << "<key>" << escapeString((*iter).first) << "</key>" << post;
-				format_count += format_impl((*iter).second, ostr, options, level + 1);
+				buffer.writeIndent(indent);
+				buffer.write("<key>");
+				buffer.writeXMLEscaped((*iter).first);
+				buffer.write("</key>");
+				buffer.write(post);
+				format_count += format_impl((*iter).second, buffer, options, level + 1);
 			}
-			ostr << pre <<  "</map>" << post;
+			buffer.writeIndent(indent);
+			buffer.write("</map>");
+			buffer.write(post);
 		}
 		break;
 
 	case LLSD::TypeArray:
 		if(0 == data.size())
 		{
-			ostr << pre << "<array />" << post;
+			buffer.writeIndent(indent);
+			buffer.write("<array />");
+			buffer.write(post);
 		}
 		else
 		{
-			ostr << pre << "<array>" << post;
+			buffer.writeIndent(indent);
+			buffer.write("<array>");
+			buffer.write(post);
 			LLSD::array_const_iterator iter = data.beginArray();
 			LLSD::array_const_iterator end = data.endArray();
 			for(; iter != end; ++iter)
 			{
-				format_count += format_impl(*iter, ostr, options, level + 1);
+				format_count += format_impl(*iter, buffer, options, level + 1);
 			}
-			ostr << pre << "</array>" << post;
+			buffer.writeIndent(indent);
+			buffer.write("</array>");
+			buffer.write(post);
 		}
 		break;
 
 	case LLSD::TypeUndefined:
-		ostr << pre << "<undef />" << post;
+		buffer.writeIndent(indent);
+		buffer.write("<undef />");
+		buffer.write(post);
 		break;
 
 	case LLSD::TypeBoolean:
-		ostr << pre << "<boolean>";
-		if(mBoolAlpha ||
-		   (ostr.flags() & std::ios::boolalpha)
-		   )
+		buffer.writeIndent(indent);
+		buffer.write("<boolean>");
+		if(mBoolAlpha || buffer.boolalpha())
 		{
-			ostr << (data.asBoolean() ? "true" : "false");
+			buffer.write(data.asBoolean() ? "true" : "false");
 		}
 		else
 		{
-			ostr << (data.asBoolean() ? 1 : 0);
+			buffer.writeInteger(data.asBoolean() ? 1 : 0);
 		}
-		ostr << "</boolean>" << post;
+		buffer.write("</boolean>");
+		buffer.write(post);
 		break;
 
 	case LLSD::TypeInteger:
-		ostr << pre << "<integer>" << data.asInteger() << "</integer>" << post;
+		buffer.writeIndent(indent);
+		buffer.write("<integer>");
+		buffer.writeInteger(data.asInteger());
+		buffer.write("</integer>");
+		buffer.write(post);
 		break;
 
 	case LLSD::TypeReal:
-		ostr << pre << "<real>";
+		buffer.writeIndent(indent);
+		buffer.write("<real>");
 		if(mRealFormat.empty())
 		{
-			ostr << data.asReal();
+			buffer.writeReal(data.asReal());
 		}
 		else
 		{
-			formatReal(data.asReal(), ostr);
+			formatReal(data.asReal(), buffer);
 		}
-		ostr << "</real>" << post;
+		buffer.write("</real>");
+		buffer.write(post);
 		break;
 
 	case LLSD::TypeUUID:
-		if(data.asUUID().isNull()) ostr << pre << "<uuid />" << post;
-		else ostr << pre << "<uuid>" << data.asUUID() << "</uuid>" << post;
+		if(data.asUUID().isNull())
+		{
+			buffer.writeIndent(indent);
+			buffer.write("<uuid />");
+			buffer.write(post);
+		}
+		else
+		{
+			buffer.writeIndent(indent);
+			buffer.write("<uuid>");
+			buffer.writeUUID(data.asUUID());
+			buffer.write("</uuid>");
+			buffer.write(post);
+		}
 		break;
 
 	case LLSD::TypeString:
-		if(data.asStringRef().empty()) ostr << pre << "<string />" << post;
-		else ostr << pre << "<string>" << escapeString(data.asStringRef()) <<"</string>" << post;
+		if(data.asStringRef().empty())
+		{
+			buffer.writeIndent(indent);
+			buffer.write("<string />");
+			buffer.write(post);
+		}
+		else
+		{
+			buffer.writeIndent(indent);
+			buffer.write("<string>");
+			buffer.writeXMLEscaped(data.asStringRef());
+			buffer.write("</string>");
+			buffer.write(post);
+		}
 		break;
 
 	case LLSD::TypeDate:
-		ostr << pre << "<date>" << data.asDate() << "</date>" << post;
+		buffer.writeIndent(indent);
+		buffer.write("<date>");
+		buffer.writeDate(data.asDate());
+		buffer.write("</date>");
+		buffer.write(post);
 		break;
 
 	case LLSD::TypeURI:
-		ostr << pre << "<uri>" << escapeString(data.asString()) << "</uri>" << post;
+		buffer.writeIndent(indent);
+		buffer.write("<uri>");
+		buffer.writeXMLEscaped(data.asString());
+		buffer.write("</uri>");
+		buffer.write(post);
 		break;
 
 	case LLSD::TypeBinary:
 	{
-		const LLSD::Binary& buffer = data.asBinary();
-		if(buffer.empty())
+		const LLSD::Binary& binary = data.asBinary();
+		if(binary.empty())
 		{
-			ostr << pre << "<binary />" << post;
+			buffer.writeIndent(indent);
+			buffer.write("<binary />");
+			buffer.write(post);
 		}
 		else
 		{
-			// *FIX: memory inefficient.
 			// *TODO: convert to use LLBase64
-			ostr << pre << "<binary encoding=\"base64\">";
-			int b64_buffer_length = apr_base64_encode_len(narrow<size_t>(buffer.size()));
-			char* b64_buffer = new char[b64_buffer_length];
+			buffer.writeIndent(indent);
+			buffer.write("<binary encoding=\"base64\">");
+			int b64_buffer_length = apr_base64_encode_len(narrow<size_t>(binary.size()));
+			char* b64_buffer = buffer.reserve(b64_buffer_length);
 			b64_buffer_length = apr_base64_encode_binary(
 				b64_buffer,
-				&buffer[0],
-				narrow<size_t>(buffer.size()));
-			ostr.write(b64_buffer, b64_buffer_length - 1);
-			delete[] b64_buffer;
-			ostr << "</binary>" << post;
+				&binary[0],
+				narrow<size_t>(binary.size()));
+			buffer.commit(b64_buffer_length - 1);
+			buffer.write("</binary>");
+			buffer.write(post);
 		}
 		break;
 	}
 	default:
 		// *NOTE: This should never happen.
-		ostr << pre << "<undef />" << post;
+		buffer.writeIndent(indent);
+		buffer.write("<undef />");
+		buffer.write(post);
 		break;
 	}
 	return format_count;
@@ -219,34 +299,9 @@ S32 LLSDXMLFormatter::format_impl(const LLSD& data, std::ostream& ostr,
 // static
 std::string LLSDXMLFormatter::escapeString(const std::string& in)
 {
-	std::ostringstream out;
-	std::string::const_iterator it = in.begin();
-	std::string::const_iterator end = in.end();
-	for(; it != end; ++it)
-	{
-		switch((*it))
-		{
-		case '<':
-			out << "&lt;";
-			break;
-		case '>':
-			out << "&gt;";
-			break;
-		case '&':
-			out << "&amp;";
-			break;
-		case '\'':
-			out << "&apos;";
-			break;
-		case '"':
-			out << "&quot;";
-			break;
-		default:
-			out << (*it);
-			break;
-		}
-	}
-	return out.str();
+	LLSDFormatBuffer buffer;
+	buffer.writeXMLEscaped(in);
+	return buffer.str();
 }
 
 
@@ -33,6 +33,7 @@
 #include LLCOROS_CONDVAR_HEADER
 #include "llexception.h"
 #include "mutex.h"
+#include <atomic>
 #include <chrono>
 #include <queue>
 #include <string>
@@ -258,6 +259,178 @@ namespace LL
 } // namespace LL
 
 
+/*****************************************************************************
+*   MPSCQueue
+*****************************************************************************/
+namespace LL
+{
+    /**
+     * MPSCQueue is an unbounded FIFO to which any number of threads may
+     * push() concurrently, without locking, but from which only one thread
+     * at a time may pop(). This is Dmitry Vyukov's node-based queue: push()
+     * costs one allocation and one atomic exchange, pop() one atomic load.
+     *
+     * Pass it as LLThreadSafeQueue's QueueT to get the lock-free
+     * LLThreadSafeQueue specialization below.
+     */
+    template <typename T>
+    class MPSCQueue
+    {
+    public:
+        typedef T value_type;
+
+        MPSCQueue():
+            mHead(new Node),
+            mTail(mHead.load())
+        {}
+        MPSCQueue(const MPSCQueue&) = delete;
+        MPSCQueue& operator=(const MPSCQueue&) = delete;
+
+        ~MPSCQueue()
+        {
+            while (mTail)
+            {
+                Node* next = mTail->mNext.load(std::memory_order_relaxed);
+                delete mTail;
+                mTail = next;
+            }
+        }
+
+        // any thread
+        template <typename U>
+        void push(U&& value)
+        {
+            Node* node = new Node(std::forward<U>(value));
+            Node* prev = mHead.exchange(node, std::memory_order_acq_rel);
+            // Until this store, pop() can't see node, or any node pushed
+            // after it.
+            prev->mNext.store(node, std::memory_order_release);
+        }
+
+        // consumer thread only: false if empty, or if the next push() is
+        // still in progress
+        bool pop(T& value)
+        {
+            Node* next = mTail->mNext.load(std::memory_order_acquire);
+            if (! next)
+            {
+                return false;
+            }
+            // next becomes the new stub node
+            value = std::move(next->mValue);
+            delete mTail;
+            mTail = next;
+            return true;
+        }
+
+    private:
+        struct Node
+        {
+            Node(): mNext(nullptr) {}
+            template <typename U>
+            explicit Node(U&& value): mNext(nullptr), mValue(std::forward<U>(value)) {}
+
+            std::atomic<Node*> mNext;
+            T mValue;
+        };
+
+        // producers and consumer on separate cache lines
+        alignas(64) std::atomic<Node*> mHead;
+        alignas(64) Node* mTail;
+    };
+} // namespace LL
+
+/*****************************************************************************
+*   LLThreadSafeQueue lock-free MPSC specialization
+*****************************************************************************/
+/**
+ * LLThreadSafeQueue<ElementT, LL::MPSCQueue<ElementT>> has the same API and
+ * the same capacity, close() and timeout semantics as the general
+ * LLThreadSafeQueue, for the common case of many threads pushing and only
+ * one thread popping -- such as results going back to the main thread. Only
+ * one thread at a time may call any of the pop methods.
+ *
+ * push() and pop() don't lock. The mutex is only taken to sleep while the
+ * queue is empty or full, and to wake such a sleeper.
+ */
+template<typename ElementT>
+class LLThreadSafeQueue<ElementT, LL::MPSCQueue<ElementT>>
+{
+public:
+	typedef ElementT value_type;
+
+	LLThreadSafeQueue(size_t capacity = 1024);
+	virtual ~LLThreadSafeQueue() {}
+
+	// see the general LLThreadSafeQueue for each of these
+	template <typename T>
+	void push(T&& element);
+	void pushFront(ElementT const & element) { return push(element); }
+	template <typename T>
+	bool pushIfOpen(T&& element);
+	template <typename T>
+	bool tryPush(T&& element);
+	bool tryPushFront(ElementT const & element) { return tryPush(element); }
+	template <typename Rep, typename Period, typename T>
+	bool tryPushFor(const std::chrono::duration<Rep, Period>& timeout,
+					T&& element);
+	template <typename Rep, typename Period>
+	bool tryPushFrontFor(const std::chrono::duration<Rep, Period>& timeout,
+						 ElementT const & element) { return tryPushFor(timeout, element); }
+	template <typename Clock, typename Duration, typename T>
+	bool tryPushUntil(const std::chrono::time_point<Clock, Duration>& until,
+					  T&& element);
+
+	// consumer thread only
+	ElementT pop(void);
+	ElementT popBack(void) { return pop(); }
+	bool tryPop(ElementT & element);
+	bool tryPopBack(ElementT & element) { return tryPop(element); }
+	template <typename Rep, typename Period>
+	bool tryPopFor(const std::chrono::duration<Rep, Period>& timeout, ElementT& element);
+	template <typename Clock, typename Duration>
+	bool tryPopUntil(const std::chrono::time_point<Clock, Duration>& until,
+					 ElementT& element);
+
+	// Counts elements whose push() has begun and whose pop() has not ended.
+	size_t size() { return mSize; }
+	U32 capacity() { return (U32)mCapacity; }
+
+	void close();
+	bool isClosed() { return mClosed; }
+	bool done() { return mClosed && mSize == 0; }
+
+protected:
+	typedef LL::MPSCQueue<ElementT> queue_type;
+	typedef LLCoros::LockType lock_t;
+	enum pop_result { EMPTY, DONE, POPPED };
+
+	// Count one more element. Returns false, undoing that, if the queue is
+	// closed or full: full tells which.
+	bool reserve(bool& full);
+	// reserve(), waiting for room as long as wait(lock) returns true
+	template <typename WAIT>
+	bool reserveWaiting(WAIT&& wait);
+	// push a reserved element, waking the consumer if it's asleep
+	template <typename T>
+	void push_(T&& element);
+	// pop, waiting for an element as long as wait(lock) returns true
+	template <typename WAIT>
+	pop_result popWaiting(ElementT& element, WAIT&& wait);
+
+	queue_type mStorage;
+	const size_t mCapacity;
+	alignas(64) std::atomic<size_t> mSize;
+	std::atomic<bool> mClosed;
+	// threads asleep in pop or push
+	std::atomic<U32> mPopWaiters;
+	std::atomic<U32> mPushWaiters;
+
+	LLCoros::Mutex mLock;
+	LLCoros::ConditionVariable mCapacityCond;
+	LLCoros::ConditionVariable mEmptyCond;
+};
+
 /*****************************************************************************
 *   LLThreadSafeQueue implementation
 *****************************************************************************/
@@ -587,4 +760,243 @@ bool LLThreadSafeQueue<ElementT, QueueT>::done()
     return mClosed && mStorage.empty();
 }
 
+/*****************************************************************************
+*   LLThreadSafeQueue lock-free MPSC implementation
+*****************************************************************************/
+template<typename ElementT>
+LLThreadSafeQueue<ElementT, LL::MPSCQueue<ElementT>>::LLThreadSafeQueue(size_t capacity) :
+    mCapacity(capacity),
+    mSize(0),
+    mClosed(false),
+    mPopWaiters(0),
+    mPushWaiters(0)
+{
+}
+
+
+template<typename ElementT>
+bool LLThreadSafeQueue<ElementT, LL::MPSCQueue<ElementT>>::reserve(bool& full)
+{
+    // Count the element before checking mClosed: a consumer that sees
+    // mClosed then also sees this count, and waits for the element.
+    size_t prev = mSize++;
+    full = prev >= mCapacity;
+    if (mClosed || full)
+    {
+        --mSize;
+        return false;
+    }
+    return true;
+}
+
+
+template<typename ElementT>
+template <typename WAIT>
+bool LLThreadSafeQueue<ElementT, LL::MPSCQueue<ElementT>>::reserveWaiting(WAIT&& wait)
+{
+    LL_PROFILE_ZONE_SCOPED_CATEGORY_THREAD;
+    bool full = false;
+    if (reserve(full))
+        return true;
+    if (! full)
+        return false;
+
+    // Storage full. Register as a waiter before checking again, so that a
+    // pop either sees us or makes room we see.
+    lock_t lock(mLock);
+    ++mPushWaiters;
+    bool reserved = false;
+    while (! (reserved = reserve(full)) && full && wait(lock))
+        ;
+    --mPushWaiters;
+    return reserved;
+}
+
+
+template<typename ElementT>
+template <typename T>
+void LLThreadSafeQueue<ElementT, LL::MPSCQueue<ElementT>>::push_(T&& element)
+{
+    mStorage.push(std::forward<T>(element));
+    if (mPopWaiters)
+    {
+        lock_t lock(mLock);
+        mEmptyCond.notify_one();
+    }
+}
+
+
+template<typename ElementT>
+template <typename T>
+bool LLThreadSafeQueue<ElementT, LL::MPSCQueue<ElementT>>::pushIfOpen(T&& element)
+{
+    LL_PROFILE_ZONE_SCOPED_CATEGORY_THREAD;
+    if (! reserveWaiting([this](lock_t& lock){ mCapacityCond.wait(lock); return true; }))
+        return false;
+
+    push_(std::forward<T>(element));
+    return true;
+}
+
+
+template<typename ElementT>
+template <typename T>
+void LLThreadSafeQueue<ElementT, LL::MPSCQueue<ElementT>>::push(T&& element)
+{
+    LL_PROFILE_ZONE_SCOPED_CATEGORY_THREAD;
+    if (! pushIfOpen(std::forward<T>(element)))
+    {
+        LLTHROW(LLThreadSafeQueueInterrupt());
+    }
+}
+
+
+template<typename ElementT>
+template <typename T>
+bool LLThreadSafeQueue<ElementT, LL::MPSCQueue<ElementT>>::tryPush(T&& element)
+{
+    LL_PROFILE_ZONE_SCOPED_CATEGORY_THREAD;
+    bool full = false;
+    if (! reserve(full))
+        return false;
+
+    push_(std::forward<T>(element));
+    return true;
+}
+
+
+template<typename ElementT>
+template <typename Rep, typename Period, typename T>
+bool LLThreadSafeQueue<ElementT, LL::MPSCQueue<ElementT>>::tryPushFor(
+    const std::chrono::duration<Rep, Period>& timeout,
+    T&& element)
+{
+    return tryPushUntil(std::chrono::steady_clock::now() + timeout,
+                        std::forward<T>(element));
+}
+
+
+template<typename ElementT>
+template <typename Clock, typename Duration, typename T>
+bool LLThreadSafeQueue<ElementT, LL::MPSCQueue<ElementT>>::tryPushUntil(
+    const std::chrono::time_point<Clock, Duration>& until,
+    T&& element)
+{
+    LL_PROFILE_ZONE_SCOPED_CATEGORY_THREAD;
+    if (! reserveWaiting(
+            [this, &until](lock_t& lock)
+            { return LLCoros::cv_status::timeout != mCapacityCond.wait_until(lock, until); }))
+        return false;
+
+    push_(std::forward<T>(element));
+    return true;
+}
+
+
+template<typename ElementT>
+template <typename WAIT>
+typename LLThreadSafeQueue<ElementT, LL::MPSCQueue<ElementT>>::pop_result
+LLThreadSafeQueue<ElementT, LL::MPSCQueue<ElementT>>::popWaiting(ElementT& element, WAIT&& wait)
+{
+    LL_PROFILE_ZONE_SCOPED_CATEGORY_THREAD;
+    while (true)
+    {
+        // As with the general LLThreadSafeQueue, try to pop before checking
+        // mClosed so we can finish draining the queue.
+        if (tryPop(element))
+            return POPPED;
+
+        if (mClosed && mSize == 0)
+            return DONE;
+
+        // Register as a waiter before checking mSize again, so that a push
+        // either sees us or is seen by us. mSize may count an element whose
+        // push() hasn't finished, in which case we loop until it has.
+        lock_t lock(mLock);
+        ++mPopWaiters;
+        bool woken = wait(lock);
+        --mPopWaiters;
+        if (! woken)
+            return EMPTY;
+    }
+}
+
+
+template<typename ElementT>
+ElementT LLThreadSafeQueue<ElementT, LL::MPSCQueue<ElementT>>::pop(void)
+{
+    LL_PROFILE_ZONE_SCOPED_CATEGORY_THREAD;
+    ElementT value;
+    pop_result popped = popWaiting(
+        value,
+        [this](lock_t& lock)
+        {
+            mEmptyCond.wait(lock, [this](){ return mSize > 0 || mClosed; });
+            return true;
+        });
+    if (popped == DONE)
+    {
+        LLTHROW(LLThreadSafeQueueInterrupt());
+    }
+    return value;
+}
+
+
+template<typename ElementT>
+bool LLThreadSafeQueue<ElementT, LL::MPSCQueue<ElementT>>::tryPop(ElementT & element)
+{
+    LL_PROFILE_ZONE_SCOPED_CATEGORY_THREAD;
+    if (! mStorage.pop(element))
+        return false;
+
+    --mSize;
+    // now that we've popped, if somebody's been waiting to push, signal them
+    if (mPushWaiters)
+    {
+        lock_t lock(mLock);
+        mCapacityCond.notify_one();
+    }
+    return true;
+}
+
+
+template<typename ElementT>
+template <typename Rep, typename Period>
+bool LLThreadSafeQueue<ElementT, LL::MPSCQueue<ElementT>>::tryPopFor(
+    const std::chrono::duration<Rep, Period>& timeout,
+    ElementT& element)
+{
+    return tryPopUntil(std::chrono::steady_clock::now() + timeout, element);
+}
+
+
+template<typename ElementT>
+template <typename Clock, typename Duration>
+bool LLThreadSafeQueue<ElementT, LL::MPSCQueue<ElementT>>::tryPopUntil(
+    const std::chrono::time_point<Clock, Duration>& until,
+    ElementT& element)
+{
+    LL_PROFILE_ZONE_SCOPED_CATEGORY_THREAD;
+    return POPPED == popWaiting(
+        element,
+        [this, &until](lock_t& lock)
+        {
+            return mEmptyCond.wait_until(lock, until, [this](){ return mSize > 0 || mClosed; });
+        });
+}
+
+
+template<typename ElementT>
+void LLThreadSafeQueue<ElementT, LL::MPSCQueue<ElementT>>::close()
+{
+    LL_PROFILE_ZONE_SCOPED_CATEGORY_THREAD;
+    lock_t lock(mLock);
+    mClosed = true;
+    lock.unlock();
+    // wake up any blocked pop() calls
+    mEmptyCond.notify_all();
+    // wake up any blocked push() calls
+    mCapacityCond.notify_all();
+}
+
 #endif
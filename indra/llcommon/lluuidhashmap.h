@@ -0,0 +1,312 @@
+/**
+ * @file lluuidhashmap.h
+ * @brief Open-addressed hash table keyed by LLUUID.
+ *
+ * $LicenseInfo:firstyear=2024&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2024, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#ifndef LL_LLUUIDHASHMAP_H
+#define LL_LLUUIDHASHMAP_H
+
+#include "lluuid.h"
+
+#include <iterator>
+#include <utility>
+#include <vector>
+
+/**
+ * LLUUIDHashMap is a map from LLUUID to T stored in one flat array, with
+ * linear probing. Asset and texture ids are random, so their 64 bit digest
+ * is used as the hash as is.
+ *
+ * A null key marks an empty slot, so the null id itself lives in one extra
+ * slot past the table. Erasing shifts the following entries back rather
+ * than leaving tombstones, so lookups never slow down as entries come and
+ * go. Inserting a new key can invalidate iterators and, unlike with
+ * std::unordered_map, references; operator[]() on a key that is already
+ * there never does. Erasing invalidates iterators too.
+ *
+ * The interface is the subset of std::map used for id lookups: find(),
+ * operator[](), erase(), iteration over std::pair<LLUUID, T>.
+ */
+template <typename T>
+class LLUUIDHashMap
+{
+public:
+    typedef std::pair<LLUUID, T> value_type;
+
+private:
+    template <typename MAP, typename VALUE>
+    class iterator_base
+    {
+    public:
+        typedef std::forward_iterator_tag iterator_category;
+        typedef VALUE value_type;
+        typedef std::ptrdiff_t difference_type;
+        typedef VALUE* pointer;
+        typedef VALUE& reference;
+
+        iterator_base() : mMap(nullptr), mSlot(0) {}
+        iterator_base(MAP* map, size_t slot) : mMap(map), mSlot(slot) {}
+        // iterator to const_iterator
+        template <typename OTHER_MAP, typename OTHER_VALUE>
+        iterator_base(const iterator_base<OTHER_MAP, OTHER_VALUE>& other) : mMap(other.mMap), mSlot(other.mSlot) {}
+
+        reference operator*() const     { return mMap->mSlots[mSlot]; }
+        pointer operator->() const      { return &mMap->mSlots[mSlot]; }
+
+        iterator_base& operator++()
+        {
+            mSlot = mMap->nextUsedSlot(mSlot + 1);
+            return *this;
+        }
+        iterator_base operator++(int)
+        {
+            iterator_base prev(*this);
+            ++*this;
+            return prev;
+        }
+
+        bool operator==(const iterator_base& other) const   { return mSlot == other.mSlot; }
+        bool operator!=(const iterator_base& other) const   { return mSlot != other.mSlot; }
+
+    private:
+        template <typename, typename> friend class iterator_base;
+        friend class LLUUIDHashMap;
+
+        MAP* mMap;
+        size_t mSlot;
+    };
+
+public:
+    typedef iterator_base<LLUUIDHashMap, value_type> iterator;
+    typedef iterator_base<const LLUUIDHashMap, const value_type> const_iterator;
+
+    LLUUIDHashMap()
+    :   mSize(0),
+        mMask(0),
+        mHasNull(false)
+    {
+        rehash(MIN_CAPACITY);
+    }
+
+    size_t size() const     { return mSize; }
+    bool empty() const      { return mSize == 0; }
+
+    iterator begin()                { return iterator(this, nextUsedSlot(0)); }
+    iterator end()                  { return iterator(this, mSlots.size()); }
+    const_iterator begin() const    { return const_iterator(this, nextUsedSlot(0)); }
+    const_iterator end() const      { return const_iterator(this, mSlots.size()); }
+
+    iterator find(const LLUUID& key)                { return iterator(this, findSlot(key)); }
+    const_iterator find(const LLUUID& key) const    { return const_iterator(this, findSlot(key)); }
+    size_t count(const LLUUID& key) const           { return findSlot(key) != mSlots.size() ? 1 : 0; }
+
+    T& operator[](const LLUUID& key)
+    {
+        return mSlots[insertSlot(key)].second;
+    }
+
+    size_t erase(const LLUUID& key)
+    {
+        size_t slot = findSlot(key);
+        if (slot == mSlots.size())
+        {
+            return 0;
+        }
+        eraseSlot(slot);
+        return 1;
+    }
+
+    void erase(iterator iter)
+    {
+        eraseSlot(iter.mSlot);
+    }
+
+    void clear()
+    {
+        for (value_type& slot : mSlots)
+        {
+            slot = value_type();
+        }
+        mSize = 0;
+        mHasNull = false;
+    }
+
+    // Size the table for count entries without growing
+    void reserve(size_t count)
+    {
+        size_t capacity = MIN_CAPACITY;
+        while (count * 4 > capacity * 3)
+        {
+            capacity *= 2;
+        }
+        if (capacity > mMask + 1)
+        {
+            rehash(capacity);
+        }
+    }
+
+private:
+    static constexpr size_t MIN_CAPACITY = 16;
+
+    size_t idealSlot(const LLUUID& key) const
+    {
+        return (size_t)key.getDigest64() & mMask;
+    }
+
+    size_t nullSlot() const
+    {
+        return mMask + 1;
+    }
+
+    bool isUsed(size_t slot) const
+    {
+        return slot < nullSlot() ? mSlots[slot].first.notNull() : mHasNull;
+    }
+
+    size_t nextUsedSlot(size_t slot) const
+    {
+        while (slot < mSlots.size() && !isUsed(slot))
+        {
+            ++slot;
+        }
+        return slot;
+    }
+
+    // mSlots.size() if not found
+    size_t findSlot(const LLUUID& key) const
+    {
+        if (key.isNull())
+        {
+            return mHasNull ? nullSlot() : mSlots.size();
+        }
+        for (size_t slot = idealSlot(key); ; slot = (slot + 1) & mMask)
+        {
+            const LLUUID& slot_key = mSlots[slot].first;
+            if (slot_key == key)
+            {
+                return slot;
+            }
+            if (slot_key.isNull())
+            {
+                return mSlots.size();
+            }
+        }
+    }
+
+    size_t insertSlot(const LLUUID& key)
+    {
+        if (key.isNull())
+        {
+            if (!mHasNull)
+            {
+                mHasNull = true;
+                ++mSize;
+            }
+            return nullSlot();
+        }
+
+        size_t slot = idealSlot(key);
+        for ( ; mSlots[slot].first.notNull(); slot = (slot + 1) & mMask)
+        {
+            if (mSlots[slot].first == key)
+            {
+                return slot;
+            }
+        }
+
+        // Only a new key may grow the table, so looking up one that is
+        // there never moves the others. Keep the load factor under 3/4.
+        if ((mSize + 1) * 4 > (mMask + 1) * 3)
+        {
+            rehash((mMask + 1) * 2);
+            return insertSlot(key);
+        }
+        mSlots[slot].first = key;
+        ++mSize;
+        return slot;
+    }
+
+    void eraseSlot(size_t slot)
+    {
+        if (slot == nullSlot())
+        {
+            mSlots[slot].second = T();
+            mHasNull = false;
+            --mSize;
+            return;
+        }
+
+        // Shift back the entries of the probe sequence that follows, so
+        // that none of them ends up behind an empty slot.
+        size_t hole = slot;
+        for (size_t next = (hole + 1) & mMask; mSlots[next].first.notNull(); next = (next + 1) & mMask)
+        {
+            size_t ideal = idealSlot(mSlots[next].first);
+            // Can the entry at 'next' move to 'hole'? Only if its ideal slot
+            // is not cyclically within (hole, next].
+            bool movable = hole <= next ? (ideal <= hole || ideal > next)
+                                        : (ideal <= hole && ideal > next);
+            if (movable)
+            {
+                mSlots[hole] = std::move(mSlots[next]);
+                hole = next;
+            }
+        }
+        mSlots[hole] = value_type();
+        --mSize;
+    }
+
+    void rehash(size_t capacity)
+    {
+        std::vector<value_type> old_slots;
+        old_slots.swap(mSlots);
+        bool had_null = mHasNull;
+        size_t old_null_slot = old_slots.empty() ? 0 : mMask + 1;
+
+        mMask = capacity - 1;
+        mSlots.resize(capacity + 1);
+        mSize = 0;
+        mHasNull = false;
+
+        for (size_t slot = 0; slot < old_null_slot; ++slot)
+        {
+            if (old_slots[slot].first.notNull())
+            {
+                mSlots[insertSlot(old_slots[slot].first)].second = std::move(old_slots[slot].second);
+            }
+        }
+        if (had_null)
+        {
+            mSlots[insertSlot(LLUUID::null)].second = std::move(old_slots[old_null_slot].second);
+        }
+    }
+
+private:
+    std::vector<value_type> mSlots; // mMask + 1 hashed slots, then the null key slot
+    size_t mSize;
+    size_t mMask;
+    bool mHasNull;
+};
+
+#endif // LL_LLUUIDHASHMAP_H
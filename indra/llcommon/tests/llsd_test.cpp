@@ -0,0 +1,362 @@
+/**
+ * @file   llsd_test.cpp
+ * @brief  Test for LLSD's map representation, and its cost on large
+ *         documents.
+ *
+ * $LicenseInfo:firstyear=2024&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2024, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+
+#include "../llsd.h"
+
+#include <atomic>
+#include <map>
+#include <random>
+#include <sstream>
+#include <thread>
+
+#include "llsdserialize.h"
+#include "llsdutil.h"
+#include "lltimer.h"
+#include "stringize.h"
+
+#include "../test/countallocs.h"
+#include "../test/lltut.h"
+
+namespace
+{
+	// Alternately keys std::string keeps inline and keys it doesn't
+	std::string random_key_prefix(S32 round)
+	{
+		return (round % 2) ? "a key long enough to need its own allocation " : "k";
+	}
+
+	// A settings.xml: each setting a map of its comment, type and value
+	LLSD make_settings(std::mt19937& random, S32 count)
+	{
+		static const char* PREFIXES[] = { "Render", "Avatar", "Camera", "Debug", "Inventory", "Audio", "Chat",
+										  "Floater", "Texture", "Mesh" };
+		static const char* WORDS[] = { "Max", "Enable", "Quality", "Distance", "Scale", "Offset", "Visible",
+									   "Impostors", "Cache", "Threads", "Volume", "Level", "Size" };
+		static const char* TYPES[] = { "Boolean", "S32", "F32", "String", "Vector3" };
+		LLSD settings = LLSD::emptyMap();
+		while (settings.size() < (size_t)count)
+		{
+			std::string name = PREFIXES[random() % LL_ARRAY_SIZE(PREFIXES)];
+			for (S32 words = 1 + random() % 3; words; --words)
+			{
+				name += WORDS[random() % LL_ARRAY_SIZE(WORDS)];
+			}
+			name += stringize(random() % 100);
+			LLSD& setting = settings[name];
+			setting["Comment"] = "What " + name + " does, in a sentence or two for the debug settings floater";
+			setting["Persist"] = 1;
+			S32 type = random() % LL_ARRAY_SIZE(TYPES);
+			setting["Type"] = TYPES[type];
+			switch (type)
+			{
+			case 0:
+			case 1:
+				setting["Value"] = S32(random() % 2);
+				break;
+			case 2:
+				setting["Value"] = F64(random() % 1000) / 10.0;
+				break;
+			case 3:
+				setting["Value"] = std::string("default");
+				break;
+			default:
+				setting["Value"][0] = 1.0;
+				setting["Value"][1] = 0.5;
+				setting["Value"][2] = 0.0;
+				break;
+			}
+			if (random() % 4 == 0)
+			{
+				setting["Backup"] = 0;
+			}
+		}
+		return settings;
+	}
+
+	// An inventory cache: each item as LLInventoryItem::asLLSD() has it
+	LLSD make_inventory(std::mt19937& random, S32 count)
+	{
+		LLSD items = LLSD::emptyArray();
+		LLUUID owner_id = LLUUID::generateNewID();
+		for (S32 i = 0; i < count; ++i)
+		{
+			LLSD item;
+			item["item_id"] = LLUUID::generateNewID();
+			item["parent_id"] = LLUUID::generateNewID();
+			item["asset_id"] = LLUUID::generateNewID();
+			item["name"] = stringize("Item ", i, " of ", count);
+			item["desc"] = (random() % 2) ? std::string("(No Description)") : stringize("Description ", random());
+			item["type"] = S32(random() % 20);
+			item["inv_type"] = S32(random() % 20);
+			item["flags"] = S32(random() % 0x10000);
+			item["created_at"] = S32(1600000000 + random() % 100000000);
+			LLSD& permissions = item["permissions"];
+			permissions["creator_id"] = LLUUID::generateNewID();
+			permissions["owner_id"] = owner_id;
+			permissions["last_owner_id"] = owner_id;
+			permissions["group_id"] = LLUUID::null;
+			permissions["is_owner_group"] = false;
+			permissions["base_mask"] = S32(0x7fffffff);
+			permissions["owner_mask"] = S32(0x7fffffff);
+			permissions["group_mask"] = 0;
+			permissions["everyone_mask"] = 0;
+			permissions["next_owner_mask"] = S32(0x82000);
+			item["sale_info"]["sale_price"] = 10;
+			item["sale_info"]["sale_type"] = 0;
+			items.append(item);
+		}
+		return items;
+	}
+}
+
+namespace tut
+{
+	struct llsd_data
+	{
+		llsd_data() :
+			mRandom(20241003)
+		{
+		}
+
+		std::mt19937 mRandom;
+	};
+	typedef test_group<llsd_data> llsd_test;
+	typedef llsd_test::object llsd_object;
+	tut::llsd_test llsd("LLSD");
+
+	template<> template<>
+	void llsd_object::test<1>()
+	{
+		set_test_name("maps agree with std::map under random operations");
+		for (S32 round = 0; round < 20; ++round)
+		{
+			LLSD map = LLSD::emptyMap();
+			std::map<std::string, S32> model;
+			// references must stay good for as long as std::map's would
+			LLSD* held = NULL;
+			std::string held_key;
+			for (S32 i = 0; i < 2000; ++i)
+			{
+				// short and long keys, so some repeat
+				std::string key = stringize(random_key_prefix(round), mRandom() % 300);
+				switch (mRandom() % 6)
+				{
+				case 0:
+				case 1:
+					map[key] = i;
+					model[key] = i;
+					break;
+				case 2:
+					map.insert(key, i);
+					model.insert(std::make_pair(key, i));
+					break;
+				case 3:
+					if (key != held_key)
+					{
+						map.erase(key);
+						model.erase(key);
+					}
+					break;
+				case 4:
+				{
+					// copy on write
+					LLSD copy = map;
+					copy[key] = -1;
+					copy.erase(held_key);
+					break;
+				}
+				default:
+					held = &map[key];
+					held_key = key;
+					if (model.find(key) == model.end())
+					{
+						model[key] = 0;
+						*held = 0;
+					}
+					break;
+				}
+				if (held)
+				{
+					ensure_equals("held reference", held->asInteger(), model[held_key]);
+				}
+			}
+
+			ensure_equals("size", map.size(), model.size());
+			LLSD::map_const_iterator it = map.beginMap();
+			for (const auto& entry : model)
+			{
+				ensure_equals("key", it->first, entry.first);
+				ensure_equals(entry.first, it->second.asInteger(), entry.second);
+				ensure(entry.first + " has", map.has(entry.first));
+				++it;
+			}
+			ensure("end", it == map.endMap());
+		}
+	}
+
+	template<> template<>
+	void llsd_object::test<2>()
+	{
+		set_test_name("maps on several threads sharing keys");
+		// Keys are shared between maps, whichever threads they're on
+		std::vector<std::thread> threads;
+		std::atomic<S32> failures(0);
+		for (S32 t = 0; t < 4; ++t)
+		{
+			threads.emplace_back([t, &failures]()
+			{
+				std::mt19937 random(t);
+				for (S32 i = 0; i < 2000; ++i)
+				{
+					LLSD map;
+					for (S32 j = 0; j < 20; ++j)
+					{
+						S32 key = random() % 40;
+						map[stringize(random_key_prefix(key), key)] = key;
+					}
+					LLSD copy = map;
+					copy["extra"] = true;
+					map.erase(map.beginMap()->first);
+					for (LLSD::map_const_iterator it = copy.beginMap(); it != copy.endMap(); ++it)
+					{
+						if (it->first != "extra" && it->first != stringize(random_key_prefix(it->second.asInteger()),
+																		   it->second.asInteger()))
+						{
+							++failures;
+						}
+					}
+				}
+			});
+		}
+		for (std::thread& thread : threads)
+		{
+			thread.join();
+		}
+		ensure_equals("mismatched keys", failures.load(), 0);
+	}
+
+	template<> template<>
+	void llsd_object::test<3>()
+	{
+		set_test_name("time and memory for settings and inventory documents");
+		// The round trips always run; the documents grow to full size and
+		// the numbers get logged only under LL_BENCHMARKS
+		const S32 scale = benchmarking() ? 10 : 1;
+		struct Document
+		{
+			std::string mName;
+			LLSD mSD;
+			std::string mXML;
+		};
+		Document documents[] = {
+			{ STRINGIZE("settings.xml, " << 150 * scale << " settings"), make_settings(mRandom, 150 * scale) },
+			{ STRINGIZE("inventory cache, " << 2000 * scale << " items"), make_inventory(mRandom, 2000 * scale) }
+		};
+
+		for (Document& document : documents)
+		{
+			std::ostringstream xml;
+			LLSDSerialize::toXML(document.mSD, xml);
+			document.mXML = xml.str();
+			const std::string& name(document.mName);
+
+			const S32 PASSES = benchmarking() ? 3 : 1;
+			F64 parse_seconds = 0.0;
+			F64 lookup_seconds = 0.0;
+			F64 clone_seconds = 0.0;
+			F64 free_seconds = 0.0;
+			size_t allocations = 0;
+			S64 bytes = 0;
+			S64 lookups = 0;
+			for (S32 pass = 0; pass < PASSES; ++pass)
+			{
+				LLSD sd;
+				{
+					std::istringstream stream(document.mXML);
+					size_t allocs_before = CountAllocs::sCount;
+					S64 bytes_before = CountAllocs::sLiveBytes;
+					LLTimer timer;
+					LLSDSerialize::fromXML(sd, stream);
+					parse_seconds += timer.getElapsedTimeF64();
+					allocations = CountAllocs::sCount - allocs_before;
+					bytes = CountAllocs::sLiveBytes - bytes_before;
+				}
+				ensure(name + " round trip", llsd_equals(sd, document.mSD));
+
+				// every key of every map, once
+				LLTimer timer;
+				S64 found = 0;
+				if (sd.isMap())
+				{
+					for (LLSD::map_const_iterator it = sd.beginMap(); it != sd.endMap(); ++it)
+					{
+						const LLSD& setting = sd[it->first];
+						found += setting["Value"].isDefined() + setting["Type"].isDefined() + setting["Persist"].isDefined()
+							+ setting["Comment"].isDefined() + setting["Backup"].isDefined() + 1;
+					}
+				}
+				else
+				{
+					const LLSD& items = sd;
+					for (LLSD::array_const_iterator it = items.beginArray(); it != items.endArray(); ++it)
+					{
+						const LLSD& item = *it;
+						found += item["item_id"].isDefined() + item["parent_id"].isDefined()
+							+ item["asset_id"].isDefined() + item["name"].isDefined() + item["desc"].isDefined()
+							+ item["type"].isDefined() + item["inv_type"].isDefined() + item["flags"].isDefined()
+							+ item["created_at"].isDefined() + item["permissions"]["owner_id"].isDefined()
+							+ item["permissions"]["next_owner_mask"].isDefined()
+							+ item["sale_info"]["sale_price"].isDefined();
+					}
+				}
+				lookup_seconds += timer.getElapsedTimeF64();
+				lookups = found;
+
+				timer.reset();
+				LLSD clone = llsd_clone(sd);
+				clone_seconds += timer.getElapsedTimeF64();
+
+				timer.reset();
+				sd.clear();
+				clone.clear();
+				free_seconds += timer.getElapsedTimeF64();
+			}
+
+			if (benchmarking())
+			{
+				LL_INFOS("Benchmark") << name << ": parsing " << document.mXML.size() / 1024 << " KB of XML "
+									  << 1000.0 * parse_seconds / PASSES << " ms, "
+									  << allocations << " allocations, " << bytes / 1024 << " KB in use" << LL_ENDL;
+				LL_INFOS("Benchmark") << name << ": " << lookups << " lookups " << 1000.0 * lookup_seconds / PASSES
+									  << " ms, llsd_clone() " << 1000.0 * clone_seconds / PASSES
+									  << " ms, freeing both " << 1000.0 * free_seconds / PASSES << " ms" << LL_ENDL;
+			}
+		}
+	}
+}
@@ -0,0 +1,1014 @@
+/**
+ * @file   llsdsaxparser_test.cpp
+ * @brief  Test for LLSDSAXParser against LLSDBinaryParser and
+ *         LLSDNotationParser.
+ *
+ * Test 6 is a benchmark, run with LL_BENCHMARKS set. It also takes a real
+ * mesh asset: point LL_MESH_ASSET_FILE at one (from the viewer's cache, say)
+ * to benchmark its header.
+ *
+ * $LicenseInfo:firstyear=2024&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2024, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+
+#include "../llsdsaxparser.h"
+
+#include <fstream>
+#include <random>
+#include <sstream>
+
+#include "lldate.h"
+#include "llmemorystream.h"
+#include "llsdserialize.h"
+#include "llsdutil.h"
+#include "lltimer.h"
+#include "lluri.h"
+#include "stringize.h"
+
+#include "../test/countallocs.h"
+#include "../test/lltut.h"
+
+namespace
+{
+	std::string random_string(std::mt19937& random, S32 max_length)
+	{
+		// quotes, escapes, control characters and non-ASCII, now and then
+		static const char SPECIAL[] = "'\"\\\n\t\x01\x7f\xc3\xa9 :,{}[]";
+		std::string value;
+		S32 length = random() % (max_length + 1);
+		for (S32 i = 0; i < length; ++i)
+		{
+			if (random() % 8)
+			{
+				value += char('a' + random() % 26);
+			}
+			else
+			{
+				value += SPECIAL[random() % (sizeof(SPECIAL) - 1)];
+			}
+		}
+		return value;
+	}
+
+	LLSD random_llsd(std::mt19937& random, S32 depth)
+	{
+		switch (random() % (depth > 0 ? 12 : 9))
+		{
+		case 0:
+			return LLSD();
+		case 1:
+			return LLSD(bool(random() % 2));
+		case 2:
+			return LLSD(S32(random()));
+		case 3:
+			return LLSD(F64(S32(random())) / F64(random() % 1000 + 1));
+		case 4:
+		{
+			LLUUID id;
+			for (S32 i = 0; i < UUID_BYTES; ++i)
+			{
+				id.mData[i] = U8(random());
+			}
+			return LLSD(id);
+		}
+		case 5:
+			return LLSD(random_string(random, 40));
+		case 6:
+			return LLSD(LLDate(F64(random() % 2000000000)));
+		case 7:
+			return LLSD(LLURI("http://example.com/" + random_string(random, 10)));
+		case 8:
+		{
+			LLSD::Binary value(random() % 40);
+			for (U8& byte : value)
+			{
+				byte = U8(random());
+			}
+			return LLSD(value);
+		}
+		case 9:
+		case 10:
+		{
+			LLSD map = LLSD::emptyMap();
+			S32 size = random() % 6;
+			for (S32 i = 0; i < size; ++i)
+			{
+				map[random_string(random, 12)] = random_llsd(random, depth - 1);
+			}
+			return map;
+		}
+		default:
+		{
+			LLSD array = LLSD::emptyArray();
+			S32 size = random() % 6;
+			for (S32 i = 0; i < size; ++i)
+			{
+				array.append(random_llsd(random, depth - 1));
+			}
+			return array;
+		}
+		}
+	}
+
+	std::string to_binary(const LLSD& sd)
+	{
+		std::ostringstream stream;
+		LLSDSerialize::toBinary(sd, stream);
+		return stream.str();
+	}
+
+	// Parses doc with LLSDBinaryParser or LLSDNotationParser, the way the
+	// viewer does with data in memory
+	S32 tree_parse(const std::string& doc, bool binary, LLSD& sd, S32 max_depth = -1)
+	{
+		LLMemoryStream stream((const U8*)doc.data(), (S32)doc.size());
+		if (binary)
+		{
+			return LLSDSerialize::fromBinary(sd, stream, doc.size(), max_depth);
+		}
+		LLPointer<LLSDNotationParser> parser = new LLSDNotationParser;
+		return parser->parse(stream, sd, doc.size(), max_depth);
+	}
+
+	S32 sax_parse(LLSDSAXParser& parser, const std::string& doc, bool binary, LLSD& sd, S32 max_depth = -1)
+	{
+		LLSDSAXBuilder builder(sd);
+		if (binary)
+		{
+			return parser.parseBinary(doc.data(), doc.size(), builder, max_depth);
+		}
+		return parser.parseNotation(doc.data(), doc.size(), builder, max_depth);
+	}
+
+	// The fields LLMeshHeader::fromLLSD() takes from a mesh header
+	struct MeshHeaderFields
+	{
+		S32 mVersion = -1;
+		S32 mLodOffset[4] = { -1, -1, -1, -1 };
+		S32 mLodSize[4] = { -1, -1, -1, -1 };
+		S32 mSkinOffset = -1;
+		S32 mSkinSize = -1;
+		S32 mPhysicsConvexOffset = -1;
+		S32 mPhysicsConvexSize = -1;
+		S32 mPhysicsMeshOffset = -1;
+		S32 mPhysicsMeshSize = -1;
+		bool m404 = false;
+
+		bool operator==(const MeshHeaderFields& other) const
+		{
+			return !memcmp(this, &other, offsetof(MeshHeaderFields, m404)) && m404 == other.m404;
+		}
+	};
+
+	const char* MESH_LODS[] = { "lowest_lod", "low_lod", "medium_lod", "high_lod" };
+
+	void mesh_header_from_llsd(const LLSD& header, MeshHeaderFields& fields)
+	{
+		fields.mVersion = header["version"].asInteger();
+		for (U32 i = 0; i < 4; ++i)
+		{
+			fields.mLodOffset[i] = header[MESH_LODS[i]]["offset"].asInteger();
+			fields.mLodSize[i] = header[MESH_LODS[i]]["size"].asInteger();
+		}
+		fields.mSkinOffset = header["skin"]["offset"].asInteger();
+		fields.mSkinSize = header["skin"]["size"].asInteger();
+		fields.mPhysicsConvexOffset = header["physics_convex"]["offset"].asInteger();
+		fields.mPhysicsConvexSize = header["physics_convex"]["size"].asInteger();
+		fields.mPhysicsMeshOffset = header["physics_mesh"]["offset"].asInteger();
+		fields.mPhysicsMeshSize = header["physics_mesh"]["size"].asInteger();
+		fields.m404 = header.has("404");
+	}
+
+	// Decodes the same fields without building anything
+	class MeshHeaderHandler : public LLSDSAXHandler
+	{
+	public:
+		MeshHeaderHandler(MeshHeaderFields& fields) :
+			mFields(fields),
+			mDepth(0),
+			mOffset(NULL),
+			mSize(NULL),
+			mTarget(NULL)
+		{
+			// LLSD::asInteger() of a missing entry
+			mFields = MeshHeaderFields();
+			mFields.mVersion = 0;
+			S32* fields_to_zero[] = { &mFields.mSkinOffset, &mFields.mSkinSize,
+									  &mFields.mPhysicsConvexOffset, &mFields.mPhysicsConvexSize,
+									  &mFields.mPhysicsMeshOffset, &mFields.mPhysicsMeshSize };
+			for (S32* field : fields_to_zero)
+			{
+				*field = 0;
+			}
+			for (U32 i = 0; i < 4; ++i)
+			{
+				mFields.mLodOffset[i] = mFields.mLodSize[i] = 0;
+			}
+		}
+
+		EAction beginMap(S32 size) override
+		{
+			++mDepth;
+			return CONTINUE;
+		}
+
+		EAction endMap() override
+		{
+			--mDepth;
+			return CONTINUE;
+		}
+
+		EAction key(std::string_view key) override
+		{
+			mTarget = NULL;
+			if (1 == mDepth)
+			{
+				mOffset = mSize = NULL;
+				if (key == "version")
+				{
+					mTarget = &mFields.mVersion;
+				}
+				else if (key == "404")
+				{
+					mFields.m404 = true;
+					return SKIP;
+				}
+				else if (key == "skin")
+				{
+					mOffset = &mFields.mSkinOffset;
+					mSize = &mFields.mSkinSize;
+				}
+				else if (key == "physics_convex")
+				{
+					mOffset = &mFields.mPhysicsConvexOffset;
+					mSize = &mFields.mPhysicsConvexSize;
+				}
+				else if (key == "physics_mesh")
+				{
+					mOffset = &mFields.mPhysicsMeshOffset;
+					mSize = &mFields.mPhysicsMeshSize;
+				}
+				else
+				{
+					for (U32 i = 0; i < 4; ++i)
+					{
+						if (key == MESH_LODS[i])
+						{
+							mOffset = &mFields.mLodOffset[i];
+							mSize = &mFields.mLodSize[i];
+						}
+					}
+				}
+				return (mTarget || mOffset) ? CONTINUE : SKIP;
+			}
+			if (2 == mDepth && mOffset)
+			{
+				if (key == "offset")
+				{
+					mTarget = mOffset;
+				}
+				else if (key == "size")
+				{
+					mTarget = mSize;
+				}
+			}
+			return mTarget ? CONTINUE : SKIP;
+		}
+
+		EAction integer(S32 value) override
+		{
+			return set(value);
+		}
+
+		EAction real(F64 value) override
+		{
+			return set(LLSD(value).asInteger());
+		}
+
+		EAction boolean(bool value) override
+		{
+			return set(value ? 1 : 0);
+		}
+
+	private:
+		EAction set(S32 value)
+		{
+			if (mTarget)
+			{
+				*mTarget = value;
+				mTarget = NULL;
+			}
+			return CONTINUE;
+		}
+
+		MeshHeaderFields&	mFields;
+		S32					mDepth;
+		S32*				mOffset;
+		S32*				mSize;
+		S32*				mTarget;
+	};
+
+	LLSD mesh_header(std::mt19937& random)
+	{
+		LLSD header;
+		header["version"] = 1;
+		header["creator"] = LLUUID::generateNewID();
+		header["date"] = LLDate(F64(1700000000 + random() % 10000000));
+		S32 offset = 0;
+		const char* blocks[] = { "physics_convex", "skin", "lowest_lod", "low_lod", "medium_lod", "high_lod",
+								 "physics_mesh" };
+		for (const char* block : blocks)
+		{
+			if (random() % 4)
+			{
+				S32 size = S32(random() % 200000 + 100);
+				header[block]["offset"] = offset;
+				header[block]["size"] = size;
+				offset += size;
+			}
+		}
+		return header;
+	}
+
+	// What an AIS category fetch returns: the category, its items and
+	// subcategories, and links
+	LLSD ais_category(std::mt19937& random)
+	{
+		LLSD category;
+		LLUUID category_id = LLUUID::generateNewID();
+		category["category_id"] = category_id;
+		category["parent_id"] = LLUUID::generateNewID();
+		category["agent_id"] = LLUUID::generateNewID();
+		category["name"] = "Objects " + random_string(random, 10);
+		category["type_default"] = -1;
+		category["version"] = S32(random() % 1000);
+		category["descendents"] = 40;
+		LLSD& items = category["_embedded"]["items"];
+		for (S32 i = 0; i < 30; ++i)
+		{
+			LLUUID item_id = LLUUID::generateNewID();
+			LLSD& item = items[item_id.asString()];
+			item["item_id"] = item_id;
+			item["parent_id"] = category_id;
+			item["asset_id"] = LLUUID::generateNewID();
+			item["name"] = "Item " + random_string(random, 20);
+			item["desc"] = random() % 2 ? std::string("(No Description)") : random_string(random, 40);
+			item["type"] = S32(random() % 20);
+			item["inv_type"] = S32(random() % 20);
+			item["flags"] = S32(random() % 0x10000);
+			item["created_at"] = S32(1600000000 + random() % 100000000);
+			LLSD& permissions = item["permissions"];
+			permissions["creator_id"] = LLUUID::generateNewID();
+			permissions["owner_id"] = category["agent_id"];
+			permissions["last_owner_id"] = LLUUID::generateNewID();
+			permissions["group_id"] = LLUUID::null;
+			permissions["is_owner_group"] = false;
+			permissions["base_mask"] = S32(0x7fffffff);
+			permissions["owner_mask"] = S32(0x7fffffff);
+			permissions["group_mask"] = 0;
+			permissions["everyone_mask"] = 0;
+			permissions["next_owner_mask"] = S32(0x82000);
+			item["sale_info"]["sale_price"] = 10;
+			item["sale_info"]["sale_type"] = 0;
+			item["_links"]["self"]["href"] = "/category/" + category_id.asString() + "/items";
+		}
+		LLSD& categories = category["_embedded"]["categories"];
+		for (S32 i = 0; i < 10; ++i)
+		{
+			LLUUID child_id = LLUUID::generateNewID();
+			LLSD& child = categories[child_id.asString()];
+			child["category_id"] = child_id;
+			child["parent_id"] = category_id;
+			child["name"] = "Folder " + random_string(random, 10);
+			child["type_default"] = -1;
+			child["version"] = S32(random() % 100);
+		}
+		category["_links"]["self"]["href"] = "/category/" + category_id.asString();
+		return category;
+	}
+
+	// The parts of an item the inventory model needs to place it
+	struct ItemFields
+	{
+		LLUUID mItemID;
+		LLUUID mParentID;
+		LLUUID mAssetID;
+		std::string mName;
+		S32 mType = -1;
+		S32 mInvType = -1;
+		S32 mFlags = 0;
+		LLUUID mOwnerID;
+	};
+
+	void items_from_llsd(const LLSD& category, std::vector<ItemFields>& items)
+	{
+		items.clear();
+		const LLSD& embedded = category["_embedded"]["items"];
+		for (LLSD::map_const_iterator it = embedded.beginMap(); it != embedded.endMap(); ++it)
+		{
+			const LLSD& item = it->second;
+			items.push_back(ItemFields());
+			ItemFields& fields = items.back();
+			fields.mItemID = item["item_id"].asUUID();
+			fields.mParentID = item["parent_id"].asUUID();
+			fields.mAssetID = item["asset_id"].asUUID();
+			fields.mName = item["name"].asString();
+			fields.mType = item["type"].asInteger();
+			fields.mInvType = item["inv_type"].asInteger();
+			fields.mFlags = item["flags"].asInteger();
+			fields.mOwnerID = item["permissions"]["owner_id"].asUUID();
+		}
+	}
+
+	// Walks _embedded/items/<id>/... and skips everything else
+	class ItemsHandler : public LLSDSAXHandler
+	{
+	public:
+		ItemsHandler(std::vector<ItemFields>& items) :
+			mItems(items),
+			mDepth(0),
+			mField(NONE)
+		{
+			mItems.clear();
+		}
+
+		EAction beginMap(S32 size) override
+		{
+			if (4 == ++mDepth)
+			{
+				mItems.push_back(ItemFields());
+			}
+			return CONTINUE;
+		}
+
+		EAction endMap() override
+		{
+			--mDepth;
+			return CONTINUE;
+		}
+
+		EAction key(std::string_view key) override
+		{
+			mField = NONE;
+			switch (mDepth)
+			{
+			case 1:
+				return key == "_embedded" ? CONTINUE : SKIP;
+			case 2:
+				return key == "items" ? CONTINUE : SKIP;
+			case 3:
+				// one per item
+				return CONTINUE;
+			case 4:
+				if (key == "permissions")
+				{
+					return CONTINUE;
+				}
+				mField = key == "item_id" ? ITEM_ID
+					: key == "parent_id" ? PARENT_ID
+					: key == "asset_id" ? ASSET_ID
+					: key == "name" ? NAME
+					: key == "type" ? TYPE
+					: key == "inv_type" ? INV_TYPE
+					: key == "flags" ? FLAGS
+					: NONE;
+				break;
+			case 5:
+				mField = key == "owner_id" ? OWNER_ID : NONE;
+				break;
+			}
+			return (NONE == mField) ? SKIP : CONTINUE;
+		}
+
+		EAction uuid(const LLUUID& value) override
+		{
+			ItemFields& item = mItems.back();
+			switch (mField)
+			{
+			case ITEM_ID:
+				item.mItemID = value;
+				break;
+			case PARENT_ID:
+				item.mParentID = value;
+				break;
+			case ASSET_ID:
+				item.mAssetID = value;
+				break;
+			case OWNER_ID:
+				item.mOwnerID = value;
+				break;
+			default:
+				break;
+			}
+			return CONTINUE;
+		}
+
+		EAction integer(S32 value) override
+		{
+			ItemFields& item = mItems.back();
+			switch (mField)
+			{
+			case TYPE:
+				item.mType = value;
+				break;
+			case INV_TYPE:
+				item.mInvType = value;
+				break;
+			case FLAGS:
+				item.mFlags = value;
+				break;
+			default:
+				break;
+			}
+			return CONTINUE;
+		}
+
+		EAction string(std::string_view value) override
+		{
+			if (NAME == mField)
+			{
+				mItems.back().mName.assign(value.data(), value.size());
+			}
+			return CONTINUE;
+		}
+
+	private:
+		enum EField { NONE, ITEM_ID, PARENT_ID, ASSET_ID, NAME, TYPE, INV_TYPE, FLAGS, OWNER_ID };
+
+		std::vector<ItemFields>&	mItems;
+		S32							mDepth;
+		EField						mField;
+	};
+
+	bool operator==(const ItemFields& lhs, const ItemFields& rhs)
+	{
+		return lhs.mItemID == rhs.mItemID && lhs.mParentID == rhs.mParentID && lhs.mAssetID == rhs.mAssetID
+			&& lhs.mName == rhs.mName && lhs.mType == rhs.mType && lhs.mInvType == rhs.mInvType
+			&& lhs.mFlags == rhs.mFlags && lhs.mOwnerID == rhs.mOwnerID;
+	}
+
+	// Records the callbacks as text
+	class TraceHandler : public LLSDSAXHandler
+	{
+	public:
+		EAction integer(S32 value) override
+		{
+			mTrace += stringize("i", value, " ");
+			return CONTINUE;
+		}
+
+		EAction string(std::string_view value) override
+		{
+			mTrace += "s" + std::string(value) + " ";
+			return CONTINUE;
+		}
+
+		EAction beginMap(S32 size) override
+		{
+			mTrace += stringize("{", size, " ");
+			if (mSkipNestedMaps && mMapDepth)
+			{
+				return SKIP;
+			}
+			++mMapDepth;
+			return CONTINUE;
+		}
+
+		EAction key(std::string_view key) override
+		{
+			mTrace += "k" + std::string(key) + " ";
+			if (key == mSkipKey)
+			{
+				return SKIP;
+			}
+			return (key == mStopKey) ? STOP : CONTINUE;
+		}
+
+		EAction endMap() override
+		{
+			mTrace += "} ";
+			--mMapDepth;
+			return CONTINUE;
+		}
+
+		EAction beginArray(S32 size) override
+		{
+			mTrace += stringize("[", size, " ");
+			return CONTINUE;
+		}
+
+		EAction endArray() override
+		{
+			mTrace += "] ";
+			return CONTINUE;
+		}
+
+		std::string mTrace;
+		std::string mSkipKey;
+		std::string mStopKey;
+		bool mSkipNestedMaps = false;
+		S32 mMapDepth = 0;
+	};
+}
+
+namespace tut
+{
+	struct llsdsaxparser_data
+	{
+		llsdsaxparser_data() :
+			mRandom(20240917)
+		{
+		}
+
+		// Parses doc both ways and checks they agree
+		void checkSame(const std::string& what, const std::string& doc, bool binary, S32 max_depth = -1)
+		{
+			LLSD tree;
+			LLSD sax;
+			S32 tree_count = tree_parse(doc, binary, tree, max_depth);
+			S32 sax_count = sax_parse(mParser, doc, binary, sax, max_depth);
+			ensure_equals(what + " count", sax_count, tree_count);
+			if (sax_count > 0)
+			{
+				ensure(stringize(what, ": ", LLSDNotationStreamer(sax), " differs from ", LLSDNotationStreamer(tree)),
+					   llsd_equals(sax, tree));
+			}
+		}
+
+		std::mt19937 mRandom;
+		LLSDSAXParser mParser;
+	};
+	typedef test_group<llsdsaxparser_data> llsdsaxparser_test;
+	typedef llsdsaxparser_test::object llsdsaxparser_object;
+	tut::llsdsaxparser_test llsdsaxparser("LLSDSAXParser");
+
+	template<> template<>
+	void llsdsaxparser_object::test<1>()
+	{
+		set_test_name("binary parses as LLSDBinaryParser parses it");
+		for (S32 i = 0; i < 3000; ++i)
+		{
+			checkSame(stringize("document ", i), to_binary(random_llsd(mRandom, 4)), true);
+		}
+
+		// notation style strings and keys are allowed in binary
+		static const char NOTATION_STRINGS[] = "{\0\0\0\x02'k\\x41'\"va\\nl\"k\0\0\0\x01x[\0\0\0\x01i\0\0\0\x07]}";
+		std::string doc(NOTATION_STRINGS, sizeof(NOTATION_STRINGS) - 1);
+		checkSame("notation strings in binary", doc, true);
+		LLSD sd;
+		sax_parse(mParser, doc, true, sd);
+		ensure_equals("escaped key", sd["kA"].asString(), "va\nl");
+		ensure_equals("array", sd["x"][0].asInteger(), 7);
+
+		// depth limits
+		LLSD nested = LLSD::emptyArray();
+		for (S32 depth = 0; depth < 6; ++depth)
+		{
+			LLSD outer = LLSD::emptyMap();
+			outer["a"] = nested;
+			nested = outer;
+		}
+		for (S32 max_depth = -1; max_depth < 9; ++max_depth)
+		{
+			checkSame(stringize("max depth ", max_depth), to_binary(nested), true, max_depth);
+		}
+	}
+
+	template<> template<>
+	void llsdsaxparser_object::test<2>()
+	{
+		set_test_name("notation parses as LLSDNotationParser parses it");
+		for (S32 i = 0; i < 3000; ++i)
+		{
+			LLSD sd = random_llsd(mRandom, 4);
+			std::ostringstream notation;
+			switch (i % 3)
+			{
+			case 0:
+				LLSDSerialize::toNotation(sd, notation);
+				break;
+			case 1:
+				LLSDSerialize::toPrettyNotation(sd, notation);
+				break;
+			default:
+				LLSDSerialize::toPrettyBinaryNotation(sd, notation);
+				break;
+			}
+			checkSame(stringize("document ", i), notation.str(), false);
+		}
+
+		// What the formatters don't write, but people do
+		const char* docs[] =
+		{
+			"{'a':TRUE,'b':f,'c':False,'d':t,\"e\":1,'f':0}",
+			"[i-12, i+5, i 7, r1.5e3, r-.25, r 2, r-0]",
+			"{s(3)\"abc\":s(5)'a\"b\\c'}",
+			"['\\x41\\x7a\\a\\b\\f\\n\\r\\t\\v\\q', \"it's\"]",
+			"[b64\"SGVsbG8gd29ybGQ=\", b16\"00FFab12\", b(3)\"x\"y\"]",
+			"[l\"http://example.com/a b\", d\"2024-02-29T12:34:56.78Z\", d'2001-01-01T00:00:00Z']",
+			"[u6cb4a2b5-0b2f-4e15-bb43-1a5c8e0c41d8, u 6cb4a2b5-0b2f-4e15-bb43-1a5c8e0c41d8, !]",
+			"  \n{ 'nested' : { 'deeper' : [ [ ], { } , [ 1 , 0 ] ] } , 'x' : i1 }",
+			"{'dup':i1,'dup':i2,'map':{'a':i1},'map':{'b':i2}}",
+			"{ junk 'a' : i1 , , more junk 'b' i2 }",
+			"[s(0)\"\", '', \"\", s(0x2)\"ab\"]",
+		};
+		for (const char* doc : docs)
+		{
+			checkSame(doc, doc, false);
+		}
+	}
+
+	template<> template<>
+	void llsdsaxparser_object::test<3>()
+	{
+		set_test_name("truncated and malformed documents");
+		for (S32 i = 0; i < 200; ++i)
+		{
+			LLSD sd = LLSD::emptyMap();
+			sd["value"] = random_llsd(mRandom, 3);
+			std::string binary = to_binary(sd);
+			std::ostringstream notation_stream;
+			LLSDSerialize::toNotation(sd, notation_stream);
+			std::string notation = notation_stream.str();
+
+			// a container isn't closed until its last byte
+			for (size_t length = 1; length < binary.size(); ++length)
+			{
+				LLSD result;
+				ensure_equals(stringize("binary cut to ", length),
+							  sax_parse(mParser, binary.substr(0, length), true, result),
+							  (S32)LLSDSAXParser::PARSE_FAILURE);
+			}
+			for (size_t length = 1; length < notation.size(); ++length)
+			{
+				LLSD result;
+				ensure_equals(stringize("notation cut to ", length),
+							  sax_parse(mParser, notation.substr(0, length), false, result),
+							  (S32)LLSDSAXParser::PARSE_FAILURE);
+			}
+
+			// and arbitrary damage, which just mustn't crash
+			for (S32 j = 0; j < 20; ++j)
+			{
+				std::string damaged = binary;
+				damaged[mRandom() % damaged.size()] = char(mRandom());
+				LLSD result;
+				sax_parse(mParser, damaged, true, result);
+				damaged = notation;
+				damaged[mRandom() % damaged.size()] = char(mRandom());
+				sax_parse(mParser, damaged, false, result);
+			}
+		}
+
+		// counts that run past the end
+		std::string doc("[\x7f\xff\xff\xffi\0\0\0\x01]", 11);
+		LLSD result;
+		ensure_equals("array size", sax_parse(mParser, doc, true, result), (S32)LLSDSAXParser::PARSE_FAILURE);
+		doc.assign("s\x7f\xff\xff\xff" "abc", 8);
+		ensure_equals("string size", sax_parse(mParser, doc, true, result), (S32)LLSDSAXParser::PARSE_FAILURE);
+		ensure_equals("raw size", sax_parse(mParser, "s(99)\"abc\"", false, result),
+					  (S32)LLSDSAXParser::PARSE_FAILURE);
+		ensure_equals("empty", sax_parse(mParser, "", true, result), 0);
+		ensure_equals("whitespace", sax_parse(mParser, " \n", false, result), 0);
+	}
+
+	template<> template<>
+	void llsdsaxparser_object::test<4>()
+	{
+		set_test_name("skipping and stopping");
+		LLSD sd;
+		sd["a"] = 1;
+		sd["b"]["c"] = "skipped";
+		sd["b"]["d"][0] = 2;
+		sd["e"][0] = 3;
+		sd["e"][1] = "x";
+		sd["f"] = 4;
+		std::string binary = to_binary(sd);
+		std::ostringstream notation_stream;
+		LLSDSerialize::toNotation(sd, notation_stream);
+		std::string notation = notation_stream.str();
+
+		for (S32 binary_format = 0; binary_format < 2; ++binary_format)
+		{
+			const std::string& doc = binary_format ? binary : notation;
+			S32 size = binary_format ? 4 : -1;
+			auto parse = [&](TraceHandler& handler)
+			{
+				return binary_format ? mParser.parseBinary(doc.data(), doc.size(), handler)
+									 : mParser.parseNotation(doc.data(), doc.size(), handler);
+			};
+
+			TraceHandler all;
+			ensure_equals("all count", parse(all), 10);
+			ensure_equals("all", all.mTrace,
+						  stringize("{", size, " ka i1 kb {", binary_format ? 2 : -1, " kc sskipped kd [",
+									binary_format ? 1 : -1, " i2 ] } ke [", binary_format ? 2 : -1,
+									" i3 sx ] kf i4 } "));
+			ensure_equals("bytes parsed", mParser.getBytesParsed(), (llssize)doc.size());
+
+			TraceHandler skip_key;
+			skip_key.mSkipKey = "b";
+			ensure_equals("skip key count", parse(skip_key), 10);
+			ensure_equals("skip key", skip_key.mTrace,
+						  stringize("{", size, " ka i1 kb ke [", binary_format ? 2 : -1, " i3 sx ] kf i4 } "));
+
+			TraceHandler skip_map;
+			skip_map.mSkipNestedMaps = true;
+			parse(skip_map);
+			ensure_equals("skip map", skip_map.mTrace,
+						  stringize("{", size, " ka i1 kb {", binary_format ? 2 : -1, " ke [",
+									binary_format ? 2 : -1, " i3 sx ] kf i4 } "));
+
+			TraceHandler stop;
+			stop.mStopKey = "e";
+			ensure_equals("stop count", parse(stop), 6);
+			ensure_equals("stop", stop.mTrace,
+						  stringize("{", size, " ka i1 kb {", binary_format ? 2 : -1, " kc sskipped kd [",
+									binary_format ? 1 : -1, " i2 ] } ke "));
+		}
+	}
+
+	template<> template<>
+	void llsdsaxparser_object::test<5>()
+	{
+		set_test_name("decoding into structs");
+		for (S32 i = 0; i < 200; ++i)
+		{
+			LLSD header = mesh_header(mRandom);
+			if (i % 10 == 0)
+			{
+				header["404"] = true;
+			}
+			if (i % 7 == 0)
+			{
+				header["high_lod"]["size"] = 12.75;
+			}
+			std::string doc = to_binary(header);
+
+			MeshHeaderFields expected;
+			mesh_header_from_llsd(header, expected);
+			MeshHeaderFields fields;
+			MeshHeaderHandler handler(fields);
+			ensure("mesh header parse", mParser.parseBinary(doc.data(), doc.size(), handler) > 0);
+			ensure(stringize("mesh header ", i), fields == expected);
+		}
+
+		LLSD category = ais_category(mRandom);
+		std::string doc = to_binary(category);
+		std::vector<ItemFields> expected;
+		items_from_llsd(category, expected);
+		std::vector<ItemFields> items;
+		ItemsHandler handler(items);
+		ensure("category parse", mParser.parseBinary(doc.data(), doc.size(), handler) > 0);
+		ensure_equals("items", items.size(), expected.size());
+		ensure("item fields", items == expected);
+	}
+
+	template<> template<>
+	void llsdsaxparser_object::test<6>()
+	{
+		set_test_name("documents/s and allocations against LLSDSerialize");
+		// Times the parsers the earlier tests compare, on the same documents
+		const char* mesh_file = getenv("LL_MESH_ASSET_FILE");
+		if (!mesh_file && !benchmarking())
+		{
+			skip("set LL_BENCHMARKS or LL_MESH_ASSET_FILE to time the parsers");
+		}
+		const S32 DOCS = 64;
+		std::vector<std::string> meshes;
+		std::vector<std::string> categories;
+		std::vector<std::string> category_notations;
+		for (S32 i = 0; i < DOCS; ++i)
+		{
+			if (mesh_file)
+			{
+				// the parsers stop after the header
+				std::ifstream file(mesh_file, std::ios::binary);
+				ensure(std::string("read ") + mesh_file, file.good());
+				meshes.push_back(std::string(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>()));
+			}
+			else
+			{
+				meshes.push_back(to_binary(mesh_header(mRandom)));
+			}
+			LLSD category = ais_category(mRandom);
+			categories.push_back(to_binary(category));
+			std::ostringstream notation;
+			LLSDSerialize::toNotation(category, notation);
+			category_notations.push_back(notation.str());
+		}
+
+		struct Result
+		{
+			F64 mSeconds;
+			size_t mAllocations;
+			size_t mBytes;
+		};
+		auto run = [&](const std::vector<std::string>& docs, S32 passes, std::function<void(const std::string&)> parse)
+		{
+			Result result = { 0.0, 0, 0 };
+			size_t allocs_before = CountAllocs::sCount;
+			LLTimer timer;
+			for (S32 pass = 0; pass < passes; ++pass)
+			{
+				for (const std::string& doc : docs)
+				{
+					parse(doc);
+					result.mBytes += doc.size();
+				}
+			}
+			result.mSeconds = timer.getElapsedTimeF64();
+			result.mAllocations = CountAllocs::sCount - allocs_before;
+			return result;
+		};
+		auto report = [&](const std::string& what, S32 docs, const Result& result)
+		{
+			LL_INFOS("Benchmark") << what << ": " << S32(docs / result.mSeconds) << " documents/s, "
+								  << S32(result.mBytes / result.mSeconds / (1024 * 1024)) << " MB/s, "
+								  << F64(result.mAllocations) / docs << " allocations/document" << LL_ENDL;
+		};
+
+		const S32 MESH_PASSES = 500;
+		const S32 CATEGORY_PASSES = 20;
+		MeshHeaderFields fields;
+		std::vector<ItemFields> items;
+		S32 mesh_docs = DOCS * MESH_PASSES;
+		S32 category_docs = DOCS * CATEGORY_PASSES;
+
+		report("mesh header, fromBinary() and LLMeshHeader::fromLLSD()", mesh_docs,
+			   run(meshes, MESH_PASSES, [&](const std::string& doc)
+				   {
+					   LLSD header;
+					   tree_parse(doc, true, header);
+					   mesh_header_from_llsd(header, fields);
+				   }));
+		report("mesh header, LLSDSAXParser to LLSD", mesh_docs,
+			   run(meshes, MESH_PASSES, [&](const std::string& doc)
+				   {
+					   LLSD header;
+					   sax_parse(mParser, doc, true, header);
+					   mesh_header_from_llsd(header, fields);
+				   }));
+		report("mesh header, LLSDSAXParser to the struct", mesh_docs,
+			   run(meshes, MESH_PASSES, [&](const std::string& doc)
+				   {
+					   MeshHeaderHandler handler(fields);
+					   mParser.parseBinary(doc.data(), doc.size(), handler);
+				   }));
+
+		report("AIS category, fromBinary() and extracting the items", category_docs,
+			   run(categories, CATEGORY_PASSES, [&](const std::string& doc)
+				   {
+					   LLSD category;
+					   tree_parse(doc, true, category);
+					   items_from_llsd(category, items);
+				   }));
+		report("AIS category, LLSDSAXParser to LLSD", category_docs,
+			   run(categories, CATEGORY_PASSES, [&](const std::string& doc)
+				   {
+					   LLSD category;
+					   sax_parse(mParser, doc, true, category);
+					   items_from_llsd(category, items);
+				   }));
+		report("AIS category, LLSDSAXParser to the items", category_docs,
+			   run(categories, CATEGORY_PASSES, [&](const std::string& doc)
+				   {
+					   ItemsHandler handler(items);
+					   mParser.parseBinary(doc.data(), doc.size(), handler);
+				   }));
+
+		report("AIS category notation, LLSDNotationParser and extracting the items", category_docs,
+			   run(category_notations, CATEGORY_PASSES, [&](const std::string& doc)
+				   {
+					   LLSD category;
+					   tree_parse(doc, false, category);
+					   items_from_llsd(category, items);
+				   }));
+		report("AIS category notation, LLSDSAXParser to the items", category_docs,
+			   run(category_notations, CATEGORY_PASSES, [&](const std::string& doc)
+				   {
+					   ItemsHandler handler(items);
+					   mParser.parseNotation(doc.data(), doc.size(), handler);
+				   }));
+	}
+}
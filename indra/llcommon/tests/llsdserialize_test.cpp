@@ -46,11 +46,14 @@ typedef U32 uint32_t;
 
 #include "boost/range.hpp"
 
+#include "apr_base64.h"
+
 #include "llsd.h"
 #include "llsdserialize.h"
 #include "llsdutil.h"
 #include "llformat.h"
 #include "llmemorystream.h"
+#include "lltimer.h"
 
 #include "../test/hexdump.h"
 #include "../test/lltut.h"
@@ -58,6 +61,10 @@ typedef U32 uint32_t;
 #include "stringize.h"
 #include "StringVec.h"
 #include <functional>
+#include <iomanip>
+#include <limits>
+#include <locale>
+#include <random>
 
 typedef std::function<void(const LLSD& data, std::ostream& str)> FormatterFunction;
 typedef std::function<bool(std::istream& istr, LLSD& data, llssize max_bytes)> ParserFunction;
@@ -602,6 +609,46 @@ namespace tut
 	};
 |*==========================================================================*/
 
+	template<> template<>
+	void TestLLSDSerializeObject::test<11>()
+	{
+		set_test_name("zip_llsd -> unzip_llsd from segments");
+		LLSD sd;
+		sd["binary"] = LLSD::Binary(5000, 0xaa);
+		sd["array"].append(1.5);
+		sd["array"].append("text");
+		std::string zipped = zip_llsd(sd);
+		ensure("compressed", !zipped.empty());
+
+		// Cut the block into uneven pieces, including an empty one
+		const U8* data = (const U8*)zipped.data();
+		size_t half = zipped.size() / 2;
+		LLUZipHelper::Segment segments[] = {
+			{ data, 1 },
+			{ data + 1, 0 },
+			{ data + 1, half - 1 },
+			{ data + half, zipped.size() - half }
+		};
+
+		LLSD unzipped;
+		ensure_equals("unzip_llsd result",
+					  LLUZipHelper::unzip_llsd(unzipped, segments, LL_ARRAY_SIZE(segments)),
+					  LLUZipHelper::ZR_OK);
+		ensure_equals("round trip", unzipped, sd);
+
+		// A reused output buffer shrinks to the inflated size
+		std::vector<U8> out(1024 * 1024);
+		ensure_equals("unzip result",
+					  LLUZipHelper::unzip(out, segments, LL_ARRAY_SIZE(segments)),
+					  LLUZipHelper::ZR_OK);
+		ensure("inflated size", out.size() > 5000 && out.size() < 1024 * 1024);
+
+		// Missing the tail of the stream
+		ensure_equals("truncated",
+					  LLUZipHelper::unzip(out, segments, LL_ARRAY_SIZE(segments) - 1),
+					  LLUZipHelper::ZR_BUFFER_ERROR);
+	}
+
 	/**
 	 * @class TestLLSDParsing
 	 * @brief Base class for of a parse tester.
@@ -2194,4 +2241,733 @@ namespace tut
                         { return LLSDSerialize::fromBinary(data, istr, max_bytes) > 0; });
     }
 |*==========================================================================*/
+
+	/**
+	 * The notation and XML formatters as they were before LLSDFormatBuffer,
+	 * writing each token to the stream. The buffer based ones must match
+	 * them byte for byte.
+	 */
+	void stream_notation_escape(const std::string& value, std::ostream& str)
+	{
+		for (char ch : value)
+		{
+			U8 c = (U8)ch;
+			switch (c)
+			{
+			case '\a': str << "\\a"; break;
+			case '\b': str << "\\b"; break;
+			case '\t': str << "\\t"; break;
+			case '\n': str << "\\n"; break;
+			case '\v': str << "\\v"; break;
+			case '\f': str << "\\f"; break;
+			case '\r': str << "\\r"; break;
+			case '\'': str << "\\'"; break;
+			case '\\': str << "\\\\"; break;
+			default:
+				if (c < 0x20 || c >= 0x7f)
+				{
+					str << llformat("\\x%02x", c);
+				}
+				else
+				{
+					str << ch;
+				}
+				break;
+			}
+		}
+	}
+
+	std::string stream_xml_escape(const std::string& in)
+	{
+		std::ostringstream out;
+		for (char c : in)
+		{
+			switch (c)
+			{
+			case '<': out << "&lt;"; break;
+			case '>': out << "&gt;"; break;
+			case '&': out << "&amp;"; break;
+			case '\'': out << "&apos;"; break;
+			case '"': out << "&quot;"; break;
+			default: out << c; break;
+			}
+		}
+		return out.str();
+	}
+
+	class StreamNotationFormatter : public LLSDFormatter
+	{
+	public:
+		StreamNotationFormatter(bool boolAlpha=false, const std::string& realFormat="") :
+			LLSDFormatter(boolAlpha, realFormat)
+		{}
+
+	protected:
+		S32 format_impl(const LLSD& data, std::ostream& ostr, EFormatterOptions options,
+						U32 level) const override
+		{
+			S32 format_count = 1;
+			std::string pre;
+			std::string post;
+			if (options & LLSDFormatter::OPTIONS_PRETTY)
+			{
+				for (U32 i = 0; i < level; i++)
+				{
+					pre += "    ";
+				}
+				post = "\n";
+			}
+
+			switch(data.type())
+			{
+			case LLSD::TypeMap:
+			{
+				if (0 != level) ostr << post << pre;
+				ostr << "{";
+				std::string inner_pre;
+				if (options & LLSDFormatter::OPTIONS_PRETTY)
+				{
+					inner_pre = pre + "    ";
+				}
+				bool need_comma = false;
+				for (LLSD::map_const_iterator iter = data.beginMap(); iter != data.endMap(); ++iter)
+				{
+					if(need_comma) ostr << ",";
+					need_comma = true;
+					ostr << post << inner_pre << '\'';
+					stream_notation_escape((*iter).first, ostr);
+					ostr << "':";
+					format_count += format_impl((*iter).second, ostr, options, level + 2);
+				}
+				ostr << post << pre << "}";
+				break;
+			}
+			case LLSD::TypeArray:
+			{
+				ostr << post << pre << "[";
+				bool need_comma = false;
+				for (LLSD::array_const_iterator iter = data.beginArray(); iter != data.endArray(); ++iter)
+				{
+					if(need_comma) ostr << ",";
+					need_comma = true;
+					format_count += format_impl(*iter, ostr, options, level + 1);
+				}
+				ostr << "]";
+				break;
+			}
+			case LLSD::TypeUndefined:
+				ostr << "!";
+				break;
+			case LLSD::TypeBoolean:
+				if(mBoolAlpha || (ostr.flags() & std::ios::boolalpha))
+				{
+					ostr << (data.asBoolean() ? "true" : "false");
+				}
+				else
+				{
+					ostr << (data.asBoolean() ? 1 : 0);
+				}
+				break;
+			case LLSD::TypeInteger:
+				ostr << "i" << data.asInteger();
+				break;
+			case LLSD::TypeReal:
+				ostr << "r";
+				if(mRealFormat.empty())
+				{
+					ostr << data.asReal();
+				}
+				else
+				{
+					formatReal(data.asReal(), ostr);
+				}
+				break;
+			case LLSD::TypeUUID:
+				ostr << "u" << data.asUUID();
+				break;
+			case LLSD::TypeString:
+				ostr << '\'';
+				stream_notation_escape(data.asStringRef(), ostr);
+				ostr << '\'';
+				break;
+			case LLSD::TypeDate:
+				ostr << "d\"" << data.asDate() << "\"";
+				break;
+			case LLSD::TypeURI:
+				ostr << "l\"";
+				stream_notation_escape(data.asString(), ostr);
+				ostr << "\"";
+				break;
+			case LLSD::TypeBinary:
+			{
+				const std::vector<U8>& buffer = data.asBinary();
+				if (options & LLSDFormatter::OPTIONS_PRETTY_BINARY)
+				{
+					ostr << "b16\"";
+					if (! buffer.empty())
+					{
+						std::ios_base::fmtflags old_flags = ostr.flags();
+						ostr.setf( std::ios::hex, std::ios::basefield );
+						ostr << std::uppercase;
+						auto oldfill(ostr.fill('0'));
+						auto oldwidth(ostr.width());
+						for (size_t i = 0; i < buffer.size(); i++)
+						{
+							ostr << std::setw(2) << (int) buffer[i];
+						}
+						ostr.width(oldwidth);
+						ostr.fill(oldfill);
+						ostr.flags(old_flags);
+					}
+				}
+				else
+				{
+					ostr << "b(" << buffer.size() << ")\"";
+					if (! buffer.empty())
+					{
+						ostr.write((const char*)&buffer[0], buffer.size());
+					}
+				}
+				ostr << "\"";
+				break;
+			}
+			default:
+				ostr << "!";
+				break;
+			}
+			return format_count;
+		}
+	};
+
+	class StreamXMLFormatter : public LLSDFormatter
+	{
+	public:
+		StreamXMLFormatter(bool boolAlpha=false, const std::string& realFormat="") :
+			LLSDFormatter(boolAlpha, realFormat)
+		{}
+
+		S32 format(const LLSD& data, std::ostream& ostr, EFormatterOptions options) const override
+		{
+			std::streamsize old_precision = ostr.precision(25);
+			std::string post;
+			if (options & LLSDFormatter::OPTIONS_PRETTY)
+			{
+				post = "\n";
+			}
+			ostr << "<llsd>" << post;
+			S32 rv = format_impl(data, ostr, options, 1);
+			ostr << "</llsd>\n";
+			ostr.precision(old_precision);
+			return rv;
+		}
+		using LLSDFormatter::format;
+
+	protected:
+		S32 format_impl(const LLSD& data, std::ostream& ostr, EFormatterOptions options,
+						U32 level) const override
+		{
+			S32 format_count = 1;
+			std::string pre;
+			std::string post;
+			if (options & LLSDFormatter::OPTIONS_PRETTY)
+			{
+				for (U32 i = 0; i < level; i++)
+				{
+					pre += "    ";
+				}
+				post = "\n";
+			}
+
+			switch(data.type())
+			{
+			case LLSD::TypeMap:
+				if(0 == data.size())
+				{
+					ostr << pre << "<map />" << post;
+				}
+				else
+				{
+					ostr << pre << "<map>" << post;
+					for (LLSD::map_const_iterator iter = data.beginMap(); iter != data.endMap(); ++iter)
+					{
+						ostr << pre << "<key>" << stream_xml_escape((*iter).first) << "</key>" << post;
+						format_count += format_impl((*iter).second, ostr, options, level + 1);
+					}
+					ostr << pre <<  "</map>" << post;
+				}
+				break;
+			case LLSD::TypeArray:
+				if(0 == data.size())
+				{
+					ostr << pre << "<array />" << post;
+				}
+				else
+				{
+					ostr << pre << "<array>" << post;
+					for (LLSD::array_const_iterator iter = data.beginArray(); iter != data.endArray(); ++iter)
+					{
+						format_count += format_impl(*iter, ostr, options, level + 1);
+					}
+					ostr << pre << "</array>" << post;
+				}
+				break;
+			case LLSD::TypeUndefined:
+				ostr << pre << "<undef />" << post;
+				break;
+			case LLSD::TypeBoolean:
+				ostr << pre << "<boolean>";
+				if(mBoolAlpha || (ostr.flags() & std::ios::boolalpha))
+				{
+					ostr << (data.asBoolean() ? "true" : "false");
+				}
+				else
+				{
+					ostr << (data.asBoolean() ? 1 : 0);
+				}
+				ostr << "</boolean>" << post;
+				break;
+			case LLSD::TypeInteger:
+				ostr << pre << "<integer>" << data.asInteger() << "</integer>" << post;
+				break;
+			case LLSD::TypeReal:
+				ostr << pre << "<real>";
+				if(mRealFormat.empty())
+				{
+					ostr << data.asReal();
+				}
+				else
+				{
+					formatReal(data.asReal(), ostr);
+				}
+				ostr << "</real>" << post;
+				break;
+			case LLSD::TypeUUID:
+				if(data.asUUID().isNull()) ostr << pre << "<uuid />" << post;
+				else ostr << pre << "<uuid>" << data.asUUID() << "</uuid>" << post;
+				break;
+			case LLSD::TypeString:
+				if(data.asStringRef().empty()) ostr << pre << "<string />" << post;
+				else ostr << pre << "<string>" << stream_xml_escape(data.asStringRef()) <<"</string>" << post;
+				break;
+			case LLSD::TypeDate:
+				ostr << pre << "<date>" << data.asDate() << "</date>" << post;
+				break;
+			case LLSD::TypeURI:
+				ostr << pre << "<uri>" << stream_xml_escape(data.asString()) << "</uri>" << post;
+				break;
+			case LLSD::TypeBinary:
+			{
+				const LLSD::Binary& buffer = data.asBinary();
+				if(buffer.empty())
+				{
+					ostr << pre << "<binary />" << post;
+				}
+				else
+				{
+					ostr << pre << "<binary encoding=\"base64\">";
+					int b64_buffer_length = apr_base64_encode_len(narrow<size_t>(buffer.size()));
+					std::vector<char> b64_buffer(b64_buffer_length);
+					b64_buffer_length = apr_base64_encode_binary(&b64_buffer[0], &buffer[0],
+																 narrow<size_t>(buffer.size()));
+					ostr.write(&b64_buffer[0], b64_buffer_length - 1);
+					ostr << "</binary>" << post;
+				}
+				break;
+			}
+			default:
+				ostr << pre << "<undef />" << post;
+				break;
+			}
+			return format_count;
+		}
+	};
+
+	// Characters the escaping treats specially are common in these
+	std::string random_format_string(std::mt19937& random)
+	{
+		static const char SPECIAL[] = "<>&'\"\\\a\n\t\x01\x1f\x7f\x80\xc3\xa9\xff";
+		std::string str;
+		// around the 16 byte chunks the escaping scans
+		size_t length = random() % 4 ? random() % 40 : random() % 200;
+		for (size_t i = 0; i < length; ++i)
+		{
+			U32 pick = random() % 16;
+			if (0 == pick)
+			{
+				str += SPECIAL[random() % (sizeof(SPECIAL) - 1)];
+			}
+			else if (1 == pick)
+			{
+				str += char(random() % 256);
+			}
+			else
+			{
+				str += char(' ' + random() % 95);
+			}
+		}
+		return str;
+	}
+
+	LLSD random_format_value(std::mt19937& random, S32 depth)
+	{
+		static const F64 REALS[] = { 0.0, -0.0, 0.1, 1.0 / 3.0, -2.5, 1e300, -1e-300, 123456789.125,
+									 4.9e-324, std::numeric_limits<F64>::infinity(),
+									 -std::numeric_limits<F64>::infinity() };
+		U32 type = random() % (depth < 4 ? 14 : 11);
+		switch (type)
+		{
+		case 0:
+			return LLSD();
+		case 1:
+			return LLSD::Boolean(random() % 2);
+		case 2:
+			return LLSD::Integer(random());
+		case 3:
+			return LLSD::Integer(random() % 200) - 100;
+		case 4:
+			return REALS[random() % LL_ARRAY_SIZE(REALS)];
+		case 5:
+			return F64(S32(random())) / F64(random() + 1);
+		case 6:
+		{
+			if (random() % 4 == 0)
+			{
+				return LLUUID::null;
+			}
+			LLUUID id;
+			for (S32 i = 0; i < UUID_BYTES; ++i)
+			{
+				id.mData[i] = U8(random());
+			}
+			return id;
+		}
+		case 7:
+		case 8:
+			return random_format_string(random);
+		case 9:
+			return LLDate(F64(random() % 2000000000) + (random() % 2 ? 0.0 : 0.25));
+		case 10:
+		{
+			if (random() % 3 == 0)
+			{
+				return LLURI(random_format_string(random));
+			}
+			LLSD::Binary binary(random() % 40);
+			for (U8& byte : binary)
+			{
+				byte = U8(random());
+			}
+			return binary;
+		}
+		case 11:
+		case 12:
+		{
+			LLSD map = LLSD::emptyMap();
+			for (U32 count = random() % 6; count; --count)
+			{
+				map[random_format_string(random)] = random_format_value(random, depth + 1);
+			}
+			return map;
+		}
+		default:
+		{
+			LLSD array = LLSD::emptyArray();
+			for (U32 count = random() % 6; count; --count)
+			{
+				array.append(random_format_value(random, depth + 1));
+			}
+			return array;
+		}
+		}
+	}
+
+	// An inventory cache: each item as LLInventoryItem::asLLSD() has it
+	LLSD make_format_inventory(std::mt19937& random, S32 count)
+	{
+		LLSD items = LLSD::emptyArray();
+		LLUUID owner_id = LLUUID::generateNewID();
+		for (S32 i = 0; i < count; ++i)
+		{
+			LLSD item;
+			item["item_id"] = LLUUID::generateNewID();
+			item["parent_id"] = LLUUID::generateNewID();
+			item["asset_id"] = LLUUID::generateNewID();
+			item["name"] = stringize("Item ", i, " of ", count, (random() % 8) ? "" : " <\"copy\">");
+			item["desc"] = (random() % 2) ? std::string("(No Description)") : stringize("Description ", random());
+			item["type"] = S32(random() % 20);
+			item["inv_type"] = S32(random() % 20);
+			item["flags"] = S32(random() % 0x10000);
+			item["created_at"] = S32(1600000000 + random() % 100000000);
+			LLSD& permissions = item["permissions"];
+			permissions["creator_id"] = LLUUID::generateNewID();
+			permissions["owner_id"] = owner_id;
+			permissions["last_owner_id"] = owner_id;
+			permissions["group_id"] = LLUUID::null;
+			permissions["is_owner_group"] = false;
+			permissions["base_mask"] = S32(0x7fffffff);
+			permissions["owner_mask"] = S32(0x7fffffff);
+			permissions["group_mask"] = 0;
+			permissions["everyone_mask"] = 0;
+			permissions["next_owner_mask"] = S32(0x82000);
+			item["sale_info"]["sale_price"] = 10;
+			item["sale_info"]["sale_type"] = 0;
+			items.append(item);
+		}
+		return items;
+	}
+
+	// Groups digits in threes and uses a decimal comma
+	struct CommaNumpunct : public std::numpunct<char>
+	{
+		char do_decimal_point() const override { return ','; }
+		char do_thousands_sep() const override { return '.'; }
+		std::string do_grouping() const override { return "\3"; }
+	};
+
+	struct TestFormatBuffer
+	{
+		TestFormatBuffer() :
+			mRandom(20241014)
+		{
+		}
+
+		// The formatter's output on ostr, as set up by prepare
+		template <class FORMATTER>
+		std::string formatted(const LLSD& sd, const FORMATTER& formatter,
+							  LLSDFormatter::EFormatterOptions options,
+							  const std::function<void(std::ostream&)>& prepare)
+		{
+			std::ostringstream ostr;
+			prepare(ostr);
+			formatter.format(sd, ostr, options);
+			return ostr.str();
+		}
+
+		// Checks both formatters, each way, against the stream ones
+		void ensure_same(const std::string& desc, const LLSD& sd,
+						 bool bool_alpha, const std::string& real_format,
+						 LLSDFormatter::EFormatterOptions options,
+						 const std::function<void(std::ostream&)>& prepare = [](std::ostream&){})
+		{
+			LLPointer<StreamNotationFormatter> old_notation = new StreamNotationFormatter(bool_alpha, real_format);
+			LLPointer<LLSDNotationFormatter> notation = new LLSDNotationFormatter(bool_alpha, real_format);
+			LLPointer<StreamXMLFormatter> old_xml = new StreamXMLFormatter(bool_alpha, real_format);
+			LLPointer<LLSDXMLFormatter> xml = new LLSDXMLFormatter(bool_alpha, real_format);
+
+			std::string expected = formatted(sd, *old_notation, options, prepare);
+			ensure_equals(desc + " notation", formatted(sd, *notation, options, prepare), expected);
+			std::string expected_xml = formatted(sd, *old_xml, options, prepare);
+			ensure_equals(desc + " XML", formatted(sd, *xml, options, prepare), expected_xml);
+
+			// the free standing buffer formats as a default stream would
+			std::ostringstream plain;
+			prepare(plain);
+			if (plain.flags() == std::ostringstream().flags() && plain.precision() == 6
+				&& plain.getloc() == std::locale::classic())
+			{
+				mBuffer.clear();
+				mBuffer.write("prefix");
+				notation->format(sd, mBuffer, options);
+				ensure_equals(desc + " notation buffer", std::string(mBuffer.view()), "prefix" + expected);
+				mBuffer.clear();
+				xml->format(sd, mBuffer, options);
+				ensure_equals(desc + " XML buffer", mBuffer.str(), expected_xml);
+			}
+		}
+
+		std::mt19937 mRandom;
+		LLSDFormatBuffer mBuffer;
+	};
+	typedef test_group<TestFormatBuffer> TestFormatBufferGroup;
+	typedef TestFormatBufferGroup::object TestFormatBufferObject;
+	TestFormatBufferGroup format_buffer("LLSDFormatBuffer");
+
+	template<> template<>
+	void TestFormatBufferObject::test<1>()
+	{
+		set_test_name("escapeString() matches the stream escaping");
+		std::string every_byte;
+		for (S32 c = 0; c < 256; ++c)
+		{
+			std::string one(1, char(c));
+			ensure_equals(stringize("notation escape of ", c), LLSDNotationFormatter::escapeString(one),
+						  [&]{ std::ostringstream ostr; stream_notation_escape(one, ostr); return ostr.str(); }());
+			ensure_equals(stringize("XML escape of ", c), LLSDXMLFormatter::escapeString(one),
+						  stream_xml_escape(one));
+			every_byte += one;
+		}
+		for (S32 i = 0; i < 5000; ++i)
+		{
+			// every alignment of the special characters against the chunks
+			std::string str = (i < 256) ? every_byte.substr(i) + every_byte.substr(0, i)
+										: random_format_string(mRandom);
+			std::ostringstream ostr;
+			stream_notation_escape(str, ostr);
+			ensure_equals("notation escape", LLSDNotationFormatter::escapeString(str), ostr.str());
+			ensure_equals("XML escape", LLSDXMLFormatter::escapeString(str), stream_xml_escape(str));
+		}
+	}
+
+	template<> template<>
+	void TestFormatBufferObject::test<2>()
+	{
+		set_test_name("random LLSD formats as it did through the stream");
+		const LLSDFormatter::EFormatterOptions OPTIONS[] = {
+			LLSDFormatter::OPTIONS_NONE,
+			LLSDFormatter::OPTIONS_PRETTY,
+			LLSDFormatter::OPTIONS_PRETTY_BINARY,
+			LLSDFormatter::EFormatterOptions(LLSDFormatter::OPTIONS_PRETTY | LLSDFormatter::OPTIONS_PRETTY_BINARY)
+		};
+		for (S32 i = 0; i < 2000; ++i)
+		{
+			LLSD sd = random_format_value(mRandom, 0);
+			for (LLSDFormatter::EFormatterOptions options : OPTIONS)
+			{
+				std::string desc = stringize("value ", i, " options ", options);
+				ensure_same(desc, sd, false, "", options);
+				ensure_same(desc + " boolalpha", sd, true, "", options);
+				ensure_same(desc + " real format", sd, false, "%.2f", options);
+			}
+		}
+	}
+
+	template<> template<>
+	void TestFormatBufferObject::test<3>()
+	{
+		set_test_name("streams with unusual formatting get the same output");
+		std::function<void(std::ostream&)> PREPARES[] = {
+			[](std::ostream& ostr){ ostr << std::boolalpha; },
+			[](std::ostream& ostr){ ostr << std::hex; },
+			[](std::ostream& ostr){ ostr << std::hex << std::showbase; },
+			[](std::ostream& ostr){ ostr << std::showpos; },
+			[](std::ostream& ostr){ ostr << std::uppercase; },
+			[](std::ostream& ostr){ ostr << std::scientific; },
+			[](std::ostream& ostr){ ostr << std::fixed << std::setprecision(3); },
+			[](std::ostream& ostr){ ostr << std::showpoint; },
+			[](std::ostream& ostr){ ostr.precision(0); },
+			[](std::ostream& ostr){ ostr.precision(17); },
+			[](std::ostream& ostr){ ostr.precision(60); },
+			[](std::ostream& ostr){ ostr.imbue(std::locale(std::locale::classic(), new CommaNumpunct)); }
+		};
+		for (S32 i = 0; i < 300; ++i)
+		{
+			LLSD sd = random_format_value(mRandom, 0);
+			for (size_t p = 0; p < LL_ARRAY_SIZE(PREPARES); ++p)
+			{
+				ensure_same(stringize("value ", i, " stream setup ", p), sd, false, "",
+							LLSDFormatter::OPTIONS_PRETTY_BINARY, PREPARES[p]);
+			}
+		}
+
+		// and the stream's own state comes back as it was
+		std::ostringstream ostr;
+		ostr << std::hex << std::setprecision(4);
+		LLSD sd;
+		sd["integer"] = 1000;
+		sd["real"] = 2.5;
+		LLSDSerialize::toPrettyXML(sd, ostr);
+		ensure_equals("precision", ostr.precision(), 4);
+		ensure("hex", (ostr.flags() & std::ios::basefield) == std::ios::hex);
+	}
+
+	template<> template<>
+	void TestFormatBufferObject::test<4>()
+	{
+		set_test_name("entry points and output larger than a buffer chunk");
+		LLSD sd = make_format_inventory(mRandom, 2000);
+		LLPointer<StreamNotationFormatter> old_notation = new StreamNotationFormatter;
+		LLPointer<StreamXMLFormatter> old_xml = new StreamXMLFormatter;
+
+		std::ostringstream expected_xml;
+		old_xml->format(sd, expected_xml, LLSDFormatter::OPTIONS_PRETTY);
+		ensure("bigger than a chunk", expected_xml.str().size() > 1024 * 1024);
+		std::ostringstream xml;
+		LLSDSerialize::toPrettyXML(sd, xml);
+		ensure("toPrettyXML()", xml.str() == expected_xml.str());
+
+		std::ostringstream expected_serialized;
+		expected_serialized << "<? LLSD/XML ?>\n";
+		old_xml->format(sd, expected_serialized, LLSDFormatter::OPTIONS_NONE);
+		std::ostringstream serialized;
+		LLSDSerialize::serialize(sd, serialized, LLSDSerialize::LLSD_XML, LLSDFormatter::OPTIONS_NONE);
+		ensure("serialize() XML", serialized.str() == expected_serialized.str());
+
+		std::ostringstream expected_notation;
+		expected_notation << "[" ;
+		old_notation->format(sd, expected_notation);
+		expected_notation << "]";
+		std::ostringstream notation;
+		notation << "[" << sd << "]";
+		ensure("operator<<()", notation.str() == expected_notation.str());
+
+		// and it still parses
+		LLSD parsed;
+		std::istringstream istr(xml.str());
+		ensure("parses", LLSDSerialize::fromXML(parsed, istr) > 0);
+		ensure("round trip", llsd_equals(parsed, sd));
+	}
+
+	template<> template<>
+	void TestFormatBufferObject::test<5>()
+	{
+		set_test_name("formatting speed, old and new");
+		// Old and new formatters have to agree at any size. It takes
+		// LL_BENCHMARKS for a document big enough to time, and the log.
+		const S32 ITEMS = benchmarking() ? 20000 : 2000;
+		LLSD inventory = make_format_inventory(mRandom, ITEMS);
+		LLPointer<StreamNotationFormatter> old_notation = new StreamNotationFormatter;
+		LLPointer<LLSDNotationFormatter> notation = new LLSDNotationFormatter;
+		LLPointer<StreamXMLFormatter> old_xml = new StreamXMLFormatter;
+		LLPointer<LLSDXMLFormatter> xml = new LLSDXMLFormatter;
+
+		struct Case
+		{
+			const char* mName;
+			const LLSDFormatter* mOld;
+			const LLSDFormatter* mNew;
+			LLSDFormatter::EFormatterOptions mOptions;
+		};
+		Case cases[] = {
+			{ "pretty XML", old_xml.get(), xml.get(), LLSDFormatter::OPTIONS_PRETTY },
+			{ "notation", old_notation.get(), notation.get(), LLSDFormatter::OPTIONS_NONE }
+		};
+		const S32 PASSES = benchmarking() ? 3 : 1;
+		for (const Case& c : cases)
+		{
+			F64 old_seconds = 0.0;
+			F64 stream_seconds = 0.0;
+			F64 buffer_seconds = 0.0;
+			size_t size = 0;
+			for (S32 pass = 0; pass < PASSES; ++pass)
+			{
+				LLTimer timer;
+				std::ostringstream old_out;
+				c.mOld->format(inventory, old_out, c.mOptions);
+				old_seconds += timer.getElapsedTimeF64();
+
+				timer.reset();
+				std::ostringstream out;
+				c.mNew->format(inventory, out, c.mOptions);
+				stream_seconds += timer.getElapsedTimeF64();
+
+				mBuffer.clear();
+				timer.reset();
+				c.mNew->format(inventory, mBuffer, c.mOptions);
+				buffer_seconds += timer.getElapsedTimeF64();
+
+				size = mBuffer.size();
+				ensure(std::string(c.mName) + " same output", out.str() == old_out.str()
+					   && mBuffer.view() == old_out.str());
+			}
+			if (benchmarking())
+			{
+				F64 megabytes = F64(size) / (1024.0 * 1024.0);
+				LL_INFOS("Benchmark") << "inventory cache, " << ITEMS << " items, " << c.mName << ", "
+									  << size / 1024 << " KB: through the stream "
+									  << megabytes * PASSES / old_seconds << " MB/s, buffered to a stream "
+									  << megabytes * PASSES / stream_seconds << " MB/s, into a reused buffer "
+									  << megabytes * PASSES / buffer_seconds << " MB/s" << LL_ENDL;
+			}
+		}
+	}
 }
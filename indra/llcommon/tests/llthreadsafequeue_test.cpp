@@ -0,0 +1,214 @@
+/**
+ * @file   llthreadsafequeue_test.cpp
+ * @brief  Test for LLThreadSafeQueue and its lock-free MPSC specialization.
+ *
+ * $LicenseInfo:firstyear=2024&license=viewerlgpl$
+ * Copyright (c) 2024, Linden Research, Inc.
+ * $/LicenseInfo$
+ */
+
+// Precompiled header
+#include "linden_common.h"
+// associated header
+#include "llthreadsafequeue.h"
+// STL headers
+#include <vector>
+// std headers
+#include <atomic>
+#include <chrono>
+#include <thread>
+// external library headers
+// other Linden headers
+#include "../test/lltut.h"
+#include "../test/catch_and_store_what_in.h"
+#include "stringize.h"
+
+using namespace std::literals::chrono_literals; // ms suffix
+
+namespace
+{
+    using Clock = std::chrono::steady_clock;
+    using MPSCQueue = LLThreadSafeQueue<U64, LL::MPSCQueue<U64>>;
+    using LockedQueue = LLThreadSafeQueue<U64>;
+
+    // Each producer pushes (producer << 32 | sequence) so the consumer can
+    // check per-producer order. Producers stop early at the deadline, if
+    // any. Returns items/second.
+    template <typename QUEUE>
+    double pushPop(size_t producers, size_t per_producer, size_t capacity,
+                   std::string& error, Clock::duration budget = Clock::duration::zero())
+    {
+        QUEUE queue(capacity);
+        std::vector<U64> next(producers, 0);
+        std::atomic<size_t> pushed{ 0 };
+        auto start = Clock::now();
+        auto deadline = budget == Clock::duration::zero() ? Clock::time_point::max() : start + budget;
+        std::vector<std::thread> threads;
+        for (size_t p = 0; p < producers; ++p)
+        {
+            threads.emplace_back([&queue, &pushed, p, per_producer, deadline]()
+                                 {
+                                     U64 i = 0;
+                                     for ( ; i < per_producer; ++i)
+                                     {
+                                         if (i % 256 == 0 && Clock::now() > deadline)
+                                         {
+                                             break;
+                                         }
+                                         queue.push((U64(p) << 32) | i);
+                                     }
+                                     pushed += i;
+                                 });
+        }
+        std::thread closer([&threads, &queue]()
+                           {
+                               for (auto& thread : threads)
+                               {
+                                   thread.join();
+                               }
+                               queue.close();
+                           });
+
+        size_t popped = 0;
+        try
+        {
+            for (;;)
+            {
+                U64 item = queue.pop();
+                size_t p = size_t(item >> 32);
+                if (p >= producers || (item & 0xffffffff) != next[p])
+                {
+                    error = STRINGIZE("item " << std::hex << item << " out of order");
+                }
+                else
+                {
+                    ++next[p];
+                }
+                ++popped;
+            }
+        }
+        catch (const LLThreadSafeQueueInterrupt&)
+        {
+        }
+        std::chrono::duration<double> elapsed = Clock::now() - start;
+        closer.join();
+        if (error.empty() && popped != pushed)
+        {
+            error = STRINGIZE("popped " << popped << " of " << pushed);
+        }
+        return popped / elapsed.count();
+    }
+}
+
+/*****************************************************************************
+*   TUT
+*****************************************************************************/
+namespace tut
+{
+    struct llthreadsafequeue_data
+    {
+    };
+    typedef test_group<llthreadsafequeue_data> llthreadsafequeue_group;
+    typedef llthreadsafequeue_group::object object;
+    llthreadsafequeue_group llthreadsafequeuegrp("llthreadsafequeue");
+
+    template<> template<>
+    void object::test<1>()
+    {
+        set_test_name("MPSC queue capacity and order");
+        MPSCQueue queue(3);
+        ensure_equals("capacity", queue.capacity(), 3);
+        for (U64 i = 0; i < 3; ++i)
+        {
+            ensure(STRINGIZE("tryPush " << i), queue.tryPush(i));
+        }
+        ensure_equals("size", queue.size(), 3);
+        ensure("pushed past capacity", ! queue.tryPush(U64(3)));
+        auto start = Clock::now();
+        ensure("tryPushFor pushed past capacity", ! queue.tryPushFor(20ms, U64(3)));
+        ensure("tryPushFor didn't wait", Clock::now() - start >= 20ms);
+
+        U64 value = 0;
+        ensure("tryPop", queue.tryPop(value));
+        ensure_equals("FIFO", value, 0);
+        ensure("room after pop", queue.tryPushFor(20ms, U64(3)));
+        for (U64 i = 1; i <= 3; ++i)
+        {
+            ensure_equals("FIFO", queue.pop(), i);
+        }
+        ensure("tryPop on empty queue", ! queue.tryPop(value));
+        start = Clock::now();
+        ensure("tryPopFor on empty queue", ! queue.tryPopFor(20ms, value));
+        ensure("tryPopFor didn't wait", Clock::now() - start >= 20ms);
+    }
+
+    template<> template<>
+    void object::test<2>()
+    {
+        set_test_name("MPSC queue close");
+        MPSCQueue queue;
+        queue.push(U64(17));
+        queue.close();
+        ensure("not closed", queue.isClosed());
+        ensure("done before draining", ! queue.done());
+        ensure("pushIfOpen after close", ! queue.pushIfOpen(U64(18)));
+        ensure("tryPush after close", ! queue.tryPush(U64(18)));
+        std::string what = catch_what<LLThreadSafeQueueInterrupt>([&queue](){ queue.push(U64(18)); });
+        ensure("push after close didn't throw", ! what.empty());
+
+        ensure_equals("drain", queue.pop(), 17);
+        ensure("not done", queue.done());
+        U64 value;
+        ensure("tryPopFor after done", ! queue.tryPopFor(1s, value));
+        what = catch_what<LLThreadSafeQueueInterrupt>([&queue](){ queue.pop(); });
+        ensure("pop after done didn't throw", ! what.empty());
+
+        // close() wakes a blocked consumer
+        MPSCQueue empty;
+        std::thread closer([&empty]()
+                           {
+                               std::this_thread::sleep_for(20ms);
+                               empty.close();
+                           });
+        what = catch_what<LLThreadSafeQueueInterrupt>([&empty](){ empty.pop(); });
+        closer.join();
+        ensure("close didn't interrupt pop", ! what.empty());
+    }
+
+    template<> template<>
+    void object::test<3>()
+    {
+        set_test_name("MPSC queue under contention");
+        // A small capacity makes both producers and the consumer block.
+        for (size_t capacity : { 4, 1024 })
+        {
+            std::string error;
+            pushPop<MPSCQueue>(4, 20000, capacity, error);
+            ensure(STRINGIZE("capacity " << capacity << ": " << error), error.empty());
+        }
+    }
+
+    template<> template<>
+    void object::test<4>()
+    {
+        set_test_name("items/second, locked vs MPSC, vs producer count");
+        // test<3> covers delivery; this one only times it. Each run is
+        // capped at half a second of pushing.
+        if (! benchmarking())
+        {
+            skip("set LL_BENCHMARKS to time the queues");
+        }
+        const size_t items = 200000;
+        for (size_t producers : { 1, 2, 4, 8 })
+        {
+            std::string error;
+            double locked = pushPop<LockedQueue>(producers, items / producers, 1024 * 1024, error, 500ms);
+            ensure(error, error.empty());
+            double mpsc = pushPop<MPSCQueue>(producers, items / producers, 1024 * 1024, error, 500ms);
+            ensure(error, error.empty());
+            LL_INFOS("Benchmark") << producers << " producers: LLThreadSafeQueue "
+                                  << size_t(locked) << " items/s, MPSC "
+                                  << size_t(mpsc) << " items/s" << LL_ENDL;
+        }
+    }
+} // namespace tut
@@ -0,0 +1,456 @@
+/**
+ * @file   lluuidhashmap_test.cpp
+ * @brief  Tests for LLUUIDHashMap and LLIndexList.
+ *
+ * $LicenseInfo:firstyear=2024&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2024, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+// Precompiled header
+#include "linden_common.h"
+// associated header
+#include "lluuidhashmap.h"
+// STL headers
+#include <chrono>
+#include <map>
+#include <random>
+#include <set>
+// other Linden headers
+#include "llindexlist.h"
+#include "llpointer.h"
+#include "llrefcount.h"
+#include "../test/lltut.h"
+
+namespace
+{
+    std::vector<LLUUID> makeIDs(size_t count, U64 seed)
+    {
+        // generateNewID() is far too slow to make a million ids
+        std::mt19937_64 rng(seed);
+        std::vector<LLUUID> ids(count);
+        for (LLUUID& id : ids)
+        {
+            U64 halves[2] = { rng(), rng() };
+            memcpy(id.mData, halves, sizeof(halves));
+        }
+        return ids;
+    }
+
+    // Stands in for LLViewerFetchedTexture in the texture list benchmark
+    struct BenchTexture : public LLRefCount
+    {
+        BenchTexture(const LLUUID& id, S32 type) : mID(id), mType(type), mVirtualSize(1.f), mListIndex(-1) {}
+        LLUUID mID;
+        S32 mType;
+        F32 mVirtualSize;
+        S32 mListIndex;
+        char mRest[512]; // the rest of a texture, which spreads them over memory
+    };
+
+    // What LLViewerTextureList keyed textures by before
+    struct BenchKey
+    {
+        BenchKey(const LLUUID& id, S32 type) : mID(id), mType(type) {}
+        LLUUID mID;
+        S32 mType;
+        bool operator<(const BenchKey& other) const
+        {
+            return mID != other.mID ? mID < other.mID : mType < other.mType;
+        }
+    };
+
+    class BenchTimer
+    {
+    public:
+        BenchTimer() : mStart(std::chrono::steady_clock::now()) {}
+        F64 elapsedMS() const
+        {
+            return std::chrono::duration<F64, std::milli>(std::chrono::steady_clock::now() - mStart).count();
+        }
+    private:
+        std::chrono::steady_clock::time_point mStart;
+    };
+}
+
+namespace tut
+{
+    struct lluuidhashmap_data
+    {
+    };
+    typedef test_group<lluuidhashmap_data> lluuidhashmap_group;
+    typedef lluuidhashmap_group::object object;
+    lluuidhashmap_group lluuidhashmapgrp("LLUUIDHashMap");
+
+    template<> template<>
+    void object::test<1>()
+    {
+        set_test_name("insert, find, erase against std::map");
+        std::vector<LLUUID> ids = makeIDs(5000, 1);
+        LLUUIDHashMap<S32> map;
+        std::map<LLUUID, S32> ref;
+
+        for (size_t i = 0; i < ids.size(); ++i)
+        {
+            map[ids[i]] = (S32)i;
+            ref[ids[i]] = (S32)i;
+        }
+        ensure_equals("size", map.size(), ref.size());
+
+        // Erase every third entry, which moves probe chains around
+        for (size_t i = 0; i < ids.size(); i += 3)
+        {
+            ensure_equals("erase", map.erase(ids[i]), ref.erase(ids[i]));
+        }
+        ensure_equals("erase missing", map.erase(ids[0]), (size_t)0);
+        ensure_equals("size after erase", map.size(), ref.size());
+
+        for (size_t i = 0; i < ids.size(); ++i)
+        {
+            LLUUIDHashMap<S32>::const_iterator it = map.find(ids[i]);
+            std::map<LLUUID, S32>::const_iterator ref_it = ref.find(ids[i]);
+            ensure_equals("found", it != map.end(), ref_it != ref.end());
+            if (ref_it != ref.end())
+            {
+                ensure_equals("value", it->second, ref_it->second);
+            }
+        }
+
+        size_t visited = 0;
+        for (const auto& entry : map)
+        {
+            ensure_equals("iterated value", entry.second, ref[entry.first]);
+            ++visited;
+        }
+        ensure_equals("iterated all", visited, ref.size());
+    }
+
+    template<> template<>
+    void object::test<2>()
+    {
+        set_test_name("null key, clear, reserve");
+        LLUUIDHashMap<S32> map;
+        ensure("empty", map.empty());
+        ensure("no null", map.find(LLUUID::null) == map.end());
+
+        map[LLUUID::null] = 7;
+        ensure_equals("null counted", map.size(), (size_t)1);
+        ensure_equals("null value", map.find(LLUUID::null)->second, 7);
+        ensure("null iterated", map.begin() != map.end() && map.begin()->first.isNull());
+
+        // The null entry survives a rehash
+        std::vector<LLUUID> ids = makeIDs(100, 2);
+        for (const LLUUID& id : ids)
+        {
+            map[id] = 1;
+        }
+        ensure_equals("null after rehash", map.find(LLUUID::null)->second, 7);
+        ensure_equals("erase null", map.erase(LLUUID::null), (size_t)1);
+        ensure_equals("size", map.size(), ids.size());
+
+        map.erase(map.find(ids[0]));
+        ensure_equals("erase by iterator", map.count(ids[0]), (size_t)0);
+
+        map.clear();
+        ensure("cleared", map.empty() && map.begin() == map.end());
+        ensure("nothing left", map.find(ids[1]) == map.end());
+
+        map.reserve(1000);
+        map[ids[1]] = 3;
+        ensure_equals("after reserve", map.find(ids[1])->second, 3);
+
+        // Fill a table to its load limit: looking up a key that is there
+        // must not grow it under references already handed out
+        LLUUIDHashMap<S32> full;
+        std::vector<LLUUID> keys = makeIDs(12, 3);
+        for (const LLUUID& id : keys)
+        {
+            full[id] = 1;
+        }
+        S32* first = &full.find(keys[0])->second;
+        for (const LLUUID& id : keys)
+        {
+            ensure_equals("value", full[id], 1);
+        }
+        ensure("not moved", first == &full.find(keys[0])->second);
+        full[ids[2]] = 2;
+        ensure_equals("grown", full.size(), keys.size() + 1);
+        ensure_equals("kept after growing", full[keys[0]], 1);
+    }
+
+    template<> template<>
+    void object::test<3>()
+    {
+        set_test_name("LLIndexList");
+        LLIndexList list;
+        ensure_equals("empty pop", list.popFront(), LLIndexList::NONE);
+
+        list.pushBack(3);
+        list.pushBack(1);
+        list.pushBack(7);
+        ensure_equals("size", list.size(), 3U);
+        ensure_equals("front", list.front(), 3);
+        ensure_equals("back", list.back(), 7);
+        ensure_equals("next", list.next(3), 1);
+
+        // pushing an existing index moves it to the back
+        list.pushBack(3);
+        ensure_equals("still 3", list.size(), 3U);
+        ensure_equals("moved", list.back(), 3);
+        ensure_equals("new front", list.front(), 1);
+
+        list.remove(7);
+        list.remove(7);
+        list.remove(100);
+        ensure("removed", !list.contains(7));
+        ensure_equals("size after remove", list.size(), 2U);
+
+        ensure_equals("pop 1", list.popFront(), 1);
+        ensure_equals("pop 3", list.popFront(), 3);
+        ensure("drained", list.empty() && list.front() == LLIndexList::NONE && list.back() == LLIndexList::NONE);
+    }
+
+    template<> template<>
+    void object::test<4>()
+    {
+        set_test_name("lookup/insert/evict micro-benchmark");
+        // Mimics the LLTextureCache header index: id -> entry index, plus
+        // an LRU of entry indices evicted oldest first. Without
+        // LL_BENCHMARKS only the smallest map runs, to check both agree.
+        const size_t sizes[] = { 10000, 100000, 1000000 };
+        for (size_t count : sizes)
+        {
+            if (count > sizes[0] && !benchmarking())
+            {
+                break;
+            }
+            std::vector<LLUUID> ids = makeIDs(count, count);
+            std::vector<LLUUID> misses = makeIDs(count, count + 1);
+            S64 found = 0;
+
+            F64 map_insert, map_lookup, map_evict;
+            {
+                std::map<LLUUID, S32> map;
+                std::set<LLUUID> lru;
+                BenchTimer timer;
+                for (size_t i = 0; i < count; ++i)
+                {
+                    map[ids[i]] = (S32)i;
+                    lru.insert(ids[i]);
+                }
+                map_insert = timer.elapsedMS();
+
+                timer = BenchTimer();
+                for (size_t i = 0; i < count; ++i)
+                {
+                    found += map.count(ids[i]) + map.count(misses[i]);
+                }
+                map_lookup = timer.elapsedMS();
+
+                timer = BenchTimer();
+                while (!lru.empty())
+                {
+                    map.erase(*lru.begin());
+                    lru.erase(lru.begin());
+                }
+                map_evict = timer.elapsedMS();
+                ensure("std::map drained", map.empty());
+            }
+
+            F64 hash_insert, hash_lookup, hash_evict;
+            {
+                LLUUIDHashMap<S32> map;
+                LLIndexList lru;
+                BenchTimer timer;
+                for (size_t i = 0; i < count; ++i)
+                {
+                    map[ids[i]] = (S32)i;
+                    lru.pushBack((S32)i);
+                }
+                hash_insert = timer.elapsedMS();
+
+                timer = BenchTimer();
+                for (size_t i = 0; i < count; ++i)
+                {
+                    found -= map.count(ids[i]) + map.count(misses[i]);
+                }
+                hash_lookup = timer.elapsedMS();
+
+                timer = BenchTimer();
+                while (!lru.empty())
+                {
+                    map.erase(ids[lru.popFront()]);
+                }
+                hash_evict = timer.elapsedMS();
+                ensure("LLUUIDHashMap drained", map.empty());
+            }
+            ensure_equals("same lookups", found, (S64)0);
+
+            if (benchmarking())
+            {
+                LL_INFOS("Benchmark") << count << " entries, ms std::map/std::set vs LLUUIDHashMap/LLIndexList:"
+                                      << " insert " << map_insert << " / " << hash_insert
+                                      << ", lookup " << map_lookup << " / " << hash_lookup
+                                      << ", evict " << map_evict << " / " << hash_evict << LL_ENDL;
+            }
+        }
+    }
+
+    template<> template<>
+    void object::test<5>()
+    {
+        set_test_name("texture list find/insert/iterate micro-benchmark");
+        // Mimics LLViewerTextureList at 50k textures: std::map by key plus a
+        // std::set of the same textures, against ids hashed to handles into
+        // a packed vector plus a packed vector that each texture knows its
+        // index in. Both have to find the same textures; the full list and
+        // the timing log are for LL_BENCHMARKS.
+        typedef LLPointer<BenchTexture> texture_ptr_t;
+        struct Handles
+        {
+            Handles() { mHandle[0] = mHandle[1] = -1; }
+            S32 mHandle[2];
+        };
+
+        const size_t COUNT = benchmarking() ? 50000 : 5000;
+        const S32 ITERATIONS = benchmarking() ? 20 : 1;
+        std::vector<LLUUID> ids = makeIDs(COUNT, 50);
+        std::vector<LLUUID> misses = makeIDs(COUNT, 51);
+        std::vector<texture_ptr_t> textures;
+        for (size_t i = 0; i < COUNT; ++i)
+        {
+            // a few scaled copies of standard textures, as with the real list
+            S32 type = i % 50 == 49 ? 1 : 0;
+            textures.push_back(new BenchTexture(type ? ids[i - 1] : ids[i], type));
+        }
+        F64 found = 0.0;
+
+        F64 map_insert, map_find, map_iterate, map_erase;
+        {
+            std::map<BenchKey, texture_ptr_t> map;
+            std::set<texture_ptr_t> list;
+            BenchTimer timer;
+            for (const texture_ptr_t& texture : textures)
+            {
+                map[BenchKey(texture->mID, texture->mType)] = texture;
+                list.insert(texture);
+            }
+            map_insert = timer.elapsedMS();
+
+            timer = BenchTimer();
+            for (size_t i = 0; i < COUNT; ++i)
+            {
+                std::map<BenchKey, texture_ptr_t>::iterator it = map.find(BenchKey(ids[i], 0));
+                found += it != map.end() ? it->second->mVirtualSize : 0.f;
+                found += map.count(BenchKey(misses[i], 0));
+            }
+            map_find = timer.elapsedMS();
+
+            timer = BenchTimer();
+            for (S32 pass = 0; pass < ITERATIONS; ++pass)
+            {
+                for (const texture_ptr_t& texture : list)
+                {
+                    found += texture->mVirtualSize;
+                }
+            }
+            map_iterate = timer.elapsedMS() / ITERATIONS;
+
+            timer = BenchTimer();
+            for (const texture_ptr_t& texture : textures)
+            {
+                map.erase(BenchKey(texture->mID, texture->mType));
+                list.erase(texture);
+            }
+            map_erase = timer.elapsedMS();
+            ensure("std::map drained", map.empty() && list.empty());
+        }
+
+        F64 hash_insert, hash_find, hash_iterate, hash_erase;
+        {
+            LLUUIDHashMap<Handles> map;
+            std::vector<texture_ptr_t> packed;
+            std::vector<texture_ptr_t> list;
+            BenchTimer timer;
+            for (BenchTexture* texture : textures)
+            {
+                map[texture->mID].mHandle[texture->mType] = (S32)packed.size();
+                packed.push_back(texture);
+                texture->mListIndex = (S32)list.size();
+                list.push_back(texture);
+            }
+            hash_insert = timer.elapsedMS();
+
+            timer = BenchTimer();
+            for (size_t i = 0; i < COUNT; ++i)
+            {
+                LLUUIDHashMap<Handles>::const_iterator it = map.find(ids[i]);
+                found -= it != map.end() && it->second.mHandle[0] >= 0 ? packed[it->second.mHandle[0]]->mVirtualSize : 0.f;
+                found -= map.count(misses[i]);
+            }
+            hash_find = timer.elapsedMS();
+
+            timer = BenchTimer();
+            for (S32 pass = 0; pass < ITERATIONS; ++pass)
+            {
+                for (const texture_ptr_t& texture : list)
+                {
+                    found -= texture->mVirtualSize;
+                }
+            }
+            hash_iterate = timer.elapsedMS() / ITERATIONS;
+
+            timer = BenchTimer();
+            for (BenchTexture* texture : textures)
+            {
+                // Move the last ones into the holes
+                Handles& handles = map[texture->mID];
+                S32 handle = handles.mHandle[texture->mType];
+                const texture_ptr_t& last = packed.back();
+                map[last->mID].mHandle[last->mType] = handle;
+                packed[handle] = last;
+                packed.pop_back();
+                handles.mHandle[texture->mType] = -1;
+                if (handles.mHandle[0] < 0 && handles.mHandle[1] < 0)
+                {
+                    map.erase(texture->mID);
+                }
+
+                S32 index = texture->mListIndex;
+                list[index] = list.back();
+                list[index]->mListIndex = index;
+                list.pop_back();
+                texture->mListIndex = -1;
+            }
+            hash_erase = timer.elapsedMS();
+            ensure("LLUUIDHashMap drained", map.empty() && packed.empty() && list.empty());
+        }
+        ensure_equals("same lookups", found, 0.0);
+
+        if (benchmarking())
+        {
+            LL_INFOS("Benchmark") << COUNT << " textures, ms std::map/std::set vs LLUUIDHashMap/std::vector:"
+                                  << " insert " << map_insert << " / " << hash_insert
+                                  << ", find " << map_find << " / " << hash_find
+                                  << ", iterate " << map_iterate << " / " << hash_iterate
+                                  << ", erase " << map_erase << " / " << hash_erase << LL_ENDL;
+        }
+    }
+}
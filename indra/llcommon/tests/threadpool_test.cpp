@@ -0,0 +1,206 @@
+/**
+ * @file   threadpool_test.cpp
+ * @brief  Test for threadpool and WorkStealingQueue.
+ *
+ * $LicenseInfo:firstyear=2024&license=viewerlgpl$
+ * Copyright (c) 2024, Linden Research, Inc.
+ * $/LicenseInfo$
+ */
+
+// Precompiled header
+#include "linden_common.h"
+// associated header
+#include "threadpool.h"
+// STL headers
+// std headers
+#include <atomic>
+#include <chrono>
+#include <thread>
+// external library headers
+// other Linden headers
+#include "../test/lltut.h"
+#include "stringize.h"
+
+using namespace LL;
+using namespace std::literals::chrono_literals; // ms suffix
+
+namespace
+{
+    using Clock = std::chrono::steady_clock;
+
+    // Poll for count to reach expected, since the posting thread must not
+    // block on the pool it's feeding.
+    bool waitFor(const std::atomic<size_t>& count, size_t expected,
+                 Clock::duration timeout = 20s)
+    {
+        auto until = Clock::now() + timeout;
+        while (count < expected)
+        {
+            if (Clock::now() > until)
+            {
+                return false;
+            }
+            std::this_thread::sleep_for(1ms);
+        }
+        return true;
+    }
+
+    // Something for each task to do that the optimizer can't discard
+    void spin(std::atomic<size_t>& count, size_t loops)
+    {
+        volatile size_t sum = 0;
+        for (size_t i = 0; i < loops; ++i)
+        {
+            sum = sum + i * i;
+        }
+        count.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    // Tasks per second through a POOL of the given width. Half the tasks are
+    // posted by the main thread, the other half by the tasks themselves,
+    // the way decode completions queue follow-up work.
+    template <class POOL>
+    double tasksPerSecond(const std::string& name, size_t threads, size_t tasks, size_t loops)
+    {
+        POOL pool(name, threads);
+        pool.start();
+        auto& queue = pool.getQueue();
+        std::atomic<size_t> count{ 0 };
+
+        auto start = Clock::now();
+        for (size_t i = 0; i < tasks / 2; ++i)
+        {
+            queue.post([&queue, &count, loops]()
+                       {
+                           spin(count, loops);
+                           queue.post([&count, loops](){ spin(count, loops); });
+                       });
+        }
+        bool finished = waitFor(count, tasks / 2 * 2);
+        std::chrono::duration<double> elapsed = Clock::now() - start;
+        pool.close();
+        tut::ensure(STRINGIZE(name << " finished"), finished);
+        return (tasks / 2 * 2) / elapsed.count();
+    }
+}
+
+/*****************************************************************************
+*   TUT
+*****************************************************************************/
+namespace tut
+{
+    struct threadpool_data
+    {
+    };
+    typedef test_group<threadpool_data> threadpool_group;
+    typedef threadpool_group::object object;
+    threadpool_group threadpoolgrp("threadpool");
+
+    template<> template<>
+    void object::test<1>()
+    {
+        set_test_name("WorkStealingQueue as a plain queue");
+        WorkStealingQueue queue("stealing", 4);
+        ensure_equals("didn't capture name", queue.getKey(), "stealing");
+        ensure("not findable", WorkStealingQueue::getInstance("stealing") == queue.getWeak().lock());
+
+        // Nobody services the queue yet: work waits in the shared queue.
+        std::string order;
+        for (char c : std::string("abcd"))
+        {
+            ensure(STRINGIZE("couldn't post " << c), queue.tryPost([&order, c](){ order += c; }));
+        }
+        ensure_equals("size", queue.size(), 4);
+        ensure("posted past capacity", ! queue.tryPost([](){}));
+
+        ensure("runOne", queue.runOne());
+        ensure_equals("ran out of order", order, "a");
+        queue.close();
+        ensure("not closed", queue.isClosed());
+        ensure("posted after close", ! queue.post([&order](){ order += 'x'; }));
+        ensure("done too soon", ! queue.done());
+        queue.runUntilClose();
+        ensure_equals("didn't drain", order, "abcd");
+        ensure("not done", queue.done());
+    }
+
+    template<> template<>
+    void object::test<2>()
+    {
+        set_test_name("WorkStealingThreadPool runs every task once");
+        WorkStealingThreadPool pool("fanout", 4);
+        pool.start();
+        ensure_equals("width", pool.getWidth(), 4);
+        auto& queue = pool.getQueue();
+
+        // Each root task fans out children from its worker thread, so they
+        // land in that worker's deque for the others to steal.
+        const size_t roots = 100, children = 50;
+        std::atomic<size_t> ran{ 0 };
+        std::atomic<size_t> failed{ 0 };
+        for (size_t r = 0; r < roots; ++r)
+        {
+            queue.post([&queue, &ran, &failed]()
+                       {
+                           for (size_t c = 0; c < children; ++c)
+                           {
+                               if (! queue.post([&ran](){ ++ran; }))
+                               {
+                                   ++failed;
+                               }
+                           }
+                           ++ran;
+                       });
+        }
+        ensure("timed out", waitFor(ran, roots * (children + 1)));
+        ensure_equals("failed posts", failed.load(), 0);
+
+        // postTo() round trip through the pool
+        WorkQueue main("threadpool main");
+        int result = 0;
+        main.postTo(queue.getWeak(), [](){ return 17; }, [&result](int i){ result = i; });
+        for (auto until = Clock::now() + 10s; result == 0 && Clock::now() < until; )
+        {
+            main.runPending();
+            std::this_thread::sleep_for(1ms);
+        }
+        ensure_equals("postTo callback", result, 17);
+
+        // close() drains whatever is still queued before joining
+        std::atomic<size_t> late{ 0 };
+        for (size_t i = 0; i < 1000; ++i)
+        {
+            queue.post([&late](){ spin(late, 1000); });
+        }
+        pool.close();
+        ensure_equals("close didn't drain", late.load(), 1000);
+        ensure("not done", queue.done());
+        ensure("posted after close", ! queue.post([](){}));
+    }
+
+    template<> template<>
+    void object::test<3>()
+    {
+        set_test_name("tasks/second vs thread count");
+        // Every pool has to finish its tasks; the rates are only worth
+        // logging from a full size run with LL_BENCHMARKS.
+        const size_t tasks = benchmarking() ? 200000 : 2000;
+        for (size_t threads : { 1, 2, 4, 8 })
+        {
+            for (size_t loops : { 0, 1000 })
+            {
+                double shared = tasksPerSecond<ThreadPool>(
+                    STRINGIZE("shared" << threads << '-' << loops), threads, tasks, loops);
+                double stealing = tasksPerSecond<WorkStealingThreadPool>(
+                    STRINGIZE("stealing" << threads << '-' << loops), threads, tasks, loops);
+                if (benchmarking())
+                {
+                    LL_INFOS("Benchmark") << threads << " threads, " << loops << " loops per task: "
+                                          << "WorkQueue " << size_t(shared) << " tasks/s, "
+                                          << "WorkStealingQueue " << size_t(stealing) << " tasks/s"
+                                          << LL_ENDL;
+                }
+            }
+        }
+    }
+} // namespace tut
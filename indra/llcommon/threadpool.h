@@ -98,7 +98,9 @@ namespace LL
     };
 
     /**
-     * Specialize with WorkQueue or, for timestamped tasks, WorkSchedule
+     * Specialize with WorkQueue or, for timestamped tasks, WorkSchedule. For
+     * a pool of several threads taking bursts of small tasks, WorkStealingQueue
+     * spares them all contending for a single queue lock.
      */
     template <class QUEUE>
     struct ThreadPoolUsing: public ThreadPoolBase
@@ -136,6 +138,9 @@ namespace LL
     /// ThreadPool is shorthand for using the simpler WorkQueue
     using ThreadPool = ThreadPoolUsing<WorkQueue>;
 
+    /// WorkStealingThreadPool gives each worker thread its own deque
+    using WorkStealingThreadPool = ThreadPoolUsing<WorkStealingQueue>;
+
 } // namespace LL
 
 #endif /* ! defined(LL_THREADPOOL_H) */
@@ -181,6 +181,286 @@ bool LL::WorkQueue::tryPop_(Work& work)
     return mQueue.tryPop(work);
 }
 
+/*****************************************************************************
+*   WorkStealingQueue
+*****************************************************************************/
+namespace
+{
+    // The WorkStealingQueue, if any, whose runUntilClose() the current thread
+    // is running, and which deque it owns there
+    struct BoundWorker
+    {
+        U64 mSerial = 0;
+        size_t mIndex = 0;
+    };
+    thread_local BoundWorker sBoundWorker;
+
+    std::atomic<U64> sNextSerial{ 1 };
+}
+
+LL::WorkStealingQueue::WorkStealingQueue(const std::string& name, size_t capacity):
+    super(name),
+    mCapacity(capacity),
+    mSerial(sNextSerial++),
+    mSize(0),
+    mClosed(false),
+    mSleepers(0),
+    mBlockedPosters(0),
+    mNextWorker(0),
+    mWorkerCount(0),
+    mSharedSize(0)
+{
+}
+
+void LL::WorkStealingQueue::close()
+{
+    {
+        // set mClosed under the lock, so that a worker or poster can't check
+        // it and then miss the notification
+        Lock lock(mMutex);
+        mClosed = true;
+    }
+    mWorkCond.notify_all();
+    mSpaceCond.notify_all();
+}
+
+size_t LL::WorkStealingQueue::size()
+{
+    return mSize;
+}
+
+bool LL::WorkStealingQueue::isClosed()
+{
+    return mClosed;
+}
+
+bool LL::WorkStealingQueue::done()
+{
+    return mClosed && mSize == 0;
+}
+
+bool LL::WorkStealingQueue::post(const Work& callable)
+{
+    size_t index;
+    Worker* self = getWorker(index);
+    bool full = false;
+    if (! reserve(! self, full))
+    {
+        if (! full)
+        {
+            // closed
+            return false;
+        }
+
+        Lock lock(mMutex);
+        ++mBlockedPosters;
+        while (! reserve(true, full))
+        {
+            if (! full)
+            {
+                --mBlockedPosters;
+                return false;
+            }
+            mSpaceCond.wait(lock);
+        }
+        --mBlockedPosters;
+    }
+    push(self, callable);
+    return true;
+}
+
+bool LL::WorkStealingQueue::tryPost(const Work& callable)
+{
+    size_t index;
+    Worker* self = getWorker(index);
+    bool full = false;
+    if (! reserve(true, full))
+    {
+        return false;
+    }
+    push(self, callable);
+    return true;
+}
+
+LL::WorkStealingQueue::Worker* LL::WorkStealingQueue::getWorker(size_t& index) const
+{
+    if (sBoundWorker.mSerial != mSerial)
+    {
+        return nullptr;
+    }
+    index = sBoundWorker.mIndex;
+    return index < MAX_WORKERS ? mWorkers[index].get() : nullptr;
+}
+
+void LL::WorkStealingQueue::claimWorker()
+{
+    Lock lock(mMutex);
+    size_t index = mWorkerCount;
+    if (index < MAX_WORKERS)
+    {
+        mWorkers[index].reset(new Worker);
+        mWorkerCount.store(index + 1, std::memory_order_release);
+    }
+    else
+    {
+        LL_DEBUGS("WorkQueue") << getKey() << " has more than " << MAX_WORKERS
+                               << " workers, the rest get no deque" << LL_ENDL;
+    }
+    // remember even a failed claim, rather than retrying on every pop
+    sBoundWorker.mSerial = mSerial;
+    sBoundWorker.mIndex = index;
+}
+
+bool LL::WorkStealingQueue::reserve(bool limit, bool& full)
+{
+    // Count the item before checking mClosed: a worker that sees mClosed
+    // then sees this count, and keeps going until the item is popped.
+    size_t prev = mSize++;
+    full = limit && prev >= mCapacity;
+    if (mClosed || full)
+    {
+        --mSize;
+        return false;
+    }
+    return true;
+}
+
+void LL::WorkStealingQueue::push(Worker* self, const Work& work)
+{
+    Worker* worker = self;
+    if (! worker)
+    {
+        // deal work from other threads round-robin
+        size_t count = mWorkerCount.load(std::memory_order_acquire);
+        if (count)
+        {
+            worker = mWorkers[mNextWorker.fetch_add(1, std::memory_order_relaxed) % count].get();
+        }
+    }
+
+    if (worker)
+    {
+        std::lock_guard<std::mutex> lock(worker->mMutex);
+        worker->mDeque.push_back(work);
+    }
+    else
+    {
+        Lock lock(mMutex);
+        mShared.push_back(work);
+        ++mSharedSize;
+    }
+
+    // reserve() already counted the item, so a worker going to sleep either
+    // sees it or has registered in mSleepers by now
+    if (mSleepers)
+    {
+        Lock lock(mMutex);
+        mWorkCond.notify_one();
+    }
+}
+
+bool LL::WorkStealingQueue::popFrom(Worker* worker, Work& work, bool front)
+{
+    std::lock_guard<std::mutex> lock(worker->mMutex);
+    if (worker->mDeque.empty())
+    {
+        return false;
+    }
+    if (front)
+    {
+        work = std::move(worker->mDeque.front());
+        worker->mDeque.pop_front();
+    }
+    else
+    {
+        work = std::move(worker->mDeque.back());
+        worker->mDeque.pop_back();
+    }
+    return true;
+}
+
+void LL::WorkStealingQueue::popped()
+{
+    --mSize;
+    if (mBlockedPosters)
+    {
+        Lock lock(mMutex);
+        mSpaceCond.notify_one();
+    }
+}
+
+LL::WorkStealingQueue::Work LL::WorkStealingQueue::pop_()
+{
+    if (sBoundWorker.mSerial != mSerial)
+    {
+        claimWorker();
+    }
+
+    for (;;)
+    {
+        Work work;
+        if (tryPop_(work))
+        {
+            return work;
+        }
+
+        Lock lock(mMutex);
+        ++mSleepers;
+        mWorkCond.wait(lock, [this](){ return mSize > 0 || mClosed; });
+        --mSleepers;
+        if (mClosed && mSize == 0)
+        {
+            LLTHROW(Closed());
+        }
+    }
+}
+
+bool LL::WorkStealingQueue::tryPop_(Work& work)
+{
+    if (mSize == 0)
+    {
+        return false;
+    }
+
+    // own deque first, oldest item first
+    size_t index = 0;
+    Worker* self = getWorker(index);
+    if (self && popFrom(self, work, true))
+    {
+        popped();
+        return true;
+    }
+
+    if (mSharedSize)
+    {
+        Lock lock(mMutex);
+        if (! mShared.empty())
+        {
+            work = std::move(mShared.front());
+            mShared.pop_front();
+            --mSharedSize;
+            lock.unlock();
+            popped();
+            return true;
+        }
+    }
+
+    // steal the newest item of some other worker, starting past our own
+    // slot so that thieves spread out
+    size_t count = mWorkerCount.load(std::memory_order_acquire);
+    size_t start = self ? index + 1 : 0;
+    for (size_t i = 0; i < count; ++i)
+    {
+        Worker* victim = mWorkers[(start + i) % count].get();
+        if (victim != self && popFrom(victim, work, false))
+        {
+            popped();
+            return true;
+        }
+    }
+    return false;
+}
+
 /*****************************************************************************
 *   WorkSchedule
 *****************************************************************************/
@@ -17,9 +17,13 @@
 #include "llinstancetracker.h"
 #include "llinstancetrackersubclass.h"
 #include "threadsafeschedule.h"
+#include <atomic>
 #include <chrono>
+#include <deque>
 #include <exception>                // std::current_exception
 #include <functional>               // std::function
+#include <memory>                   // std::unique_ptr
+#include <mutex>
 #include <string>
 
 namespace LL
@@ -262,6 +266,123 @@ namespace LL
         bool tryPop_(Work&) override;
     };
 
+/*****************************************************************************
+*   WorkStealingQueue: per-worker deques with work stealing
+*****************************************************************************/
+    /**
+     * WorkStealingQueue is a drop-in alternative to WorkQueue for a pool of
+     * worker threads. Rather than having every post() and every pop contend
+     * on a single lock, each thread that services the queue with
+     * runUntilClose() gets a deque of its own:
+     *
+     * * work posted by one of the workers goes to that worker's deque;
+     * * work posted by any other thread is dealt round-robin to the workers'
+     *   deques;
+     * * a worker takes work from the front of its own deque, and when that
+     *   is empty, steals from the back of the other workers' deques.
+     *
+     * Until some thread calls runUntilClose(), posted work waits in a shared
+     * queue, as do threads calling runPending() and friends, which do not
+     * get a deque but do steal.
+     *
+     * Work items run in posting order per worker, but, as with any pool of
+     * more than one thread, not in overall posting order.
+     *
+     * capacity bounds the total number of pending items. post() blocks while
+     * the queue is full -- except when a worker posts, since blocking a
+     * worker on its own queue could deadlock.
+     */
+    class WorkStealingQueue: public LLInstanceTrackerSubclass<WorkStealingQueue, WorkQueueBase>
+    {
+    private:
+        using super = LLInstanceTrackerSubclass<WorkStealingQueue, WorkQueueBase>;
+
+    public:
+        /// threads past this count service the queue without a deque
+        static constexpr size_t MAX_WORKERS = 64;
+
+        /**
+         * You may omit the WorkStealingQueue name, in which case a unique
+         * name is synthesized; for practical purposes that makes it
+         * anonymous.
+         */
+        WorkStealingQueue(const std::string& name = std::string(), size_t capacity=1024);
+
+        /**
+         * Since the point of WorkStealingQueue is to pass work to some other
+         * worker threads asynchronously, it's important that it continue to
+         * exist until the worker threads have drained it. To communicate that
+         * it's time for them to quit, close() the queue.
+         */
+        void close() override;
+
+        /**
+         * As with WorkQueue, size() is only meaningful to a sole producer
+         * (noticing that size() == 0) or a sole consumer (noticing that
+         * size() > 0).
+         */
+        size_t size() override;
+        /// producer end: are we prevented from pushing any additional items?
+        bool isClosed() override;
+        /// consumer end: are we done, is the queue entirely drained?
+        bool done() override;
+
+        /*---------------------- fire and forget API -----------------------*/
+
+        /**
+         * post work, unless the queue is closed before we can post
+         */
+        bool post(const Work&) override;
+
+        /**
+         * post work, unless the queue is full
+         */
+        bool tryPost(const Work&) override;
+
+    private:
+        struct Worker
+        {
+            std::mutex mMutex;
+            std::deque<Work> mDeque;
+        };
+
+        // the Worker of the calling thread, if it services this queue
+        Worker* getWorker(size_t& index) const;
+        // bind the calling thread to the next free Worker
+        void claimWorker();
+        // Count one more pending item. Returns false, undoing that, if the
+        // queue is closed or, when limit is set, full: full tells which.
+        bool reserve(bool limit, bool& full);
+        void push(Worker* self, const Work& work);
+        bool popFrom(Worker* worker, Work& work, bool front);
+        void popped();
+
+        Work pop_() override;
+        bool tryPop_(Work&) override;
+
+        const size_t mCapacity;
+        // tells apart instances that happen to reuse an address
+        const U64 mSerial;
+        // items posted and not yet popped
+        std::atomic<size_t> mSize;
+        std::atomic<bool> mClosed;
+        std::atomic<U32> mSleepers;
+        std::atomic<U32> mBlockedPosters;
+        std::atomic<U32> mNextWorker;
+
+        // Claimed in order. Each slot is set before mWorkerCount publishes
+        // it, and left alone after that.
+        std::unique_ptr<Worker> mWorkers[MAX_WORKERS];
+        std::atomic<size_t> mWorkerCount;
+
+        // mMutex guards mShared and the condition variables
+        LLCoros::Mutex mMutex;
+        LLCoros::ConditionVariable mWorkCond;
+        LLCoros::ConditionVariable mSpaceCond;
+        std::deque<Work> mShared;
+        std::atomic<size_t> mSharedSize;
+    };
+
 /*****************************************************************************
 *   WorkSchedule: add support for timestamped tasks
 *****************************************************************************/
@@ -282,6 +282,21 @@ size_t BufferArray::write(size_t pos, const void * src, size_t len)
 }
 		
 
+const char * BufferArray::getContiguous(size_t pos, size_t * len)
+{
+	size_t offset(0);
+	const char * start(NULL), * end(NULL);
+	if (! getBlockStartEnd(findBlock(pos, &offset), &start, &end))
+	{
+		*len = 0;
+		return NULL;
+	}
+
+	*len = (end - start) - offset;
+	return start + offset;
+}
+
+
 int BufferArray::findBlock(size_t pos, size_t * ret_offset)
 {
 	*ret_offset = 0;
@@ -120,6 +120,14 @@ public:
 	/// append data when current position is equal to the
 	/// size of the instance or do a mix of both.
 	size_t write(size_t pos, const void * src, size_t len);
+
+	/// Returns a pointer to the data at 'pos' without copying
+	/// it and, in '*len', the count of bytes contiguous from
+	/// there.  Walk a range by advancing 'pos' by '*len' between
+	/// calls.  The pointer is invalidated by writes to the instance.
+	/// Returns NULL and a zero length if 'pos' is at or beyond
+	/// the end of the data.
+	const char * getContiguous(size_t pos, size_t * len);
 	
 protected:
 	int findBlock(size_t pos, size_t * ret_offset);
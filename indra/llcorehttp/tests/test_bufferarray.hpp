@@ -374,6 +374,42 @@ void BufferArrayTestObjectType::test<8>()
 	ba->release();
 }
 
+template <> template <>
+void BufferArrayTestObjectType::test<9>()
+{
+	set_test_name("BufferArray getContiguous across blocks");
+
+	// create a new ref counted object with an implicit reference
+	BufferArray * ba = new BufferArray();
+
+	size_t len(0);
+	ensure("Empty instance has no data", NULL == ba->getContiguous(0, &len));
+	ensure("Empty instance has zero length", 0 == len);
+
+	// two blocks: appendBufferAlloc always starts a new one
+	char str1[] = "abcdefghij";
+	size_t str1_len(strlen(str1));
+	char str2[] = "ABCDEFGHIJKLMNOPQRST";
+	size_t str2_len(strlen(str2));
+	ba->append(str1, str1_len);
+	memcpy(ba->appendBufferAlloc(str2_len), str2, str2_len);
+
+	const char * data(ba->getContiguous(4, &len));
+	ensure("Pointer into first block", NULL != data);
+	ensure("Rest of first block", str1_len - 4 == len);
+	ensure("First block content", 0 == strncmp(data, str1 + 4, len));
+
+	data = ba->getContiguous(4 + len, &len);
+	ensure("Second block", str2_len == len);
+	ensure("Second block content", 0 == strncmp(data, str2, len));
+
+	ensure("Past the end", NULL == ba->getContiguous(str1_len + str2_len, &len));
+	ensure("Past the end has zero length", 0 == len);
+
+	// release the implicit reference, causing the object to be released
+	ba->release();
+}
+
 }  // end namespace tut
 
 
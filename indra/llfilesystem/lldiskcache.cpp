@@ -34,25 +34,823 @@
 #include "llapp.h"
 #include "llassettype.h"
 #include "lldir.h"
+#include "hbxxh.h"
 #include <boost/filesystem.hpp>
 #include <chrono>
 
 #include "lldiskcache.h"
 
+namespace
+{
+    // Name of the index file inside the cache directory. Note that it must
+    // not contain the cache filename prefix or clearCache() would delete it.
+    const std::string INDEX_FILENAME("index.lldc");
+
+    const U32 INVALID_SLOT = U32_MAX;
+
+    U32 header_checksum(const LLDiskCache::IndexHeader* header)
+    {
+        return (U32)HBXXH64::digest(header, offsetof(LLDiskCache::IndexHeader, mChecksum));
+    }
+
+    U64 record_checksum(const LLDiskCache::IndexRecord* record)
+    {
+        return HBXXH64::digest(record, offsetof(LLDiskCache::IndexRecord, mChecksum));
+    }
+
+    size_t index_file_size(U32 capacity)
+    {
+        return sizeof(LLDiskCache::IndexHeader) + (size_t)capacity * sizeof(LLDiskCache::IndexRecord);
+    }
+}
+
 LLDiskCache::LLDiskCache(const std::string cache_dir,
                          const uintmax_t max_size_bytes,
                          const bool enable_cache_debug_info) :
     mCacheDir(cache_dir),
     mMaxSizeBytes(max_size_bytes),
-    mEnableCacheDebugInfo(enable_cache_debug_info)
+    mEnableCacheDebugInfo(enable_cache_debug_info),
+    mIndexHeader(nullptr),
+    mIndexRecords(nullptr),
+    mLRUHead(INVALID_SLOT),
+    mLRUTail(INVALID_SLOT),
+    mTotalBytes(0),
+    mPackThreshold(0)
 {
     mCacheFilenamePrefix = "sl_cache";
 
     LLFile::mkdir(cache_dir);
+
+    mPack.reset(new LLDiskCachePack(mCacheDir, mCacheFilenamePrefix));
+
+    mIndexFilename = mCacheDir + gDirUtilp->getDirDelimiter() + INDEX_FILENAME;
+    loadIndex();
+}
+
+LLDiskCache::~LLDiskCache()
+{
+    closeIndex();
+}
+
+void LLDiskCache::closeIndex()
+{
+    LLMutexLock lock(&mIndexMutex);
+    if (mIndexHeader)
+    {
+        // Everything in the mapping is up to date: flag the index so that
+        // the next session can use it as is.
+        mIndexHeader->mCleanShutdown = 1;
+        mIndexHeader->mChecksum = header_checksum(mIndexHeader);
+        mIndexFile.flush(true);
+    }
+    mIndexFile.close();
+    mIndexHeader = nullptr;
+    mIndexRecords = nullptr;
+    mIndexMap.clear();
+    mFreeSlots.clear();
+    mLRUHead = mLRUTail = INVALID_SLOT;
+    mTotalBytes = 0;
+    mPack->closeSegments(false);
+}
+
+void LLDiskCache::loadIndex()
+{
+    LLMutexLock lock(&mIndexMutex);
+
+    // The lock keeps a second viewer sharing this cache directory from
+    // loading, rebuilding or clearing the index under the first one. A new
+    // or short file is extended to a zeroed header, which is never valid.
+    if (!mIndexFile.open(mIndexFilename, sizeof(IndexHeader), false, true))
+    {
+        LL_WARNS() << "Unable to open disk cache index " << mIndexFilename
+                   << ", another viewer may be using this cache. Carrying on without an index,"
+                   << " so this session neither purges nor packs the cache." << LL_ENDL;
+        return;
+    }
+
+    mIndexHeader = (IndexHeader*)mIndexFile.getData();
+    mIndexRecords = (IndexRecord*)(mIndexFile.getData() + sizeof(IndexHeader));
+    bool valid = mIndexHeader->mMagic == INDEX_MAGIC
+        && mIndexHeader->mVersion == INDEX_VERSION
+        && mIndexHeader->mRecordSize == sizeof(IndexRecord)
+        && mIndexHeader->mChecksum == header_checksum(mIndexHeader)
+        && mIndexFile.getSize() == index_file_size(mIndexHeader->mCapacity);
+    if (valid && !mIndexHeader->mCleanShutdown)
+    {
+        // Viewer crashed: some writes may never have made it to the index.
+        LL_INFOS() << "Disk cache index was not closed cleanly" << LL_ENDL;
+        valid = false;
+    }
+
+    if (valid)
+    {
+        const U32 capacity = mIndexHeader->mCapacity;
+        mIndexMap.clear();
+        mIndexMap.reserve(capacity);
+        mLRUPrev.assign(capacity, INVALID_SLOT);
+        mLRUNext.assign(capacity, INVALID_SLOT);
+        mFreeSlots.clear();
+        mLRUHead = mLRUTail = INVALID_SLOT;
+        mTotalBytes = 0;
+
+        std::vector<std::pair<S64, U32>> in_use;
+        for (U32 slot = capacity; slot-- > 0; )
+        {
+            const IndexRecord& record = mIndexRecords[slot];
+            if (!(record.mFlags & RECORD_IN_USE))
+            {
+                mFreeSlots.push_back(slot);
+                continue;
+            }
+            if (record.mChecksum != record_checksum(&record) || !mIndexMap.emplace(record.mID, slot).second)
+            {
+                valid = false;
+                break;
+            }
+            in_use.emplace_back(record.mLastAccess, slot);
+            mTotalBytes += record.mSize;
+        }
+
+        if (valid)
+        {
+            // Oldest first so that the most recently used ends up at the head
+            std::sort(in_use.begin(), in_use.end());
+            for (const auto& entry : in_use)
+            {
+                lruPushFront(entry.second);
+            }
+
+            mPack->openSegments(mIndexHeader->mNextSegment);
+            for (const auto& entry : in_use)
+            {
+                const U32 slot = entry.second;
+                const IndexRecord& record = mIndexRecords[slot];
+                if (!(record.mFlags & RECORD_PACKED))
+                {
+                    continue;
+                }
+                if (mPack->getData(record.mSegment, record.mOffset, (U32)record.mSize))
+                {
+                    mPack->addLiveBytes(record.mSegment, (U32)record.mSize);
+                }
+                else
+                {
+                    // Segment deleted behind our back: forget the asset
+                    mIndexRecords[slot].mFlags &= ~RECORD_PACKED;
+                    freeEntry(slot);
+                }
+            }
+        }
+        else
+        {
+            LL_WARNS() << "Disk cache index is corrupt" << LL_ENDL;
+        }
+    }
+
+    if (valid)
+    {
+        LL_INFOS() << "Loaded disk cache index with " << mIndexMap.size() << " entries, "
+                   << mTotalBytes << " bytes" << LL_ENDL;
+    }
+    else
+    {
+        rebuildIndex();
+    }
+
+    if (mIndexHeader)
+    {
+        mIndexHeader->mCleanShutdown = 0;
+        mIndexHeader->mChecksum = header_checksum(mIndexHeader);
+        mIndexFile.flush();
+    }
+}
+
+void LLDiskCache::resetIndex(U32 capacity)
+{
+    capacity = llmax(capacity, (U32)INDEX_MIN_CAPACITY);
+
+    mIndexHeader = nullptr;
+    mIndexRecords = nullptr;
+    mIndexMap.clear();
+    mLRUPrev.assign(capacity, INVALID_SLOT);
+    mLRUNext.assign(capacity, INVALID_SLOT);
+    mFreeSlots.clear();
+    mLRUHead = mLRUTail = INVALID_SLOT;
+    mTotalBytes = 0;
+
+    const size_t size = index_file_size(capacity);
+    bool mapped = mIndexFile.isOpen() ? mIndexFile.resize(size) : mIndexFile.open(mIndexFilename, size, false, true);
+    if (!mapped)
+    {
+        // Not fatal: the cache works without an index, it just never purges.
+        // The file is left alone if another viewer has it locked.
+        LL_WARNS() << "Unable to map disk cache index " << mIndexFilename << LL_ENDL;
+        mIndexFile.close();
+        return;
+    }
+
+    memset(mIndexFile.getData(), 0, size);
+    mIndexHeader = (IndexHeader*)mIndexFile.getData();
+    mIndexRecords = (IndexRecord*)(mIndexFile.getData() + sizeof(IndexHeader));
+    mIndexHeader->mMagic = INDEX_MAGIC;
+    mIndexHeader->mVersion = INDEX_VERSION;
+    mIndexHeader->mCapacity = capacity;
+    mIndexHeader->mRecordSize = sizeof(IndexRecord);
+    mIndexHeader->mChecksum = header_checksum(mIndexHeader);
+
+    mFreeSlots.reserve(capacity);
+    for (U32 slot = capacity; slot-- > 0; )
+    {
+        mFreeSlots.push_back(slot);
+    }
+}
+
+void LLDiskCache::rebuildIndex()
+{
+    auto start_time = std::chrono::high_resolution_clock::now();
+
+    typedef std::pair<std::time_t, std::pair<uintmax_t, LLUUID>> file_info_t;
+    std::vector<file_info_t> file_info;
+
+    // Packed assets: segment number and time of the last write to it
+    std::map<U32, std::time_t> segments;
+
+    // Files are named <prefix>_<uuid>_<extra info>.asset, see metaDataToFilepath()
+    const std::string prefix = mCacheFilenamePrefix + "_";
+    const size_t uuid_length = UUID_STR_LENGTH - 1;
+
+    boost::system::error_code ec;
+#if LL_WINDOWS
+    std::wstring cache_path(utf8str_to_utf16str(mCacheDir));
+#else
+    std::string cache_path(mCacheDir);
+#endif
+    if (boost::filesystem::is_directory(cache_path, ec) && !ec.failed())
+    {
+        boost::filesystem::directory_iterator iter(cache_path, ec);
+        while (iter != boost::filesystem::directory_iterator() && !ec.failed())
+        {
+            if (boost::filesystem::is_regular_file(*iter, ec) && !ec.failed())
+            {
+                const std::string file_name = (*iter).path().filename().string();
+                U32 segment;
+                if (mPack->parseSegmentFilename(file_name, segment))
+                {
+                    segments[segment] = boost::filesystem::last_write_time(*iter, ec);
+                }
+                else if (file_name.compare(0, prefix.length(), prefix) == 0 &&
+                    file_name.length() > prefix.length() + uuid_length)
+                {
+                    const std::string id_str = file_name.substr(prefix.length(), uuid_length);
+                    uintmax_t file_size = boost::filesystem::file_size(*iter, ec);
+                    std::time_t file_time = 0;
+                    if (!ec.failed())
+                    {
+                        file_time = boost::filesystem::last_write_time(*iter, ec);
+                    }
+                    if (!ec.failed() && LLUUID::validate(id_str))
+                    {
+                        file_info.push_back(file_info_t(file_time, { file_size, LLUUID(id_str) }));
+                    }
+                }
+            }
+            iter.increment(ec);
+        }
+    }
+
+    std::sort(file_info.begin(), file_info.end(), [](const file_info_t& x, const file_info_t& y)
+    {
+        return x.first < y.first;
+    });
+
+    mPack->closeSegments(false);
+    resetIndex((U32)file_info.size() * 2);
+    if (!mIndexHeader)
+    {
+        return;
+    }
+
+    for (const file_info_t& entry : file_info)
+    {
+        U32 slot = allocEntry(entry.second.second);
+        if (slot == INVALID_SLOT)
+        {
+            break;
+        }
+        IndexRecord& record = mIndexRecords[slot];
+        record.mAssetType = LLAssetType::AT_NONE;
+        record.mSize = entry.second.first;
+        record.mLastAccess = entry.first;
+        updateRecordChecksum(slot);
+        mTotalBytes += entry.second.first;
+    }
+
+    // Then the packed assets. Records are scanned oldest first, so a later
+    // record for the same id replaces an earlier one; an asset that also
+    // has its own file keeps the file.
+    U32 packed_count = 0;
+    if (!segments.empty())
+    {
+        mPack->openSegments(segments.rbegin()->first + 1);
+        for (const auto& seg_entry : segments)
+        {
+            const std::time_t seg_time = seg_entry.second;
+            mPack->scanSegment(seg_entry.first, true,
+                [this, seg_time, &packed_count](const LLDiskCachePack::RecordHeader& header, U32 segment, U32 offset)
+                {
+                    U32 slot;
+                    auto iter = mIndexMap.find(header.mID);
+                    if (iter == mIndexMap.end())
+                    {
+                        slot = allocEntry(header.mID);
+                        if (slot == INVALID_SLOT)
+                        {
+                            mPack->release(segment, offset);
+                            return;
+                        }
+                        ++packed_count;
+                    }
+                    else if (mIndexRecords[iter->second].mFlags & RECORD_PACKED)
+                    {
+                        slot = iter->second;
+                        releasePacked(slot);
+                    }
+                    else
+                    {
+                        mPack->release(segment, offset);
+                        return;
+                    }
+
+                    IndexRecord& record = mIndexRecords[slot];
+                    mTotalBytes -= llmin(mTotalBytes, (uintmax_t)record.mSize);
+                    record.mFlags |= RECORD_PACKED;
+                    record.mAssetType = header.mAssetType;
+                    record.mSize = header.mSize;
+                    record.mSegment = segment;
+                    record.mOffset = offset;
+                    record.mLastAccess = seg_time;
+                    updateRecordChecksum(slot);
+                    mTotalBytes += header.mSize;
+                    mPack->addLiveBytes(segment, header.mSize);
+                });
+        }
+    }
+    updateNextSegment();
+
+    auto end_time = std::chrono::high_resolution_clock::now();
+    auto execute_time = std::chrono::duration_cast<std::chrono::milliseconds>(end_time - start_time).count();
+    LL_INFOS() << "Rebuilt disk cache index from " << file_info.size() << " files and "
+               << packed_count << " packed assets, " << mTotalBytes << " bytes in " << execute_time << " ms" << LL_ENDL;
+}
+
+U32 LLDiskCache::allocEntry(const LLUUID& id)
+{
+    if (!mIndexHeader)
+    {
+        return INVALID_SLOT;
+    }
+
+    if (mFreeSlots.empty())
+    {
+        const U32 old_capacity = mIndexHeader->mCapacity;
+        const U32 new_capacity = old_capacity * 2;
+        if (!mIndexFile.resize(index_file_size(new_capacity)))
+        {
+            // The mapping is gone: carry on without an index
+            LL_WARNS() << "Unable to grow disk cache index to " << new_capacity << " entries" << LL_ENDL;
+            mIndexFile.close();
+            mIndexHeader = nullptr;
+            mIndexRecords = nullptr;
+            mIndexMap.clear();
+            mFreeSlots.clear();
+            mLRUHead = mLRUTail = INVALID_SLOT;
+            mTotalBytes = 0;
+            return INVALID_SLOT;
+        }
+        mIndexHeader = (IndexHeader*)mIndexFile.getData();
+        mIndexRecords = (IndexRecord*)(mIndexFile.getData() + sizeof(IndexHeader));
+        memset((void*)&mIndexRecords[old_capacity], 0, (size_t)(new_capacity - old_capacity) * sizeof(IndexRecord));
+        mIndexHeader->mCapacity = new_capacity;
+        mIndexHeader->mChecksum = header_checksum(mIndexHeader);
+        mLRUPrev.resize(new_capacity, INVALID_SLOT);
+        mLRUNext.resize(new_capacity, INVALID_SLOT);
+        for (U32 slot = new_capacity; slot-- > old_capacity; )
+        {
+            mFreeSlots.push_back(slot);
+        }
+    }
+
+    U32 slot = mFreeSlots.back();
+    mFreeSlots.pop_back();
+
+    IndexRecord& record = mIndexRecords[slot];
+    record.mID = id;
+    record.mAssetType = LLAssetType::AT_NONE;
+    record.mFlags = RECORD_IN_USE;
+    record.mSize = 0;
+    record.mLastAccess = std::time(nullptr);
+    updateRecordChecksum(slot);
+
+    mIndexMap[id] = slot;
+    lruPushFront(slot);
+    return slot;
+}
+
+void LLDiskCache::freeEntry(U32 slot)
+{
+    releasePacked(slot);
+
+    IndexRecord& record = mIndexRecords[slot];
+    mTotalBytes -= llmin(mTotalBytes, (uintmax_t)record.mSize);
+    mIndexMap.erase(record.mID);
+    lruUnlink(slot);
+    memset((void*)&record, 0, sizeof(IndexRecord));
+    mFreeSlots.push_back(slot);
+}
+
+void LLDiskCache::releasePacked(U32 slot)
+{
+    IndexRecord& record = mIndexRecords[slot];
+    if (record.mFlags & RECORD_PACKED)
+    {
+        mPack->release(record.mSegment, record.mOffset);
+        record.mFlags &= ~RECORD_PACKED;
+        record.mSegment = record.mOffset = 0;
+        updateRecordChecksum(slot);
+    }
+}
+
+void LLDiskCache::updateNextSegment()
+{
+    if (mIndexHeader && mIndexHeader->mNextSegment != mPack->getNextSegment())
+    {
+        mIndexHeader->mNextSegment = mPack->getNextSegment();
+        mIndexHeader->mChecksum = header_checksum(mIndexHeader);
+    }
+}
+
+void LLDiskCache::touchEntry(U32 slot)
+{
+    mIndexRecords[slot].mLastAccess = std::time(nullptr);
+    updateRecordChecksum(slot);
+    if (slot != mLRUHead)
+    {
+        lruUnlink(slot);
+        lruPushFront(slot);
+    }
+}
+
+void LLDiskCache::lruUnlink(U32 slot)
+{
+    const U32 prev = mLRUPrev[slot];
+    const U32 next = mLRUNext[slot];
+    if (prev != INVALID_SLOT)
+    {
+        mLRUNext[prev] = next;
+    }
+    else
+    {
+        mLRUHead = next;
+    }
+    if (next != INVALID_SLOT)
+    {
+        mLRUPrev[next] = prev;
+    }
+    else
+    {
+        mLRUTail = prev;
+    }
+    mLRUPrev[slot] = mLRUNext[slot] = INVALID_SLOT;
+}
+
+void LLDiskCache::lruPushFront(U32 slot)
+{
+    mLRUPrev[slot] = INVALID_SLOT;
+    mLRUNext[slot] = mLRUHead;
+    if (mLRUHead != INVALID_SLOT)
+    {
+        mLRUPrev[mLRUHead] = slot;
+    }
+    mLRUHead = slot;
+    if (mLRUTail == INVALID_SLOT)
+    {
+        mLRUTail = slot;
+    }
+}
+
+void LLDiskCache::updateRecordChecksum(U32 slot)
+{
+    mIndexRecords[slot].mChecksum = record_checksum(&mIndexRecords[slot]);
+}
+
+void LLDiskCache::updateFileAccessTime(const LLUUID& id)
+{
+    LLMutexLock lock(&mIndexMutex);
+    if (!mIndexHeader)
+    {
+        return;
+    }
+
+    auto iter = mIndexMap.find(id);
+    if (iter != mIndexMap.end())
+    {
+        touchEntry(iter->second);
+    }
+}
+
+void LLDiskCache::updateFileSize(const LLUUID& id, LLAssetType::EType at, uintmax_t file_size)
+{
+    LLMutexLock lock(&mIndexMutex);
+    if (!mIndexHeader)
+    {
+        return;
+    }
+
+    U32 slot;
+    auto iter = mIndexMap.find(id);
+    if (iter != mIndexMap.end())
+    {
+        slot = iter->second;
+        touchEntry(slot);
+    }
+    else
+    {
+        slot = allocEntry(id);
+        if (slot == INVALID_SLOT)
+        {
+            return;
+        }
+    }
+
+    // The asset now lives in its own file
+    releasePacked(slot);
+
+    IndexRecord& record = mIndexRecords[slot];
+    mTotalBytes -= llmin(mTotalBytes, (uintmax_t)record.mSize);
+    mTotalBytes += file_size;
+    record.mSize = file_size;
+    record.mAssetType = at;
+    updateRecordChecksum(slot);
+}
+
+bool LLDiskCache::removeFileEntry(const LLUUID& id)
+{
+    LLMutexLock lock(&mIndexMutex);
+    if (!mIndexHeader)
+    {
+        return false;
+    }
+
+    bool packed = false;
+    auto iter = mIndexMap.find(id);
+    if (iter != mIndexMap.end())
+    {
+        packed = (mIndexRecords[iter->second].mFlags & RECORD_PACKED) != 0;
+        freeEntry(iter->second);
+    }
+    return packed;
+}
+
+void LLDiskCache::renameFileEntry(const LLUUID& old_id, const LLUUID& new_id, LLAssetType::EType new_at)
+{
+    LLMutexLock lock(&mIndexMutex);
+    if (!mIndexHeader)
+    {
+        return;
+    }
+
+    // The file at the new name (if any) was replaced
+    auto iter = mIndexMap.find(new_id);
+    if (iter != mIndexMap.end())
+    {
+        freeEntry(iter->second);
+    }
+
+    iter = mIndexMap.find(old_id);
+    if (iter != mIndexMap.end())
+    {
+        const U32 slot = iter->second;
+        mIndexMap.erase(iter);
+        mIndexMap[new_id] = slot;
+
+        IndexRecord& record = mIndexRecords[slot];
+        record.mID = new_id;
+        record.mAssetType = new_at;
+        if (record.mFlags & RECORD_PACKED)
+        {
+            mPack->setRecordID(record.mSegment, record.mOffset, new_id);
+        }
+        touchEntry(slot);
+    }
+}
+
+void LLDiskCache::setPackThreshold(U32 bytes)
+{
+    LLMutexLock lock(&mIndexMutex);
+    mPackThreshold = llmin(bytes, LLDiskCachePack::getMaxRecordSize());
+}
+
+S32 LLDiskCache::getPackedSize(const LLUUID& id)
+{
+    LLMutexLock lock(&mIndexMutex);
+    if (!mIndexHeader)
+    {
+        return -1;
+    }
+
+    auto iter = mIndexMap.find(id);
+    if (iter == mIndexMap.end() || !(mIndexRecords[iter->second].mFlags & RECORD_PACKED))
+    {
+        return -1;
+    }
+    return (S32)mIndexRecords[iter->second].mSize;
+}
+
+bool LLDiskCache::readPacked(const LLUUID& id, S32 position, U8* buffer, S32 bytes, S32& bytes_read)
+{
+    LLMutexLock lock(&mIndexMutex);
+    if (!mIndexHeader)
+    {
+        return false;
+    }
+
+    auto iter = mIndexMap.find(id);
+    if (iter == mIndexMap.end() || !(mIndexRecords[iter->second].mFlags & RECORD_PACKED))
+    {
+        return false;
+    }
+
+    const U32 slot = iter->second;
+    const IndexRecord& record = mIndexRecords[slot];
+    const U8* data = mPack->getData(record.mSegment, record.mOffset, (U32)record.mSize);
+    if (!data)
+    {
+        LL_WARNS() << "Packed asset " << id << " is missing from its segment" << LL_ENDL;
+        freeEntry(slot);
+        return false;
+    }
+
+    const S32 size = (S32)record.mSize;
+    bytes_read = llclamp(size - position, 0, llmax(bytes, 0));
+    if (bytes_read > 0)
+    {
+        memcpy(buffer, data + position, bytes_read);
+    }
+    return true;
+}
+
+bool LLDiskCache::writePacked(const LLUUID& id, LLAssetType::EType at, const U8* data, S32 bytes, bool& remove_file)
+{
+    remove_file = false;
+
+    LLMutexLock lock(&mIndexMutex);
+    if (!mIndexHeader || bytes < 0 || (U32)bytes > mPackThreshold)
+    {
+        return false;
+    }
+
+    U32 segment, offset;
+    if (!mPack->append(id, at, data, (U32)bytes, segment, offset))
+    {
+        return false;
+    }
+    updateNextSegment();
+
+    U32 slot;
+    auto iter = mIndexMap.find(id);
+    if (iter != mIndexMap.end())
+    {
+        slot = iter->second;
+        remove_file = !(mIndexRecords[slot].mFlags & RECORD_PACKED);
+        releasePacked(slot);
+        touchEntry(slot);
+    }
+    else
+    {
+        slot = allocEntry(id);
+        if (slot == INVALID_SLOT)
+        {
+            mPack->release(segment, offset);
+            return false;
+        }
+    }
+
+    IndexRecord& record = mIndexRecords[slot];
+    mTotalBytes -= llmin(mTotalBytes, (uintmax_t)record.mSize);
+    mTotalBytes += bytes;
+    record.mFlags |= RECORD_PACKED;
+    record.mAssetType = at;
+    record.mSize = bytes;
+    record.mSegment = segment;
+    record.mOffset = offset;
+    updateRecordChecksum(slot);
+    return true;
+}
+
+bool LLDiskCache::unpackFile(const LLUUID& id, const std::string& filename)
+{
+    LLMutexLock lock(&mIndexMutex);
+    if (!mIndexHeader)
+    {
+        return false;
+    }
+
+    auto iter = mIndexMap.find(id);
+    if (iter == mIndexMap.end() || !(mIndexRecords[iter->second].mFlags & RECORD_PACKED))
+    {
+        return false;
+    }
+
+    const U32 slot = iter->second;
+    const IndexRecord& record = mIndexRecords[slot];
+    const U8* data = mPack->getData(record.mSegment, record.mOffset, (U32)record.mSize);
+    llofstream ofs(filename, std::ios::binary);
+    if (!data || !ofs.is_open())
+    {
+        LL_WARNS() << "Unable to unpack asset " << id << " to " << filename << LL_ENDL;
+        freeEntry(slot);
+        return false;
+    }
+    // Assets are small: fine to do with the lock held
+    ofs.write((const char*)data, record.mSize);
+    ofs.close();
+
+    releasePacked(slot);
+    return true;
+}
+
+void LLDiskCache::compactPack()
+{
+    // Dead space in the segments takes up disk like anything else: if it
+    // is what keeps the cache over its limit, compact more than just the
+    // mostly dead segments
+    const U64 used = (U64)mTotalBytes + mPack->getDeadBytes();
+    const U64 excess = used > (U64)mMaxSizeBytes ? used - (U64)mMaxSizeBytes : 0;
+    const std::vector<U32> candidates = mPack->getCompactionCandidates(excess);
+    for (U32 segment : candidates)
+    {
+        std::vector<std::pair<LLUUID, U32>> records;
+        mPack->scanSegment(segment, false,
+            [&records](const LLDiskCachePack::RecordHeader& header, U32 seg, U32 offset)
+            {
+                records.push_back(std::make_pair(header.mID, offset));
+            });
+
+        bool moved_all = true;
+        for (const auto& entry : records)
+        {
+            auto iter = mIndexMap.find(entry.first);
+            if (iter == mIndexMap.end())
+            {
+                continue;
+            }
+            const U32 slot = iter->second;
+            IndexRecord& record = mIndexRecords[slot];
+            if (!(record.mFlags & RECORD_PACKED) || record.mSegment != segment || record.mOffset != entry.second)
+            {
+                // Stale record left over from a crash
+                continue;
+            }
+
+            const U8* data = mPack->getData(segment, entry.second, (U32)record.mSize);
+            U32 new_segment, new_offset;
+            if (!data || !mPack->append(record.mID, record.mAssetType, data, (U32)record.mSize, new_segment, new_offset))
+            {
+                moved_all = false;
+                break;
+            }
+            mPack->release(segment, entry.second);
+            record.mSegment = new_segment;
+            record.mOffset = new_offset;
+            updateRecordChecksum(slot);
+        }
+        updateNextSegment();
+
+        if (!moved_all)
+        {
+            LL_WARNS() << "Unable to compact disk cache segment " << segment << LL_ENDL;
+            break;
+        }
+
+        if (mEnableCacheDebugInfo)
+        {
+            LL_INFOS() << "Compacted disk cache segment " << segment << ": moved " << records.size() << " records" << LL_ENDL;
+        }
+        mPack->dropSegment(segment);
+    }
+}
+
+uintmax_t LLDiskCache::getCacheSizeBytes()
+{
+    LLMutexLock lock(&mIndexMutex);
+    return mTotalBytes;
 }
 
 // WARNING: purge() is called by LLPurgeDiskCacheThread. As such it must
 // NOT touch any LLDiskCache data without introducing and locking a mutex!
+// The index is guarded by mIndexMutex, but the files themselves are
+// deleted after the lock is released so that readers and writers on
+// other threads are not stalled by the filesystem.
 
 // Interaction through the filesystem itself should be safe. Let’s say thread
 // A is accessing the cache file for reading/writing and thread B is trimming
@@ -79,6 +877,10 @@ LLDiskCache::LLDiskCache(const std::string cache_dir,
 // will prevent this. B continues with the next file. If the file is already
 // gone before A finally gets to open it, this operation will fail and the
 // asset will have to be re-requested.
+
+// If A rewrites the file after B dropped it from the index but before B
+// deleted it, the index ends up with an entry for a file that is gone. That
+// only costs its size in the accounting until that entry is evicted in turn.
 void LLDiskCache::purge()
 {
     if (mEnableCacheDebugInfo)
@@ -86,74 +888,48 @@ void LLDiskCache::purge()
         LL_INFOS() << "Total dir size before purge is " << dirFileSize(mCacheDir) << LL_ENDL;
     }
 
-    boost::system::error_code ec;
     auto start_time = std::chrono::high_resolution_clock::now();
 
     typedef std::pair<std::time_t, std::pair<uintmax_t, std::string>> file_info_t;
     std::vector<file_info_t> file_info;
+    uintmax_t file_size_total = 0;
 
-#if LL_WINDOWS
-    std::wstring cache_path(utf8str_to_utf16str(mCacheDir));
-#else
-    std::string cache_path(mCacheDir);
-#endif
-    if (boost::filesystem::is_directory(cache_path, ec) && !ec.failed())
     {
-        boost::filesystem::directory_iterator iter(cache_path, ec);
-        while (iter != boost::filesystem::directory_iterator() && !ec.failed())
+        LLMutexLock lock(&mIndexMutex);
+
+        LL_INFOS() << "Purging cache to a maximum of " << mMaxSizeBytes << " bytes" << LL_ENDL;
+
+        while (mIndexHeader && mTotalBytes > mMaxSizeBytes && mLRUTail != INVALID_SLOT)
         {
-            if (boost::filesystem::is_regular_file(*iter, ec) && !ec.failed())
+            const U32 slot = mLRUTail;
+            const IndexRecord& record = mIndexRecords[slot];
+            if (!(record.mFlags & RECORD_PACKED))
             {
-                if ((*iter).path().string().find(mCacheFilenamePrefix) != std::string::npos)
-                {
-                    uintmax_t file_size = boost::filesystem::file_size(*iter, ec);
-                    if (ec.failed())
-                    {
-                        continue;
-                    }
-                    const std::string file_path = (*iter).path().string();
-                    const std::time_t file_time = boost::filesystem::last_write_time(*iter, ec);
-                    if (ec.failed())
-                    {
-                        continue;
-                    }
-
-                    file_info.push_back(file_info_t(file_time, { file_size, file_path }));
-                }
+                file_info.push_back(file_info_t(record.mLastAccess,
+                                                { record.mSize, metaDataToFilepath(record.mID.asString(), LLAssetType::AT_NONE, "") }));
             }
-            iter.increment(ec);
+            freeEntry(slot);
         }
-    }
-
-    std::sort(file_info.begin(), file_info.end(), [](file_info_t& x, file_info_t& y)
-    {
-        return x.first > y.first;
-    });
+        file_size_total = mTotalBytes;
 
-    LL_INFOS() << "Purging cache to a maximum of " << mMaxSizeBytes << " bytes" << LL_ENDL;
+        if (mIndexHeader)
+        {
+            compactPack();
+        }
 
-    std::vector<bool> file_removed;
-    if (mEnableCacheDebugInfo)
-    {
-        file_removed.reserve(file_info.size());
+        if (mIndexHeader)
+        {
+            mIndexFile.flush();
+        }
     }
-    uintmax_t file_size_total = 0;
+
+    boost::system::error_code ec;
     for (file_info_t& entry : file_info)
     {
-        file_size_total += entry.second.first;
-
-        bool should_remove = file_size_total > mMaxSizeBytes;
-        if (mEnableCacheDebugInfo)
+        boost::filesystem::remove(entry.second.second, ec);
+        if (ec.failed())
         {
-            file_removed.push_back(should_remove);
-        }
-        if (should_remove)
-        {
-            boost::filesystem::remove(entry.second.second, ec);
-            if (ec.failed())
-            {
-                LL_WARNS() << "Failed to delete cache file " << entry.second.second << ": " << ec.message() << LL_ENDL;
-            }
+            LL_WARNS() << "Failed to delete cache file " << entry.second.second << ": " << ec.message() << LL_ENDL;
         }
     }
 
@@ -164,16 +940,12 @@ void LLDiskCache::purge()
 
         // Log afterward so it doesn't affect the time measurement
         // Logging thousands of file results can take hundreds of milliseconds
-        for (size_t i = 0; i < file_info.size(); ++i)
+        for (const file_info_t& entry : file_info)
         {
-            const file_info_t& entry = file_info[i];
-            const bool removed = file_removed[i];
-            const std::string action = removed ? "DELETE:" : "KEEP:";
-
             // have to do this because of LL_INFO/LL_END weirdness
             std::ostringstream line;
 
-            line << action << "  ";
+            line << "DELETE:  ";
             line << entry.first << "  ";
             line << entry.second.first << "  ";
             line << entry.second.second;
@@ -181,7 +953,8 @@ void LLDiskCache::purge()
             LL_INFOS() << line.str() << LL_ENDL;
         }
 
-        LL_INFOS() << "Total dir size after purge is " << dirFileSize(mCacheDir) << LL_ENDL;
+        LL_INFOS() << "Total dir size after purge is " << dirFileSize(mCacheDir)
+                   << ", index says " << file_size_total << LL_ENDL;
         LL_INFOS() << "Cache purge took " << execute_time << " ms to execute for " << file_info.size() << " files" << LL_ENDL;
     }
 }
@@ -258,73 +1031,12 @@ const std::string LLDiskCache::metaDataToFilepath(const std::string id,
     return file_path.str();
 }
 
-void LLDiskCache::updateFileAccessTime(const std::string file_path)
-{
-    /**
-     * Threshold in time_t units that is used to decide if the last access time
-     * time of the file is updated or not. Added as a precaution for the concern
-     * outlined in SL-14582  about frequent writes on older SSDs reducing their
-     * lifespan. I think this is the right place for the threshold value - rather
-     * than it being a pref - do comment on that Jira if you disagree...
-     *
-     * Let's start with 1 hour in time_t units and see how that unfolds
-     */
-    const std::time_t time_threshold = 1 * 60 * 60;
-
-    // current time
-    const std::time_t cur_time = std::time(nullptr);
-
-    boost::system::error_code ec;
-#if LL_WINDOWS
-    // file last write time
-    const std::time_t last_write_time = boost::filesystem::last_write_time(utf8str_to_utf16str(file_path), ec);
-    if (ec.failed())
-    {
-        LL_WARNS() << "Failed to read last write time for cache file " << file_path << ": " << ec.message() << LL_ENDL;
-        return;
-    }
-
-    // delta between cur time and last time the file was written
-    const std::time_t delta_time = cur_time - last_write_time;
-
-    // we only write the new value if the time in time_threshold has elapsed
-    // before the last one
-    if (delta_time > time_threshold)
-    {
-        boost::filesystem::last_write_time(utf8str_to_utf16str(file_path), cur_time, ec);
-    }
-#else
-    // file last write time
-    const std::time_t last_write_time = boost::filesystem::last_write_time(file_path, ec);
-    if (ec.failed())
-    {
-        LL_WARNS() << "Failed to read last write time for cache file " << file_path << ": " << ec.message() << LL_ENDL;
-        return;
-    }
-
-    // delta between cur time and last time the file was written
-    const std::time_t delta_time = cur_time - last_write_time;
-
-    // we only write the new value if the time in time_threshold has elapsed
-    // before the last one
-    if (delta_time > time_threshold)
-    {
-        boost::filesystem::last_write_time(file_path, cur_time, ec);
-    }
-#endif
-
-    if (ec.failed())
-    {
-        LL_WARNS() << "Failed to update last write time for cache file " << file_path << ": " << ec.message() << LL_ENDL;
-    }
-}
-
 const std::string LLDiskCache::getCacheInfo()
 {
     std::ostringstream cache_info;
 
     F32 max_in_mb = (F32)mMaxSizeBytes / (1024.0 * 1024.0);
-    F32 percent_used = ((F32)dirFileSize(mCacheDir) / (F32)mMaxSizeBytes) * 100.0;
+    F32 percent_used = ((F32)getCacheSizeBytes() / (F32)mMaxSizeBytes) * 100.0;
 
     cache_info << std::fixed;
     cache_info << std::setprecision(1);
@@ -336,6 +1048,16 @@ const std::string LLDiskCache::getCacheInfo()
 
 void LLDiskCache::clearCache()
 {
+    bool own_segments;
+    {
+        // The segment files have the cache prefix, but they can't be
+        // deleted while they are mapped on Windows
+        LLMutexLock lock(&mIndexMutex);
+        mPack->closeSegments(true);
+        // Without the index, the segments belong to the viewer that has it
+        own_segments = mIndexHeader != nullptr;
+    }
+
     /**
      * See notes on performance in dirFileSize(..) - there may be
      * a quicker way to do this by operating on the parent dir vs
@@ -355,7 +1077,9 @@ void LLDiskCache::clearCache()
         {
             if (boost::filesystem::is_regular_file(*iter, ec) && !ec.failed())
             {
-                if ((*iter).path().string().find(mCacheFilenamePrefix) != std::string::npos)
+                U32 segment;
+                if ((*iter).path().string().find(mCacheFilenamePrefix) != std::string::npos &&
+                    (own_segments || !mPack->parseSegmentFilename((*iter).path().filename().string(), segment)))
                 {
                     boost::filesystem::remove(*iter, ec);
                     if (ec.failed())
@@ -367,6 +1091,9 @@ void LLDiskCache::clearCache()
             iter.increment(ec);
         }
     }
+
+    LLMutexLock lock(&mIndexMutex);
+    resetIndex(INDEX_MIN_CAPACITY);
 }
 
 void LLDiskCache::removeOldVFSFiles()
@@ -22,20 +22,34 @@
                     that identifies the type of asset being stored.
         .asset      A file extension of .asset is used to help
                     identify this as a Viewer asset file
- * 2/ The time of last access for a file can be updated instantly
- *    for file reads and automatically as part of the file writes.
- * 3/ The purge algorithm collects a list of all files in the
- *    directory, sorts them by date of last access (write) and then
- *    deletes any files based on age until the total size of all
- *    the files is less than the maximum size specified.
- * 4/ An LLSingleton idiom is used since there will only ever be
+ * 2/ The size and time of last access of every cache file is kept
+ *    in an index file that is memory-mapped and updated incrementally
+ *    by LLFileSystem as files are opened, written and removed. There
+ *    is one fixed size record per file, so updating an entry costs a
+ *    store into the mapping rather than a filesystem call.
+ * 3/ An in-memory LRU list is built over the index records when the
+ *    index is loaded. The purge algorithm pops the least recently
+ *    used entries off that list and deletes their files until the
+ *    total size of all the files is less than the maximum size
+ *    specified, so it only touches the files it actually removes.
+ *    If the index is missing, from an older version, corrupt or was
+ *    not closed cleanly, it is rebuilt from a directory walk using
+ *    the last write time of each file. The index file is locked while
+ *    it is in use: a second viewer sharing the cache directory runs
+ *    without an index instead of rebuilding it under the first one.
+ * 4/ Optionally, assets no bigger than a threshold are not stored as
+ *    files at all but as records in large append-only segment files
+ *    (see lldiskcachepack.h). The index records the segment and offset
+ *    of each of them, and the purge thread compacts segments that are
+ *    mostly made of removed or evicted records. Their dead space counts
+ *    against the maximum size too: while it takes the cache over, the
+ *    segments with the most of it are compacted as well.
+ * 5/ An LLSingleton idiom is used since there will only ever be
  *    a single cache and we want to access it from numerous places.
- * 5/ Performance on my modest system seems very acceptable. For
- *    example, in testing, I was able to purge a directory of
- *    10,000 files, deleting about half of them in ~ 1700ms. For
- *    the same sized directory of files, writing the last updated
- *    time to each took less than 600ms indicating that this
- *    important part of the mechanism has almost no overhead.
+ * 6/ The original implementation walked the directory and stat'ed
+ *    every file on each purge, which took ~ 1700ms for 10,000 files
+ *    and grew linearly with the size of the cache. With the index a
+ *    purge costs O(files evicted) and the cache size is always known.
  *
  * $LicenseInfo:firstyear=2009&license=viewerlgpl$
  * Second Life Viewer Source Code
@@ -63,6 +77,11 @@
 #define _LLDISKCACHE
 
 #include "llsingleton.h"
+#include "llassettype.h"
+#include "lldiskcachepack.h"
+#include "llmappedfile.h"
+#include "llmutex.h"
+#include "lluuid.h"
 
 class LLDiskCache :
     public LLParamSingleton<LLDiskCache>
@@ -94,7 +113,7 @@ class LLDiskCache :
                      */
                     const bool enable_cache_debug_info);
 
-        virtual ~LLDiskCache() = default;
+        virtual ~LLDiskCache();
 
     public:
         /**
@@ -109,11 +128,69 @@ class LLDiskCache :
                                              const std::string extra_info);
 
         /**
-         * Update the "last write time" of a file to "now". This must be called whenever a
+         * Mark the cache file for this id as used "now". This must be called whenever a
          * file in the cache is read (not written) so that the last time the file was
-         * accessed is up to date (This is used in the mechanism for purging the cache)
+         * accessed is up to date (This is used in the mechanism for purging the cache).
+         * Files that are not in the index are left alone.
          */
-        void updateFileAccessTime(const std::string file_path);
+        void updateFileAccessTime(const LLUUID& id);
+
+        /**
+         * Record that the cache file for this id was written and is now
+         * file_size bytes long. Also counts as an access.
+         */
+        void updateFileSize(const LLUUID& id, LLAssetType::EType at, uintmax_t file_size);
+
+        /**
+         * Forget about the cache file for this id - called when it is removed.
+         * Returns true if the asset was packed, in which case there is no
+         * file to remove.
+         */
+        bool removeFileEntry(const LLUUID& id);
+
+        /**
+         * Move the index entry for a renamed cache file to its new id
+         */
+        void renameFileEntry(const LLUUID& old_id, const LLUUID& new_id, LLAssetType::EType new_at);
+
+        /**
+         * Assets written in one go that are no bigger than this are packed
+         * into segment files rather than getting a file each. 0 disables
+         * packing; assets that are already packed stay readable.
+         */
+        void setPackThreshold(U32 bytes);
+
+        /**
+         * Size of the packed asset for this id, or -1 if it isn't packed
+         */
+        S32 getPackedSize(const LLUUID& id);
+
+        /**
+         * Copy up to 'bytes' of a packed asset starting at 'position' into
+         * buffer. Returns false if the asset isn't packed.
+         */
+        bool readPacked(const LLUUID& id, S32 position, U8* buffer, S32 bytes, S32& bytes_read);
+
+        /**
+         * Store a whole asset as a packed record, replacing whatever was
+         * there. Returns false if packing is disabled, the asset is too big
+         * or it could not be stored; the caller then writes a file as usual.
+         * remove_file is set if the asset was previously stored in its own
+         * file, which the caller should delete.
+         */
+        bool writePacked(const LLUUID& id, LLAssetType::EType at, const U8* data, S32 bytes, bool& remove_file);
+
+        /**
+         * Move a packed asset out into its own file, for callers that want
+         * to append to it or modify it in place. Returns false if the asset
+         * wasn't packed.
+         */
+        bool unpackFile(const LLUUID& id, const std::string& filename);
+
+        /**
+         * Total size of the files in the cache, as tracked by the index
+         */
+        uintmax_t getCacheSizeBytes();
 
         /**
          * Purge the oldest items in the cache so that the combined size of all files
@@ -142,20 +219,106 @@ class LLDiskCache :
 
         void removeOldVFSFiles();
 
+        /**
+         * Map the index file and build the lookup table and LRU list from it,
+         * falling back to rebuildIndex() if it can't be trusted. The file stays
+         * locked until closeIndex(). If another viewer sharing the cache
+         * directory holds the lock, this one runs without an index and leaves
+         * the file alone.
+         */
+        void loadIndex();
+
+        /**
+         * Flag the index as closed cleanly, unmap it and release its lock.
+         * Done on destruction; the unit tests pair it with loadIndex() to
+         * restart the cache.
+         */
+        void closeIndex();
+
     private:
         /**
          * Utility function to gather the total size the files in a given
-         * directory. Primarily used here to determine the directory size
-         * before and after the cache purge
+         * directory. Only used with mEnableCacheDebugInfo to check the
+         * index against what is actually on disk
          */
         uintmax_t dirFileSize(const std::string dir);
 
+        /**
+         * Recreate the index from scratch by walking the cache directory
+         */
+        void rebuildIndex();
+
+        /**
+         * Drop every entry from the index (the files are left alone). Maps
+         * and locks the index file first if it isn't open.
+         */
+        void resetIndex(U32 capacity);
+
+        /**
+         * Helpers for the index and LRU list - mIndexMutex must be held
+         */
+        U32 allocEntry(const LLUUID& id);
+        void freeEntry(U32 slot);
+        void releasePacked(U32 slot);
+        void updateNextSegment();
+
+        /**
+         * Move the live records out of mostly dead segments, and out of the
+         * ones with the most dead space while that space keeps the cache over
+         * mMaxSizeBytes, so that the segment files can be deleted. Called by
+         * purge(), with mIndexMutex held.
+         */
+        void compactPack();
+        void touchEntry(U32 slot);
+        void lruUnlink(U32 slot);
+        void lruPushFront(U32 slot);
+        void updateRecordChecksum(U32 slot);
+
         /**
          * Utility function to convert an LLAssetType enum into a
          * string that we use as part of the cache file filename
          */
         const std::string assetTypeToString(LLAssetType::EType at);
 
+    public:
+        /**
+         * On-disk layout of the index file: a header followed by a flat
+         * array of fixed size records. A slot is free if its flags don't
+         * contain RECORD_IN_USE. Kept public for the unit tests.
+         */
+        enum
+        {
+            INDEX_MAGIC = 0x4344534c,    // "LSDC"
+            INDEX_VERSION = 2,
+            INDEX_MIN_CAPACITY = 4096,
+            RECORD_IN_USE = 0x1,
+            RECORD_PACKED = 0x2,    // stored in a pack segment rather than a file
+        };
+
+        struct IndexHeader
+        {
+            U32 mMagic;
+            U32 mVersion;
+            U32 mCapacity;
+            U32 mRecordSize;
+            U32 mCleanShutdown;
+            U32 mNextSegment;
+            U32 mChecksum;
+            U32 mReserved;
+        };
+
+        struct IndexRecord
+        {
+            LLUUID mID;
+            S32 mAssetType;
+            U32 mFlags;
+            U64 mSize;
+            S64 mLastAccess;
+            U32 mSegment;
+            U32 mOffset;
+            U64 mChecksum;
+        };
+
     private:
         /**
          * The maximum size of the cache in bytes. After purge is called, the
@@ -187,6 +350,32 @@ class LLDiskCache :
          * various parts of the code
          */
         bool mEnableCacheDebugInfo;
+
+        /**
+         * The memory-mapped index and the in-memory structures built over
+         * it: lookup from id to record slot, LRU links per slot (head is
+         * the most recently used entry) and the list of free slots.
+         * Everything here is guarded by mIndexMutex since the index is
+         * used by LLFileSystem on any thread and by LLPurgeDiskCacheThread.
+         */
+        LLMutex mIndexMutex;
+        LLMappedFile mIndexFile;
+        std::string mIndexFilename;
+        IndexHeader* mIndexHeader;
+        IndexRecord* mIndexRecords;
+        std::unordered_map<LLUUID, U32> mIndexMap;
+        std::vector<U32> mLRUPrev;
+        std::vector<U32> mLRUNext;
+        std::vector<U32> mFreeSlots;
+        U32 mLRUHead;
+        U32 mLRUTail;
+        uintmax_t mTotalBytes;
+
+        /**
+         * Segment files for packed assets, also guarded by mIndexMutex
+         */
+        std::unique_ptr<LLDiskCachePack> mPack;
+        U32 mPackThreshold;
 };
 
 class LLPurgeDiskCacheThread : public LLThread
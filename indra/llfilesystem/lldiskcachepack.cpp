@@ -0,0 +1,371 @@
+/**
+ * @file lldiskcachepack.cpp
+ * @brief Append-only segment files holding small disk cache assets.
+ *
+ * $LicenseInfo:firstyear=2024&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2024, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+#include "lldir.h"
+#include "hbxxh.h"
+
+#include <algorithm>
+
+#include "lldiskcachepack.h"
+
+namespace
+{
+    const U32 INVALID_SEGMENT = U32_MAX;
+    const std::string SEGMENT_EXTENSION(".llpk");
+}
+
+LLDiskCachePack::LLDiskCachePack(const std::string& cache_dir, const std::string& filename_prefix) :
+    mCacheDir(cache_dir),
+    mFilenamePrefix(filename_prefix + "_pack_"),
+    mActiveSegment(INVALID_SEGMENT),
+    mNextSegment(0)
+{
+}
+
+LLDiskCachePack::~LLDiskCachePack()
+{
+    closeSegments(false);
+}
+
+// static
+U32 LLDiskCachePack::recordSize(U32 data_size)
+{
+    return (sizeof(RecordHeader) + data_size + RECORD_ALIGN - 1) & ~(U32)(RECORD_ALIGN - 1);
+}
+
+// static
+U32 LLDiskCachePack::dataChecksum(const U8* data, U32 size)
+{
+    return (U32)HBXXH64::digest(data, size);
+}
+
+std::string LLDiskCachePack::getSegmentFilename(U32 segment) const
+{
+    return mCacheDir + gDirUtilp->getDirDelimiter() + mFilenamePrefix + llformat("%06u", segment) + SEGMENT_EXTENSION;
+}
+
+bool LLDiskCachePack::parseSegmentFilename(const std::string& filename, U32& segment) const
+{
+    if (filename.compare(0, mFilenamePrefix.length(), mFilenamePrefix) != 0 ||
+        filename.length() <= mFilenamePrefix.length() + SEGMENT_EXTENSION.length() ||
+        filename.compare(filename.length() - SEGMENT_EXTENSION.length(), SEGMENT_EXTENSION.length(), SEGMENT_EXTENSION) != 0)
+    {
+        return false;
+    }
+
+    const std::string number = filename.substr(mFilenamePrefix.length(),
+                                               filename.length() - mFilenamePrefix.length() - SEGMENT_EXTENSION.length());
+    if (number.find_first_not_of("0123456789") != std::string::npos)
+    {
+        return false;
+    }
+    segment = (U32)std::stoul(number);
+    return true;
+}
+
+LLDiskCachePack::Segment* LLDiskCachePack::getSegment(U32 segment) const
+{
+    auto iter = mSegments.find(segment);
+    return iter != mSegments.end() ? iter->second.get() : nullptr;
+}
+
+LLDiskCachePack::RecordHeader* LLDiskCachePack::getHeader(U32 segment, U32 offset) const
+{
+    Segment* seg = getSegment(segment);
+    if (!seg || (size_t)offset + sizeof(RecordHeader) > seg->mFile.getSize() || (offset & (RECORD_ALIGN - 1)))
+    {
+        return nullptr;
+    }
+    return (RecordHeader*)(seg->mFile.getData() + offset);
+}
+
+void LLDiskCachePack::openSegments(U32 next_segment)
+{
+    closeSegments(false);
+
+    for (U32 segment = 0; segment < next_segment; ++segment)
+    {
+        const std::string filename = getSegmentFilename(segment);
+        if (!gDirUtilp->fileExists(filename))
+        {
+            continue;
+        }
+
+        std::unique_ptr<Segment> seg(new Segment);
+        seg->mWriteOffset = SEGMENT_SIZE;
+        seg->mLiveBytes = 0;
+        if (seg->mFile.open(filename, SEGMENT_SIZE))
+        {
+            mSegments[segment] = std::move(seg);
+            mActiveSegment = segment;
+        }
+        else
+        {
+            LL_WARNS() << "Unable to map disk cache segment " << filename << LL_ENDL;
+        }
+    }
+    mNextSegment = llmax(mNextSegment, next_segment);
+
+    // Appends carry on at the end of the last segment
+    if (mActiveSegment != INVALID_SEGMENT)
+    {
+        scanSegment(mActiveSegment, false, nullptr);
+    }
+}
+
+void LLDiskCachePack::closeSegments(bool delete_files)
+{
+    for (auto& entry : mSegments)
+    {
+        entry.second->mFile.close();
+        if (delete_files)
+        {
+            LLFile::remove(getSegmentFilename(entry.first), ENOENT);
+        }
+    }
+    mSegments.clear();
+    mActiveSegment = INVALID_SEGMENT;
+    if (delete_files)
+    {
+        mNextSegment = 0;
+    }
+}
+
+void LLDiskCachePack::scanSegment(U32 segment, bool verify, const record_visitor_t& visitor)
+{
+    Segment* seg = getSegment(segment);
+    if (!seg)
+    {
+        return;
+    }
+
+    const U32 size = (U32)seg->mFile.getSize();
+    U32 offset = 0;
+    while (offset + sizeof(RecordHeader) <= size)
+    {
+        RecordHeader* header = (RecordHeader*)(seg->mFile.getData() + offset);
+        if ((header->mMagic != RECORD_LIVE && header->mMagic != RECORD_DEAD) ||
+            header->mSize > size - offset - sizeof(RecordHeader))
+        {
+            // Past the last record that was completely written
+            break;
+        }
+
+        if (header->mMagic == RECORD_LIVE)
+        {
+            const U8* data = (const U8*)(header + 1);
+            if (verify && header->mChecksum != dataChecksum(data, header->mSize))
+            {
+                LL_WARNS() << "Bad checksum for " << header->mID << " in disk cache segment " << segment << LL_ENDL;
+                header->mMagic = RECORD_DEAD;
+            }
+            else if (visitor)
+            {
+                visitor(*header, segment, offset);
+            }
+        }
+        offset += recordSize(header->mSize);
+    }
+    seg->mWriteOffset = llmin(offset, size);
+}
+
+bool LLDiskCachePack::startSegment()
+{
+    const U32 segment = mNextSegment++;
+    const std::string filename = getSegmentFilename(segment);
+
+    // Left over from a session that crashed before updating the index
+    LLFile::remove(filename, ENOENT);
+
+    std::unique_ptr<Segment> seg(new Segment);
+    seg->mWriteOffset = 0;
+    seg->mLiveBytes = 0;
+    if (!seg->mFile.open(filename, SEGMENT_SIZE))
+    {
+        LL_WARNS() << "Unable to create disk cache segment " << filename << LL_ENDL;
+        return false;
+    }
+
+    mSegments[segment] = std::move(seg);
+    mActiveSegment = segment;
+    return true;
+}
+
+bool LLDiskCachePack::append(const LLUUID& id, S32 asset_type, const U8* data, U32 size, U32& segment, U32& offset)
+{
+    if (size > getMaxRecordSize())
+    {
+        return false;
+    }
+
+    const U32 record_size = recordSize(size);
+    Segment* seg = getSegment(mActiveSegment);
+    if (!seg || (size_t)seg->mWriteOffset + record_size > seg->mFile.getSize())
+    {
+        if (!startSegment())
+        {
+            return false;
+        }
+        seg = getSegment(mActiveSegment);
+    }
+
+    segment = mActiveSegment;
+    offset = seg->mWriteOffset;
+
+    RecordHeader* header = (RecordHeader*)(seg->mFile.getData() + offset);
+    memcpy(header + 1, data, size);
+    header->mSize = size;
+    header->mID = id;
+    header->mAssetType = asset_type;
+    header->mChecksum = dataChecksum(data, size);
+    // Written last: a record without its magic is ignored by scanSegment()
+    header->mMagic = RECORD_LIVE;
+
+    seg->mWriteOffset += record_size;
+    seg->mLiveBytes += record_size;
+    return true;
+}
+
+const U8* LLDiskCachePack::getData(U32 segment, U32 offset, U32 size) const
+{
+    RecordHeader* header = getHeader(segment, offset);
+    if (!header || header->mMagic != RECORD_LIVE || header->mSize != size ||
+        (size_t)offset + sizeof(RecordHeader) + size > getSegment(segment)->mFile.getSize())
+    {
+        return nullptr;
+    }
+    return (const U8*)(header + 1);
+}
+
+void LLDiskCachePack::release(U32 segment, U32 offset)
+{
+    RecordHeader* header = getHeader(segment, offset);
+    if (header && header->mMagic == RECORD_LIVE)
+    {
+        header->mMagic = RECORD_DEAD;
+        Segment* seg = getSegment(segment);
+        seg->mLiveBytes -= llmin(seg->mLiveBytes, recordSize(header->mSize));
+    }
+}
+
+void LLDiskCachePack::setRecordID(U32 segment, U32 offset, const LLUUID& id)
+{
+    RecordHeader* header = getHeader(segment, offset);
+    if (header && header->mMagic == RECORD_LIVE)
+    {
+        header->mID = id;
+    }
+}
+
+void LLDiskCachePack::addLiveBytes(U32 segment, U32 size)
+{
+    Segment* seg = getSegment(segment);
+    if (seg)
+    {
+        seg->mLiveBytes += recordSize(size);
+    }
+}
+
+U32 LLDiskCachePack::deadBytes(U32 segment, const Segment& seg) const
+{
+    // Only the active segment still has room to append to
+    const U32 used = segment == mActiveSegment ? seg.mWriteOffset : (U32)seg.mFile.getSize();
+    return used - llmin(used, seg.mLiveBytes);
+}
+
+std::vector<U32> LLDiskCachePack::getCompactionCandidates(U64 excess_bytes) const
+{
+    std::vector<U32> candidates;
+    std::vector<std::pair<U32, U32>> others;
+    for (const auto& entry : mSegments)
+    {
+        if (entry.first == mActiveSegment)
+        {
+            continue;
+        }
+        const U32 dead = deadBytes(entry.first, *entry.second);
+        if (entry.second->mLiveBytes < SEGMENT_SIZE / 2)
+        {
+            candidates.push_back(entry.first);
+            excess_bytes -= llmin(excess_bytes, (U64)dead);
+        }
+        else if (dead)
+        {
+            others.emplace_back(dead, entry.first);
+        }
+    }
+
+    // Most dead space first, so that as little as possible is copied
+    std::sort(others.begin(), others.end(), std::greater<std::pair<U32, U32>>());
+    for (const auto& entry : others)
+    {
+        if (!excess_bytes)
+        {
+            break;
+        }
+        candidates.push_back(entry.second);
+        excess_bytes -= llmin(excess_bytes, (U64)entry.first);
+    }
+    return candidates;
+}
+
+void LLDiskCachePack::dropSegment(U32 segment)
+{
+    auto iter = mSegments.find(segment);
+    if (iter == mSegments.end())
+    {
+        return;
+    }
+
+    // The mapping must be gone before the file can be deleted on Windows
+    mSegments.erase(iter);
+    if (segment == mActiveSegment)
+    {
+        mActiveSegment = INVALID_SEGMENT;
+    }
+    LLFile::remove(getSegmentFilename(segment), ENOENT);
+}
+
+U64 LLDiskCachePack::getDeadBytes() const
+{
+    U64 total = 0;
+    for (const auto& entry : mSegments)
+    {
+        total += deadBytes(entry.first, *entry.second);
+    }
+    return total;
+}
+
+U64 LLDiskCachePack::getDiskBytes() const
+{
+    U64 total = 0;
+    for (const auto& entry : mSegments)
+    {
+        total += entry.second->mFile.getSize();
+    }
+    return total;
+}
@@ -0,0 +1,192 @@
+/**
+ * @file lldiskcachepack.h
+ * @brief Append-only segment files holding small disk cache assets.
+ *
+ * @Description:
+ * Small assets (notecards, gestures, animations, mesh and sound headers...)
+ * cost an inode, an open() and a stat() each when they are stored as one
+ * file per asset. LLDiskCachePack stores them as records appended to large
+ * memory-mapped segment files instead, so reading or writing one of them is
+ * a memcpy into or out of the mapping.
+ *
+ * Each record is a RecordHeader followed by the asset data, padded to
+ * RECORD_ALIGN bytes. Records are never modified in place except for the
+ * header magic, which is flipped to RECORD_DEAD when the asset is removed,
+ * replaced or evicted. Segments that are mostly dead, or whose dead space
+ * takes the cache over its size limit, are compacted by copying their live
+ * records to the active segment and deleting the file.
+ *
+ * LLDiskCachePack only manages the segments: the table saying which record
+ * holds which asset is the LLDiskCache index. It does no locking either,
+ * LLDiskCache calls it with its index mutex held. Between processes, the
+ * segments belong to whichever viewer holds the lock on the index file;
+ * another viewer sharing the cache directory never opens them and stores
+ * all its assets as loose files.
+ *
+ * $LicenseInfo:firstyear=2024&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2024, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#ifndef LL_LLDISKCACHEPACK_H
+#define LL_LLDISKCACHEPACK_H
+
+#include "llmappedfile.h"
+#include "lluuid.h"
+
+#include <functional>
+#include <memory>
+
+class LLDiskCachePack
+{
+public:
+    enum
+    {
+        SEGMENT_SIZE = 16 * 1024 * 1024,
+        RECORD_ALIGN = 16,
+        RECORD_LIVE = 0x4b50534c,    // "LSPK"
+        RECORD_DEAD = 0x44414544,    // "DEAD"
+    };
+
+    struct RecordHeader
+    {
+        U32 mMagic;
+        U32 mSize;
+        LLUUID mID;
+        S32 mAssetType;
+        U32 mChecksum;      // of the data, only checked when rebuilding the index
+    };
+
+    /**
+     * Called for each live record found by scanSegment()
+     */
+    typedef std::function<void(const RecordHeader& header, U32 segment, U32 offset)> record_visitor_t;
+
+    LLDiskCachePack(const std::string& cache_dir, const std::string& filename_prefix);
+    ~LLDiskCachePack();
+
+    /**
+     * Largest asset that fits in a segment
+     */
+    static U32 getMaxRecordSize()   { return SEGMENT_SIZE - sizeof(RecordHeader); }
+
+    /**
+     * Parse the segment number out of a file name, returns false if this
+     * is not a segment of ours
+     */
+    bool parseSegmentFilename(const std::string& filename, U32& segment) const;
+
+    /**
+     * Map segment files [0, next_segment) that exist on disk. The last one
+     * becomes the active segment and is scanned to find where appends
+     * carry on.
+     */
+    void openSegments(U32 next_segment);
+
+    /**
+     * Unmap all the segments. With delete_files, remove them from disk too.
+     */
+    void closeSegments(bool delete_files);
+
+    /**
+     * Walk the records of a segment in order, calling visitor for the live
+     * ones. Stops at the first slot that doesn't hold a valid record, which
+     * becomes the write position if this is the active segment. With
+     * verify, the data checksum of every record is checked and records
+     * that fail it are marked dead.
+     */
+    void scanSegment(U32 segment, bool verify, const record_visitor_t& visitor);
+
+    /**
+     * Append a record to the active segment, starting a new one if needed.
+     * Returns false if the data could not be stored.
+     */
+    bool append(const LLUUID& id, S32 asset_type, const U8* data, U32 size, U32& segment, U32& offset);
+
+    /**
+     * Pointer to the data of a live record, or nullptr if segment/offset
+     * doesn't point at one of the expected size. Only valid until the next
+     * call that may remap or drop segments.
+     */
+    const U8* getData(U32 segment, U32 offset, U32 size) const;
+
+    /**
+     * Mark a record dead
+     */
+    void release(U32 segment, U32 offset);
+
+    /**
+     * Change the asset id stored in a record (rename)
+     */
+    void setRecordID(U32 segment, U32 offset, const LLUUID& id);
+
+    /**
+     * Account for a live record found in the index when it was loaded
+     */
+    void addLiveBytes(U32 segment, U32 size);
+
+    /**
+     * Segments, other than the active one, worth compacting: those that are
+     * mostly dead space, then those with the most dead space until
+     * compacting them would free at least excess_bytes.
+     */
+    std::vector<U32> getCompactionCandidates(U64 excess_bytes) const;
+
+    /**
+     * Unmap a segment and delete its file. Any record still in it is lost.
+     */
+    void dropSegment(U32 segment);
+
+    U32 getNextSegment() const      { return mNextSegment; }
+    U32 getActiveSegment() const    { return mActiveSegment; }
+    U64 getDiskBytes() const;
+
+    /**
+     * Bytes of the segments that hold no live record: removed and replaced
+     * records, and the unused end of full segments
+     */
+    U64 getDeadBytes() const;
+
+private:
+    struct Segment
+    {
+        LLMappedFile mFile;
+        U32 mWriteOffset;
+        U32 mLiveBytes;
+    };
+
+    std::string getSegmentFilename(U32 segment) const;
+    Segment* getSegment(U32 segment) const;
+    RecordHeader* getHeader(U32 segment, U32 offset) const;
+    U32 deadBytes(U32 segment, const Segment& seg) const;
+    bool startSegment();
+
+    static U32 recordSize(U32 data_size);
+    static U32 dataChecksum(const U8* data, U32 size);
+
+private:
+    std::string mCacheDir;
+    std::string mFilenamePrefix;
+    std::map<U32, std::unique_ptr<Segment>> mSegments;
+    U32 mActiveSegment;
+    U32 mNextSegment;
+};
+
+#endif // LL_LLDISKCACHEPACK_H
@@ -54,21 +54,12 @@ LLFileSystem::LLFileSystem(const LLUUID& file_id, const LLAssetType::EType file_
     // we decided to follow Henri's suggestion and move the code to update the last access time here.
     if (mode == LLFileSystem::READ)
     {
-        // build the filename (TODO: we do this in a few places - perhaps we should factor into a single function)
-        std::string id;
-        mFileID.toString(id);
-        const std::string extra_info = "";
-        const std::string filename = LLDiskCache::getInstance()->metaDataToFilepath(id, mFileType, extra_info);
-
         // update the last access time for the file if it exists - this is required
         // even though we are reading and not writing because this is the
         // way the cache works - it relies on a valid "last accessed time" for
-        // each file so it knows how to remove the oldest, unused files
-        bool exists = gDirUtilp->fileExists(filename);
-        if (exists)
-        {
-            LLDiskCache::getInstance()->updateFileAccessTime(filename);
-        }
+        // each file so it knows how to remove the oldest, unused files.
+        // Files that don't exist aren't in the cache index so this is a no-op for them.
+        LLDiskCache::getInstance()->updateFileAccessTime(mFileID);
     }
 }
 
@@ -79,6 +70,12 @@ LLFileSystem::~LLFileSystem()
 // static
 bool LLFileSystem::getExists(const LLUUID& file_id, const LLAssetType::EType file_type)
 {
+    const S32 packed_size = LLDiskCache::getInstance()->getPackedSize(file_id);
+    if (packed_size >= 0)
+    {
+        return packed_size > 0;
+    }
+
     std::string id_str;
     file_id.toString(id_str);
     const std::string extra_info = "";
@@ -101,7 +98,10 @@ bool LLFileSystem::removeFile(const LLUUID& file_id, const LLAssetType::EType fi
     const std::string extra_info = "";
     const std::string filename =  LLDiskCache::getInstance()->metaDataToFilepath(id_str, file_type, extra_info);
 
-    LLFile::remove(filename.c_str(), suppress_error);
+    if (!LLDiskCache::getInstance()->removeFileEntry(file_id))
+    {
+        LLFile::remove(filename.c_str(), suppress_error);
+    }
 
     return true;
 }
@@ -122,6 +122,13 @@ bool LLFileSystem::renameFile(const LLUUID& old_file_id, const LLAssetType::ETyp
     // Rename needs the new file to not exist.
     LLFileSystem::removeFile(new_file_id, new_file_type, ENOENT);
 
+    // A packed asset has no file: only its index entry moves
+    if (LLDiskCache::getInstance()->getPackedSize(old_file_id) >= 0)
+    {
+        LLDiskCache::getInstance()->renameFileEntry(old_file_id, new_file_id, new_file_type);
+        return TRUE;
+    }
+
     if (LLFile::rename(old_filename, new_filename) != 0)
     {
         // We would like to return FALSE here indicating the operation
@@ -130,6 +137,10 @@ bool LLFileSystem::renameFile(const LLUUID& old_file_id, const LLAssetType::ETyp
         //return FALSE;
         LL_WARNS() << "Failed to rename " << old_file_id << " to " << new_id_str << " reason: "  << strerror(errno) << LL_ENDL;
     }
+    else
+    {
+        LLDiskCache::getInstance()->renameFileEntry(old_file_id, new_file_id, new_file_type);
+    }
 
     return TRUE;
 }
@@ -137,6 +148,12 @@ bool LLFileSystem::renameFile(const LLUUID& old_file_id, const LLAssetType::ETyp
 // static
 S32 LLFileSystem::getFileSize(const LLUUID& file_id, const LLAssetType::EType file_type)
 {
+    const S32 packed_size = LLDiskCache::getInstance()->getPackedSize(file_id);
+    if (packed_size >= 0)
+    {
+        return packed_size;
+    }
+
     std::string id_str;
     file_id.toString(id_str);
     const std::string extra_info = "";
@@ -157,6 +174,12 @@ BOOL LLFileSystem::read(U8* buffer, S32 bytes)
 {
     BOOL success = FALSE;
 
+    if (LLDiskCache::getInstance()->readPacked(mFileID, mPosition, buffer, bytes, mBytesRead))
+    {
+        mPosition += mBytesRead;
+        return mBytesRead > 0;
+    }
+
     std::string id;
     mFileID.toString(id);
     const std::string extra_info = "";
@@ -208,6 +231,27 @@ BOOL LLFileSystem::write(const U8* buffer, S32 bytes)
     const std::string filename =  LLDiskCache::getInstance()->metaDataToFilepath(id_str, mFileType, extra_info);
 
     BOOL success = FALSE;
+    S64 file_size = 0;
+
+    if (mMode == WRITE)
+    {
+        // Small assets written in one go can go to a pack segment instead of a file
+        bool remove_file = false;
+        if (LLDiskCache::getInstance()->writePacked(mFileID, mFileType, buffer, bytes, remove_file))
+        {
+            if (remove_file)
+            {
+                LLFile::remove(filename, ENOENT);
+            }
+            mPosition += bytes;
+            return TRUE;
+        }
+    }
+    else
+    {
+        // Appending to or modifying a packed asset: move it to its own file first
+        LLDiskCache::getInstance()->unpackFile(mFileID, filename);
+    }
 
     if (mMode == APPEND)
     {
@@ -244,6 +288,12 @@ BOOL LLFileSystem::write(const U8* buffer, S32 bytes)
                 success = TRUE;
             }
         }
+        if (success)
+        {
+            // We may have written into the middle of the file
+            ofs.seekp(0, std::ios::end);
+            file_size = ofs.tellp();
+        }
     }
     // </FS:Ansariel>
     else
@@ -259,6 +309,11 @@ BOOL LLFileSystem::write(const U8* buffer, S32 bytes)
         }
     }
 
+    if (success)
+    {
+        LLDiskCache::getInstance()->updateFileSize(mFileID, mFileType, llmax(file_size, (S64)mPosition));
+    }
+
     return success;
 }
 
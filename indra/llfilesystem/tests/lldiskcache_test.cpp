@@ -0,0 +1,356 @@
+/**
+ * @file lldiskcache_test.cpp
+ * @brief Tests for the LLDiskCache index.
+ *
+ * $LicenseInfo:firstyear=2024&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2024, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+
+#include "../lldir.h"
+#include "../lldiskcache.h"
+#include "../llfilesystem.h"
+
+#include "../test/lltut.h"
+
+#include <algorithm>
+#include <fstream>
+#include <iterator>
+
+namespace tut
+{
+    // LLDiskCache is an LLParamSingleton, which can only be initialized once
+    // per process, so all the tests share one cache and clear it first.
+    // closeIndex() followed by loadIndex() stands in for a restart.
+    const uintmax_t MAX_CACHE_SIZE = 1000;
+
+    struct LLDiskCacheTest
+    {
+        LLDiskCacheTest()
+        {
+            if (!LLDiskCache::instanceExists())
+            {
+                sCacheDir = gDirUtilp->add(gDirUtilp->getTempDir(), "lldiskcache_test_" + LLUUID::generateNewID().asString());
+                LLDiskCache::initParamSingleton(sCacheDir, MAX_CACHE_SIZE, false);
+            }
+            LLDiskCache::instance().setPackThreshold(0);
+            LLDiskCache::instance().clearCache();
+
+            for (S32 i = 0; i < 3; ++i)
+            {
+                mIDs.push_back(LLUUID::generateNewID());
+            }
+        }
+
+        void writeAsset(const LLUUID& id, S32 size)
+        {
+            std::vector<U8> data(size, (U8)id.mData[0]);
+            LLFileSystem file(id, LLAssetType::AT_NOTECARD, LLFileSystem::WRITE);
+            file.write(&data[0], size);
+        }
+
+        void readAsset(const LLUUID& id)
+        {
+            LLFileSystem file(id, LLAssetType::AT_NOTECARD, LLFileSystem::READ);
+        }
+
+        // Whole asset reads back as written by writeAsset()
+        bool checkAsset(const LLUUID& id, S32 size)
+        {
+            std::vector<U8> data(size + 1, 0);
+            LLFileSystem file(id, LLAssetType::AT_NOTECARD, LLFileSystem::READ);
+            file.read(&data[0], size + 1);
+            return file.getLastBytesRead() == size &&
+                std::count(data.begin(), data.begin() + size, (U8)id.mData[0]) == size;
+        }
+
+        bool fileExists(const LLUUID& id)
+        {
+            return gDirUtilp->fileExists(LLDiskCache::instance().metaDataToFilepath(id.asString(), LLAssetType::AT_NOTECARD, ""));
+        }
+
+        std::string indexFilename()
+        {
+            return gDirUtilp->add(sCacheDir, "index.lldc");
+        }
+
+        // Scribble over the first records of a closed index
+        void corruptIndex()
+        {
+            std::fstream index(indexFilename(), std::ios::binary | std::ios::in | std::ios::out);
+            index.seekp(sizeof(LLDiskCache::IndexHeader));
+            const std::string garbage(4 * sizeof(LLDiskCache::IndexRecord), '\xab');
+            index.write(garbage.data(), garbage.size());
+        }
+
+        std::string readIndex()
+        {
+            std::ifstream in(indexFilename(), std::ios::binary);
+            return std::string(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+        }
+
+        static std::string sCacheDir;
+        std::vector<LLUUID> mIDs;
+    };
+    std::string LLDiskCacheTest::sCacheDir;
+
+    typedef test_group<LLDiskCacheTest> LLDiskCacheTest_t;
+    typedef LLDiskCacheTest_t::object LLDiskCacheTest_object_t;
+    tut::LLDiskCacheTest_t tut_LLDiskCacheTest("LLDiskCache");
+
+    template<> template<>
+    void LLDiskCacheTest_object_t::test<1>()
+        // size accounting follows writes, appends and removes
+    {
+        ensure_equals("empty cache", LLDiskCache::instance().getCacheSizeBytes(), (uintmax_t)0);
+
+        writeAsset(mIDs[0], 100);
+        writeAsset(mIDs[1], 200);
+        ensure_equals("after writes", LLDiskCache::instance().getCacheSizeBytes(), (uintmax_t)300);
+
+        {
+            U8 data[50] = { 0 };
+            LLFileSystem file(mIDs[0], LLAssetType::AT_NOTECARD, LLFileSystem::APPEND);
+            file.write(data, sizeof(data));
+        }
+        ensure_equals("after append", LLDiskCache::instance().getCacheSizeBytes(), (uintmax_t)350);
+
+        LLFileSystem::removeFile(mIDs[1], LLAssetType::AT_NOTECARD);
+        ensure_equals("after remove", LLDiskCache::instance().getCacheSizeBytes(), (uintmax_t)150);
+    }
+
+    template<> template<>
+    void LLDiskCacheTest_object_t::test<2>()
+        // purge evicts the least recently used files first
+    {
+        writeAsset(mIDs[0], 400);
+        writeAsset(mIDs[1], 400);
+        writeAsset(mIDs[2], 400);
+
+        // mIDs[1] is now the least recently used
+        readAsset(mIDs[0]);
+
+        LLDiskCache::instance().purge();
+        ensure_equals("purged size", LLDiskCache::instance().getCacheSizeBytes(), (uintmax_t)800);
+        ensure("recently read kept", LLFileSystem::getExists(mIDs[0], LLAssetType::AT_NOTECARD));
+        ensure("oldest evicted", !LLFileSystem::getExists(mIDs[1], LLAssetType::AT_NOTECARD));
+        ensure("newest kept", LLFileSystem::getExists(mIDs[2], LLAssetType::AT_NOTECARD));
+    }
+
+    template<> template<>
+    void LLDiskCacheTest_object_t::test<3>()
+        // clearCache removes files and index entries
+    {
+        writeAsset(mIDs[0], 100);
+        LLDiskCache::instance().clearCache();
+        ensure_equals("cleared", LLDiskCache::instance().getCacheSizeBytes(), (uintmax_t)0);
+        ensure("file removed", !fileExists(mIDs[0]));
+        ensure("index kept", gDirUtilp->fileExists(indexFilename()));
+    }
+
+    template<> template<>
+    void LLDiskCacheTest_object_t::test<4>()
+        // small assets are packed into segments and behave like files
+    {
+        LLDiskCache::instance().setPackThreshold(256);
+
+        writeAsset(mIDs[0], 100);
+        writeAsset(mIDs[1], 300);
+        ensure_equals("small asset packed", LLDiskCache::instance().getPackedSize(mIDs[0]), 100);
+        ensure("no loose file", !fileExists(mIDs[0]));
+        ensure_equals("large asset not packed", LLDiskCache::instance().getPackedSize(mIDs[1]), -1);
+        ensure("loose file", fileExists(mIDs[1]));
+        ensure_equals("packed size accounted", LLDiskCache::instance().getCacheSizeBytes(), (uintmax_t)400);
+
+        {
+            LLFileSystem file(mIDs[0], LLAssetType::AT_NOTECARD, LLFileSystem::READ);
+            ensure_equals("packed file size", file.getSize(), 100);
+            U8 data[100] = { 0 };
+            ensure("read packed", file.read(data, sizeof(data)));
+            ensure_equals("bytes read", file.getLastBytesRead(), 100);
+            ensure_equals("packed content", data[99], mIDs[0].mData[0]);
+        }
+
+        // Appending moves the asset back to a loose file
+        {
+            U8 data[10] = { 0 };
+            LLFileSystem file(mIDs[0], LLAssetType::AT_NOTECARD, LLFileSystem::APPEND);
+            file.write(data, sizeof(data));
+        }
+        ensure_equals("unpacked", LLDiskCache::instance().getPackedSize(mIDs[0]), -1);
+        ensure_equals("unpacked size", LLFileSystem::getFileSize(mIDs[0], LLAssetType::AT_NOTECARD), 110);
+
+        writeAsset(mIDs[2], 50);
+        LLUUID new_id = LLUUID::generateNewID();
+        LLFileSystem::renameFile(mIDs[2], LLAssetType::AT_NOTECARD, new_id, LLAssetType::AT_NOTECARD);
+        ensure_equals("old id gone", LLDiskCache::instance().getPackedSize(mIDs[2]), -1);
+        ensure_equals("renamed", LLDiskCache::instance().getPackedSize(new_id), 50);
+
+        LLFileSystem::removeFile(new_id, LLAssetType::AT_NOTECARD);
+        ensure("removed", !LLFileSystem::getExists(new_id, LLAssetType::AT_NOTECARD));
+        ensure_equals("size after remove", LLDiskCache::instance().getCacheSizeBytes(), (uintmax_t)410);
+    }
+
+    template<> template<>
+    void LLDiskCacheTest_object_t::test<5>()
+        // the index survives a restart, and a corrupt one is rebuilt
+    {
+        writeAsset(mIDs[0], 300);
+        writeAsset(mIDs[1], 300);
+        writeAsset(mIDs[2], 300);
+
+        LLDiskCache::instance().closeIndex();
+        LLDiskCache::instance().loadIndex();
+        ensure_equals("size after restart", LLDiskCache::instance().getCacheSizeBytes(), (uintmax_t)900);
+        LLFileSystem::removeFile(mIDs[2], LLAssetType::AT_NOTECARD);
+        ensure_equals("entries tracked after restart", LLDiskCache::instance().getCacheSizeBytes(), (uintmax_t)600);
+
+        LLDiskCache::instance().closeIndex();
+        corruptIndex();
+        LLDiskCache::instance().loadIndex();
+        ensure_equals("size after rebuild", LLDiskCache::instance().getCacheSizeBytes(), (uintmax_t)600);
+        LLFileSystem::removeFile(mIDs[0], LLAssetType::AT_NOTECARD);
+        ensure_equals("entries tracked after rebuild", LLDiskCache::instance().getCacheSizeBytes(), (uintmax_t)300);
+    }
+
+    template<> template<>
+    void LLDiskCacheTest_object_t::test<6>()
+        // a second viewer on the same cache leaves the index alone
+    {
+        writeAsset(mIDs[0], 100);
+        LLDiskCache::instance().closeIndex();
+        const std::string before = readIndex();
+
+        {
+            // The other viewer
+            LLMappedFile other;
+            ensure("index locked", other.open(indexFilename(), 0, false, true));
+
+            LLDiskCache::instance().loadIndex();
+            ensure_equals("no index", LLDiskCache::instance().getCacheSizeBytes(), (uintmax_t)0);
+            writeAsset(mIDs[1], 200);
+            ensure("still cached in a file", fileExists(mIDs[1]));
+            LLDiskCache::instance().purge();
+            LLDiskCache::instance().closeIndex();
+            ensure("index untouched", readIndex() == before);
+        }
+
+        LLDiskCache::instance().loadIndex();
+        ensure_equals("index back", LLDiskCache::instance().getCacheSizeBytes(), (uintmax_t)100);
+
+        // And while this one holds it, nobody else gets it
+        LLMappedFile other;
+        ensure("index busy", !other.open(indexFilename(), 0, false, true));
+    }
+
+    template<> template<>
+    void LLDiskCacheTest_object_t::test<7>()
+        // packed assets survive a restart, and are found again by a rebuild
+    {
+        LLDiskCache::instance().setPackThreshold(256);
+        writeAsset(mIDs[0], 100);
+        writeAsset(mIDs[1], 200);
+        LLFileSystem::removeFile(mIDs[1], LLAssetType::AT_NOTECARD);
+        writeAsset(mIDs[2], 300);
+
+        LLDiskCache::instance().closeIndex();
+        LLDiskCache::instance().loadIndex();
+        ensure_equals("packed after restart", LLDiskCache::instance().getPackedSize(mIDs[0]), 100);
+        ensure("content after restart", checkAsset(mIDs[0], 100));
+        ensure_equals("removed after restart", LLDiskCache::instance().getPackedSize(mIDs[1]), -1);
+        ensure_equals("size after restart", LLDiskCache::instance().getCacheSizeBytes(), (uintmax_t)400);
+
+        LLDiskCache::instance().closeIndex();
+        corruptIndex();
+        LLDiskCache::instance().loadIndex();
+        ensure_equals("packed after rebuild", LLDiskCache::instance().getPackedSize(mIDs[0]), 100);
+        ensure("content after rebuild", checkAsset(mIDs[0], 100));
+        ensure_equals("dead record not revived", LLDiskCache::instance().getPackedSize(mIDs[1]), -1);
+        ensure("loose file after rebuild", checkAsset(mIDs[2], 300));
+        ensure_equals("size after rebuild", LLDiskCache::instance().getCacheSizeBytes(), (uintmax_t)400);
+    }
+
+    template<> template<>
+    void LLDiskCacheTest_object_t::test<8>()
+        // a second viewer neither packs nor deletes the segments
+    {
+        LLDiskCache::instance().setPackThreshold(256);
+        writeAsset(mIDs[0], 100);
+        LLDiskCache::instance().closeIndex();
+        const std::string segment = gDirUtilp->add(sCacheDir, "sl_cache_pack_000000.llpk");
+        ensure("segment written", gDirUtilp->fileExists(segment));
+
+        {
+            LLMappedFile other;
+            ensure("index locked", other.open(indexFilename(), 0, false, true));
+
+            LLDiskCache::instance().loadIndex();
+            writeAsset(mIDs[1], 100);
+            ensure_equals("not packed", LLDiskCache::instance().getPackedSize(mIDs[1]), -1);
+            ensure("loose file instead", checkAsset(mIDs[1], 100));
+
+            LLDiskCache::instance().clearCache();
+            ensure("loose file cleared", !fileExists(mIDs[1]));
+            ensure("segment kept", gDirUtilp->fileExists(segment));
+            LLDiskCache::instance().closeIndex();
+        }
+
+        LLDiskCache::instance().loadIndex();
+        ensure_equals("still packed", LLDiskCache::instance().getPackedSize(mIDs[0]), 100);
+        ensure("content kept", checkAsset(mIDs[0], 100));
+    }
+
+    template<> template<>
+    void LLDiskCacheTest_object_t::test<9>()
+        // dead space in a mostly live segment is compacted once it is too much
+    {
+        const std::string dir = gDirUtilp->add(gDirUtilp->getTempDir(), "lldiskcachepack_test_" + LLUUID::generateNewID().asString());
+        LLFile::mkdir(dir);
+        LLDiskCachePack pack(dir, "sl_cache");
+
+        // Three records fill a segment, the fourth starts the next one
+        const U32 size = LLDiskCachePack::SEGMENT_SIZE / 4;
+        const U32 record_size = size + sizeof(LLDiskCachePack::RecordHeader);
+        std::vector<U8> data(size, 1);
+        U32 segment[4], offset[4];
+        for (S32 i = 0; i < 4; ++i)
+        {
+            ensure("appended", pack.append(LLUUID::generateNewID(), LLAssetType::AT_NOTECARD, &data[0], size, segment[i], offset[i]));
+        }
+        ensure_equals("first segment", segment[2], (U32)0);
+        ensure_equals("second segment", segment[3], (U32)1);
+        ensure_equals("unused end of the full segment", pack.getDeadBytes(), (U64)(LLDiskCachePack::SEGMENT_SIZE - 3 * record_size));
+
+        // Still two thirds live: only worth compacting to get under the limit
+        pack.release(segment[0], offset[0]);
+        ensure_equals("dead space", pack.getDeadBytes(), (U64)(LLDiskCachePack::SEGMENT_SIZE - 2 * record_size));
+        ensure("within the limit", pack.getCompactionCandidates(0).empty());
+        const std::vector<U32> candidates = pack.getCompactionCandidates(1);
+        ensure_equals("over the limit", candidates.size(), (size_t)1);
+        ensure_equals("compacted segment", candidates[0], (U32)0);
+
+        pack.dropSegment(0);
+        ensure_equals("dead space reclaimed", pack.getDeadBytes(), (U64)0);
+        pack.closeSegments(true);
+        LLFile::rmdir(dir);
+    }
+}
@@ -30,6 +30,7 @@
 #include "llimage.h"
 
 #include "llmath.h"
+#include "llsimdmath.h"
 #include "v4coloru.h"
 
 #include "llimagebmp.h"
@@ -556,11 +557,377 @@ inline void bilinear_scale(
 	} //else
 }
 
+//..................................................................................
+// SSE2 versions of the scaling, compositing and channel conversion loops.
+// Each does the integer arithmetic of the scalar loop it replaces, so the
+// pixels come out the same; LLImageRaw::setUseSIMD(false) goes back to the
+// scalar loops.
+//..................................................................................
+
+// The channels of one pixel, one per 32 bit lane. last is the last pixel
+// of the source: RGB pixels before it are read with the byte after them,
+// which lands in the fourth lane and is never stored.
+template<U8 ch> inline __m128i sse2_load_pixel(const U8 *pix, const U8 *last);
+
+template<> inline __m128i sse2_load_pixel<3>(const U8 *pix, const U8 *last)
+{
+	const __m128i zero = _mm_setzero_si128();
+	S32 v;
+	if (pix < last)
+	{
+		memcpy(&v, pix, 4);
+	}
+	else
+	{
+		v = pix[0] | (pix[1] << 8) | (pix[2] << 16);
+	}
+	return _mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(v), zero), zero);
+}
+
+template<> inline __m128i sse2_load_pixel<4>(const U8 *pix, const U8 *)
+{
+	const __m128i zero = _mm_setzero_si128();
+	S32 v;
+	memcpy(&v, pix, 4);
+	return _mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(v), zero), zero);
+}
+
+// Low byte of each lane, as the scalar loops' comp[c]&0xff
+template<U8 ch> inline void sse2_store_pixel(U8 *&dptr, __m128i comp)
+{
+	comp = _mm_and_si128(comp, _mm_set1_epi32(0xff));
+	comp = _mm_packus_epi16(_mm_packs_epi32(comp, comp), comp);
+	S32 v = _mm_cvtsi128_si32(comp);
+	memcpy(dptr, &v, ch);
+	dptr += ch;
+}
+
+// pix[c] * val, for the weights of the scaling loops, which are all below
+// 1 << 15: the pixel and the weight each fit in the low half of a lane
+inline __m128i sse2_mul_weight(__m128i pix, S32 val)
+{
+	return _mm_madd_epi16(pix, _mm_set1_epi32(val));
+}
+
+// a[c] * val, low 32 bits, for sums too big for sse2_mul_weight()
+inline __m128i sse2_mul(__m128i a, S32 val)
+{
+	const __m128i b = _mm_set1_epi32(val);
+	__m128i even = _mm_mul_epu32(a, b);
+	__m128i odd = _mm_mul_epu32(_mm_srli_si128(a, 4), b);
+	return _mm_unpacklo_epi32(_mm_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 2, 0)),
+							  _mm_shuffle_epi32(odd, _MM_SHUFFLE(0, 0, 2, 0)));
+}
+
+// Weighted sum of the source pixels one destination pixel spans, along a
+// row (step ch) or a column (step srcStride)
+template<U8 ch> inline __m128i sse2_span_sum(const U8 *&pix, const U8 *last, S32 step, S32 ap, S32 C)
+{
+	__m128i sum = sse2_mul_weight(sse2_load_pixel<ch>(pix, last), ap);
+	pix += step;
+	S32 j;
+	for(j = (1 << 14) - ap; j > C; j -= C)
+	{
+		sum = _mm_add_epi32(sum, sse2_mul_weight(sse2_load_pixel<ch>(pix, last), C));
+		pix += step;
+	}
+	if(j > 0)
+	{
+		sum = _mm_add_epi32(sum, sse2_mul_weight(sse2_load_pixel<ch>(pix, last), j));
+	}
+	return sum;
+}
+
+template<U8 ch>
+inline void bilinear_scale_sse2(
+	const U8 *src, U32 srcW, U32 srcH, U32 srcStride
+	, U8 *dst, U32 dstW, U32 dstH, U32 dstStride
+	)
+{
+	scale_info<ch> info(src, srcW, srcH, dstW, dstH, srcStride);
+	const U8 *last = src + (srcH - 1) * srcStride + (srcW - 1) * ch;
+
+	const U8 *sptr;
+	U8 *dptr;
+	U32 x, y;
+	const U8 *pix;
+	__m128i cx, comp;
+
+	if(3 == info.xup_yup)
+	{ //scale x/y - up
+		for(y = 0; y < dstH; ++y)
+		{
+			dptr = dst + (y * dstStride);
+			sptr = info.ystrides[y];
+			S32 yap = info.yapoints[y];
+
+			if(0 < yap)
+			{
+				for(x = 0; x < dstW; ++x)
+				{
+					S32 xap = info.xapoints[x];
+					pix = sptr + info.xpoints[x] * ch;
+					if(0 < xap)
+					{
+						comp = sse2_mul_weight(sse2_load_pixel<ch>(pix, last), 256 - xap);
+						comp = _mm_add_epi32(comp, sse2_mul_weight(sse2_load_pixel<ch>(pix + ch, last), xap));
+						cx = sse2_mul_weight(sse2_load_pixel<ch>(pix + srcStride + ch, last), xap);
+						cx = _mm_add_epi32(cx, sse2_mul_weight(sse2_load_pixel<ch>(pix + srcStride, last), 256 - xap));
+						comp = _mm_srai_epi32(_mm_add_epi32(sse2_mul(cx, yap), sse2_mul(comp, 256 - yap)), 16);
+					}
+					else
+					{
+						comp = sse2_mul_weight(sse2_load_pixel<ch>(pix, last), 256 - yap);
+						comp = _mm_add_epi32(comp, sse2_mul_weight(sse2_load_pixel<ch>(pix + srcStride, last), yap));
+						comp = _mm_srai_epi32(comp, 8);
+					}
+					sse2_store_pixel<ch>(dptr, comp);
+				}
+			}
+			else
+			{
+				for(x = 0; x < dstW; ++x)
+				{
+					S32 xap = info.xapoints[x];
+					pix = sptr + info.xpoints[x] * ch;
+					if(0 < xap)
+					{
+						// Same pixel twice, as the scalar loop has it
+						comp = sse2_mul_weight(sse2_load_pixel<ch>(pix, last), 256 - xap);
+						comp = _mm_add_epi32(comp, sse2_mul_weight(sse2_load_pixel<ch>(pix, last), xap));
+						sse2_store_pixel<ch>(dptr, _mm_srai_epi32(comp, 8));
+					}
+					else
+					{
+						memcpy(dptr, pix, ch);
+						dptr += ch;
+					}
+				}
+			}
+		}
+	}
+	else if(info.xup_yup == 1)
+	{ //scaling down vertically
+		for(y = 0; y < dstH; y++)
+		{
+			S32 Cy = info.yapoints[y] >> 16;
+			S32 yap = info.yapoints[y] & 0xffff;
+
+			dptr = dst + (y * dstStride);
+
+			for(x = 0; x < dstW; x++)
+			{
+				pix = info.ystrides[y] + info.xpoints[x] * ch;
+				comp = sse2_span_sum<ch>(pix, last, srcStride, yap, Cy);
+
+				S32 xap = info.xapoints[x];
+				if(xap > 0)
+				{
+					pix = info.ystrides[y] + info.xpoints[x] * ch + ch;
+					cx = sse2_span_sum<ch>(pix, last, srcStride, yap, Cy);
+					comp = _mm_srai_epi32(_mm_add_epi32(sse2_mul(comp, 256 - xap), sse2_mul(cx, xap)), 12);
+				}
+				else
+				{
+					comp = _mm_srai_epi32(comp, 4);
+				}
+
+				sse2_store_pixel<ch>(dptr, _mm_srai_epi32(comp, 10));
+			}
+		}
+	}
+	else if(info.xup_yup == 2)
+	{ // scaling down horizontally
+		for(y = 0; y < dstH; y++)
+		{
+			S32 yap = info.yapoints[y];
+
+			dptr = dst + (y * dstStride);
+
+			for(x = 0; x < dstW; x++)
+			{
+				S32 Cx = info.xapoints[x] >> 16;
+				S32 xap = info.xapoints[x] & 0xffff;
+
+				pix = info.ystrides[y] + info.xpoints[x] * ch;
+				comp = sse2_span_sum<ch>(pix, last, ch, xap, Cx);
+
+				if(yap > 0)
+				{
+					pix = info.ystrides[y] + info.xpoints[x] * ch + srcStride;
+					cx = sse2_span_sum<ch>(pix, last, ch, xap, Cx);
+					comp = _mm_srai_epi32(_mm_add_epi32(sse2_mul(comp, 256 - yap), sse2_mul(cx, yap)), 12);
+				}
+				else
+				{
+					comp = _mm_srai_epi32(comp, 4);
+				}
+
+				sse2_store_pixel<ch>(dptr, _mm_srai_epi32(comp, 10));
+			}
+		}
+	}
+	else
+	{ //scale x/y - down
+		for(y = 0; y < dstH; y++)
+		{
+			S32 Cy = info.yapoints[y] >> 16;
+			S32 yap = info.yapoints[y] & 0xffff;
+
+			dptr = dst + (y * dstStride);
+			for(x = 0; x < dstW; x++)
+			{
+				S32 Cx = info.xapoints[x] >> 16;
+				S32 xap = info.xapoints[x] & 0xffff;
+
+				sptr = info.ystrides[y] + info.xpoints[x] * ch;
+				pix = sptr;
+				sptr += srcStride;
+				cx = sse2_span_sum<ch>(pix, last, ch, xap, Cx);
+				comp = sse2_mul(_mm_srai_epi32(cx, 5), yap);
+
+				S32 j;
+				for(j = (1 << 14) - yap; j > Cy; j -= Cy)
+				{
+					pix = sptr;
+					sptr += srcStride;
+					cx = sse2_span_sum<ch>(pix, last, ch, xap, Cx);
+					comp = _mm_add_epi32(comp, sse2_mul(_mm_srai_epi32(cx, 5), Cy));
+				}
+
+				if(j > 0)
+				{
+					pix = sptr;
+					cx = sse2_span_sum<ch>(pix, last, ch, xap, Cx);
+					comp = _mm_add_epi32(comp, sse2_mul(_mm_srai_epi32(cx, 5), j));
+				}
+
+				sse2_store_pixel<ch>(dptr, _mm_srai_epi32(comp, 23));
+			}
+		}
+	}
+}
+
+// Four RGB pixels as four RGBx words (x is 0), and back: first between
+// two pixels to each 64 bit half and three bytes in each, then between
+// each pixel of a pair. Reads and writes only the 12 bytes of the pixels.
+inline __m128i sse2_expand_rgb(const U8 *rgb)
+{
+	S32 tail;
+	memcpy(&tail, rgb + 8, 4);
+	__m128i v = _mm_unpacklo_epi64(_mm_loadl_epi64((const __m128i*)rgb), _mm_cvtsi32_si128(tail));
+	__m128i pairs = _mm_or_si128(_mm_and_si128(v, _mm_set_epi32(0, 0, 0x0000ffff, -1)),
+								 _mm_and_si128(_mm_slli_si128(v, 2), _mm_set_epi32(0x0000ffff, -1, 0, 0)));
+	return _mm_or_si128(_mm_and_si128(pairs, _mm_set_epi32(0, 0x00ffffff, 0, 0x00ffffff)),
+						_mm_and_si128(_mm_slli_epi64(pairs, 8), _mm_set_epi32(0x00ffffff, 0, 0x00ffffff, 0)));
+}
+
+inline void sse2_compact_rgb(__m128i words, U8 *rgb)
+{
+	__m128i pairs = _mm_or_si128(_mm_and_si128(words, _mm_set_epi32(0, 0x00ffffff, 0, 0x00ffffff)),
+								 _mm_and_si128(_mm_srli_epi64(words, 8), _mm_set_epi32(0x0000ffff, (S32)0xff000000, 0x0000ffff, (S32)0xff000000)));
+	__m128i packed = _mm_or_si128(_mm_and_si128(pairs, _mm_set_epi32(0, 0, 0x0000ffff, -1)),
+								  _mm_and_si128(_mm_srli_si128(pairs, 2), _mm_set_epi32(0, -1, (S32)0xffff0000, 0)));
+	_mm_storel_epi64((__m128i*)rgb, packed);
+	S32 tail = _mm_cvtsi128_si32(_mm_srli_si128(packed, 8));
+	memcpy(rgb + 8, &tail, 4);
+}
+
+// The pixels it converts; the caller does the rest with the scalar loop
+static S32 sse2_copy_3onto4(const U8 *src, U8 *dst, S32 pixels)
+{
+	const __m128i opaque = _mm_set1_epi32((S32)0xff000000);
+	S32 i = 0;
+	for(; i + 4 <= pixels; i += 4, src += 12, dst += 16)
+	{
+		_mm_storeu_si128((__m128i*)dst, _mm_or_si128(sse2_expand_rgb(src), opaque));
+	}
+	return i;
+}
+
+static S32 sse2_copy_4onto3(const U8 *src, U8 *dst, S32 pixels)
+{
+	S32 i = 0;
+	for(; i + 4 <= pixels; i += 4, src += 16, dst += 12)
+	{
+		sse2_compact_rgb(_mm_loadu_si128((const __m128i*)src), dst);
+	}
+	return i;
+}
+
+static S32 sse2_copy_alpha_mask(const U8 *src, U8 *dst, S32 pixels, const LLColor4U& fill)
+{
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i rgb = _mm_set1_epi32(fill.mV[0] | (fill.mV[1] << 8) | (fill.mV[2] << 16));
+	S32 i = 0;
+	for(; i + 16 <= pixels; i += 16, src += 16, dst += 64)
+	{
+		__m128i alpha = _mm_loadu_si128((const __m128i*)src);
+		// Each alpha byte moved to the top of its pixel's word
+		__m128i lo = _mm_unpacklo_epi8(zero, alpha);
+		__m128i hi = _mm_unpackhi_epi8(zero, alpha);
+		_mm_storeu_si128((__m128i*)dst, _mm_or_si128(rgb, _mm_unpacklo_epi16(zero, lo)));
+		_mm_storeu_si128((__m128i*)(dst + 16), _mm_or_si128(rgb, _mm_unpackhi_epi16(zero, lo)));
+		_mm_storeu_si128((__m128i*)(dst + 32), _mm_or_si128(rgb, _mm_unpacklo_epi16(zero, hi)));
+		_mm_storeu_si128((__m128i*)(dst + 48), _mm_or_si128(rgb, _mm_unpackhi_epi16(zero, hi)));
+	}
+	return i;
+}
+
+// LLImageRaw::fastFractionalMult() on eight 16 bit lanes
+inline __m128i sse2_fractional_mult(__m128i a, __m128i b)
+{
+	__m128i i = _mm_add_epi16(_mm_mullo_epi16(a, b), _mm_set1_epi16(128));
+	return _mm_srli_epi16(_mm_add_epi16(i, _mm_srli_epi16(i, 8)), 8);
+}
+
+// dst * (255 - alpha) + src * alpha, on two pixels widened to 16 bits.
+// Alphas of 0 and 255 come out as the scalar loop's shortcuts do.
+inline __m128i sse2_blend(__m128i src, __m128i dst)
+{
+	__m128i alpha = _mm_shufflehi_epi16(_mm_shufflelo_epi16(src, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+	__m128i transparency = _mm_sub_epi16(_mm_set1_epi16(255), alpha);
+	__m128i sum = _mm_add_epi16(sse2_fractional_mult(dst, transparency), sse2_fractional_mult(src, alpha));
+	// U8 arithmetic, as in the scalar loop
+	return _mm_and_si128(sum, _mm_set1_epi16(0xff));
+}
+
+static S32 sse2_composite_4onto3(const U8 *src, U8 *dst, S32 pixels)
+{
+	const __m128i zero = _mm_setzero_si128();
+	S32 i = 0;
+	for(; i + 4 <= pixels; i += 4, src += 16, dst += 12)
+	{
+		__m128i d = sse2_expand_rgb(dst);
+		__m128i s = _mm_loadu_si128((const __m128i*)src);
+		__m128i lo = sse2_blend(_mm_unpacklo_epi8(s, zero), _mm_unpacklo_epi8(d, zero));
+		__m128i hi = sse2_blend(_mm_unpackhi_epi8(s, zero), _mm_unpackhi_epi8(d, zero));
+		sse2_compact_rgb(_mm_packus_epi16(lo, hi), dst);
+	}
+	return i;
+}
+
 //wrapper
 static void bilinear_scale(const U8 *src, U32 srcW, U32 srcH, U32 srcCh, U32 srcStride, U8 *dst, U32 dstW, U32 dstH, U32 dstCh, U32 dstStride)
 {
 	llassert(srcCh == dstCh);
 
+	if (LLImageRaw::getUseSIMD())
+	{
+		// One channel leaves most of a register idle; the scalar loop does it
+		switch(srcCh)
+		{
+		case 3:
+			bilinear_scale_sse2<3>(src, srcW, srcH, srcStride, dst, dstW, dstH, dstStride);
+			return;
+		case 4:
+			bilinear_scale_sse2<4>(src, srcW, srcH, srcStride, dst, dstW, dstH, dstStride);
+			return;
+		default:
+			break;
+		}
+	}
+
 	switch(srcCh)
 	{
 	case 1:
@@ -799,6 +1166,7 @@ U8* LLImageBase::allocateDataSize(S32 width, S32 height, S32 ncomponents, S32 si
 //---------------------------------------------------------------------------
 
 S32 LLImageRaw::sRawImageCount = 0;
+bool LLImageRaw::sUseSIMD = true;
 
 LLImageRaw::LLImageRaw()
 	: LLImageBase()
@@ -1180,6 +1548,13 @@ void LLImageRaw::compositeUnscaled4onto3( LLImageRaw* src )
 	U8* src_data = src->getData();
 	U8* dst_data = dst->getData();
 	S32 pixels = getWidth() * getHeight();
+	if (sUseSIMD)
+	{
+		S32 done = sse2_composite_4onto3(src_data, dst_data, pixels);
+		src_data += done * 4;
+		dst_data += done * 3;
+		pixels -= done;
+	}
 	while( pixels-- )
 	{
 		U8 alpha = src_data[3];
@@ -1223,7 +1598,14 @@ void LLImageRaw::copyUnscaledAlphaMask( LLImageRaw* src, const LLColor4U& fill)
 	S32 pixels = getWidth() * getHeight();
 	U8* src_data = src->getData();
 	U8* dst_data = dst->getData();
-	for ( S32 i = 0; i < pixels; i++ )
+	S32 i = 0;
+	if (sUseSIMD)
+	{
+		i = sse2_copy_alpha_mask(src_data, dst_data, pixels, fill);
+		src_data += i;
+		dst_data += i * 4;
+	}
+	for ( ; i < pixels; i++ )
 	{
 		dst_data[0] = fill.mV[0];
 		dst_data[1] = fill.mV[1];
@@ -1377,7 +1759,14 @@ void LLImageRaw::copyUnscaled4onto3( LLImageRaw* src )
 	S32 pixels = getWidth() * getHeight();
 	U8* src_data = src->getData();
 	U8* dst_data = dst->getData();
-	for( S32 i=0; i<pixels; i++ )
+	S32 i = 0;
+	if (sUseSIMD)
+	{
+		i = sse2_copy_4onto3(src_data, dst_data, pixels);
+		src_data += i * 4;
+		dst_data += i * 3;
+	}
+	for( ; i<pixels; i++ )
 	{
 		dst_data[0] = src_data[0];
 		dst_data[1] = src_data[1];
@@ -1399,7 +1788,14 @@ void LLImageRaw::copyUnscaled3onto4( LLImageRaw* src )
 	S32 pixels = getWidth() * getHeight();
 	U8* src_data = src->getData();
 	U8* dst_data = dst->getData();
-	for( S32 i=0; i<pixels; i++ )
+	S32 i = 0;
+	if (sUseSIMD)
+	{
+		i = sse2_copy_3onto4(src_data, dst_data, pixels);
+		src_data += i * 3;
+		dst_data += i * 4;
+	}
+	for( ; i<pixels; i++ )
 	{
 		dst_data[0] = src_data[0];
 		dst_data[1] = src_data[1];
@@ -282,8 +282,15 @@ protected:
 public:
 	static S32 sRawImageCount;
 
+	// Scaling, compositing and channel conversion use SSE2; false runs the
+	// scalar loops, which give the same pixels
+	static void setUseSIMD(bool use_simd)	{ sUseSIMD = use_simd; }
+	static bool getUseSIMD()				{ return sUseSIMD; }
+
 private:
 	bool validateSrcAndDst(std::string func, LLImageRaw* src, LLImageRaw* dst);
+
+	static bool sUseSIMD;
 };
 
 // Compressed representation of image.
@@ -59,8 +59,9 @@ public:
 private:
 	// As of SL-17483, LLImageDecodeThread is no longer itself an
 	// LLQueuedThread - instead this is the API by which we submit work to the
-	// "ImageDecode" ThreadPool.
-	std::unique_ptr<LL::ThreadPool> mThreadPool;
+	// "ImageDecode" ThreadPool. Decode requests come in bursts from the main
+	// thread, so give each decode thread its own deque.
+	std::unique_ptr<LL::WorkStealingThreadPool> mThreadPool;
     LLAtomicU32 mDecodeCount;
 };
 
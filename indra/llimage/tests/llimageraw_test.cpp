@@ -0,0 +1,277 @@
+/**
+ * @file   llimageraw_test.cpp
+ * @brief  Test for LLImageRaw scaling, compositing and channel conversion,
+ *         SSE2 against scalar.
+ *
+ * $LicenseInfo:firstyear=2024&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2024, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+
+#include "../llimage.h"
+
+#include <functional>
+#include <random>
+
+#include "lltimer.h"
+#include "stringize.h"
+#include "v4coloru.h"
+
+#include "../test/lltut.h"
+
+namespace
+{
+	LLPointer<LLImageRaw> make_image(U16 width, U16 height, S8 components, U32 seed)
+	{
+		std::mt19937 random(seed);
+		LLPointer<LLImageRaw> raw = new LLImageRaw(width, height, components);
+		U8* data = raw->getData();
+		for (S32 i = 0; i < raw->getDataSize(); ++i)
+		{
+			data[i] = U8(random());
+		}
+		return raw;
+	}
+
+	// Alphas of 0 and 255 are common in real images, and take shortcuts
+	void make_alpha_edges(LLImageRaw* raw)
+	{
+		U8* data = raw->getData();
+		S32 pixels = raw->getWidth() * raw->getHeight();
+		for (S32 i = 0; i < pixels; ++i)
+		{
+			if (i % 3 == 0)
+			{
+				data[i * 4 + 3] = (i % 2) ? 255 : 0;
+			}
+		}
+	}
+
+	bool same_pixels(const LLImageRaw* a, const LLImageRaw* b)
+	{
+		return a->getWidth() == b->getWidth() && a->getHeight() == b->getHeight()
+			&& a->getComponents() == b->getComponents() && a->getDataSize() == b->getDataSize()
+			&& !memcmp(a->getData(), b->getData(), a->getDataSize());
+	}
+
+	// What op makes of a copy of image, with the scalar loops and with SSE2
+	bool same_both_ways(const LLImageRaw* image, const std::function<LLPointer<LLImageRaw>(LLImageRaw*)>& op)
+	{
+		LLImageRaw::setUseSIMD(false);
+		LLPointer<LLImageRaw> scalar = op(new LLImageRaw(image->getData(), image->getWidth(), image->getHeight(), image->getComponents()));
+		LLImageRaw::setUseSIMD(true);
+		LLPointer<LLImageRaw> simd = op(new LLImageRaw(image->getData(), image->getWidth(), image->getHeight(), image->getComponents()));
+		return same_pixels(scalar, simd);
+	}
+
+	// Seconds per call of op, on one image made once
+	F64 time_op(const std::function<void()>& op, S32 passes)
+	{
+		LLTimer timer;
+		for (S32 pass = 0; pass < passes; ++pass)
+		{
+			op();
+		}
+		return timer.getElapsedTimeF64() / passes;
+	}
+}
+
+namespace tut
+{
+	struct llimageraw_data
+	{
+		llimageraw_data()
+		{
+			LLImage::initClass();
+		}
+
+		~llimageraw_data()
+		{
+			LLImageRaw::setUseSIMD(true);
+			LLImage::cleanupClass();
+		}
+	};
+	typedef test_group<llimageraw_data> llimageraw_test;
+	typedef llimageraw_test::object llimageraw_object;
+	tut::llimageraw_test llimageraw("LLImageRaw");
+
+	template<> template<>
+	void llimageraw_object::test<1>()
+	{
+		set_test_name("scaling up and down, each way, gives the same pixels");
+		// Up and down in both directions, and one of each, with odd sizes
+		const U16 SIZES[][4] = {
+			{ 64, 64, 256, 256 }, { 37, 23, 100, 61 },
+			{ 256, 256, 64, 64 }, { 301, 199, 77, 33 },
+			{ 64, 256, 256, 64 }, { 33, 190, 129, 17 },
+			{ 256, 64, 64, 256 }, { 190, 33, 17, 129 },
+			{ 128, 128, 128, 127 }, { 5, 3, 1024, 7 }, { 1024, 7, 5, 3 } };
+		const S8 COMPONENTS[] = { 1, 3, 4 };
+		for (S8 components : COMPONENTS)
+		{
+			for (const U16* size : SIZES)
+			{
+				std::string name = stringize(S32(components), " components, ", size[0], "x", size[1], " to ",
+											 size[2], "x", size[3]);
+				LLPointer<LLImageRaw> image = make_image(size[0], size[1], components, size[0] + size[1]);
+				S32 width = size[2];
+				S32 height = size[3];
+				ensure(name + " scale", same_both_ways(image, [width, height](LLImageRaw* raw)
+				{
+					raw->scale(width, height);
+					return LLPointer<LLImageRaw>(raw);
+				}));
+				ensure(name + " copyScaled", same_both_ways(image, [width, height](LLImageRaw* raw)
+				{
+					LLPointer<LLImageRaw> dst = new LLImageRaw(width, height, raw->getComponents());
+					dst->copyScaled(raw);
+					return dst;
+				}));
+			}
+		}
+	}
+
+	template<> template<>
+	void llimageraw_object::test<2>()
+	{
+		set_test_name("channel conversion gives the same pixels, whatever is left over");
+		const U16 SIZES[][2] = { { 1, 1 }, { 3, 1 }, { 5, 3 }, { 17, 9 }, { 64, 64 }, { 255, 3 } };
+		for (const U16* size : SIZES)
+		{
+			std::string name = stringize(size[0], "x", size[1]);
+			LLPointer<LLImageRaw> rgb = make_image(size[0], size[1], 3, size[0]);
+			LLPointer<LLImageRaw> rgba = make_image(size[0], size[1], 4, size[1]);
+			LLPointer<LLImageRaw> mask = make_image(size[0], size[1], 1, size[0] * size[1]);
+
+			ensure(name + " 3 onto 4", same_both_ways(rgb, [](LLImageRaw* raw)
+			{
+				LLPointer<LLImageRaw> dst = new LLImageRaw(raw->getWidth(), raw->getHeight(), 4);
+				dst->copyUnscaled3onto4(raw);
+				return dst;
+			}));
+			ensure(name + " 4 onto 3", same_both_ways(rgba, [](LLImageRaw* raw)
+			{
+				LLPointer<LLImageRaw> dst = new LLImageRaw(raw->getWidth(), raw->getHeight(), 3);
+				dst->copyUnscaled4onto3(raw);
+				return dst;
+			}));
+			ensure(name + " alpha mask", same_both_ways(mask, [](LLImageRaw* raw)
+			{
+				LLPointer<LLImageRaw> dst = new LLImageRaw(raw->getWidth(), raw->getHeight(), 4);
+				dst->copyUnscaledAlphaMask(raw, LLColor4U(10, 200, 77, 0));
+				return dst;
+			}));
+			ensure(name + " scaled 3 onto 4", same_both_ways(rgb, [](LLImageRaw* raw)
+			{
+				LLPointer<LLImageRaw> dst = new LLImageRaw(raw->getWidth() * 2 + 1, raw->getHeight() + 3, 4);
+				dst->copyScaled3onto4(raw);
+				return dst;
+			}));
+
+			// Spot checks against the plain definition
+			LLPointer<LLImageRaw> rgba_from_rgb = new LLImageRaw(size[0], size[1], 4);
+			rgba_from_rgb->copyUnscaled3onto4(rgb);
+			S32 last = size[0] * size[1] - 1;
+			ensure_equals(name + " red", rgba_from_rgb->getData()[last * 4], rgb->getData()[last * 3]);
+			ensure_equals(name + " blue", rgba_from_rgb->getData()[last * 4 + 2], rgb->getData()[last * 3 + 2]);
+			ensure_equals(name + " alpha", rgba_from_rgb->getData()[last * 4 + 3], U8(255));
+		}
+	}
+
+	template<> template<>
+	void llimageraw_object::test<3>()
+	{
+		set_test_name("compositing gives the same pixels");
+		const U16 SIZES[][2] = { { 1, 1 }, { 3, 2 }, { 31, 17 }, { 256, 256 } };
+		for (const U16* size : SIZES)
+		{
+			std::string name = stringize(size[0], "x", size[1]);
+			LLPointer<LLImageRaw> src = make_image(size[0], size[1], 4, size[0]);
+			make_alpha_edges(src);
+			LLPointer<LLImageRaw> background = make_image(size[0], size[1], 3, size[1]);
+			ensure(name, same_both_ways(background, [src](LLImageRaw* raw)
+			{
+				raw->compositeUnscaled4onto3(src);
+				return LLPointer<LLImageRaw>(raw);
+			}));
+		}
+
+		// Transparent leaves the background, opaque replaces it
+		LLPointer<LLImageRaw> src = make_image(2, 1, 4, 1);
+		src->getData()[3] = 0;
+		src->getData()[7] = 255;
+		LLPointer<LLImageRaw> dst = make_image(2, 1, 3, 2);
+		LLPointer<LLImageRaw> before = new LLImageRaw(dst->getData(), 2, 1, 3);
+		dst->compositeUnscaled4onto3(src);
+		ensure("transparent", !memcmp(dst->getData(), before->getData(), 3));
+		ensure("opaque", !memcmp(dst->getData() + 3, src->getData() + 4, 3));
+	}
+
+	template<> template<>
+	void llimageraw_object::test<4>()
+	{
+		set_test_name("throughput, scalar and SSE2");
+		// Tests 1 to 3 hold the two paths to the same pixels. Racing them
+		// is for LL_BENCHMARKS runs.
+		if (!benchmarking())
+		{
+			skip("set LL_BENCHMARKS to time scalar against SSE2");
+		}
+		struct Case
+		{
+			std::string mName;
+			LLPointer<LLImageRaw> mSrc;
+			LLPointer<LLImageRaw> mDst;
+			std::function<void(LLImageRaw* src, LLImageRaw* dst)> mOp;
+		};
+		auto copy_scaled = [](LLImageRaw* src, LLImageRaw* dst) { dst->copyScaled(src); };
+		LLPointer<LLImageRaw> composite_src = make_image(1024, 1024, 4, 3);
+		make_alpha_edges(composite_src);
+		Case cases[] = {
+			{ "scale RGBA 1024 to 256", make_image(1024, 1024, 4, 1), new LLImageRaw(256, 256, 4), copy_scaled },
+			{ "scale RGBA 256 to 1024", make_image(256, 256, 4, 1), new LLImageRaw(1024, 1024, 4), copy_scaled },
+			{ "scale RGB 1024 to 512x128", make_image(1024, 1024, 3, 2), new LLImageRaw(512, 128, 3), copy_scaled },
+			{ "scale RGB 512 to 1024x256", make_image(512, 512, 3, 2), new LLImageRaw(1024, 256, 3), copy_scaled },
+			{ "composite RGBA onto RGB 1024", composite_src, new LLImageRaw(1024, 1024, 3),
+			  [](LLImageRaw* src, LLImageRaw* dst) { dst->compositeUnscaled4onto3(src); } },
+			{ "RGB to RGBA 1024", make_image(1024, 1024, 3, 4), new LLImageRaw(1024, 1024, 4),
+			  [](LLImageRaw* src, LLImageRaw* dst) { dst->copyUnscaled3onto4(src); } },
+			{ "RGBA to RGB 1024", make_image(1024, 1024, 4, 5), new LLImageRaw(1024, 1024, 3),
+			  [](LLImageRaw* src, LLImageRaw* dst) { dst->copyUnscaled4onto3(src); } },
+			{ "alpha mask to RGBA 1024", make_image(1024, 1024, 1, 6), new LLImageRaw(1024, 1024, 4),
+			  [](LLImageRaw* src, LLImageRaw* dst) { dst->copyUnscaledAlphaMask(src, LLColor4U::white); } } };
+
+		const S32 PASSES = 10;
+		for (Case& c : cases)
+		{
+			F64 seconds[2];
+			for (S32 simd = 0; simd < 2; ++simd)
+			{
+				LLImageRaw::setUseSIMD(simd != 0);
+				seconds[simd] = time_op([&c]() { c.mOp(c.mSrc, c.mDst); }, PASSES);
+			}
+			F64 mpixels = F64(c.mDst->getWidth() * c.mDst->getHeight()) / 1000000.0;
+			LL_INFOS("Benchmark") << c.mName << ": scalar " << mpixels / seconds[0] << " Mpixel/s, SSE2 "
+								  << mpixels / seconds[1] << " Mpixel/s" << LL_ENDL;
+		}
+	}
+}
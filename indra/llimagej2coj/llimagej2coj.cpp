@@ -27,6 +27,9 @@
 #include "linden_common.h"
 #include "llimagej2coj.h"
 
+#include <atomic>
+#include <thread>
+
 // this is defined so that we get static linking.
 #include "openjpeg.h"
 #include "event.h"
@@ -34,6 +37,88 @@
 
 #define MAX_ENCODED_DISCARD_LEVELS 5
 
+// Images smaller than this, once decoded, are decoded on the calling thread
+// alone: OpenJPEG starts its threads for each image, which costs more than
+// it saves on the small textures that make up most of the decodes.
+static const U32 PARALLEL_DECODE_MIN_PIXELS = 512 * 512;
+// Decoded pixels per OpenJPEG thread, at least
+static const U32 PARALLEL_DECODE_PIXELS_PER_THREAD = 128 * 128;
+
+static std::atomic<S32> sMaxDecodeThreads(4);
+// OpenJPEG threads running for all the images decoding at once. Several
+// "ImageDecode" threads may each be decoding a big image; together they
+// get no more threads than there are cores.
+static std::atomic<S32> sDecodeThreadsInUse(0);
+
+// Threads for decoding one image, taken from what the other images
+// decoding at the same time left over
+class DecodeThreads
+{
+public:
+    DecodeThreads(U32 pixels)
+    :   mCount(0)
+    {
+        if (pixels < PARALLEL_DECODE_MIN_PIXELS)
+        {
+            return;
+        }
+        S32 wanted = llmin(sMaxDecodeThreads.load(), S32(pixels / PARALLEL_DECODE_PIXELS_PER_THREAD));
+        S32 cores = llmax(S32(std::thread::hardware_concurrency()), 1);
+        S32 in_use = sDecodeThreadsInUse.load();
+        do
+        {
+            mCount = llmin(wanted, cores - in_use);
+            if (mCount < 2)
+            {
+                // Not worth starting threads for
+                mCount = 0;
+                return;
+            }
+        }
+        while (!sDecodeThreadsInUse.compare_exchange_weak(in_use, in_use + mCount));
+    }
+
+    ~DecodeThreads()
+    {
+        sDecodeThreadsInUse -= mCount;
+    }
+
+    // 0 for the calling thread alone
+    S32 getCount() const { return mCount; }
+
+private:
+    S32 mCount;
+};
+
+// Size of the main header of a codestream: the SOC marker and the marker
+// segments after it, up to the first tile-part (SOT). 0 if the data ends
+// before the first tile-part or doesn't look like a codestream.
+static U32 main_header_size(const U8* data, U32 size)
+{
+    const U16 SOC = 0xFF4F;
+    const U16 SOT = 0xFF90;
+    if (size < 2 || ((data[0] << 8) | data[1]) != SOC)
+    {
+        return 0;
+    }
+    U32 offset = 2;
+    while (offset + 4 <= size)
+    {
+        U16 marker = U16((data[offset] << 8) | data[offset + 1]);
+        if (marker == SOT)
+        {
+            return offset;
+        }
+        U16 length = U16((data[offset + 2] << 8) | data[offset + 3]);
+        if ((marker & 0xFF00) != 0xFF00 || length < 2)
+        {
+            return 0;
+        }
+        offset += 2 + length;
+    }
+    return 0;
+}
+
 // Factory function: see declaration in llimagej2c.cpp
 LLImageJ2CImpl* fallbackCreateLLImageJ2CImpl()
 {
@@ -333,13 +418,21 @@ public:
         return true;
     }
 
-    bool decode(U8* data, U32 dataSize, U32* channels, U8 discard_level)
+    bool decode(U8* data, U32 dataSize, U32* channels, U8 discard_level, S32 threads = 0)
     {
         parameters.flags &= ~OPJ_DPARAMETERS_DUMP_FLAG;
 
         decoder = opj_create_decompress(OPJ_CODEC_J2K);
         opj_setup_decoder(decoder, &parameters);
 
+        // OpenJPEG spreads the code-blocks and the wavelet transform over
+        // its own threads; has to be set before the header is read. Does
+        // nothing if OpenJPEG was built without thread support.
+        if (threads > 1)
+        {
+            opj_codec_set_threads(decoder, threads);
+        }
+
         opj_set_info_handler(decoder, opj_info, this);
         opj_set_warning_handler(decoder, opj_warn, this);
         opj_set_error_handler(decoder, opj_error, this);
@@ -709,7 +802,11 @@ private:
 
 
 LLImageJ2COJ::LLImageJ2COJ()
-	: LLImageJ2CImpl()
+	: LLImageJ2CImpl(),
+    mHeaderWidth(0),
+    mHeaderHeight(0),
+    mHeaderComponents(0),
+    mHeaderDiscardLevel(0)
 {
 }
 
@@ -731,14 +828,30 @@ bool LLImageJ2COJ::initEncode(LLImageJ2C &base, LLImageRaw &raw_image, int block
 	return false;
 }
 
+//static
+void LLImageJ2COJ::setMaxDecodeThreads(S32 threads)
+{
+    sMaxDecodeThreads = llmax(threads, 1);
+}
+
+//static
+S32 LLImageJ2COJ::getMaxDecodeThreads()
+{
+    return sMaxDecodeThreads;
+}
+
 bool LLImageJ2COJ::decodeImpl(LLImageJ2C &base, LLImageRaw &raw_image, F32 decode_time, S32 first_channel, S32 max_channel_count)
 {
     JPEG2KDecode decoder(0);
 
+    // getMetadata() has the full size; the discard level divides it
+    S32 discard = llclamp(S32(base.mDiscardLevel), 0, MAX_DISCARD_LEVEL);
+    DecodeThreads threads(U32(base.getWidth() >> discard) * U32(base.getHeight() >> discard));
+
     U32 image_channels = 0;
     S32 data_size = base.getDataSize();
     S32 max_bytes = (base.getMaxBytes() ? base.getMaxBytes() : data_size);
-    bool decoded = decoder.decode(base.getData(), max_bytes, &image_channels, base.mDiscardLevel);
+    bool decoded = decoder.decode(base.getData(), max_bytes, &image_channels, base.mDiscardLevel, threads.getCount());
 
     // set correct channel count early so failed decodes don't miss it...
     S32 channels = (S32)image_channels - first_channel;
@@ -820,6 +933,18 @@ bool LLImageJ2COJ::encodeImpl(LLImageJ2C &base, const LLImageRaw &raw_image, con
 
 bool LLImageJ2COJ::getMetadata(LLImageJ2C &base)
 {
+    U32 dataSize = base.getDataSize();
+    U8* data = base.getData();
+
+    // More of the same texture: nothing new to learn from its header
+    if (!mHeader.empty() && dataSize >= mHeader.size() && !memcmp(data, &mHeader[0], mHeader.size()))
+    {
+        base.mDiscardLevel = mHeaderDiscardLevel;
+        base.setSize(mHeaderWidth, mHeaderHeight, mHeaderComponents);
+        return true;
+    }
+    mHeader.clear();
+
     JPEG2KDecode decode(0);
 
     S32 width = 0;
@@ -827,8 +952,6 @@ bool LLImageJ2COJ::getMetadata(LLImageJ2C &base)
     S32 components = 0;
     S32 discard_level = 0;
 
-    U32 dataSize = base.getDataSize();
-    U8* data = base.getData();
     bool header_read = decode.readHeader(data, dataSize, width, height, components, discard_level);
     if (!header_read)
     {
@@ -837,5 +960,15 @@ bool LLImageJ2COJ::getMetadata(LLImageJ2C &base)
 
     base.mDiscardLevel = discard_level;
     base.setSize(width, height, components);
+
+    U32 header_size = main_header_size(data, dataSize);
+    if (header_size)
+    {
+        mHeader.assign(data, data + header_size);
+        mHeaderWidth = width;
+        mHeaderHeight = height;
+        mHeaderComponents = components;
+        mHeaderDiscardLevel = discard_level;
+    }
     return true;
 }
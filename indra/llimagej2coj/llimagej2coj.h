@@ -27,6 +27,8 @@
 #ifndef LL_LLIMAGEJ2COJ_H
 #define LL_LLIMAGEJ2COJ_H
 
+#include <vector>
+
 #include "llimagej2c.h"
 
 class LLImageJ2COJ : public LLImageJ2CImpl
@@ -34,6 +36,12 @@ class LLImageJ2COJ : public LLImageJ2CImpl
 public:
 	LLImageJ2COJ();
 	virtual ~LLImageJ2COJ();
+
+	// Most threads OpenJPEG may use to decode one big image; 1 decodes
+	// every image on the calling thread alone
+	static void setMaxDecodeThreads(S32 threads);
+	static S32 getMaxDecodeThreads();
+
 protected:
 	virtual bool getMetadata(LLImageJ2C &base);
 	virtual bool decodeImpl(LLImageJ2C &base, LLImageRaw &raw_image, F32 decode_time, S32 first_channel, S32 max_channel_count);
@@ -42,6 +50,17 @@ protected:
 	virtual bool initDecode(LLImageJ2C &base, LLImageRaw &raw_image, int discard_level = -1, int* region = NULL);
 	virtual bool initEncode(LLImageJ2C &base, LLImageRaw &raw_image, int blocks_size = -1, int precincts_size = -1, int levels = 0);
     virtual std::string getEngineInfo() const;
+
+private:
+	// The main header of the codestream last given to getMetadata(), and
+	// what it says. A texture being fetched comes back here with more data
+	// at every refinement step; its header stays the same, so it is parsed
+	// only once.
+	std::vector<U8> mHeader;
+	S32 mHeaderWidth;
+	S32 mHeaderHeight;
+	S32 mHeaderComponents;
+	S32 mHeaderDiscardLevel;
 };
 
 #endif
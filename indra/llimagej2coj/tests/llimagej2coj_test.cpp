@@ -0,0 +1,313 @@
+/**
+ * @file   llimagej2coj_test.cpp
+ * @brief  Test for decoding JPEG2000 images with OpenJPEG, on one thread
+ *         and on several, and as more of them arrives.
+ *
+ * $LicenseInfo:firstyear=2024&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2024, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+
+#include "../llimagej2coj.h"
+
+#include <cmath>
+#include <fstream>
+#include <random>
+#include <sstream>
+
+#include <boost/filesystem.hpp>
+
+#include "llimage.h"
+#include "llimagej2c.h"
+#include "lltimer.h"
+#include "stringize.h"
+
+#include "../test/lltut.h"
+
+namespace
+{
+	// Something with the smooth areas, edges and noise of a texture
+	LLPointer<LLImageRaw> make_texture(U16 width, U16 height, S8 components, U32 seed)
+	{
+		std::mt19937 random(seed);
+		LLPointer<LLImageRaw> raw = new LLImageRaw(width, height, components);
+		U8* data = raw->getData();
+		for (S32 y = 0; y < height; ++y)
+		{
+			for (S32 x = 0; x < width; ++x)
+			{
+				bool brick = ((x / 64) + (y / 32)) % 2 && (x % 64) > 2 && (y % 32) > 2;
+				for (S32 c = 0; c < components; ++c)
+				{
+					F32 value = 128.f + 60.f * sinf(F32(x * (c + 1)) / 50.f) * cosf(F32(y) / 70.f);
+					value += brick ? 40.f : -40.f;
+					value += F32(random() % 24) - 12.f;
+					*data++ = (U8)llclamp(S32(value), 0, 255);
+				}
+			}
+		}
+		return raw;
+	}
+
+	LLPointer<LLImageJ2C> encode(const LLImageRaw* raw)
+	{
+		LLPointer<LLImageJ2C> j2c = new LLImageJ2C;
+		tut::ensure("encode", j2c->encode(raw, 0.f));
+		return j2c;
+	}
+
+	// A copy, as LLImageJ2C::validate() keeps the data it is given
+	LLPointer<LLImageJ2C> copy(const LLImageJ2C* j2c)
+	{
+		U8* data = (U8*)ll_aligned_malloc_16(j2c->getDataSize());
+		memcpy(data, j2c->getData(), j2c->getDataSize());
+		LLPointer<LLImageJ2C> result = new LLImageJ2C;
+		tut::ensure("validate", result->validate(data, j2c->getDataSize()));
+		return result;
+	}
+
+	LLPointer<LLImageRaw> decode(LLImageJ2C* j2c, S32 discard_level)
+	{
+		j2c->setDiscardLevel(discard_level);
+		LLPointer<LLImageRaw> raw = new LLImageRaw;
+		j2c->decode(raw, 0.f);
+		return raw;
+	}
+
+	// The first bytes of j2c, the way the texture fetcher has them before
+	// the rest arrives
+	U8* head(const LLImageJ2C* j2c, S32 bytes)
+	{
+		bytes = llmin(bytes, j2c->getDataSize());
+		U8* data = (U8*)ll_aligned_malloc_16(bytes);
+		memcpy(data, j2c->getData(), bytes);
+		return data;
+	}
+
+	bool same_pixels(const LLImageRaw* a, const LLImageRaw* b)
+	{
+		return a->getWidth() == b->getWidth() && a->getHeight() == b->getHeight()
+			&& a->getComponents() == b->getComponents() && a->getDataSize() == b->getDataSize()
+			&& !memcmp(a->getData(), b->getData(), a->getDataSize());
+	}
+}
+
+namespace tut
+{
+	struct llimagej2coj_data
+	{
+		llimagej2coj_data() :
+			mMaxDecodeThreads(LLImageJ2COJ::getMaxDecodeThreads())
+		{
+			LLImage::initClass();
+		}
+
+		~llimagej2coj_data()
+		{
+			LLImageJ2COJ::setMaxDecodeThreads(mMaxDecodeThreads);
+			LLImage::cleanupClass();
+		}
+
+		S32 mMaxDecodeThreads;
+	};
+	typedef test_group<llimagej2coj_data> llimagej2coj_test;
+	typedef llimagej2coj_test::object llimagej2coj_object;
+	tut::llimagej2coj_test llimagej2coj("LLImageJ2COJ");
+
+	template<> template<>
+	void llimagej2coj_object::test<1>()
+	{
+		set_test_name("decoding on several threads gives the same pixels");
+		const S8 COMPONENTS[] = { 1, 3, 4 };
+		for (S8 components : COMPONENTS)
+		{
+			LLPointer<LLImageJ2C> j2c = encode(make_texture(1024, 1024, components, components));
+			for (S32 discard = 0; discard <= 3; ++discard)
+			{
+				std::string name = stringize(S32(components), " components, discard ", discard);
+				LLImageJ2COJ::setMaxDecodeThreads(1);
+				LLPointer<LLImageRaw> single = decode(copy(j2c), discard);
+				LLImageJ2COJ::setMaxDecodeThreads(8);
+				LLPointer<LLImageRaw> several = decode(copy(j2c), discard);
+				ensure_equals(name + " components", S32(single->getComponents()), S32(components));
+				ensure(name, same_pixels(single, several));
+			}
+		}
+	}
+
+	template<> template<>
+	void llimagej2coj_object::test<2>()
+	{
+		set_test_name("time to decode at each discard level, on one thread and on several");
+		// test<1> checks the threaded decode gives the same pixels; this
+		// only times it, for LL_BENCHMARKS. Set LL_J2C_CORPUS to a directory
+		// of .j2c files, such as textures saved from the viewer's cache, to
+		// time those too.
+		const char* corpus = getenv("LL_J2C_CORPUS");
+		if (!(corpus && *corpus) && !benchmarking())
+		{
+			skip("set LL_BENCHMARKS or LL_J2C_CORPUS to time decoding");
+		}
+		std::vector<std::pair<std::string, LLPointer<LLImageJ2C> > > images;
+		const U16 SIZES[] = { 256, 512, 1024, 2048 };
+		for (U16 size : SIZES)
+		{
+			images.push_back(std::make_pair(stringize("synthetic ", size, "x", size),
+											encode(make_texture(size, size, 3, size))));
+		}
+		if (corpus && *corpus)
+		{
+			for (boost::filesystem::directory_iterator it(corpus), end; it != end; ++it)
+			{
+				if (it->path().extension() != ".j2c")
+				{
+					continue;
+				}
+				std::ifstream in(it->path().string().c_str(), std::ios::binary);
+				std::ostringstream contents;
+				contents << in.rdbuf();
+				std::string bytes = contents.str();
+				U8* data = (U8*)ll_aligned_malloc_16((S32)bytes.size());
+				memcpy(data, bytes.data(), bytes.size());
+				LLPointer<LLImageJ2C> j2c = new LLImageJ2C;
+				if (j2c->validate(data, (U32)bytes.size()))
+				{
+					images.push_back(std::make_pair(it->path().filename().string(), j2c));
+				}
+			}
+		}
+
+		const S32 PASSES = 3;
+		for (auto& image : images)
+		{
+			for (S32 discard = 0; discard <= 5; ++discard)
+			{
+				if ((image.second->getWidth() >> discard) < 32 || (image.second->getHeight() >> discard) < 32)
+				{
+					break;
+				}
+				F64 seconds[2] = { 0.0, 0.0 };
+				for (S32 threaded = 0; threaded < 2; ++threaded)
+				{
+					LLImageJ2COJ::setMaxDecodeThreads(threaded ? mMaxDecodeThreads : 1);
+					for (S32 pass = 0; pass < PASSES; ++pass)
+					{
+						LLPointer<LLImageJ2C> j2c = copy(image.second);
+						LLTimer timer;
+						decode(j2c, discard);
+						seconds[threaded] += timer.getElapsedTimeF64();
+					}
+				}
+				LL_INFOS("Benchmark") << image.first << ", " << image.second->getDataSize() / 1024 << " KB, discard "
+									  << discard << ": one thread " << 1000.0 * seconds[0] / PASSES << " ms, up to "
+									  << mMaxDecodeThreads << " threads " << 1000.0 * seconds[1] / PASSES << " ms"
+									  << LL_ENDL;
+			}
+		}
+	}
+
+	template<> template<>
+	void llimagej2coj_object::test<3>()
+	{
+		set_test_name("one image, given more data at each step, decodes like a new one");
+		LLPointer<LLImageJ2C> full = encode(make_texture(1024, 1024, 3, 3));
+		LLPointer<LLImageJ2C> fetched = new LLImageJ2C;
+		for (S32 discard = 5; discard >= 0; --discard)
+		{
+			std::string name = stringize("discard ", discard);
+			S32 bytes = llmin(full->calcDataSize(discard), full->getDataSize());
+			fetched->setData(head(full, bytes), bytes);
+			ensure(name + " update", fetched->updateData());
+			ensure_equals(name + " width", fetched->getWidth(), full->getWidth());
+			ensure_equals(name + " height", fetched->getHeight(), full->getHeight());
+			ensure_equals(name + " components", S32(fetched->getComponents()), 3);
+
+			LLPointer<LLImageJ2C> fresh = new LLImageJ2C;
+			ensure(name + " validate", fresh->validate(head(full, bytes), bytes));
+			ensure(name, same_pixels(decode(fetched, discard), decode(fresh, discard)));
+		}
+
+		// Some other texture in the same image
+		LLPointer<LLImageJ2C> other = encode(make_texture(256, 512, 4, 4));
+		fetched->setData(head(other, other->getDataSize()), other->getDataSize());
+		ensure("other update", fetched->updateData());
+		ensure_equals("other width", fetched->getWidth(), 256);
+		ensure_equals("other height", fetched->getHeight(), 512);
+		ensure_equals("other components", S32(fetched->getComponents()), 4);
+		ensure("other", same_pixels(decode(fetched, 0), decode(copy(other), 0)));
+	}
+
+	template<> template<>
+	void llimagej2coj_object::test<4>()
+	{
+		set_test_name("decode time over a fetch, from discard 5 down to 0");
+		// test<3> checks each step decodes right. This one, for
+		// LL_BENCHMARKS, times the steps, each decoding what has arrived so
+		// far as LLTextureFetchWorker does, against one whole decode.
+		if (!benchmarking())
+		{
+			skip("set LL_BENCHMARKS to time a fetch's decodes");
+		}
+		const U16 SIZES[] = { 512, 1024, 2048 };
+		const S32 PASSES = 3;
+		for (U16 size : SIZES)
+		{
+			LLPointer<LLImageJ2C> full = encode(make_texture(size, size, 3, size));
+			F64 steps[6] = { 0.0, 0.0, 0.0, 0.0, 0.0, 0.0 };
+			F64 headers = 0.0;
+			F64 once = 0.0;
+			for (S32 pass = 0; pass < PASSES; ++pass)
+			{
+				LLPointer<LLImageJ2C> fetched = new LLImageJ2C;
+				for (S32 discard = 5; discard >= 0; --discard)
+				{
+					S32 bytes = llmin(full->calcDataSize(discard), full->getDataSize());
+					fetched->setData(head(full, bytes), bytes);
+					LLTimer timer;
+					fetched->updateData();
+					headers += timer.getElapsedTimeF64();
+					decode(fetched, discard);
+					steps[discard] += timer.getElapsedTimeF64();
+				}
+
+				LLPointer<LLImageJ2C> whole = new LLImageJ2C;
+				whole->setData(head(full, full->getDataSize()), full->getDataSize());
+				LLTimer timer;
+				whole->updateData();
+				decode(whole, 0);
+				once += timer.getElapsedTimeF64();
+			}
+
+			F64 total = 0.0;
+			std::ostringstream per_step;
+			for (S32 discard = 5; discard >= 0; --discard)
+			{
+				total += steps[discard];
+				per_step << " " << discard << ":" << 1000.0 * steps[discard] / PASSES;
+			}
+			LL_INFOS("Benchmark") << size << "x" << size << ", " << full->getDataSize() / 1024
+								  << " KB: steps (ms)" << per_step.str() << ", total " << 1000.0 * total / PASSES
+								  << " ms of which headers " << 1000.0 * headers / PASSES << " ms; once "
+								  << 1000.0 * once / PASSES << " ms" << LL_ENDL;
+		}
+	}
+}
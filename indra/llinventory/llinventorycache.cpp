@@ -0,0 +1,491 @@
+/**
+ * @file llinventorycache.cpp
+ * @brief Chunked, compressed file of inventory LLSD records.
+ *
+ * $LicenseInfo:firstyear=2024&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2024, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+
+#include "llinventorycache.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+
+#ifdef LL_USESYSTEMLIBS
+# include <zlib.h>
+#else
+# include "zlib-ng/zlib.h"
+#endif
+
+#include "hbxxh.h"
+#include "llexception.h"
+#include "llsd.h"
+#include "llsdsaxparser.h"
+#include "llsdserialize.h"
+#include "lluuid.h"
+#include "stringize.h"
+#include "threadpool.h"
+#include "workqueue.h"
+
+namespace
+{
+	// "INVC"
+	const U32 CACHE_MAGIC = 0x43564e49;
+	const U32 CACHE_FORMAT_VERSION = 2;
+
+	// deflate can't shrink data more than about 1032:1, so a chunk that
+	// claims to inflate further is damaged
+	const U64 MAX_INFLATE_RATIO = 1032;
+
+	// Chunks held back before they are compressed together
+	const size_t MAX_PENDING_CHUNKS = 8;
+
+	struct FileHeader
+	{
+		U32 mMagic;
+		U32 mFormatVersion;
+		S32 mCacheVersion;
+		U32 mNumChunks;
+		U32 mNumRecords;
+		// Of the fields above
+		U32 mChecksum;
+	};
+
+	struct ChunkHeader
+	{
+		U32 mCompressedSize;
+		U32 mSize;
+		U32 mNumRecords;
+		// Of the fields above and the compressed data
+		U32 mChecksum;
+	};
+
+	U32 header_checksum(const FileHeader& header)
+	{
+		return (U32)HBXXH64::digest(&header, offsetof(FileHeader, mChecksum));
+	}
+
+	U32 chunk_checksum(const ChunkHeader& header, const void* data)
+	{
+		HBXXH64 hash(&header, offsetof(ChunkHeader, mChecksum), false);
+		hash.update(data, header.mCompressedSize);
+		return (U32)hash.digest();
+	}
+
+	// Runs work(0) to work(count - 1), on the calling thread and on however
+	// many threads of the named queue pick some up, and returns once all
+	// of them are done. The calling thread takes part, so this finishes
+	// even when the queue's threads are all busy or there is no queue.
+	// Returns false if any work threw, which is logged; the rest still runs.
+	bool run_parallel(U32 count, const std::string& queue_name, const std::function<void(U32)>& work)
+	{
+		struct State
+		{
+			State(U32 count, const std::function<void(U32)>& work) :
+				mWork(work),
+				mCount(count),
+				mNext(0),
+				mFinished(0),
+				mFailed(false)
+			{
+			}
+
+			void run()
+			{
+				for (U32 i = mNext++; i < mCount; i = mNext++)
+				{
+					// Whatever happens, i has to count as finished or
+					// the caller waits forever
+					try
+					{
+						mWork(i);
+					}
+					catch (...)
+					{
+						LOG_UNHANDLED_EXCEPTION(stringize("inventory cache work ", i));
+						mFailed = true;
+					}
+					std::lock_guard<std::mutex> lock(mMutex);
+					if (++mFinished == mCount)
+					{
+						mDone.notify_all();
+					}
+				}
+			}
+
+			// A helper that only starts after everything is done never
+			// calls this, so referring to the caller's work is safe
+			const std::function<void(U32)>& mWork;
+			const U32 mCount;
+			std::atomic<U32> mNext;
+			std::mutex mMutex;
+			std::condition_variable mDone;
+			U32 mFinished;
+			std::atomic<bool> mFailed;
+		};
+
+		auto state = std::make_shared<State>(count, work);
+		if (count > 1 && !queue_name.empty())
+		{
+			LL::WorkQueue::ptr_t queue = LL::WorkQueue::getInstance(queue_name);
+			if (queue)
+			{
+				size_t helpers = llmin((size_t)count - 1, LL::ThreadPoolBase::getWidth(queue_name, 1));
+				for (size_t i = 0; i < helpers; ++i)
+				{
+					if (!queue->post([state]() { state->run(); }))
+					{
+						// closed
+						break;
+					}
+				}
+			}
+		}
+		state->run();
+
+		std::unique_lock<std::mutex> lock(state->mMutex);
+		state->mDone.wait(lock, [&state]() { return state->mFinished == state->mCount; });
+		return !state->mFailed;
+	}
+}
+
+//-----------------------------------------------------------------------------
+// LLInventoryCacheWriter
+//-----------------------------------------------------------------------------
+
+LLInventoryCacheWriter::LLInventoryCacheWriter(const std::string& queue_name) :
+	mQueueName(queue_name),
+	mFile(NULL),
+	mCacheVersion(0),
+	mNumChunks(0),
+	mNumRecords(0),
+	mChunkRecords(0)
+{
+}
+
+LLInventoryCacheWriter::~LLInventoryCacheWriter()
+{
+	abort();
+}
+
+bool LLInventoryCacheWriter::open(const std::string& filename, S32 cache_version)
+{
+	abort();
+	mFilename = filename;
+	// Unique, for other instances saving the same cache
+	mTempFilename = filename + "." + LLUUID::generateNewID().asString() + ".tmp";
+	mCacheVersion = cache_version;
+	mNumChunks = 0;
+	mNumRecords = 0;
+	mChunkRecords = 0;
+	mChunk.str(std::string());
+	mPending.clear();
+	mPendingRecords.clear();
+
+	mFile = LLFile::fopen(mTempFilename, "wb");
+	if (!mFile)
+	{
+		LL_WARNS("Inventory") << "Unable to create inventory cache " << mTempFilename << LL_ENDL;
+		return false;
+	}
+
+	// Filled in by close()
+	FileHeader header = {};
+	if (fwrite(&header, sizeof(header), 1, mFile) != 1)
+	{
+		LL_WARNS("Inventory") << "Unable to write inventory cache " << mTempFilename << LL_ENDL;
+		abort();
+		return false;
+	}
+	return true;
+}
+
+bool LLInventoryCacheWriter::add(const LLSD& record)
+{
+	if (!mFile)
+	{
+		return false;
+	}
+
+	LLSDSerialize::toBinary(record, mChunk);
+	++mNumRecords;
+	if (++mChunkRecords == RECORDS_PER_CHUNK)
+	{
+		endChunk();
+		if (mPending.size() == MAX_PENDING_CHUNKS && !writePending())
+		{
+			abort();
+			return false;
+		}
+	}
+	return true;
+}
+
+bool LLInventoryCacheWriter::close()
+{
+	if (!mFile)
+	{
+		return false;
+	}
+
+	endChunk();
+	if (!writePending())
+	{
+		abort();
+		return false;
+	}
+
+	FileHeader header = {};
+	header.mMagic = CACHE_MAGIC;
+	header.mFormatVersion = CACHE_FORMAT_VERSION;
+	header.mCacheVersion = mCacheVersion;
+	header.mNumChunks = mNumChunks;
+	header.mNumRecords = mNumRecords;
+	header.mChecksum = header_checksum(header);
+	bool success = fseek(mFile, 0, SEEK_SET) == 0
+		&& fwrite(&header, sizeof(header), 1, mFile) == 1;
+	success = (fclose(mFile) == 0) && success;
+	mFile = NULL;
+	if (success)
+	{
+		// Windows won't rename over a file
+		LLFile::remove(mFilename, ENOENT);
+		success = LLFile::rename(mTempFilename, mFilename) == 0;
+	}
+	if (!success)
+	{
+		LL_WARNS("Inventory") << "Unable to write inventory cache " << mFilename << LL_ENDL;
+		LLFile::remove(mTempFilename, ENOENT);
+	}
+	return success;
+}
+
+void LLInventoryCacheWriter::endChunk()
+{
+	if (mChunkRecords)
+	{
+		mPending.push_back(mChunk.str());
+		mPendingRecords.push_back(mChunkRecords);
+		mChunk.str(std::string());
+		mChunkRecords = 0;
+	}
+}
+
+bool LLInventoryCacheWriter::writePending()
+{
+	U32 count = (U32)mPending.size();
+	std::vector<std::string> compressed(count);
+	std::atomic<bool> success(true);
+	bool ran = run_parallel(count, mQueueName, [this, &compressed, &success](U32 i)
+	{
+		const std::string& raw = mPending[i];
+		uLongf size = compressBound((uLong)raw.size());
+		compressed[i].resize(size);
+		if (compress2((Bytef*)&compressed[i][0], &size, (const Bytef*)raw.data(), (uLong)raw.size(),
+					  Z_DEFAULT_COMPRESSION) != Z_OK)
+		{
+			success = false;
+		}
+		compressed[i].resize(size);
+	});
+	if (!ran || !success)
+	{
+		LL_WARNS("Inventory") << "Unable to compress inventory cache " << mFilename << LL_ENDL;
+		return false;
+	}
+
+	for (U32 i = 0; i < count; ++i)
+	{
+		ChunkHeader header;
+		header.mCompressedSize = (U32)compressed[i].size();
+		header.mSize = (U32)mPending[i].size();
+		header.mNumRecords = mPendingRecords[i];
+		header.mChecksum = chunk_checksum(header, compressed[i].data());
+		if (fwrite(&header, sizeof(header), 1, mFile) != 1
+			|| fwrite(compressed[i].data(), 1, compressed[i].size(), mFile) != compressed[i].size())
+		{
+			LL_WARNS("Inventory") << "Unable to write inventory cache " << mTempFilename << LL_ENDL;
+			return false;
+		}
+		++mNumChunks;
+	}
+	mPending.clear();
+	mPendingRecords.clear();
+	return true;
+}
+
+void LLInventoryCacheWriter::abort()
+{
+	if (mFile)
+	{
+		fclose(mFile);
+		mFile = NULL;
+		LLFile::remove(mTempFilename, ENOENT);
+	}
+	mPending.clear();
+	mPendingRecords.clear();
+}
+
+//-----------------------------------------------------------------------------
+// LLInventoryCacheReader
+//-----------------------------------------------------------------------------
+
+LLInventoryCacheReader::LLInventoryCacheReader() :
+	mCacheVersion(0),
+	mNumRecords(0)
+{
+}
+
+bool LLInventoryCacheReader::open(const std::string& filename)
+{
+	close();
+	if (!LLFile::isfile(filename) || !mFile.open(filename, 0, true))
+	{
+		return false;
+	}
+
+	const U8* data = mFile.getData();
+	size_t size = mFile.getSize();
+	FileHeader header;
+	if (size < sizeof(header))
+	{
+		LL_WARNS("Inventory") << "Inventory cache " << filename << " is cut short" << LL_ENDL;
+		close();
+		return false;
+	}
+	memcpy(&header, data, sizeof(header));
+	if (header.mMagic != CACHE_MAGIC
+		|| header.mFormatVersion != CACHE_FORMAT_VERSION
+		|| header.mChecksum != header_checksum(header))
+	{
+		LL_WARNS("Inventory") << "Inventory cache " << filename << " is not in a known format" << LL_ENDL;
+		close();
+		return false;
+	}
+
+	// Only the chunk headers are read here; their data is checked when
+	// it is parsed
+	size_t offset = sizeof(header);
+	U32 num_records = 0;
+	mChunks.reserve(header.mNumChunks);
+	for (U32 i = 0; i < header.mNumChunks; ++i)
+	{
+		ChunkHeader chunk_header;
+		if (size - offset < sizeof(chunk_header))
+		{
+			break;
+		}
+		memcpy(&chunk_header, data + offset, sizeof(chunk_header));
+		offset += sizeof(chunk_header);
+		if (size - offset < chunk_header.mCompressedSize)
+		{
+			break;
+		}
+		Chunk chunk;
+		chunk.mData = data + offset;
+		chunk.mCompressedSize = chunk_header.mCompressedSize;
+		chunk.mSize = chunk_header.mSize;
+		chunk.mNumRecords = chunk_header.mNumRecords;
+		chunk.mChecksum = chunk_header.mChecksum;
+		mChunks.push_back(chunk);
+		offset += chunk.mCompressedSize;
+		num_records += chunk.mNumRecords;
+	}
+	if (mChunks.size() != header.mNumChunks || offset != size || num_records != header.mNumRecords)
+	{
+		LL_WARNS("Inventory") << "Inventory cache " << filename << " is cut short" << LL_ENDL;
+		close();
+		return false;
+	}
+
+	mCacheVersion = header.mCacheVersion;
+	mNumRecords = num_records;
+	return true;
+}
+
+void LLInventoryCacheReader::close()
+{
+	mFile.close();
+	mChunks.clear();
+	mCacheVersion = 0;
+	mNumRecords = 0;
+}
+
+bool LLInventoryCacheReader::parse(const record_callback_t& callback, const std::string& queue_name)
+{
+	std::atomic<bool> success(true);
+	bool ran = run_parallel(getNumChunks(), queue_name, [this, &callback, &success](U32 i)
+	{
+		if (!parseChunk(mChunks[i], i, callback))
+		{
+			success = false;
+		}
+	});
+	return ran && success;
+}
+
+bool LLInventoryCacheReader::parseChunk(const Chunk& chunk, U32 index, const record_callback_t& callback) const
+{
+	ChunkHeader header;
+	header.mCompressedSize = chunk.mCompressedSize;
+	header.mSize = chunk.mSize;
+	header.mNumRecords = chunk.mNumRecords;
+	if (chunk_checksum(header, chunk.mData) != chunk.mChecksum
+		|| (U64)chunk.mSize > (U64)chunk.mCompressedSize * MAX_INFLATE_RATIO)
+	{
+		LL_WARNS("Inventory") << "Inventory cache " << mFile.getFilename() << " chunk " << index
+							  << " is damaged" << LL_ENDL;
+		return false;
+	}
+
+	std::vector<char> buffer(chunk.mSize);
+	uLongf size = chunk.mSize;
+	if (chunk.mSize
+		&& (uncompress((Bytef*)buffer.data(), &size, chunk.mData, chunk.mCompressedSize) != Z_OK
+			|| size != chunk.mSize))
+	{
+		LL_WARNS("Inventory") << "Inventory cache " << mFile.getFilename() << " chunk " << index
+							  << " does not inflate" << LL_ENDL;
+		return false;
+	}
+
+	LLSDSAXParser parser;
+	llssize offset = 0;
+	for (U32 i = 0; i < chunk.mNumRecords; ++i)
+	{
+		LLSD record;
+		LLSDSAXBuilder builder(record);
+		if (parser.parseBinary(buffer.data() + offset, (llssize)buffer.size() - offset, builder)
+				== LLSDSAXParser::PARSE_FAILURE
+			|| !builder.isComplete())
+		{
+			LL_WARNS("Inventory") << "Inventory cache " << mFile.getFilename() << " chunk " << index
+								  << " has a bad record" << LL_ENDL;
+			return false;
+		}
+		offset += parser.getBytesParsed();
+		callback(index, record);
+	}
+	return offset == (llssize)buffer.size();
+}
@@ -0,0 +1,167 @@
+/**
+ * @file llinventorycache.h
+ * @brief Chunked, compressed file of inventory LLSD records.
+ *
+ * $LicenseInfo:firstyear=2024&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2024, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#ifndef LL_LLINVENTORYCACHE_H
+#define LL_LLINVENTORYCACHE_H
+
+#include <functional>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "llmappedfile.h"
+
+class LLSD;
+
+/**
+ * @Description: The inventory cache file is a header followed by chunks,
+ * each a deflated run of binary LLSD records with its own header and
+ * checksum. Chunks are independent, so they are compressed and parsed on
+ * the thread pool, several at once, instead of streaming one gzip file
+ * through a single thread.
+ */
+
+/**
+ * @class LLInventoryCacheWriter
+ * @brief Writes records into a new inventory cache file.
+ *
+ * The file is written under a temporary name and renamed over the
+ * destination by close(), so a file that is there is always complete.
+ */
+class LLInventoryCacheWriter
+{
+public:
+	// Records per chunk, the unit of parallel work
+	static const U32 RECORDS_PER_CHUNK = 2048;
+
+	/**
+	 * @param queue_name WorkQueue whose threads help compress chunks;
+	 * without one, the calling thread does it all.
+	 */
+	LLInventoryCacheWriter(const std::string& queue_name = "General");
+	~LLInventoryCacheWriter();
+
+	/**
+	 * @brief Starts the file.
+	 * @param cache_version Version of the records' layout, given back by
+	 * LLInventoryCacheReader::getCacheVersion().
+	 * @return Returns false if the file can't be created.
+	 */
+	bool open(const std::string& filename, S32 cache_version);
+
+	/**
+	 * @brief Adds one record.
+	 * @return Returns false once writing has failed.
+	 */
+	bool add(const LLSD& record);
+
+	/**
+	 * @brief Writes what is left and puts the file in place.
+	 * @return Returns false if any of the file could not be written, in
+	 * which case nothing replaces the destination.
+	 */
+	bool close();
+
+	U32 getNumRecords() const							{ return mNumRecords; }
+
+private:
+	void endChunk();
+	bool writePending();
+	void abort();
+
+	std::string					mQueueName;
+	std::string					mFilename;
+	std::string					mTempFilename;
+	LLFILE*						mFile;
+	S32							mCacheVersion;
+	U32							mNumChunks;
+	U32							mNumRecords;
+	U32							mChunkRecords;
+	std::ostringstream			mChunk;
+	// Whole chunks waiting to be compressed and written, with their record
+	// counts
+	std::vector<std::string>	mPending;
+	std::vector<U32>			mPendingRecords;
+};
+
+/**
+ * @class LLInventoryCacheReader
+ * @brief Reads an inventory cache file written by LLInventoryCacheWriter.
+ */
+class LLInventoryCacheReader
+{
+public:
+	// Receives one record of one chunk
+	typedef std::function<void(U32 chunk, const LLSD& record)> record_callback_t;
+
+	LLInventoryCacheReader();
+
+	/**
+	 * @brief Maps the file and finds its chunks.
+	 * @return Returns false if the file is missing, isn't an inventory
+	 * cache, or is cut short.
+	 */
+	bool open(const std::string& filename);
+	void close();
+
+	S32 getCacheVersion() const							{ return mCacheVersion; }
+	U32 getNumChunks() const							{ return (U32)mChunks.size(); }
+	U32 getNumRecords() const							{ return mNumRecords; }
+
+	/**
+	 * @brief Inflates and parses every chunk, calling back with each record.
+	 *
+	 * Chunks are handed out to the calling thread and to the threads of
+	 * queue_name, if there is such a queue, so the callback runs on several
+	 * threads at once. A chunk's records all go to one thread, in order;
+	 * keeping the results per chunk lets the caller put them back in file
+	 * order afterwards.
+	 *
+	 * @return Returns false if any chunk was damaged, or if parsing one or
+	 * the callback threw. Records of the chunks that were intact have still
+	 * been passed on.
+	 */
+	bool parse(const record_callback_t& callback, const std::string& queue_name = "General");
+
+private:
+	struct Chunk
+	{
+		const U8*	mData;
+		U32			mCompressedSize;
+		U32			mSize;
+		U32			mNumRecords;
+		U32			mChecksum;
+	};
+
+	bool parseChunk(const Chunk& chunk, U32 index, const record_callback_t& callback) const;
+
+	LLMappedFile		mFile;
+	std::vector<Chunk>	mChunks;
+	S32					mCacheVersion;
+	U32					mNumRecords;
+};
+
+#endif // LL_LLINVENTORYCACHE_H
@@ -0,0 +1,357 @@
+/**
+ * @file   llinventorycache_test.cpp
+ * @brief  Test for the chunked inventory cache file.
+ *
+ * $LicenseInfo:firstyear=2024&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2024, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+
+#include "../llinventorycache.h"
+
+#include <atomic>
+#include <fstream>
+#include <stdexcept>
+#include <sstream>
+
+#include "llinventory.h"
+#include "llsd.h"
+#include "llsdserialize.h"
+#include "llsdutil.h"
+#include "llsys.h"
+#include "lltimer.h"
+#include "stringize.h"
+#include "threadpool.h"
+
+#include "../test/lltut.h"
+
+namespace
+{
+	const char* const POOL_NAME = "InventoryCacheTest";
+
+	// A category or an item the way the viewer caches them
+	LLSD make_record(S32 i)
+	{
+		LLUUID owner_id;
+		owner_id.generate();
+		if (i % 10 == 0)
+		{
+			LLPointer<LLInventoryCategory> cat =
+				new LLInventoryCategory(LLUUID::generateNewID(), LLUUID::generateNewID(),
+										LLFolderType::FT_NONE, stringize("Folder ", i));
+			LLSD sd = cat->exportLLSD();
+			sd["version"] = i;
+			return sd;
+		}
+
+		LLPermissions perm;
+		perm.init(LLUUID::generateNewID(), owner_id, owner_id, LLUUID::null);
+		perm.initMasks(PERM_ALL, PERM_ALL, PERM_NONE, PERM_NONE, PERM_MODIFY | PERM_COPY);
+		LLPointer<LLInventoryItem> item =
+			new LLInventoryItem(LLUUID::generateNewID(), LLUUID::generateNewID(), perm, LLUUID::generateNewID(),
+								LLAssetType::AT_NOTECARD, LLInventoryType::IT_NOTECARD, stringize("Item ", i),
+								(i % 3) ? std::string("(No Description)") : stringize("Description of item ", i),
+								LLSaleInfo::DEFAULT, 0, 1600000000 + i);
+		return item->asLLSD();
+	}
+}
+
+namespace tut
+{
+	struct llinventorycache_data
+	{
+		llinventorycache_data() :
+			mPool(POOL_NAME, 3, 1024, false)
+		{
+			mPool.start();
+			mFilename = stringize(LLFile::tmpdir(), "llinventorycache-test-", LLUUID::generateNewID(), ".chunks");
+		}
+
+		~llinventorycache_data()
+		{
+			mPool.close();
+			LLFile::remove(mFilename, ENOENT);
+		}
+
+		void write(const std::vector<LLSD>& records, S32 cache_version = 3)
+		{
+			LLInventoryCacheWriter writer(POOL_NAME);
+			ensure("open for writing", writer.open(mFilename, cache_version));
+			for (const LLSD& record : records)
+			{
+				ensure("add", writer.add(record));
+			}
+			ensure("close", writer.close());
+		}
+
+		// Records of every chunk, in file order; false if any was damaged
+		bool read(LLInventoryCacheReader& reader, std::vector<LLSD>& records)
+		{
+			std::vector<std::vector<LLSD> > chunks(reader.getNumChunks());
+			bool intact = reader.parse([&chunks](U32 chunk, const LLSD& record)
+			{
+				chunks[chunk].push_back(record);
+			}, POOL_NAME);
+			records.clear();
+			for (const std::vector<LLSD>& chunk : chunks)
+			{
+				records.insert(records.end(), chunk.begin(), chunk.end());
+			}
+			return intact;
+		}
+
+		std::string readFile()
+		{
+			std::ifstream in(mFilename.c_str(), std::ios::binary);
+			std::ostringstream contents;
+			contents << in.rdbuf();
+			return contents.str();
+		}
+
+		void writeFile(const std::string& contents)
+		{
+			std::ofstream out(mFilename.c_str(), std::ios::binary | std::ios::trunc);
+			out << contents;
+		}
+
+		LL::ThreadPool mPool;
+		std::string mFilename;
+	};
+	typedef test_group<llinventorycache_data> llinventorycache_test;
+	typedef llinventorycache_test::object llinventorycache_object;
+	tut::llinventorycache_test llinventorycache("LLInventoryCache");
+
+	template<> template<>
+	void llinventorycache_object::test<1>()
+	{
+		set_test_name("records come back in order from several chunks");
+		std::vector<LLSD> records;
+		for (S32 i = 0; i < (S32)LLInventoryCacheWriter::RECORDS_PER_CHUNK * 12 + 7; ++i)
+		{
+			records.push_back(make_record(i));
+		}
+		write(records, 42);
+
+		LLInventoryCacheReader reader;
+		ensure("open", reader.open(mFilename));
+		ensure_equals("cache version", reader.getCacheVersion(), 42);
+		ensure_equals("chunks", reader.getNumChunks(), 13U);
+		ensure_equals("records", reader.getNumRecords(), (U32)records.size());
+
+		std::vector<LLSD> parsed;
+		ensure("parse", read(reader, parsed));
+		ensure_equals("parsed", parsed.size(), records.size());
+		for (size_t i = 0; i < records.size(); ++i)
+		{
+			ensure(stringize("record ", i), llsd_equals(parsed[i], records[i]));
+		}
+	}
+
+	template<> template<>
+	void llinventorycache_object::test<2>()
+	{
+		set_test_name("empty cache, and rewriting one");
+		write(std::vector<LLSD>());
+		LLInventoryCacheReader reader;
+		ensure("open empty", reader.open(mFilename));
+		ensure_equals("no chunks", reader.getNumChunks(), 0U);
+		std::vector<LLSD> parsed;
+		ensure("parse empty", read(reader, parsed));
+		ensure("nothing parsed", parsed.empty());
+		reader.close();
+
+		std::vector<LLSD> records(1, make_record(1));
+		write(records);
+		ensure("open rewritten", reader.open(mFilename));
+		ensure("parse rewritten", read(reader, parsed));
+		ensure_equals("one record", parsed.size(), (size_t)1);
+		ensure("same record", llsd_equals(parsed[0], records[0]));
+	}
+
+	template<> template<>
+	void llinventorycache_object::test<3>()
+	{
+		set_test_name("damaged, cut short and foreign files");
+		std::vector<LLSD> records;
+		for (S32 i = 0; i < (S32)LLInventoryCacheWriter::RECORDS_PER_CHUNK * 3; ++i)
+		{
+			records.push_back(make_record(i));
+		}
+		write(records);
+		std::string contents = readFile();
+		LLInventoryCacheReader reader;
+
+		// A byte changed in the last chunk spoils it; the others still
+		// come through
+		std::string damaged = contents;
+		damaged[damaged.size() - 1] ^= 0x55;
+		writeFile(damaged);
+		ensure("open damaged", reader.open(mFilename));
+		std::vector<LLSD> parsed;
+		ensure("parse damaged", !read(reader, parsed));
+		ensure_equals("intact chunks", parsed.size(), records.size() - LLInventoryCacheWriter::RECORDS_PER_CHUNK);
+		reader.close();
+
+		writeFile(contents.substr(0, contents.size() - 1));
+		ensure("open cut short", !reader.open(mFilename));
+
+		writeFile(contents.substr(0, 10));
+		ensure("open header cut short", !reader.open(mFilename));
+
+		// The cache of older viewers
+		std::ostringstream legacy;
+		legacy << LLSDOStreamer<LLSDNotationFormatter>(records[0]) << std::endl;
+		writeFile(legacy.str());
+		ensure("open notation", !reader.open(mFilename));
+
+		// A header of some other version is not read either
+		std::string other = contents;
+		other[4] ^= 0x01;
+		writeFile(other);
+		ensure("open other version", !reader.open(mFilename));
+
+		LLFile::remove(mFilename);
+		ensure("open missing", !reader.open(mFilename));
+	}
+
+	template<> template<>
+	void llinventorycache_object::test<4>()
+	{
+		set_test_name("time to save and load, against the gzipped notation cache");
+		// Both caches still have to hand back every record. Timing them
+		// takes a full inventory, which only LL_BENCHMARKS builds.
+		const S32 COUNT = benchmarking() ? 100000 : 5000;
+		std::vector<LLSD> records;
+		records.reserve(COUNT);
+		for (S32 i = 0; i < COUNT; ++i)
+		{
+			records.push_back(make_record(i));
+		}
+
+		// What LLInventoryModel did: notation lines, gzipped, then gunzipped
+		// and parsed a line at a time
+		std::string text_filename = mFilename + ".llsd";
+		std::string gzip_filename = mFilename + ".gz";
+		LLTimer timer;
+		{
+			std::ofstream out(text_filename.c_str());
+			for (const LLSD& record : records)
+			{
+				out << LLSDOStreamer<LLSDNotationFormatter>(record) << std::endl;
+			}
+		}
+		ensure("gzip", gzip_file(text_filename, gzip_filename));
+		LLFile::remove(text_filename);
+		F64 legacy_save = timer.getElapsedTimeF64();
+
+		timer.reset();
+		ensure("gunzip", gunzip_file(gzip_filename, text_filename));
+		size_t legacy_count = 0;
+		{
+			std::ifstream in(text_filename.c_str());
+			std::string line;
+			LLPointer<LLSDParser> parser = new LLSDNotationParser();
+			while (std::getline(in, line))
+			{
+				LLSD record;
+				std::istringstream iss(line);
+				if (parser->parse(iss, record, line.length()) != LLSDParser::PARSE_FAILURE)
+				{
+					++legacy_count;
+				}
+			}
+		}
+		LLFile::remove(text_filename);
+		F64 legacy_load = timer.getElapsedTimeF64();
+		ensure_equals("legacy records", legacy_count, records.size());
+
+		timer.reset();
+		write(records);
+		F64 chunked_save = timer.getElapsedTimeF64();
+
+		timer.reset();
+		LLInventoryCacheReader reader;
+		ensure("open", reader.open(mFilename));
+		std::vector<LLSD> parsed;
+		ensure("parse", read(reader, parsed));
+		F64 chunked_load = timer.getElapsedTimeF64();
+		ensure_equals("chunked records", parsed.size(), records.size());
+
+		llstat gzip_stat;
+		llstat chunked_stat;
+		LLFile::stat(gzip_filename, &gzip_stat);
+		LLFile::stat(mFilename, &chunked_stat);
+		LLFile::remove(gzip_filename);
+
+		if (benchmarking())
+		{
+			LL_INFOS("Benchmark") << COUNT << " records, gzipped notation " << gzip_stat.st_size / 1024
+								  << " KB: save " << 1000.0 * legacy_save << " ms, load " << 1000.0 * legacy_load
+								  << " ms" << LL_ENDL;
+			LL_INFOS("Benchmark") << COUNT << " records, chunked " << chunked_stat.st_size / 1024
+								  << " KB, 3 pool threads: save " << 1000.0 * chunked_save << " ms, load "
+								  << 1000.0 * chunked_load << " ms" << LL_ENDL;
+		}
+	}
+
+	template<> template<>
+	void llinventorycache_object::test<5>()
+	{
+		set_test_name("damaged chunk header, and a callback that throws");
+		std::vector<LLSD> records;
+		for (S32 i = 0; i < (S32)LLInventoryCacheWriter::RECORDS_PER_CHUNK * 3; ++i)
+		{
+			records.push_back(make_record(i));
+		}
+		write(records);
+		std::string contents = readFile();
+
+		// The first chunk's header, right after the file header, claims to
+		// inflate to 4 GB
+		const size_t FILE_HEADER_SIZE = 6 * sizeof(U32);
+		std::string damaged = contents;
+		U32 huge = 0xffffffff;
+		memcpy(&damaged[FILE_HEADER_SIZE + sizeof(U32)], &huge, sizeof(huge));
+		writeFile(damaged);
+		LLInventoryCacheReader reader;
+		ensure("open damaged header", reader.open(mFilename));
+		std::vector<LLSD> parsed;
+		ensure("parse damaged header", !read(reader, parsed));
+		ensure_equals("other chunks", parsed.size(), records.size() - LLInventoryCacheWriter::RECORDS_PER_CHUNK);
+		reader.close();
+
+		// Every chunk still counts as done, so parse() returns
+		writeFile(contents);
+		ensure("open", reader.open(mFilename));
+		std::atomic<U32> seen(0);
+		bool intact = reader.parse([&seen](U32 chunk, const LLSD&)
+		{
+			++seen;
+			if (chunk == 1)
+			{
+				throw std::runtime_error("callback failed");
+			}
+		}, POOL_NAME);
+		ensure("parse with throwing callback", !intact);
+		ensure("other chunks parsed", seen >= 2 * LLInventoryCacheWriter::RECORDS_PER_CHUNK);
+	}
+}
@@ -2382,6 +2382,446 @@ bool LLVolumeFace::VertexData::compareNormal(const LLVolumeFace::VertexData& rhs
 	return retval;
 }
 
+// The fields of one face of a mesh LOD block.  Binary fields point into
+// either the LLSD tree or the inflated block they were read from, so they
+// are never copied before being unpacked into the face.
+struct LLVolume::FaceBlock
+{
+	struct Bytes
+	{
+		const U8* mData = nullptr;
+		size_t mSize = 0;
+
+		bool empty() const { return mSize == 0; }
+	};
+
+	FaceBlock()
+	:	mNoGeometry(false),
+		mHasNormalizedScale(false),
+		mHasWeights(false)
+	{}
+
+	void fromLLSD(const LLSD& face);
+
+	bool mNoGeometry;
+	bool mHasNormalizedScale;
+	bool mHasWeights;
+	Bytes mPosition;
+	Bytes mNormal;
+	Bytes mTangent;
+	Bytes mTexCoord;
+	Bytes mTriangleList;
+	Bytes mWeights;
+	LLVector3 mPositionMin;
+	LLVector3 mPositionMax;
+	LLVector3 mNormalizedScale;
+	LLVector2 mTexCoordMin;
+	LLVector2 mTexCoordMax;
+};
+
+namespace
+{
+	LLVolume::FaceBlock::Bytes binary_bytes(const LLSD& sd)
+	{
+		const LLSD::Binary& binary = sd.asBinary();
+		LLVolume::FaceBlock::Bytes bytes;
+		bytes.mData = binary.empty() ? nullptr : &binary[0];
+		bytes.mSize = binary.size();
+		return bytes;
+	}
+
+	// Blobs in an inflated block have no particular alignment
+	inline F32 load_u16(const U8* data)
+	{
+		U16 value;
+		memcpy(&value, data, sizeof(U16));
+		return (F32) value;
+	}
+
+	// Binary LLSD sizes and numbers are big endian
+	inline U32 load_u32_be(const U8* data)
+	{
+		return ((U32) data[0] << 24) | ((U32) data[1] << 16) | ((U32) data[2] << 8) | data[3];
+	}
+
+	/**
+	 * Reads the binary LLSD of a mesh LOD block in place, the way
+	 * LLSDBinaryParser would, but without building an LLSD tree: binary
+	 * values are returned as pointers into the block.
+	 */
+	class LLMeshBlockReader
+	{
+	public:
+		LLMeshBlockReader(const U8* data, size_t size)
+		:	mPos(data),
+			mEnd(data + size)
+		{
+			const char* deprecated_header = "<? LLSD/Binary ?>";
+			constexpr size_t deprecated_header_size = 17;
+			if (size > deprecated_header_size
+				&& memcmp(data, deprecated_header, deprecated_header_size) == 0)
+			{
+				mPos += deprecated_header_size;
+			}
+		}
+
+		// Reads the faces array into blocks, false if it is malformed
+		bool readFaces(std::vector<LLVolume::FaceBlock>& blocks)
+		{
+			U32 count = 0;
+			if (!readType('[') || !readU32(count) || count > remaining())
+			{
+				return false;
+			}
+			blocks.resize(count);
+			for (LLVolume::FaceBlock& block : blocks)
+			{
+				if (!readFace(block))
+				{
+					return false;
+				}
+			}
+			return readType(']');
+		}
+
+	private:
+		static constexpr S32 MAX_DEPTH = 96;
+
+		size_t remaining() const { return mEnd - mPos; }
+
+		bool readType(char type)
+		{
+			if (mPos < mEnd && *mPos == (U8)type)
+			{
+				++mPos;
+				return true;
+			}
+			return false;
+		}
+
+		bool readBytes(size_t size, const U8*& data)
+		{
+			if (size > remaining())
+			{
+				return false;
+			}
+			data = mPos;
+			mPos += size;
+			return true;
+		}
+
+		bool readU32(U32& value)
+		{
+			const U8* data;
+			if (!readBytes(sizeof(U32), data))
+			{
+				return false;
+			}
+			value = load_u32_be(data);
+			return true;
+		}
+
+		// 'k' keys, or quoted ones with no escapes
+		bool readKey(const U8*& key, U32& size)
+		{
+			if (readType('k'))
+			{
+				return readU32(size) && readBytes(size, key);
+			}
+			const U8* start = mPos;
+			if (!readQuoted())
+			{
+				return false;
+			}
+			key = start + 1;
+			size = (U32)(mPos - start - 2);
+			return true;
+		}
+
+		bool readQuoted()
+		{
+			if (mPos >= mEnd || (*mPos != '\'' && *mPos != '"'))
+			{
+				return false;
+			}
+			U8 delim = *mPos++;
+			while (mPos < mEnd)
+			{
+				U8 c = *mPos++;
+				if (c == delim)
+				{
+					return true;
+				}
+				if (c == '\\')
+				{
+					++mPos;
+				}
+			}
+			return false;
+		}
+
+		bool readBinary(LLVolume::FaceBlock::Bytes& bytes)
+		{
+			U32 size = 0;
+			if (!readType('b') || !readU32(size))
+			{
+				return false;
+			}
+			bytes.mSize = size;
+			return readBytes(size, bytes.mData);
+		}
+
+		// Reads a real or an integer, anything else reads as 0 like LLSD::asReal()
+		bool readReal(F32& value)
+		{
+			const U8* data;
+			if (readType('r'))
+			{
+				if (!readBytes(sizeof(F64), data))
+				{
+					return false;
+				}
+				U64 bits = ((U64) load_u32_be(data) << 32) | load_u32_be(data + 4);
+				F64 real;
+				memcpy(&real, &bits, sizeof(F64));
+				value = (F32) real;
+				return true;
+			}
+			if (readType('i'))
+			{
+				U32 integer = 0;
+				if (!readU32(integer))
+				{
+					return false;
+				}
+				value = (F32)(S32) integer;
+				return true;
+			}
+			value = 0.f;
+			return skipValue(MAX_DEPTH);
+		}
+
+		// An array of reals, as read by LLVector3::setValue() and friends
+		bool readVector(F32* values, U32 size)
+		{
+			U32 count = 0;
+			if (!readType('[') || !readU32(count))
+			{
+				return false;
+			}
+			for (U32 i = 0; i < count; ++i)
+			{
+				F32 ignored;
+				if (!readReal(i < size ? values[i] : ignored))
+				{
+					return false;
+				}
+			}
+			return readType(']');
+		}
+
+		// A { "Min": [...], "Max": [...] } domain map
+		bool readDomain(F32* min, F32* max, U32 size)
+		{
+			U32 count = 0;
+			if (!readType('{') || !readU32(count))
+			{
+				return false;
+			}
+			for (U32 i = 0; i < count; ++i)
+			{
+				const U8* key;
+				U32 key_size;
+				if (!readKey(key, key_size))
+				{
+					return false;
+				}
+				bool ok;
+				if (keyIs(key, key_size, "Min"))
+				{
+					ok = readVector(min, size);
+				}
+				else if (keyIs(key, key_size, "Max"))
+				{
+					ok = readVector(max, size);
+				}
+				else
+				{
+					ok = skipValue(MAX_DEPTH);
+				}
+				if (!ok)
+				{
+					return false;
+				}
+			}
+			return readType('}');
+		}
+
+		bool readFace(LLVolume::FaceBlock& block)
+		{
+			U32 count = 0;
+			if (!readType('{') || !readU32(count))
+			{
+				return false;
+			}
+			for (U32 i = 0; i < count; ++i)
+			{
+				const U8* key;
+				U32 key_size;
+				if (!readKey(key, key_size))
+				{
+					return false;
+				}
+
+				bool ok;
+				if (keyIs(key, key_size, "Position"))
+				{
+					ok = readBinary(block.mPosition);
+				}
+				else if (keyIs(key, key_size, "Normal"))
+				{
+					ok = readBinary(block.mNormal);
+				}
+				else if (keyIs(key, key_size, "Tangent"))
+				{
+					ok = readBinary(block.mTangent);
+				}
+				else if (keyIs(key, key_size, "TexCoord0"))
+				{
+					ok = readBinary(block.mTexCoord);
+				}
+				else if (keyIs(key, key_size, "TriangleList"))
+				{
+					ok = readBinary(block.mTriangleList);
+				}
+				else if (keyIs(key, key_size, "Weights"))
+				{
+					block.mHasWeights = true;
+					ok = readBinary(block.mWeights);
+				}
+				else if (keyIs(key, key_size, "PositionDomain"))
+				{
+					ok = readDomain(block.mPositionMin.mV, block.mPositionMax.mV, 3);
+				}
+				else if (keyIs(key, key_size, "TexCoord0Domain"))
+				{
+					ok = readDomain(block.mTexCoordMin.mV, block.mTexCoordMax.mV, 2);
+				}
+				else if (keyIs(key, key_size, "NormalizedScale"))
+				{
+					block.mHasNormalizedScale = true;
+					ok = readVector(block.mNormalizedScale.mV, 3);
+				}
+				else
+				{
+					block.mNoGeometry |= keyIs(key, key_size, "NoGeometry");
+					ok = skipValue(MAX_DEPTH);
+				}
+
+				if (!ok)
+				{
+					return false;
+				}
+			}
+			return readType('}');
+		}
+
+		bool skipValue(S32 depth)
+		{
+			if (mPos >= mEnd || depth <= 0)
+			{
+				return false;
+			}
+
+			const U8* data;
+			U32 count = 0;
+			switch (*mPos++)
+			{
+			case '!':
+			case '0':
+			case '1':
+				return true;
+			case 'i':
+				return readBytes(sizeof(S32), data);
+			case 'r':
+			case 'd':
+				return readBytes(sizeof(F64), data);
+			case 'u':
+				return readBytes(UUID_BYTES, data);
+			case 's':
+			case 'l':
+			case 'b':
+				return readU32(count) && readBytes(count, data);
+			case '\'':
+			case '"':
+				--mPos;
+				return readQuoted();
+			case '[':
+				if (!readU32(count))
+				{
+					return false;
+				}
+				for (U32 i = 0; i < count; ++i)
+				{
+					if (!skipValue(depth - 1))
+					{
+						return false;
+					}
+				}
+				return readType(']');
+			case '{':
+				if (!readU32(count))
+				{
+					return false;
+				}
+				for (U32 i = 0; i < count; ++i)
+				{
+					const U8* key;
+					U32 key_size;
+					if (!readKey(key, key_size) || !skipValue(depth - 1))
+					{
+						return false;
+					}
+				}
+				return readType('}');
+			default:
+				return false;
+			}
+		}
+
+		static bool keyIs(const U8* key, U32 size, const char* name)
+		{
+			return strlen(name) == size && memcmp(key, name, size) == 0;
+		}
+
+		const U8* mPos;
+		const U8* mEnd;
+	};
+}
+
+void LLVolume::FaceBlock::fromLLSD(const LLSD& face)
+{
+	mNoGeometry = face.has("NoGeometry");
+	mPosition = binary_bytes(face["Position"]);
+	mNormal = binary_bytes(face["Normal"]);
+	mTangent = binary_bytes(face["Tangent"]);
+	mTexCoord = binary_bytes(face["TexCoord0"]);
+	mTriangleList = binary_bytes(face["TriangleList"]);
+	mHasWeights = face.has("Weights");
+	mWeights = binary_bytes(face["Weights"]);
+
+	mPositionMin.setValue(face["PositionDomain"]["Min"]);
+	mPositionMax.setValue(face["PositionDomain"]["Max"]);
+	mTexCoordMin.setValue(face["TexCoord0Domain"]["Min"]);
+	mTexCoordMax.setValue(face["TexCoord0Domain"]["Max"]);
+
+	mHasNormalizedScale = face.has("NormalizedScale");
+	if (mHasNormalizedScale)
+	{
+		mNormalizedScale.setValue(face["NormalizedScale"]);
+	}
+}
+
 bool LLVolume::unpackVolumeFaces(std::istream& is, S32 size)
 {
 	LL_PROFILE_ZONE_SCOPED_CATEGORY_VOLUME
@@ -2400,22 +2840,61 @@ bool LLVolume::unpackVolumeFaces(std::istream& is, S32 size)
 
 bool LLVolume::unpackVolumeFaces(U8* in_data, S32 size)
 {
-	//input data is now pointing at a zlib compressed block of LLSD
-	//decompress block
-	LLSD mdl;
-	U32 uzip_result = LLUZipHelper::unzip_llsd(mdl, in_data, size);
+	LLUZipHelper::Segment segment = { in_data, (size_t)size };
+	return unpackVolumeFaces(&segment, 1);
+}
+
+bool LLVolume::unpackVolumeFaces(const LLUZipHelper::Segment* segments, size_t count)
+{
+	LL_PROFILE_ZONE_SCOPED_CATEGORY_VOLUME
+
+	// Each decode thread keeps its inflate buffer, the faces are unpacked
+	// from it before the next block comes along
+	static thread_local std::vector<U8> inflated;
+	constexpr size_t MAX_KEPT_INFLATE_BUFFER = 8 * 1024 * 1024;
+
+	//input data is a zlib compressed block of binary LLSD,
+	//possibly split across several buffers
+	U32 uzip_result = LLUZipHelper::unzip(inflated, segments, count);
 	if (uzip_result != LLUZipHelper::ZR_OK)
 	{
 		LL_DEBUGS("MeshStreaming") << "Failed to unzip LLSD blob for LoD with code " << uzip_result << " , will probably fetch from sim again." << LL_ENDL;
 		return false;
 	}
-	return unpackVolumeFacesInternal(mdl);
+
+	std::vector<FaceBlock> blocks;
+	bool parsed = LLMeshBlockReader(inflated.data(), inflated.size()).readFaces(blocks);
+	bool success = false;
+	if (parsed)
+	{
+		success = unpackVolumeFaceBlocks(blocks);
+	}
+	else
+	{
+		LL_DEBUGS("MeshStreaming") << "Failed to parse LLSD blob for LoD, will probably fetch from sim again." << LL_ENDL;
+	}
+
+	if (inflated.capacity() > MAX_KEPT_INFLATE_BUFFER)
+	{
+		std::vector<U8>().swap(inflated);
+	}
+	return success;
 }
 
 bool LLVolume::unpackVolumeFacesInternal(const LLSD& mdl)
+{
+	std::vector<FaceBlock> blocks(mdl.size());
+	for (size_t i = 0; i < blocks.size(); ++i)
+	{
+		blocks[i].fromLLSD(mdl[i]);
+	}
+	return unpackVolumeFaceBlocks(blocks);
+}
+
+bool LLVolume::unpackVolumeFaceBlocks(const std::vector<FaceBlock>& blocks)
 {
 	{
-		U32 face_count = mdl.size();
+		U32 face_count = blocks.size();
 
 		if (face_count == 0)
 		{ //no faces unpacked, treat as failed decode
@@ -2428,8 +2907,9 @@ bool LLVolume::unpackVolumeFacesInternal(const LLSD& mdl)
 		for (size_t i = 0; i < face_count; ++i)
 		{
 			LLVolumeFace& face = mVolumeFaces[i];
+			const FaceBlock& block = blocks[i];
 
-			if (mdl[i].has("NoGeometry"))
+			if (block.mNoGeometry)
 			{ //face has no geometry, continue
 				face.resizeIndices(3);
 				face.resizeVertices(1);
@@ -2440,14 +2920,14 @@ bool LLVolume::unpackVolumeFacesInternal(const LLSD& mdl)
 				continue;
 			}
 
-			LLSD::Binary pos = mdl[i]["Position"];
-			LLSD::Binary norm = mdl[i]["Normal"];
-            LLSD::Binary tangent = mdl[i]["Tangent"];
-			LLSD::Binary tc = mdl[i]["TexCoord0"];
-			LLSD::Binary idx = mdl[i]["TriangleList"];
+			const FaceBlock::Bytes& pos = block.mPosition;
+			const FaceBlock::Bytes& norm = block.mNormal;
+            const FaceBlock::Bytes& tangent = block.mTangent;
+			const FaceBlock::Bytes& tc = block.mTexCoord;
+			const FaceBlock::Bytes& idx = block.mTriangleList;
 
 			//copy out indices
-            S32 num_indices = idx.size() / 2;
+            S32 num_indices = idx.mSize / 2;
             const S32 indices_to_discard = num_indices % 3;
             if (indices_to_discard > 0)
             {
@@ -2469,14 +2949,10 @@ bool LLVolume::unpackVolumeFacesInternal(const LLSD& mdl)
 				continue;
 			}
 
-			U16* indices = (U16*) &(idx[0]);
-            for (U32 j = 0; j < num_indices; ++j)
-			{
-				face.mIndices[j] = indices[j];
-			}
+			memcpy(face.mIndices, idx.mData, num_indices * sizeof(U16));
 
 			//copy out vertices
-			U32 num_verts = pos.size()/(3*2);
+			U32 num_verts = pos.mSize/(3*2);
 			face.resizeVertices(num_verts);
 
             if (num_verts > 0 && !face.mPositions)
@@ -2486,24 +2962,17 @@ bool LLVolume::unpackVolumeFacesInternal(const LLSD& mdl)
                 continue;
             }
 
-			LLVector3 minp;
-			LLVector3 maxp;
-			LLVector2 min_tc; 
-			LLVector2 max_tc; 
-		
-			minp.setValue(mdl[i]["PositionDomain"]["Min"]);
-			maxp.setValue(mdl[i]["PositionDomain"]["Max"]);
 			LLVector4a min_pos, max_pos;
-			min_pos.load3(minp.mV);
-			max_pos.load3(maxp.mV);
+			min_pos.load3(block.mPositionMin.mV);
+			max_pos.load3(block.mPositionMax.mV);
 
-			min_tc.setValue(mdl[i]["TexCoord0Domain"]["Min"]);
-			max_tc.setValue(mdl[i]["TexCoord0Domain"]["Max"]);
+			const LLVector2& min_tc = block.mTexCoordMin;
+			const LLVector2& max_tc = block.mTexCoordMax;
 
             //unpack normalized scale/translation
-            if (mdl[i].has("NormalizedScale"))
+            if (block.mHasNormalizedScale)
             {
-                face.mNormalizedScale.setValue(mdl[i]["NormalizedScale"]);
+                face.mNormalizedScale = block.mNormalizedScale;
             }
             else
             {
@@ -2523,31 +2992,31 @@ bool LLVolume::unpackVolumeFacesInternal(const LLSD& mdl)
 			LLVector4a* tc_out = (LLVector4a*) face.mTexCoords;
 
 			{
-				U16* v = (U16*) &(pos[0]);
+				const U8* v = pos.mData;
 				for (U32 j = 0; j < num_verts; ++j)
 				{
-					pos_out->set((F32) v[0], (F32) v[1], (F32) v[2]);
+					pos_out->set(load_u16(v), load_u16(v + 2), load_u16(v + 4));
 					pos_out->div(65535.f);
 					pos_out->mul(pos_range);
 					pos_out->add(min_pos);
 					pos_out++;
-					v += 3;
+					v += 6;
 				}
 
 			}
 
 			{
-				if (!norm.empty())
+				if (norm.mSize >= num_verts * 6)
 				{
-					U16* n = (U16*) &(norm[0]);
+					const U8* n = norm.mData;
 					for (U32 j = 0; j < num_verts; ++j)
 					{
-						norm_out->set((F32) n[0], (F32) n[1], (F32) n[2]);
+						norm_out->set(load_u16(n), load_u16(n + 2), load_u16(n + 4));
 						norm_out->div(65535.f);
 						norm_out->mul(2.f);
 						norm_out->sub(1.f);
 						norm_out++;
-						n += 3;
+						n += 6;
 					}
 				}
 				else
@@ -2565,7 +3034,7 @@ bool LLVolume::unpackVolumeFacesInternal(const LLSD& mdl)
                 if (!tangent.empty())
                 {
                     face.allocateTangents(face.mNumVertices);
-                    U16* t = (U16*)&(tangent[0]);
+                    const U8* t = tangent.mData;
 
                     // NOTE: tangents coming from the asset may not be mikkt space, but they should always be used by the GLTF shaders to 
                     // maintain compliance with the GLTF spec
@@ -2573,7 +3042,7 @@ bool LLVolume::unpackVolumeFacesInternal(const LLSD& mdl)
 
                     for (U32 j = 0; j < num_verts; ++j)
                     {
-                        t_out->set((F32)t[0], (F32)t[1], (F32)t[2], (F32) t[3]);
+                        t_out->set(load_u16(t), load_u16(t + 2), load_u16(t + 4), load_u16(t + 6));
                         t_out->div(65535.f);
                         t_out->mul(2.f);
                         t_out->sub(1.f);
@@ -2582,28 +3051,30 @@ bool LLVolume::unpackVolumeFacesInternal(const LLSD& mdl)
                         tp[3] = tp[3] < 0.f ? -1.f : 1.f;
 
                         t_out++;
-                        t += 4;
+                        t += 8;
                     }
                 }
             }
+#else
+            (void) tangent;
 #endif
 
 			{
-				if (!tc.empty())
+				if (tc.mSize >= num_verts * 4)
 				{
-					U16* t = (U16*) &(tc[0]);
+					const U8* t = tc.mData;
 					for (U32 j = 0; j < num_verts; j+=2)
 					{
 						if (j < num_verts-1)
 						{
-							tc_out->set((F32) t[0], (F32) t[1], (F32) t[2], (F32) t[3]);
+							tc_out->set(load_u16(t), load_u16(t + 2), load_u16(t + 4), load_u16(t + 6));
 						}
 						else
 						{
-							tc_out->set((F32) t[0], (F32) t[1], 0.f, 0.f);
+							tc_out->set(load_u16(t), load_u16(t + 2), 0.f, 0.f);
 						}
 
-						t += 4;
+						t += 8;
 
 						tc_out->div(65535.f);
 						tc_out->mul(tc_range);
@@ -2622,7 +3093,7 @@ bool LLVolume::unpackVolumeFacesInternal(const LLSD& mdl)
 				}
 			}
 
-			if (mdl[i].has("Weights"))
+			if (block.mHasWeights)
 			{
 				face.allocateWeights(num_verts);
                 if (!face.mWeights && num_verts)
@@ -2633,12 +3104,13 @@ bool LLVolume::unpackVolumeFacesInternal(const LLSD& mdl)
                     continue;
                 }
 
-				LLSD::Binary weights = mdl[i]["Weights"];
+				const U8* weights = block.mWeights.mData;
+				const U32 weights_size = block.mWeights.mSize;
 
 				U32 idx = 0;
 
 				U32 cur_vertex = 0;
-				while (idx < weights.size() && cur_vertex < num_verts)
+				while (idx < weights_size && cur_vertex < num_verts)
 				{
 					const U8 END_INFLUENCES = 0xFF;
 					U8 joint = weights[idx++];
@@ -2648,7 +3120,7 @@ bool LLVolume::unpackVolumeFacesInternal(const LLSD& mdl)
                     U32 joints[4] = {0,0,0,0};
 					LLVector4 joints_with_weights(0,0,0,0);
 
-					while (joint != END_INFLUENCES && idx < weights.size())
+					while (joint != END_INFLUENCES && idx + 1 < weights_size)
 					{
 						U16 influence = weights[idx++];
 						influence |= ((U16) weights[idx++] << 8);
@@ -2658,7 +3130,7 @@ bool LLVolume::unpackVolumeFacesInternal(const LLSD& mdl)
 						joints[cur_influence] = joint;
 						cur_influence++;
 
-						if (cur_influence >= 4)
+						if (cur_influence >= 4 || idx >= weights_size)
 						{
 							joint = END_INFLUENCES;
 						}
@@ -2685,7 +3157,7 @@ bool LLVolume::unpackVolumeFacesInternal(const LLSD& mdl)
 					cur_vertex++;
 				}
 
-				if (cur_vertex != num_verts || idx != weights.size())
+				if (cur_vertex != num_verts || idx != weights_size)
 				{
 					LL_WARNS() << "Vertex weight count does not match vertex count!" << LL_ENDL;
 				}
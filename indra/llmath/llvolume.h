@@ -59,6 +59,7 @@ class LLVolumeTriangle;
 #include "llfile.h"
 #include "llalignedarray.h"
 #include "llrigginginfo.h"
+#include "llsdserialize.h"
 
 //============================================================================
 
@@ -1105,10 +1106,17 @@ protected:
 	BOOL generate();
 	void createVolumeFaces();
 public:
+	// Decodes a compressed mesh LOD block.  The istream version goes
+	// through an LLSD tree, the others unpack the faces straight from the
+	// inflated block.
 	bool unpackVolumeFaces(std::istream& is, S32 size);
 	bool unpackVolumeFaces(U8* in_data, S32 size);
+	bool unpackVolumeFaces(const LLUZipHelper::Segment* segments, size_t count);
+
+	struct FaceBlock;
 private:
 	bool unpackVolumeFacesInternal(const LLSD& mdl);
+	bool unpackVolumeFaceBlocks(const std::vector<FaceBlock>& blocks);
 
 public:
 	virtual void setMeshAssetLoaded(bool loaded);
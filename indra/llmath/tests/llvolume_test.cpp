@@ -0,0 +1,273 @@
+/**
+ * @file   llvolume_test.cpp
+ * @brief  Tests for unpacking mesh LOD blocks into LLVolume faces.
+ *
+ * $LicenseInfo:firstyear=2024&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2024, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+// Precompiled header
+#include "linden_common.h"
+// associated header
+#include "../llvolume.h"
+// STL headers
+#include <random>
+#include <sstream>
+// other Linden headers
+#include "llsdserialize.h"
+#include "../test/countallocs.h"
+#include "../test/lltut.h"
+
+#ifdef LL_USESYSTEMLIBS
+# include <zlib.h>
+#else
+# include "zlib-ng/zlib.h"
+#endif
+
+namespace
+{
+    LLSD::Binary randomU16s(std::mt19937& rng, size_t count, U16 limit = 0xFFFF)
+    {
+        std::uniform_int_distribution<U32> dist(0, limit);
+        LLSD::Binary data(count * sizeof(U16));
+        for (size_t i = 0; i < count; ++i)
+        {
+            U16 value = (U16)dist(rng);
+            memcpy(&data[i * sizeof(U16)], &value, sizeof(U16));
+        }
+        return data;
+    }
+
+    LLSD makeDomain(F64 min, F64 max, S32 size)
+    {
+        LLSD domain;
+        for (S32 i = 0; i < size; ++i)
+        {
+            domain["Min"].append(min);
+            domain["Max"].append(max + i);
+        }
+        return domain;
+    }
+
+    // A LOD block laid out like the ones LLModel::writeModel() uploads
+    LLSD makeLOD(U32 face_count, U32 vertex_count, U64 seed)
+    {
+        std::mt19937 rng((U32)seed);
+        LLSD lod = LLSD::emptyArray();
+        for (U32 f = 0; f < face_count; ++f)
+        {
+            LLSD face;
+            face["PositionDomain"] = makeDomain(-0.5, 0.5, 3);
+            face["TexCoord0Domain"] = makeDomain(0.0, 1.0, 2);
+            face["NormalizedScale"] = makeDomain(0.0, 2.0, 3)["Max"];
+            face["Position"] = randomU16s(rng, vertex_count * 3);
+            face["Normal"] = randomU16s(rng, vertex_count * 3);
+            face["TexCoord0"] = randomU16s(rng, vertex_count * 2);
+            face["TriangleList"] = randomU16s(rng, vertex_count * 3, (U16)(vertex_count - 1));
+
+            // Two influences per vertex
+            LLSD::Binary weights;
+            for (U32 v = 0; v < vertex_count; ++v)
+            {
+                weights.push_back((U8)(v % 8));
+                weights.push_back(0x00);
+                weights.push_back(0x80);
+                weights.push_back((U8)(v % 8 + 1));
+                weights.push_back(0xff);
+                weights.push_back(0x7f);
+                weights.push_back(0xff);
+            }
+            face["Weights"] = weights;
+            face["Unknown"] = LLSD().with("nested", LLSD().with("ignored", true));
+            lod.append(face);
+        }
+
+        LLSD empty;
+        empty["NoGeometry"] = true;
+        lod.append(empty);
+        return lod;
+    }
+
+    LLPointer<LLVolume> makeVolume()
+    {
+        LLVolumeParams params;
+        params.setType(LL_PCODE_PROFILE_SQUARE, LL_PCODE_PATH_LINE);
+        params.setSculptID(LLUUID::generateNewID(), LL_SCULPT_TYPE_MESH);
+        return new LLVolume(params, 1.f);
+    }
+
+    template <typename T>
+    bool sameArray(const T* a, const T* b, S32 count)
+    {
+        return count == 0 || (a && b && memcmp(a, b, count * sizeof(T)) == 0);
+    }
+
+    struct AllocCount
+    {
+        size_t mBytes;
+        size_t mCount;
+    };
+
+    // What this thread allocates through operator new while fn runs
+    template <typename FN>
+    AllocCount countAllocs(FN fn)
+    {
+        const size_t bytes = CountAllocs::sBytes;
+        const size_t count = CountAllocs::sCount;
+        fn();
+        return AllocCount{ CountAllocs::sBytes - bytes, CountAllocs::sCount - count };
+    }
+}
+
+namespace tut
+{
+    struct llvolume_data
+    {
+    };
+    typedef test_group<llvolume_data> llvolume_group;
+    typedef llvolume_group::object object;
+    llvolume_group llvolumegrp("LLVolume");
+
+    template<> template<>
+    void object::test<1>()
+    {
+        set_test_name("unpacking from segments matches unpacking through LLSD");
+        LLSD lod = makeLOD(3, 500, 1);
+        std::string zipped = zip_llsd(lod);
+        ensure("compressed", !zipped.empty());
+
+        std::istringstream is(zipped);
+        LLPointer<LLVolume> expected = makeVolume();
+        ensure("LLSD unpack", expected->unpackVolumeFaces(is, (S32)zipped.size()));
+
+        // Split like an HTTP body, at odd offsets
+        const U8* data = (const U8*)zipped.data();
+        LLUZipHelper::Segment segments[] = {
+            { data, 7 },
+            { data + 7, zipped.size() / 2 - 7 },
+            { data + zipped.size() / 2, zipped.size() - zipped.size() / 2 }
+        };
+        LLPointer<LLVolume> actual = makeVolume();
+        ensure("segment unpack", actual->unpackVolumeFaces(segments, LL_ARRAY_SIZE(segments)));
+
+        ensure_equals("face count", actual->getNumVolumeFaces(), expected->getNumVolumeFaces());
+        for (S32 i = 0; i < expected->getNumVolumeFaces(); ++i)
+        {
+            const LLVolumeFace& a = actual->getVolumeFace(i);
+            const LLVolumeFace& e = expected->getVolumeFace(i);
+            ensure_equals("vertices", a.mNumVertices, e.mNumVertices);
+            ensure_equals("indices", a.mNumIndices, e.mNumIndices);
+            ensure("index data", sameArray(a.mIndices, e.mIndices, e.mNumIndices));
+            ensure("positions", sameArray(a.mPositions, e.mPositions, e.mNumVertices));
+            ensure("normals", sameArray(a.mNormals, e.mNormals, e.mNumVertices));
+            ensure("texcoords", sameArray(a.mTexCoords, e.mTexCoords, e.mNumVertices));
+            ensure_equals("weights", a.mWeights != NULL, e.mWeights != NULL);
+            ensure("weight data", !e.mWeights || sameArray(a.mWeights, e.mWeights, e.mNumVertices));
+            ensure("extents", sameArray(a.mExtents, e.mExtents, 2));
+            ensure_equals("normalized scale", a.mNormalizedScale, e.mNormalizedScale);
+        }
+    }
+
+    template<> template<>
+    void object::test<2>()
+    {
+        set_test_name("malformed blocks are rejected");
+        LLSD lod = makeLOD(1, 30, 2);
+        std::string zipped = zip_llsd(lod);
+
+        // Truncated compressed data
+        LLPointer<LLVolume> volume = makeVolume();
+        ensure("truncated", !volume->unpackVolumeFaces((U8*)zipped.data(), (S32)zipped.size() / 2));
+
+        // No faces
+        LLSD empty = LLSD::emptyArray();
+        zipped = zip_llsd(empty);
+        ensure("no faces", !volume->unpackVolumeFaces((U8*)zipped.data(), (S32)zipped.size()));
+
+        // Not a faces array
+        LLSD map;
+        map["Position"] = LLSD::Binary(6);
+        zipped = zip_llsd(map);
+        ensure("not an array", !volume->unpackVolumeFaces((U8*)zipped.data(), (S32)zipped.size()));
+
+        // Binary blob claiming more bytes than the block holds
+        std::stringstream binary;
+        LLSDSerialize::toBinary(lod, binary);
+        std::string raw = binary.str();
+        size_t pos = raw.find("Position");
+        ensure("has position", pos != std::string::npos);
+        // the key, then 'b' and the big endian size
+        raw[pos + 8 + 1] = (char)0x7f;
+        std::vector<U8> corrupt(compressBound((uLong)raw.size()));
+        uLongf corrupt_size = (uLongf)corrupt.size();
+        ensure_equals("compress", compress((Bytef*)corrupt.data(), &corrupt_size, (const Bytef*)raw.data(), (uLong)raw.size()), Z_OK);
+        ensure("oversized blob", !volume->unpackVolumeFaces(corrupt.data(), (S32)corrupt_size));
+    }
+
+    template<> template<>
+    void object::test<3>()
+    {
+        set_test_name("heap allocations per LOD, LLSD tree vs direct unpack");
+        // The direct unpack has to allocate less. The counts depend on the
+        // standard library, so the bigger meshes and the log wait for
+        // LL_BENCHMARKS. The vertex and index storage of the faces is
+        // aligned memory, outside of operator new, so it is the same for
+        // both.
+        const U32 vertex_counts[] = { 100, 1000, 10000 };
+        for (U32 vertex_count : vertex_counts)
+        {
+            if (vertex_count > vertex_counts[0] && !benchmarking())
+            {
+                break;
+            }
+            LLSD lod = makeLOD(4, vertex_count, vertex_count);
+            std::string zipped = zip_llsd(lod);
+
+            LLPointer<LLVolume> warmup = makeVolume();
+            ensure("warm up", warmup->unpackVolumeFaces((U8*)zipped.data(), (S32)zipped.size()));
+
+            LLPointer<LLVolume> llsd_volume = makeVolume();
+            std::istringstream is(zipped);
+            AllocCount llsd_allocs = countAllocs([&]()
+            {
+                ensure("LLSD unpack", llsd_volume->unpackVolumeFaces(is, (S32)zipped.size()));
+            });
+
+            LLPointer<LLVolume> direct_volume = makeVolume();
+            LLUZipHelper::Segment segment = { (const U8*)zipped.data(), zipped.size() };
+            AllocCount direct_allocs = countAllocs([&]()
+            {
+                ensure("direct unpack", direct_volume->unpackVolumeFaces(&segment, 1));
+            });
+
+#if ! TRACY_ENABLE
+            ensure("fewer bytes allocated", direct_allocs.mBytes < llsd_allocs.mBytes);
+#endif
+            if (benchmarking())
+            {
+                LL_INFOS("Benchmark") << "4 faces x " << vertex_count << " vertices, " << zipped.size()
+                                      << " compressed bytes: LLSD tree " << llsd_allocs.mBytes << " bytes in "
+                                      << llsd_allocs.mCount << " allocations, direct " << direct_allocs.mBytes
+                                      << " bytes in " << direct_allocs.mCount << " allocations" << LL_ENDL;
+            }
+        }
+    }
+}
@@ -62,6 +62,230 @@ const S32 LL_MAX_RESENT_PACKETS_PER_FRAME = 100;
 const S32 LL_MAX_ACKED_PACKETS_PER_FRAME = 200;
 const F32 LL_COLLECT_ACK_TIME_MAX = 2.f;
 
+// How far apart the packet IDs in the received packet lists may be. Older
+// IDs are forgotten to make room for newer ones.
+const U32 LL_MAX_RECEIVED_ID_SPAN = 0x8000;
+
+//
+// Values keyed by packet ID, for IDs that come more or less in sequence.
+// A slot array indexed by the low bits of the ID holds the IDs from the
+// oldest to the newest one in the ring, taking wrapping at
+// LL_MAX_OUT_PACKET_ID into account, and doubles when that span outgrows
+// it. Finding, adding and removing an ID are O(1) without allocating, and
+// iteration is in sequence order, oldest first.
+//
+// Reads like the std::map it replaces, except that erasing doesn't
+// invalidate iterators to other entries. IDs past ID_MASK, which only a
+// malformed or spoofed packet can carry, are never kept.
+//
+template <typename T>
+class LLPacketIDRing
+{
+	typedef std::pair<TPACKETID, T> slot_t;
+	static constexpr TPACKETID EMPTY_ID = 0xffffffff;
+	static constexpr TPACKETID ID_MASK = LL_MAX_OUT_PACKET_ID - 1;
+
+public:
+	typedef slot_t value_type;
+
+	class iterator
+	{
+	public:
+		iterator() : mRing(NULL), mID(0) {}
+
+		slot_t& operator*() const			{ return mRing->slot(mID); }
+		slot_t* operator->() const			{ return &mRing->slot(mID); }
+		iterator& operator++()				{ mID = mRing->nextUsed(mID); return *this; }
+		iterator operator++(int)			{ iterator old(*this); ++*this; return old; }
+		bool operator==(const iterator& other) const	{ return mID == other.mID; }
+		bool operator!=(const iterator& other) const	{ return mID != other.mID; }
+
+	private:
+		friend class LLPacketIDRing;
+		iterator(LLPacketIDRing* ring, TPACKETID id) : mRing(ring), mID(id) {}
+
+		LLPacketIDRing*	mRing;
+		TPACKETID		mID;
+	};
+
+	// With a max_span, adding an ID more than max_span past the oldest one
+	// drops the old ones, and IDs that far behind the newest aren't kept:
+	// only for values that need no cleaning up.
+	LLPacketIDRing(U32 max_span = 0) :
+		mFirst(0),
+		mEnd(0),
+		mSize(0),
+		mMaxSpan(max_span)
+	{
+	}
+
+	bool empty() const						{ return !mSize; }
+	size_t size() const						{ return mSize; }
+
+	iterator begin()						{ return iterator(this, mFirst); }
+	iterator end()							{ return iterator(this, mEnd); }
+
+	iterator find(TPACKETID id)
+	{
+		return contains(id) ? iterator(this, id) : end();
+	}
+
+	T& operator[](TPACKETID id)
+	{
+		if (contains(id))
+		{
+			return slot(id).second;
+		}
+		if (id > ID_MASK)
+		{
+			mDiscarded.second = T();
+			return mDiscarded.second;
+		}
+
+		if (mMaxSpan && mSize && distance(mFirst, id) <= ID_MASK / 2)
+		{
+			while (mSize && distance(mFirst, id) >= mMaxSpan)
+			{
+				eraseFirst();
+			}
+		}
+
+		if (!mSize)
+		{
+			reserve(1);
+			mFirst = id;
+			mEnd = (id + 1) & ID_MASK;
+		}
+		else if (distance(mFirst, id) <= ID_MASK / 2)
+		{
+			// in a gap, or past the newest
+			reserve(distance(mFirst, id) + 1);
+			if (distance(mFirst, id) >= distance(mFirst, mEnd))
+			{
+				mEnd = (id + 1) & ID_MASK;
+			}
+		}
+		else
+		{
+			// ahead of the oldest
+			U32 span = distance(id, mEnd);
+			if (mMaxSpan && span > mMaxSpan)
+			{
+				mDiscarded.second = T();
+				return mDiscarded.second;
+			}
+			reserve(span);
+			mFirst = id;
+		}
+
+		slot_t& s = slot(id);
+		s.first = id;
+		s.second = T();
+		++mSize;
+		return s.second;
+	}
+
+	void erase(iterator it)					{ erase(it.mID); }
+
+	size_t erase(TPACKETID id)
+	{
+		if (!contains(id))
+		{
+			return 0;
+		}
+		slot(id).first = EMPTY_ID;
+		if (!--mSize)
+		{
+			mFirst = mEnd;
+		}
+		else if (id == mFirst)
+		{
+			mFirst = nextUsed(mFirst);
+		}
+		return 1;
+	}
+
+	// Drops the IDs that come before id
+	void eraseBefore(TPACKETID id)
+	{
+		while (mSize && isBefore(mFirst, id))
+		{
+			eraseFirst();
+		}
+	}
+
+	void clear()
+	{
+		while (mSize)
+		{
+			eraseFirst();
+		}
+	}
+
+	// true if a comes before b, taking wrapping into account
+	static bool isBefore(TPACKETID a, TPACKETID b)
+	{
+		U32 d = distance(a, b);
+		return d && d <= ID_MASK / 2;
+	}
+
+private:
+	static U32 distance(TPACKETID from, TPACKETID to)	{ return (to - from) & ID_MASK; }
+
+	slot_t& slot(TPACKETID id)				{ return mSlots[id & (mSlots.size() - 1)]; }
+
+	bool contains(TPACKETID id)
+	{
+		return mSize && id <= ID_MASK && slot(id).first == id;
+	}
+
+	TPACKETID nextUsed(TPACKETID id)
+	{
+		do
+		{
+			id = (id + 1) & ID_MASK;
+		}
+		while (id != mEnd && slot(id).first != id);
+		return id;
+	}
+
+	void eraseFirst()
+	{
+		erase(mFirst);
+	}
+
+	// Room for span consecutive IDs from mFirst
+	void reserve(U32 span)
+	{
+		size_t capacity = mSlots.empty() ? 64 : mSlots.size();
+		while (capacity < span)
+		{
+			capacity *= 2;
+		}
+		if (capacity == mSlots.size())
+		{
+			return;
+		}
+
+		std::vector<slot_t> slots(capacity, slot_t(EMPTY_ID, T()));
+		for (slot_t& s : mSlots)
+		{
+			if (s.first != EMPTY_ID)
+			{
+				slots[s.first & (capacity - 1)] = s;
+			}
+		}
+		mSlots.swap(slots);
+	}
+
+	std::vector<slot_t>	mSlots;
+	TPACKETID			mFirst;		// oldest, if not empty
+	TPACKETID			mEnd;		// one past the newest
+	size_t				mSize;
+	U32					mMaxSpan;
+	slot_t				mDiscarded;
+};
+
 //
 // Prototypes and Predefines
 //
@@ -233,14 +457,14 @@ protected:
 	U32Milliseconds		mPingDelay;             // raw ping delay
 	F32Milliseconds		mPingDelayAveraged;     // averaged ping delay (fast attack/slow decay)
 
-	typedef std::map<TPACKETID, U64Microseconds> packet_time_map;
+	typedef LLPacketIDRing<U64Microseconds> packet_time_map;
 
 	packet_time_map							mPotentialLostPackets;
 	packet_time_map							mRecentlyReceivedReliablePackets;
 	std::vector<TPACKETID> mAcks;
 	F32 mAckCreationTime; // first ack creation time
 
-	typedef std::map<TPACKETID, LLReliablePacket *> reliable_map;
+	typedef LLPacketIDRing<LLReliablePacket *> reliable_map;
 	typedef reliable_map::iterator					reliable_iter;
 
 	reliable_map							mUnackedPackets;
@@ -0,0 +1,195 @@
+/**
+ * @file llmessagereceivethread.cpp
+ * @brief Thread reading and unpacking UDP packets for LLMessageSystem.
+ *
+ * $LicenseInfo:firstyear=2024&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2024, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+
+#include "llmessagereceivethread.h"
+
+#if LL_WINDOWS
+	#include "llwin32headerslean.h"
+#else
+	#include <sys/select.h>
+#endif
+
+#include <chrono>
+
+#include "llmessagetemplate.h"
+#include "llpacketring.h"
+#include "lltimer.h"
+#include "message.h"
+
+// How many unpacked packets may wait for the main thread. Past that the
+// receive thread stops reading, and the socket buffer takes the overflow.
+static const size_t RECEIVE_QUEUE_CAPACITY = 4096;
+
+// How long the thread sleeps in select() before checking for shutdown
+static const S32 RECEIVE_POLL_MS = 50;
+
+LLReceivedPacket::LLReceivedPacket() :
+	mReceivedUsecs(0)
+{
+}
+
+LLReceivedPacket::~LLReceivedPacket()
+{
+}
+
+///////////////////////////////////////////////////////////
+
+LLMessageReceiveThread::LLMessageReceiveThread(LLPacketRing& packet_ring, S32 socket,
+											   message_template_number_map_t& templates) :
+	mPacketRing(packet_ring),
+	mSocket(socket),
+	mReader(templates),
+	mQueue(RECEIVE_QUEUE_CAPACITY)
+{
+	mThread = std::thread([this](){ run(); });
+}
+
+LLMessageReceiveThread::~LLMessageReceiveThread()
+{
+	// wakes the thread if it's blocked on a full queue, and tells it to quit
+	mQueue.close();
+	if (mThread.joinable())
+	{
+		mThread.join();
+	}
+}
+
+std::unique_ptr<LLReceivedPacket> LLMessageReceiveThread::popPacket()
+{
+	packet_ptr_t packet(std::move(mWaiting));
+	if (!packet)
+	{
+		mQueue.tryPop(packet);
+	}
+	return packet;
+}
+
+BOOL LLMessageReceiveThread::waitForPacket(F32 seconds)
+{
+	if (!mWaiting)
+	{
+		mQueue.tryPopFor(std::chrono::microseconds(S64(seconds * 1000000.f)), mWaiting);
+	}
+	return mWaiting != NULL;
+}
+
+size_t LLMessageReceiveThread::getQueueDepth()
+{
+	return mQueue.size() + (mWaiting ? 1 : 0);
+}
+
+void LLMessageReceiveThread::run()
+{
+	LL_PROFILER_SET_THREAD_NAME("MessageReceive");
+
+	U8 buffer[NET_BUFFER_SIZE];
+	S32 idle_wakeups = 0;
+	while (!mQueue.isClosed())
+	{
+		S32 size = mPacketRing.receivePacket(mSocket, (char*)buffer);
+		if (!size)
+		{
+			// With the in throttle on, the ring can hold back packets the
+			// socket says are there: don't spin on them.
+			if (idle_wakeups++)
+			{
+				std::this_thread::sleep_for(std::chrono::milliseconds(1));
+			}
+			if (!waitForSocket(RECEIVE_POLL_MS))
+			{
+				idle_wakeups = 0;
+			}
+			continue;
+		}
+		idle_wakeups = 0;
+
+		if (!mQueue.pushIfOpen(unpack(buffer, size)))
+		{
+			break;
+		}
+	}
+}
+
+BOOL LLMessageReceiveThread::waitForSocket(S32 milliseconds)
+{
+	fd_set read_fds;
+	FD_ZERO(&read_fds);
+	FD_SET(mSocket, &read_fds);
+	struct timeval timeout;
+	timeout.tv_sec = milliseconds / 1000;
+	timeout.tv_usec = (milliseconds % 1000) * 1000;
+	return select(mSocket + 1, &read_fds, NULL, NULL, &timeout) > 0;
+}
+
+// Does what checkMessages() does to a packet before it looks at circuits,
+// for packets where that goes smoothly.
+std::unique_ptr<LLReceivedPacket> LLMessageReceiveThread::unpack(const U8* buffer, S32 size)
+{
+	packet_ptr_t packet(new LLReceivedPacket);
+	packet->mData.assign(buffer, buffer + size);
+	packet->mSender = mPacketRing.getLastSender();
+	packet->mReceivingIF = mPacketRing.getLastReceivingInterface();
+	packet->mReceivedUsecs = totalTime();
+
+	if (size < (S32)LL_MINIMUM_VALID_PACKET_SIZE)
+	{
+		return packet;
+	}
+
+	// skip the appended acks, which the main thread reads
+	S32 message_size = size;
+	if (buffer[0] & LL_ACK_FLAG)
+	{
+		S32 acks = buffer[--message_size];
+		if (message_size < (S32)(acks * sizeof(TPACKETID) + LL_MINIMUM_VALID_PACKET_SIZE))
+		{
+			return packet;
+		}
+		message_size -= acks * sizeof(TPACKETID);
+	}
+
+	const U8* message = packet->mData.data();
+	if (buffer[0] & LL_ZERO_CODE_FLAG)
+	{
+		// Leave packets that don't expand cleanly for zeroCodeExpand()
+		// to complain about
+		S32 expanded = LLMessageSystem::zeroCodeExpand(message, message_size,
+													   mExpandBuffer, NET_BUFFER_SIZE);
+		if (expanded < 0)
+		{
+			return packet;
+		}
+		mExpandBuffer[0] &= ~LL_ZERO_CODE_FLAG;
+		packet->mExpanded.assign(mExpandBuffer, mExpandBuffer + expanded);
+		message = packet->mExpanded.data();
+		message_size = expanded;
+	}
+
+	packet->mDecoded.reset(mReader.predecode(message, message_size, &packet->mArena));
+	return packet;
+}
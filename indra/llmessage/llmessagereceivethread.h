@@ -0,0 +1,104 @@
+/**
+ * @file llmessagereceivethread.h
+ * @brief Thread reading and unpacking UDP packets for LLMessageSystem.
+ *
+ * @Description:
+ * With the receive thread running, LLMessageSystem::checkMessages() no
+ * longer touches the socket. The thread reads packets through the
+ * LLPacketRing, expands zero-coded ones and decodes their blocks, then
+ * queues them for the main thread, which only has acks, circuit
+ * bookkeeping and handler dispatch left to do.
+ *
+ * Anything out of the ordinary (malformed ack counts, an expansion that
+ * doesn't fit, a message that runs off the end of the packet) is queued
+ * unprocessed, for the main thread to handle -- and report -- the way it
+ * does without the thread.
+ *
+ * $LicenseInfo:firstyear=2024&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2024, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#ifndef LL_LLMESSAGERECEIVETHREAD_H
+#define LL_LLMESSAGERECEIVETHREAD_H
+
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "llhost.h"
+#include "llmsgdataarena.h"
+#include "llthreadsafequeue.h"
+#include "lltemplatemessagereader.h"
+
+class LLMsgData;
+class LLPacketRing;
+
+// A packet as the receive thread hands it to the main thread
+struct LLReceivedPacket
+{
+	LLReceivedPacket();
+	~LLReceivedPacket();
+
+	std::vector<U8>		mData;			// as received, appended acks included
+	std::vector<U8>		mExpanded;		// zero-code expanded message, if it was zero coded
+	LLHost				mSender;
+	LLHost				mReceivingIF;
+	LLMsgDataArena		mArena;			// for mDecoded, so declared ahead of it
+	std::unique_ptr<LLMsgData> mDecoded;	// its blocks, if they decoded cleanly
+	U64					mReceivedUsecs;	// totalTime() when read off the socket
+};
+
+class LLMessageReceiveThread
+{
+public:
+	typedef LLTemplateMessageReader::message_template_number_map_t message_template_number_map_t;
+
+	// The thread owns the receive side of packet_ring until it's destroyed
+	LLMessageReceiveThread(LLPacketRing& packet_ring, S32 socket,
+						   message_template_number_map_t& templates);
+	~LLMessageReceiveThread();
+
+	// main thread: the next packet, empty if none is waiting
+	std::unique_ptr<LLReceivedPacket> popPacket();
+
+	// main thread: waits up to seconds for a packet, returns TRUE if one came
+	BOOL waitForPacket(F32 seconds);
+
+	size_t getQueueDepth();
+
+private:
+	void run();
+	BOOL waitForSocket(S32 milliseconds);
+	std::unique_ptr<LLReceivedPacket> unpack(const U8* buffer, S32 size);
+
+	typedef std::unique_ptr<LLReceivedPacket> packet_ptr_t;
+	typedef LLThreadSafeQueue<packet_ptr_t, LL::MPSCQueue<packet_ptr_t>> queue_t;
+
+	LLPacketRing&			mPacketRing;
+	S32						mSocket;
+	LLTemplateMessageReader	mReader;		// thread's own, for decoding
+	U8						mExpandBuffer[NET_BUFFER_SIZE];
+	queue_t					mQueue;
+	packet_ptr_t			mWaiting;		// popped by waitForPacket()
+	std::thread				mThread;
+};
+
+#endif // LL_LLMESSAGERECEIVETHREAD_H
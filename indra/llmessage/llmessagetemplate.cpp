@@ -30,7 +30,8 @@
 
 #include "message.h"
 
-void LLMsgVarData::addData(const void *data, S32 size, EMsgVariableType type, S32 data_size)
+void LLMsgVarData::addData(const void *data, S32 size, EMsgVariableType type, S32 data_size,
+						   LLMsgDataArena* arena)
 {
 	mSize = size;
 	mDataSize = data_size;
@@ -45,8 +46,15 @@ void LLMsgVarData::addData(const void *data, S32 size, EMsgVariableType type, S3
 	}
 	if(size)
 	{
-		delete[] mData; // Delete it if it already exists
-		mData = new U8[size];
+		if (arena)
+		{
+			mData = (U8*)arena->allocate(size);
+		}
+		else
+		{
+			delete[] mData; // Delete it if it already exists
+			mData = new U8[size];
+		}
 		htolememcpy(mData, data, mType, size);
 	}
 }
@@ -30,6 +30,7 @@
 #include "message.h" // TODO: babbage: Remove...
 #include "llstl.h"
 #include "llindexedvector.h"
+#include "llmsgdataarena.h"
 
 class LLMsgVarData
 {
@@ -54,7 +55,9 @@ public:
 		mData = NULL;
 	}
 	
-	void addData(const void *indata, S32 size, EMsgVariableType type, S32 data_size = -1);
+	// With an arena, mData comes out of it and deleteData() mustn't be called
+	void addData(const void *indata, S32 size, EMsgVariableType type, S32 data_size = -1,
+				 LLMsgDataArena* arena = NULL);
 
 	char *getName() const	{ return mName; }
 	S32 getSize() const		{ return mSize; }
@@ -75,13 +78,21 @@ protected:
 class LLMsgBlkData
 {
 public:
-        LLMsgBlkData(const char *name, S32 blocknum) : mBlockNumber(blocknum), mTotalSize(-1) 
+        LLMsgBlkData(const char *name, S32 blocknum, LLMsgDataArena* arena = NULL) :
+		mBlockNumber(blocknum),
+		mMemberVarData(var_allocator_t(arena)),
+		mTotalSize(-1),
+		mArena(arena)
 	{ 
 		mName = (char *)name; 
 	}
 
 	~LLMsgBlkData()
 	{
+		if (mArena)
+		{
+			return;
+		}
 		for (msg_var_data_map_t::iterator iter = mMemberVarData.begin();
 			 iter != mMemberVarData.end(); iter++)
 		{
@@ -98,29 +109,58 @@ public:
 	void addData(char *name, const void *data, S32 size, EMsgVariableType type, S32 data_size = -1)
 	{
 		LLMsgVarData* temp = &mMemberVarData[name]; // creates a new entry if one doesn't exist
-		temp->addData(data, size, type, data_size);
+		temp->addData(data, size, type, data_size, mArena);
 	}
 
 	S32									mBlockNumber;
-	typedef LLIndexedVector<LLMsgVarData, const char *, 8> msg_var_data_map_t;
+	typedef LLMsgDataArenaAllocator<LLMsgVarData> var_allocator_t;
+	typedef LLIndexedVector<LLMsgVarData, const char *, 8, var_allocator_t> msg_var_data_map_t;
 	msg_var_data_map_t					mMemberVarData;
 	char								*mName;
 	S32									mTotalSize;
+	LLMsgDataArena*						mArena;		// holds this block and its data, if set
 };
 
 class LLMsgData
 {
 public:
-	LLMsgData(const char *name) : mTotalSize(-1) 
+	// With an arena, the blocks and their data live in it, and it must
+	// outlive this
+	LLMsgData(const char *name, LLMsgDataArena* arena = NULL) :
+		mMemberBlocks(std::less<char*>(), blk_allocator_t(arena)),
+		mTotalSize(-1),
+		mArena(arena)
 	{ 
 		mName = (char *)name; 
 	}
 	~LLMsgData()
 	{
-		for_each(mMemberBlocks.begin(), mMemberBlocks.end(), DeletePairedPointer());
+		if (mArena)
+		{
+			for (msg_blk_data_map_t::iterator iter = mMemberBlocks.begin();
+				 iter != mMemberBlocks.end(); ++iter)
+			{
+				iter->second->~LLMsgBlkData();
+			}
+		}
+		else
+		{
+			for_each(mMemberBlocks.begin(), mMemberBlocks.end(), DeletePairedPointer());
+		}
 		mMemberBlocks.clear();
 	}
 
+	// A block to addBlock() to this message
+	LLMsgBlkData* createBlock(const char *name, S32 blocknum)
+	{
+		if (mArena)
+		{
+			return new (mArena->allocate(sizeof(LLMsgBlkData), alignof(LLMsgBlkData)))
+				LLMsgBlkData(name, blocknum, mArena);
+		}
+		return new LLMsgBlkData(name, blocknum);
+	}
+
 	void addBlock(LLMsgBlkData *blockp)
 	{
 		mMemberBlocks[blockp->mName] = blockp;
@@ -129,10 +169,12 @@ public:
 	void addDataFast(char *blockname, char *varname, const void *data, S32 size, EMsgVariableType type, S32 data_size = -1);
 
 public:
-	typedef std::map<char*, LLMsgBlkData*> msg_blk_data_map_t;
+	typedef LLMsgDataArenaAllocator<std::pair<char* const, LLMsgBlkData*> > blk_allocator_t;
+	typedef std::map<char*, LLMsgBlkData*, std::less<char*>, blk_allocator_t> msg_blk_data_map_t;
 	msg_blk_data_map_t					mMemberBlocks;
 	char								*mName;
 	S32									mTotalSize;
+	LLMsgDataArena*						mArena;
 };
 
 // LLMessage* classes store the template of messages
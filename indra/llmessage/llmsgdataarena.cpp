@@ -0,0 +1,117 @@
+/**
+ * @file llmsgdataarena.cpp
+ * @brief Bump allocator for the data of decoded template messages.
+ *
+ * $LicenseInfo:firstyear=2024&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2024, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+
+#include "llmsgdataarena.h"
+
+#include "llmemory.h"
+
+LLMsgDataArena::LLMsgDataArena(size_t chunk_size) :
+	mHead(NULL),
+	mCurrent(NULL),
+	mPos(NULL),
+	mEnd(NULL),
+	mChunkSize(chunk_size),
+	mBytesUsed(0)
+{
+}
+
+LLMsgDataArena::~LLMsgDataArena()
+{
+	while (mHead)
+	{
+		Chunk* next = mHead->mNext;
+		ll_aligned_free_16(mHead);
+		mHead = next;
+	}
+}
+
+void LLMsgDataArena::reset()
+{
+	// Oversized chunks were for one unusually large message: don't hang
+	// on to them.
+	Chunk** link = &mHead;
+	while (*link)
+	{
+		Chunk* chunk = *link;
+		if (chunk->mSize > mChunkSize)
+		{
+			*link = chunk->mNext;
+			ll_aligned_free_16(chunk);
+		}
+		else
+		{
+			link = &chunk->mNext;
+		}
+	}
+
+	mCurrent = NULL;
+	mPos = NULL;
+	mEnd = NULL;
+	mBytesUsed = 0;
+}
+
+S32 LLMsgDataArena::getChunkCount() const
+{
+	S32 count = 0;
+	for (Chunk* chunk = mHead; chunk; chunk = chunk->mNext)
+	{
+		++count;
+	}
+	return count;
+}
+
+void* LLMsgDataArena::allocateSlow(size_t size, size_t alignment)
+{
+	// Chunks following mCurrent are left from before the last reset()
+	Chunk* next = mCurrent ? mCurrent->mNext : mHead;
+	if (!next || next->mSize < size + alignment)
+	{
+		size_t chunk_size = llmax(mChunkSize, size + alignment);
+		next = (Chunk*)ll_aligned_malloc_16(sizeof(Chunk) + chunk_size);
+		next->mSize = chunk_size;
+		if (mCurrent)
+		{
+			next->mNext = mCurrent->mNext;
+			mCurrent->mNext = next;
+		}
+		else
+		{
+			next->mNext = mHead;
+			mHead = next;
+		}
+	}
+
+	mCurrent = next;
+	mPos = chunkData(next);
+	mEnd = mPos + next->mSize;
+
+	U8* p = align(mPos, alignment);
+	mPos = p + size;
+	mBytesUsed += size;
+	return p;
+}
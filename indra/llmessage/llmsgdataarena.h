@@ -0,0 +1,133 @@
+/**
+ * @file llmsgdataarena.h
+ * @brief Bump allocator for the data of decoded template messages.
+ *
+ * @Description:
+ * Decoding a template message used to allocate every block, every
+ * variable's data and every map node separately, and free them all again
+ * once the handler had run. LLMsgDataArena hands out that memory from a
+ * few large chunks instead; nothing is freed individually, and reset()
+ * makes the chunks available to the next message.
+ *
+ * $LicenseInfo:firstyear=2024&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2024, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#ifndef LL_LLMSGDATAARENA_H
+#define LL_LLMSGDATAARENA_H
+
+#include <new>
+
+class LLMsgDataArena
+{
+public:
+	// Big enough for all but the largest messages
+	static const size_t DEFAULT_CHUNK_SIZE = 4096;
+
+	LLMsgDataArena(size_t chunk_size = DEFAULT_CHUNK_SIZE);
+	~LLMsgDataArena();
+
+	void* allocate(size_t size, size_t alignment = 8)
+	{
+		if (mPos)
+		{
+			U8* p = align(mPos, alignment);
+			if (p + size <= mEnd)
+			{
+				mPos = p + size;
+				mBytesUsed += size;
+				return p;
+			}
+		}
+		return allocateSlow(size, alignment);
+	}
+
+	// Everything allocated so far is forgotten, so anything living in the
+	// arena must have been destroyed. Keeps the regular sized chunks.
+	void reset();
+
+	size_t getBytesUsed() const		{ return mBytesUsed; }
+	S32 getChunkCount() const;
+
+private:
+	LLMsgDataArena(const LLMsgDataArena&);
+	LLMsgDataArena& operator=(const LLMsgDataArena&);
+
+	struct Chunk
+	{
+		Chunk*	mNext;
+		size_t	mSize;		// usable bytes after the header
+	};
+
+	static U8* align(U8* p, size_t alignment)
+	{
+		return (U8*)(((uintptr_t)p + alignment - 1) & ~(uintptr_t)(alignment - 1));
+	}
+	static U8* chunkData(Chunk* chunk)	{ return (U8*)(chunk + 1); }
+
+	void* allocateSlow(size_t size, size_t alignment);
+
+	Chunk*	mHead;
+	Chunk*	mCurrent;
+	U8*		mPos;
+	U8*		mEnd;
+	size_t	mChunkSize;
+	size_t	mBytesUsed;
+};
+
+// Standard allocator over an LLMsgDataArena, for the containers in the
+// decoded message. Without an arena it's plain operator new.
+template <typename T>
+class LLMsgDataArenaAllocator
+{
+public:
+	typedef T value_type;
+
+	LLMsgDataArenaAllocator(LLMsgDataArena* arena = NULL) : mArena(arena) {}
+	template <typename U>
+	LLMsgDataArenaAllocator(const LLMsgDataArenaAllocator<U>& other) : mArena(other.mArena) {}
+
+	T* allocate(size_t n)
+	{
+		if (mArena)
+		{
+			return static_cast<T*>(mArena->allocate(n * sizeof(T), alignof(T)));
+		}
+		return static_cast<T*>(::operator new(n * sizeof(T)));
+	}
+
+	void deallocate(T* p, size_t)
+	{
+		if (!mArena)
+		{
+			::operator delete(p);
+		}
+	}
+
+	template <typename U>
+	bool operator==(const LLMsgDataArenaAllocator<U>& other) const	{ return mArena == other.mArena; }
+	template <typename U>
+	bool operator!=(const LLMsgDataArenaAllocator<U>& other) const	{ return mArena != other.mArena; }
+
+	LLMsgDataArena* mArena;
+};
+
+#endif // LL_LLMSGDATAARENA_H
@@ -34,24 +34,14 @@
 
 ///////////////////////////////////////////////////////////
 
-LLPacketBuffer::LLPacketBuffer(const LLHost &host, const char *datap, const S32 size) : mHost(host)
+LLPacketBuffer::LLPacketBuffer() : mSize(0)
 {
-	mSize = 0;
 	mData[0] = '!';
+}
 
-	if (size > NET_BUFFER_SIZE)
-	{
-		LL_ERRS() << "Sending packet > " << NET_BUFFER_SIZE << " of size " << size << LL_ENDL;
-	}
-	else
-	{
-		if (datap != NULL)
-		{
-			memcpy(mData, datap, size);
-			mSize = size;
-		}
-	}
-	
+LLPacketBuffer::LLPacketBuffer(const LLHost &host, const char *datap, const S32 size)
+{
+	init(host, datap, size);
 }
 
 LLPacketBuffer::LLPacketBuffer (S32 hSocket)
@@ -74,3 +64,68 @@ void LLPacketBuffer::init (S32 hSocket)
 	mReceivingIF = ::get_receiving_interface();
 }
 
+void LLPacketBuffer::init(const LLHost &host, const char *datap, const S32 size)
+{
+	mHost = host;
+	mSize = 0;
+	mData[0] = '!';
+
+	if (size > NET_BUFFER_SIZE)
+	{
+		LL_ERRS() << "Sending packet > " << NET_BUFFER_SIZE << " of size " << size << LL_ENDL;
+	}
+	else
+	{
+		if (datap != NULL)
+		{
+			memcpy(mData, datap, size);
+			mSize = size;
+		}
+	}
+}
+
+///////////////////////////////////////////////////////////
+
+// static
+S32 LLPacketBuffer::receiveBatch(S32 hSocket, LLPacketBuffer *buffers, S32 count)
+{
+	LLNetDatagram datagrams[NET_BATCH_SIZE];
+	count = llmin(count, NET_BATCH_SIZE);
+	for (S32 i = 0; i < count; ++i)
+	{
+		datagrams[i].mData = buffers[i].mData;
+	}
+
+	S32 received = receive_packets(hSocket, datagrams, count);
+	for (S32 i = 0; i < received; ++i)
+	{
+		LLPacketBuffer &buffer = buffers[i];
+		buffer.mSize = datagrams[i].mSize;
+		buffer.mHost.set(datagrams[i].mAddress, datagrams[i].mPort);
+		buffer.mReceivingIF.set(datagrams[i].mReceivingIF, INVALID_PORT);
+	}
+	return received;
+}
+
+// static
+S32 LLPacketBuffer::sendBatch(S32 hSocket, LLPacketBuffer *buffers, S32 count)
+{
+	S32 failures = 0;
+	LLNetDatagram datagrams[NET_BATCH_SIZE];
+	for (S32 sent = 0; sent < count; )
+	{
+		S32 batch = llmin(count - sent, NET_BATCH_SIZE);
+		for (S32 i = 0; i < batch; ++i)
+		{
+			LLPacketBuffer &buffer = buffers[sent + i];
+			datagrams[i].mData = buffer.mData;
+			datagrams[i].mSize = buffer.mSize;
+			datagrams[i].mAddress = buffer.mHost.getAddress();
+			datagrams[i].mPort = buffer.mHost.getPort();
+			datagrams[i].mReceivingIF = INVALID_HOST_IP_ADDRESS;
+		}
+		failures += send_packets(hSocket, datagrams, batch);
+		sent += batch;
+	}
+	return failures;
+}
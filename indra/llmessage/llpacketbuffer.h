@@ -34,15 +34,23 @@
 class LLPacketBuffer
 {
 public:
+	LLPacketBuffer();
 	LLPacketBuffer(const LLHost &host, const char *datap, const S32 size);
 	LLPacketBuffer(S32 hSocket);           // receive a packet
 	~LLPacketBuffer();
 
+	// Fill/send count buffers with as few system calls as possible.
+	// receiveBatch() returns the number of packets received, sendBatch()
+	// the number that failed to send.
+	static S32 receiveBatch(S32 hSocket, LLPacketBuffer *buffers, S32 count);
+	static S32 sendBatch(S32 hSocket, LLPacketBuffer *buffers, S32 count);
+
 	S32			getSize() const					{ return mSize; }
 	const char	*getData() const				{ return mData; }
 	LLHost		getHost() const					{ return mHost; }
 	LLHost		getReceivingInterface() const	{ return mReceivingIF; }
 	void init(S32 hSocket);
+	void init(const LLHost &host, const char *datap, const S32 size);
 
 protected:
 	char	mData[NET_BUFFER_SIZE];        // packet data		/* Flawfinder : ignore */
@@ -0,0 +1,215 @@
+/**
+ * @file llpacketcapture.cpp
+ * @brief Recording received packets to a file, and reading them back.
+ *
+ * $LicenseInfo:firstyear=2024&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2024, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+
+#include "llpacketcapture.h"
+
+#include "llendianswizzle.h"
+#include "lltimer.h"
+#include "net.h"
+
+static const char CAPTURE_MAGIC[8] = { 'L', 'L', 'P', 'K', 'T', 'C', 'A', 'P' };
+static const U32 CAPTURE_VERSION = 1;
+
+// U32s ahead of each packet: time low and high, sender address and port,
+// receiving interface address and port, size
+static const S32 RECORD_HEADER_WORDS = 7;
+
+LLPacketCapture::LLPacketCapture() :
+	mFile(NULL),
+	mStartUsecs(0),
+	mPacketCount(0)
+{
+}
+
+LLPacketCapture::~LLPacketCapture()
+{
+	close();
+}
+
+BOOL LLPacketCapture::open(const std::string& filename)
+{
+	close();
+
+	mFile = LLFile::fopen(filename, "wb");		/* Flawfinder : ignore */
+	if (!mFile)
+	{
+		LL_WARNS("Messaging") << "Can't create packet capture " << filename << LL_ENDL;
+		return FALSE;
+	}
+
+	U32 version = CAPTURE_VERSION;
+	llendianswizzleone(version);
+	if (fwrite(CAPTURE_MAGIC, sizeof(CAPTURE_MAGIC), 1, mFile) != 1
+		|| fwrite(&version, sizeof(version), 1, mFile) != 1)
+	{
+		LL_WARNS("Messaging") << "Can't write packet capture " << filename << LL_ENDL;
+		close();
+		return FALSE;
+	}
+
+	mFilename = filename;
+	mStartUsecs = totalTime();
+	mPacketCount = 0;
+	LL_INFOS("Messaging") << "Capturing received packets to " << filename << LL_ENDL;
+	return TRUE;
+}
+
+void LLPacketCapture::close()
+{
+	if (mFile)
+	{
+		fclose(mFile);
+		mFile = NULL;
+		LL_INFOS("Messaging") << "Captured " << mPacketCount << " packets to " << mFilename << LL_ENDL;
+	}
+}
+
+void LLPacketCapture::write(const char* data, S32 size, const LLHost& sender, const LLHost& receiving_if)
+{
+	if (!mFile)
+	{
+		return;
+	}
+
+	U64 usecs = totalTime() - mStartUsecs;
+	U32 header[RECORD_HEADER_WORDS] =
+	{
+		U32(usecs & 0xffffffff),
+		U32(usecs >> 32),
+		sender.getAddress(),
+		sender.getPort(),
+		receiving_if.getAddress(),
+		receiving_if.getPort(),
+		U32(size)
+	};
+	llendianswizzle(header, sizeof(U32), RECORD_HEADER_WORDS);
+
+	if (fwrite(header, sizeof(header), 1, mFile) != 1
+		|| (size && fwrite(data, size, 1, mFile) != 1))
+	{
+		LL_WARNS("Messaging") << "Write to packet capture " << mFilename
+			<< " failed, stopping the capture" << LL_ENDL;
+		close();
+		return;
+	}
+	++mPacketCount;
+}
+
+///////////////////////////////////////////////////////////
+
+LLPacketReplay::LLPacketReplay() :
+	mFile(NULL),
+	mFirstRecord(0)
+{
+}
+
+LLPacketReplay::~LLPacketReplay()
+{
+	close();
+}
+
+BOOL LLPacketReplay::open(const std::string& filename)
+{
+	close();
+
+	mFile = LLFile::fopen(filename, "rb");		/* Flawfinder : ignore */
+	if (!mFile)
+	{
+		LL_WARNS("Messaging") << "Can't open packet capture " << filename << LL_ENDL;
+		return FALSE;
+	}
+
+	char magic[sizeof(CAPTURE_MAGIC)];
+	U32 version = 0;
+	if (fread(magic, sizeof(magic), 1, mFile) != 1
+		|| fread(&version, sizeof(version), 1, mFile) != 1
+		|| memcmp(magic, CAPTURE_MAGIC, sizeof(magic)))
+	{
+		LL_WARNS("Messaging") << filename << " is not a packet capture" << LL_ENDL;
+		close();
+		return FALSE;
+	}
+	llendianswizzleone(version);
+	if (version != CAPTURE_VERSION)
+	{
+		LL_WARNS("Messaging") << "Packet capture " << filename << " has unknown version "
+			<< version << LL_ENDL;
+		close();
+		return FALSE;
+	}
+
+	mFilename = filename;
+	mFirstRecord = ftell(mFile);
+	return TRUE;
+}
+
+void LLPacketReplay::close()
+{
+	if (mFile)
+	{
+		fclose(mFile);
+		mFile = NULL;
+	}
+}
+
+BOOL LLPacketReplay::read(LLCapturedPacket& packet)
+{
+	if (!mFile)
+	{
+		return FALSE;
+	}
+
+	U32 header[RECORD_HEADER_WORDS];
+	if (fread(header, sizeof(header), 1, mFile) != 1)
+	{
+		return FALSE;
+	}
+	llendianswizzle(header, sizeof(U32), RECORD_HEADER_WORDS);
+
+	U32 size = header[6];
+	if (size > NET_BUFFER_SIZE)
+	{
+		LL_WARNS("Messaging") << "Bad packet size " << size << " in packet capture "
+			<< mFilename << LL_ENDL;
+		return FALSE;
+	}
+
+	packet.mUsecs = U64(header[0]) | (U64(header[1]) << 32);
+	packet.mSender.set(header[2], header[3]);
+	packet.mReceivingIF.set(header[4], header[5]);
+	packet.mData.resize(size);
+	return !size || fread(&packet.mData[0], size, 1, mFile) == 1;
+}
+
+void LLPacketReplay::rewind()
+{
+	if (mFile)
+	{
+		fseek(mFile, mFirstRecord, SEEK_SET);
+	}
+}
@@ -0,0 +1,112 @@
+/**
+ * @file llpacketcapture.h
+ * @brief Recording received packets to a file, and reading them back.
+ *
+ * @Description:
+ * LLPacketRing can write every packet it hands to the message system to
+ * a capture file, and can later take its packets from such a file instead
+ * of the socket. Replaying a capture runs the same traffic through
+ * checkMessages() and the handlers as often as needed, with no simulator
+ * involved, which makes message system changes measurable.
+ *
+ * The file is the 8 byte magic "LLPKTCAP" and a U32 version, followed by
+ * one record per packet: the microseconds since the capture started (as
+ * two U32s, low word first), the sender's address and port, the receiving
+ * interface's address and port, the packet size, and the packet itself.
+ * Integers are little endian; addresses are as LLHost stores them.
+ *
+ * $LicenseInfo:firstyear=2024&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2024, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#ifndef LL_LLPACKETCAPTURE_H
+#define LL_LLPACKETCAPTURE_H
+
+#include <string>
+#include <vector>
+
+#include "llfile.h"
+#include "llhost.h"
+
+struct LLCapturedPacket
+{
+	LLCapturedPacket() : mUsecs(0) {}
+
+	U64					mUsecs;			// since the capture started
+	LLHost				mSender;
+	LLHost				mReceivingIF;
+	std::vector<U8>		mData;
+};
+
+class LLPacketCapture
+{
+public:
+	LLPacketCapture();
+	~LLPacketCapture();
+
+	// Creates or truncates the file. Returns FALSE if it can't be written.
+	BOOL open(const std::string& filename);
+	void close();
+	BOOL isOpen() const							{ return mFile != NULL; }
+
+	// Stops capturing on a write error
+	void write(const char* data, S32 size, const LLHost& sender, const LLHost& receiving_if);
+
+	S32 getPacketCount() const					{ return mPacketCount; }
+
+private:
+	LLPacketCapture(const LLPacketCapture&);
+	LLPacketCapture& operator=(const LLPacketCapture&);
+
+	LLFILE*		mFile;
+	std::string	mFilename;
+	U64			mStartUsecs;
+	S32			mPacketCount;
+};
+
+class LLPacketReplay
+{
+public:
+	LLPacketReplay();
+	~LLPacketReplay();
+
+	// Returns FALSE if the file can't be read or isn't a capture
+	BOOL open(const std::string& filename);
+	void close();
+	BOOL isOpen() const							{ return mFile != NULL; }
+
+	// The next packet, or FALSE at the end of the file (or at a record
+	// cut short, as the last one is if the viewer crashed while capturing)
+	BOOL read(LLCapturedPacket& packet);
+
+	// Back to the first packet
+	void rewind();
+
+private:
+	LLPacketReplay(const LLPacketReplay&);
+	LLPacketReplay& operator=(const LLPacketReplay&);
+
+	LLFILE*		mFile;
+	std::string	mFilename;
+	long		mFirstRecord;
+};
+
+#endif // LL_LLPACKETCAPTURE_H
@@ -55,7 +55,14 @@ LLPacketRing::LLPacketRing () :
 	mInBufferLength(0),
 	mOutBufferLength(0),
 	mDropPercentage(0.0f),
-	mPacketsToDrop(0x0)
+	mPacketsToDrop(0x0),
+	mUseBatching(FALSE),
+	mReceiveBatchCount(0),
+	mReceiveBatchNext(0),
+	mSendBatchCount(0),
+	mSendBatchFailures(0),
+	mSendBatchSocket(-1),
+	mBatchingSends(FALSE)
 {
 }
 
@@ -83,6 +90,10 @@ void LLPacketRing::cleanup ()
 		delete packetp;
 		mSendQueue.pop();
 	}
+
+	mReceiveBatchCount = mReceiveBatchNext = 0;
+	mSendBatchCount = mSendBatchFailures = 0;
+	mBatchingSends = FALSE;
 }
 
 ///////////////////////////////////////////////////////////
@@ -116,6 +127,11 @@ void LLPacketRing::setOutBandwidth(const F32 bps)
 {
 	mOutThrottle.setRate(bps);
 }
+
+void LLPacketRing::setUseBatching(const BOOL use_batching)
+{
+	mUseBatching = use_batching;
+}
 ///////////////////////////////////////////////////////////
 S32 LLPacketRing::receiveFromRing (S32 socket, char *datap)
 {
@@ -153,11 +169,61 @@ S32 LLPacketRing::receiveFromRing (S32 socket, char *datap)
 	return packet_size;
 }
 
+///////////////////////////////////////////////////////////
+S32 LLPacketRing::receiveFromBatch (S32 socket, char *datap)
+{
+	if (mReceiveBatchNext >= mReceiveBatchCount)
+	{
+		// Batch used up, refill it with whatever the socket has waiting
+		if (mReceiveBatch.empty())
+		{
+			mReceiveBatch.resize(NET_BATCH_SIZE);
+		}
+		mReceiveBatchCount = LLPacketBuffer::receiveBatch(socket, &mReceiveBatch[0], (S32)mReceiveBatch.size());
+		mReceiveBatchNext = 0;
+		if (!mReceiveBatchCount)
+		{
+			mLastReceivingIF = ::get_receiving_interface();
+			return 0;
+		}
+	}
+
+	const LLPacketBuffer& packet = mReceiveBatch[mReceiveBatchNext++];
+	S32 packet_size = packet.getSize();
+	memcpy(datap, packet.getData(), packet_size);	/*Flawfinder: ignore*/
+	mLastSender = packet.getHost();
+	mLastReceivingIF = packet.getReceivingInterface();
+	return packet_size;
+}
+
+S32 LLPacketRing::receiveFromReplay(char *datap)
+{
+	if (!mReplay.read(mReplayPacket))
+	{
+		return 0;
+	}
+
+	S32 packet_size = (S32)mReplayPacket.mData.size();
+	if (packet_size)
+	{
+		memcpy(datap, &mReplayPacket.mData[0], packet_size);		/* Flawfinder: ignore */
+	}
+	mLastSender = mReplayPacket.mSender;
+	mLastReceivingIF = mReplayPacket.mReceivingIF;
+	mActualBitsIn += packet_size * 8;
+	return packet_size;
+}
+
 ///////////////////////////////////////////////////////////
 S32 LLPacketRing::receivePacket (S32 socket, char *datap)
 {
 	S32 packet_size = 0;
 
+	if (mReplay.isOpen())
+	{
+		return receiveFromReplay(datap);
+	}
+
 	// If using the throttle, simulate a limited size input buffer.
 	if (mUseInThrottle)
 	{
@@ -243,15 +309,20 @@ S32 LLPacketRing::receivePacket (S32 socket, char *datap)
 			{
 				packet_size = 0;
 			}
+			mLastReceivingIF = ::get_receiving_interface();
+		}
+		else if (mUseBatching || mReceiveBatchNext < mReceiveBatchCount)
+		{
+			// Also drains what's left after batching gets turned off
+			packet_size = receiveFromBatch(socket, datap);
 		}
 		else
 		{
 			packet_size = receive_packet(socket, datap);
 			mLastSender = ::get_sender();
+			mLastReceivingIF = ::get_receiving_interface();
 		}
 
-		mLastReceivingIF = ::get_receiving_interface();
-
 		if (packet_size)  // did we actually get a packet?
 		{
 			if (mDropPercentage && (ll_frand(100.f) < mDropPercentage))
@@ -267,12 +338,42 @@ S32 LLPacketRing::receivePacket (S32 socket, char *datap)
 		}
 	}
 
+	if (packet_size && mCapture.isOpen())
+	{
+		mCapture.write(datap, packet_size, mLastSender, mLastReceivingIF);
+	}
+
 	return packet_size;
 }
 
+BOOL LLPacketRing::startCapture(const std::string& filename)
+{
+	return mCapture.open(filename);
+}
+
+void LLPacketRing::stopCapture()
+{
+	mCapture.close();
+}
+
+BOOL LLPacketRing::startReplay(const std::string& filename)
+{
+	return mReplay.open(filename);
+}
+
+void LLPacketRing::stopReplay()
+{
+	mReplay.close();
+}
+
 BOOL LLPacketRing::sendPacket(int h_socket, char * send_buffer, S32 buf_size, LLHost host)
 {
 	BOOL status = TRUE;
+	if (mReplay.isOpen())
+	{
+		// nobody to send to
+		return status;
+	}
 	if (!mUseOutThrottle)
 	{
 		return sendPacketImpl(h_socket, send_buffer, buf_size, host );
@@ -344,11 +445,48 @@ BOOL LLPacketRing::sendPacket(int h_socket, char * send_buffer, S32 buf_size, LL
 	return status;
 }
 
+void LLPacketRing::beginSendBatch()
+{
+	mBatchingSends = mUseBatching;
+}
+
+S32 LLPacketRing::flushSendBatch()
+{
+	sendBatch();
+	S32 failures = mSendBatchFailures;
+	mSendBatchFailures = 0;
+	mBatchingSends = FALSE;
+	return failures;
+}
+
+void LLPacketRing::sendBatch()
+{
+	if (mSendBatchCount)
+	{
+		mSendBatchFailures += LLPacketBuffer::sendBatch(mSendBatchSocket, &mSendBatch[0], mSendBatchCount);
+		mSendBatchCount = 0;
+	}
+}
+
 BOOL LLPacketRing::sendPacketImpl(int h_socket, const char * send_buffer, S32 buf_size, LLHost host)
 {
 	
 	if (!LLProxy::isSOCKSProxyEnabled())
 	{
+		if (mBatchingSends)
+		{
+			if (mSendBatch.empty())
+			{
+				mSendBatch.resize(NET_BATCH_SIZE);
+			}
+			if (mSendBatchCount == (S32)mSendBatch.size() || h_socket != mSendBatchSocket)
+			{
+				sendBatch();
+			}
+			mSendBatch[mSendBatchCount++].init(host, send_buffer, buf_size);
+			mSendBatchSocket = h_socket;
+			return TRUE;
+		}
 		return send_packet(h_socket, send_buffer, buf_size, host.getAddress(), host.getPort());
 	}
 
@@ -28,10 +28,13 @@
 #ifndef LL_LLPACKETRING_H
 #define LL_LLPACKETRING_H
 
+#include <atomic>
 #include <queue>
+#include <vector>
 
 #include "llhost.h"
 #include "llpacketbuffer.h"
+#include "llpacketcapture.h"
 #include "llproxy.h"
 #include "llthrottle.h"
 #include "net.h"
@@ -50,15 +53,35 @@ public:
 	void setUseOutThrottle(const BOOL use_throttle);
 	void setInBandwidth(const F32 bps);
 	void setOutBandwidth(const F32 bps);
+	void setUseBatching(const BOOL use_batching);
 	S32  receivePacket (S32 socket, char *datap);
 	S32  receiveFromRing (S32 socket, char *datap);
+	S32  receiveFromBatch (S32 socket, char *datap);
 
 	BOOL sendPacket(int h_socket, char * send_buffer, S32 buf_size, LLHost host);
 
+	// With batching on, packets sent between these two calls go out together
+	// at flushSendBatch(), which returns how many of them failed to send.
+	// sendPacket() reports success for the packets it holds back.
+	void beginSendBatch();
+	S32  flushSendBatch();
+
+	// Writes every packet receivePacket() returns to filename as well
+	BOOL startCapture(const std::string& filename);
+	void stopCapture();
+
+	// Until stopReplay(), receivePacket() returns the packets captured in
+	// filename instead of reading the socket, and sendPacket() drops
+	// everything. Not for use with the message receive thread, which waits
+	// on the socket.
+	BOOL startReplay(const std::string& filename);
+	void stopReplay();
+	BOOL isReplaying() const					{ return mReplay.isOpen(); }
+
 	inline LLHost getLastSender();
 	inline LLHost getLastReceivingInterface();
 
-	S32 getAndResetActualInBits()				{ S32 bits = mActualBitsIn; mActualBitsIn = 0; return bits;}
+	S32 getAndResetActualInBits()				{ return mActualBitsIn.exchange(0);}
 	S32 getAndResetActualOutBits()				{ S32 bits = mActualBitsOut; mActualBitsOut = 0; return bits;}
 protected:
 	BOOL mUseInThrottle;
@@ -68,23 +91,42 @@ protected:
 	LLThrottle mInThrottle;
 	LLThrottle mOutThrottle;
 
-	S32 mActualBitsIn;
+	// These two are touched from the message receive thread as well, if
+	// it's running; the rest of the receive side belongs to that thread.
+	std::atomic<S32> mActualBitsIn;
 	S32 mActualBitsOut;
 	S32 mMaxBufferLength;			// How much data can we queue up before dropping data.
 	S32 mInBufferLength;			// Current incoming buffer length
 	S32 mOutBufferLength;			// Current outgoing buffer length
 
 	F32 mDropPercentage;			// % of packets to drop
-	U32 mPacketsToDrop;				// drop next n packets
+	std::atomic<U32> mPacketsToDrop;	// drop next n packets
 
 	std::queue<LLPacketBuffer *> mReceiveQueue;
 	std::queue<LLPacketBuffer *> mSendQueue;
 
+	// Receive/send with one system call per NET_BATCH_SIZE packets
+	BOOL mUseBatching;
+	std::vector<LLPacketBuffer> mReceiveBatch;
+	S32 mReceiveBatchCount;			// packets in mReceiveBatch
+	S32 mReceiveBatchNext;			// next one to hand out
+	std::vector<LLPacketBuffer> mSendBatch;
+	S32 mSendBatchCount;
+	S32 mSendBatchFailures;
+	S32 mSendBatchSocket;
+	BOOL mBatchingSends;
+
 	LLHost mLastSender;
 	LLHost mLastReceivingIF;
 
+	LLPacketCapture mCapture;
+	LLPacketReplay mReplay;
+	LLCapturedPacket mReplayPacket;
+
 private:
+	S32  receiveFromReplay(char *datap);
 	BOOL sendPacketImpl(int h_socket, const char * send_buffer, S32 buf_size, LLHost host);
+	void sendBatch();
 };
 
 
@@ -61,6 +61,7 @@ void LLTemplateMessageReader::clearMessage()
 	mCurrentRMessageTemplate = NULL;
 	delete mCurrentRMessageData;
 	mCurrentRMessageData = NULL;
+	mArena.reset();
 }
 
 void LLTemplateMessageReader::getData(const char *blockname, const char *varname, void *datap, S32 size, S32 blocknum, S32 max_size)
@@ -442,23 +443,20 @@ S32 LLTemplateMessageReader::getMessageSize() const
 	return mReceiveSize;
 }
 
-// Returns template for the message contained in buffer
-BOOL LLTemplateMessageReader::decodeTemplate(  
-		const U8* buffer, S32 buffer_size,  // inputs
-		LLMessageTemplate** msg_template ) // outputs
+// Returns the number of the message contained in buffer, FALSE if the
+// packet is too short to hold one
+//static
+BOOL LLTemplateMessageReader::decodeMessageNumber(const U8* buffer, S32 buffer_size, U32& num)
 {
 	const U8* header = buffer + LL_PACKET_ID_SIZE;
 
-	// is there a message ready to go?
+	num = 0;
+
 	if (buffer_size <= 0)
 	{
-		LL_WARNS() << "No message waiting for decode!" << LL_ENDL;
 		return(FALSE);
 	}
-
-	U32 num = 0;
-
-	if (header[0] != 255)
+	else if (header[0] != 255)
 	{
 		// high frequency message
 		num = header[0];
@@ -486,6 +484,26 @@ BOOL LLTemplateMessageReader::decodeTemplate(
 		num = 0xFFFF0000 | message_id_U16;
 	}
 	else // bogus packet received (too short)
+	{
+		return(FALSE);
+	}
+	return(TRUE);
+}
+
+// Returns template for the message contained in buffer
+BOOL LLTemplateMessageReader::decodeTemplate(  
+		const U8* buffer, S32 buffer_size,  // inputs
+		LLMessageTemplate** msg_template ) // outputs
+{
+	// is there a message ready to go?
+	if (buffer_size <= 0)
+	{
+		LL_WARNS() << "No message waiting for decode!" << LL_ENDL;
+		return(FALSE);
+	}
+
+	U32 num = 0;
+	if (!decodeMessageNumber(buffer, buffer_size, num))
 	{
 		LL_WARNS() << "Packet with unusable length received (too short): "
 				<< buffer_size << LL_ENDL;
@@ -530,28 +548,24 @@ void LLTemplateMessageReader::logRanOffEndOfPacket( const LLHost& host, const S3
 
 static LLTrace::BlockTimerStatHandle FTM_PROCESS_MESSAGES("Process Messages");
 
-// decode a given message
-BOOL LLTemplateMessageReader::decodeData(const U8* buffer, const LLHost& sender )
+// decode the blocks of a given message
+LLMsgData* LLTemplateMessageReader::decodeBlocks(const U8* buffer, S32 buffer_size,
+												 const LLMessageTemplate* msg_template,
+												 LLMsgDataArena* arena,
+												 const LLHost& sender, bool* ran_off_end)
 {
-    LL_RECORD_BLOCK_TIME(FTM_PROCESS_MESSAGES);
-
-	llassert( mReceiveSize >= 0 );
-	llassert( mCurrentRMessageTemplate);
-	llassert( !mCurrentRMessageData );
-	delete mCurrentRMessageData; // just to make sure
-
 	// The offset tells us how may bytes to skip after the end of the
 	// message name.
 	U8 offset = buffer[PHL_OFFSET];
-	S32 decode_pos = LL_PACKET_ID_SIZE + (S32)(mCurrentRMessageTemplate->mFrequency) + offset;
+	S32 decode_pos = LL_PACKET_ID_SIZE + (S32)(msg_template->mFrequency) + offset;
 
 	// create base working data set
-	mCurrentRMessageData = new LLMsgData(mCurrentRMessageTemplate->mName);
+	LLMsgData* msg_data = new LLMsgData(msg_template->mName, arena);
 	
 	// loop through the template building the data structure as we go
 	LLMessageTemplate::message_block_map_t::const_iterator iter;
-	for(iter = mCurrentRMessageTemplate->mMemberBlocks.begin();
-		iter != mCurrentRMessageTemplate->mMemberBlocks.end();
+	for(iter = msg_template->mMemberBlocks.begin();
+		iter != msg_template->mMemberBlocks.end();
 		++iter)
 	{
 		LLMessageBlock* mbci = *iter;
@@ -574,7 +588,7 @@ BOOL LLTemplateMessageReader::decodeData(const U8* buffer, const LLHost& sender
 		{
 			// need to read the number from the message
 			// repeat number is a single byte
-			if (decode_pos >= mReceiveSize)
+			if (decode_pos >= buffer_size)
 			{
 				// commented out - hetgrid says that missing variable blocks
 				// at end of message are legal
@@ -592,7 +606,8 @@ BOOL LLTemplateMessageReader::decodeData(const U8* buffer, const LLHost& sender
 		else
 		{
 			LL_ERRS() << "Unknown block type" << LL_ENDL;
-			return FALSE;
+			delete msg_data;
+			return NULL;
 		}
 
 		LLMsgBlkData* cur_data_block = NULL;
@@ -604,16 +619,16 @@ BOOL LLTemplateMessageReader::decodeData(const U8* buffer, const LLHost& sender
 			{
 				// build new name to prevent collisions
 				// TODO: This should really change to a vector
-				cur_data_block = new LLMsgBlkData(mbci->mName, repeat_number);
+				cur_data_block = msg_data->createBlock(mbci->mName, repeat_number);
 				cur_data_block->mName = mbci->mName + i;
 			}
 			else
 			{
-				cur_data_block = new LLMsgBlkData(mbci->mName, repeat_number);
+				cur_data_block = msg_data->createBlock(mbci->mName, repeat_number);
 			}
 
 			// add the block to the message
-			mCurrentRMessageData->addBlock(cur_data_block);
+			msg_data->addBlock(cur_data_block);
 
 			// now read the variables
 			for (LLMessageBlock::message_variable_map_t::const_iterator iter = 
@@ -635,9 +650,16 @@ BOOL LLTemplateMessageReader::decodeData(const U8* buffer, const LLHost& sender
 					U16 tsizeh = 0;
 					U32 tsize = 0;
 
-					if ((decode_pos + data_size) > mReceiveSize)
+					if ((decode_pos + data_size) > buffer_size)
 					{
-						logRanOffEndOfPacket(sender, decode_pos, data_size);
+						if (ran_off_end)
+						{
+							*ran_off_end = true;
+						}
+						else
+						{
+							logRanOffEndOfPacket(sender, decode_pos, data_size);
+						}
 
 						// default to 0 length variable blocks
 						tsize = 0;
@@ -671,9 +693,16 @@ BOOL LLTemplateMessageReader::decodeData(const U8* buffer, const LLHost& sender
 				{
 					// fixed!
 					// so, copy data pointer and set data size to fixed size
-					if ((decode_pos + mvci.getSize()) > mReceiveSize)
+					if ((decode_pos + mvci.getSize()) > buffer_size)
 					{
-						logRanOffEndOfPacket(sender, decode_pos, mvci.getSize());
+						if (ran_off_end)
+						{
+							*ran_off_end = true;
+						}
+						else
+						{
+							logRanOffEndOfPacket(sender, decode_pos, mvci.getSize());
+						}
 
 						// default to 0s.
 						U32 size = mvci.getSize();
@@ -694,6 +723,27 @@ BOOL LLTemplateMessageReader::decodeData(const U8* buffer, const LLHost& sender
 		}
 	}
 
+	return msg_data;
+}
+
+// decode a given message
+BOOL LLTemplateMessageReader::decodeData(const U8* buffer, const LLHost& sender, LLMsgData* decoded )
+{
+    LL_RECORD_BLOCK_TIME(FTM_PROCESS_MESSAGES);
+
+	llassert( mReceiveSize >= 0 );
+	llassert( mCurrentRMessageTemplate);
+	llassert( !mCurrentRMessageData );
+	delete mCurrentRMessageData; // just to make sure
+	mArena.reset();
+
+	mCurrentRMessageData = decoded ? decoded :
+		decodeBlocks(buffer, mReceiveSize, mCurrentRMessageTemplate, &mArena, sender);
+	if (!mCurrentRMessageData)
+	{
+		return FALSE;
+	}
+
 	if (mCurrentRMessageData->mMemberBlocks.empty()
 		&& !mCurrentRMessageTemplate->mMemberBlocks.empty())
 	{
@@ -787,9 +837,43 @@ BOOL LLTemplateMessageReader::validateMessage(const U8* buffer,
 }
 
 BOOL LLTemplateMessageReader::readMessage(const U8* buffer, 
-										  const LLHost& sender)
+										  const LLHost& sender,
+										  LLMsgData* decoded)
+{
+	if (decoded && decoded->mName != getMessageName())
+	{
+		// decoded with some other template: don't trust it
+		delete decoded;
+		decoded = NULL;
+	}
+	return decodeData(buffer, sender, decoded);
+}
+
+LLMsgData* LLTemplateMessageReader::predecode(const U8* buffer, S32 buffer_size,
+											  LLMsgDataArena* arena)
 {
-	return decodeData(buffer, sender);
+	U32 num = 0;
+	if (buffer_size < (S32)LL_MINIMUM_VALID_PACKET_SIZE
+		|| !decodeMessageNumber(buffer, buffer_size, num))
+	{
+		return NULL;
+	}
+	LLMessageTemplate* temp = get_ptr_in_map(mMessageNumbers, num);
+	if (!temp)
+	{
+		return NULL;
+	}
+
+	bool ran_off_end = false;
+	LLMsgData* msg_data = decodeBlocks(buffer, buffer_size, temp, arena, LLHost(), &ran_off_end);
+	if (ran_off_end || !msg_data
+		|| (msg_data->mMemberBlocks.empty() && !temp->mMemberBlocks.empty()))
+	{
+		// leave the complaining to readMessage()
+		delete msg_data;
+		return NULL;
+	}
+	return msg_data;
 }
 
 //virtual 
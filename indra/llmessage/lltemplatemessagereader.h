@@ -28,6 +28,7 @@
 #define LL_LLTEMPLATEMESSAGEREADER_H
 
 #include "llmessagereader.h"
+#include "llmsgdataarena.h"
 
 #include <map>
 
@@ -100,7 +101,16 @@ public:
 
 	BOOL validateMessage(const U8* buffer, S32 buffer_size, 
 						 const LLHost& sender, bool trusted = false);
-	BOOL readMessage(const U8* buffer, const LLHost& sender);
+	// decoded, if any, is this message's predecode() result, which the
+	// reader takes ownership of
+	BOOL readMessage(const U8* buffer, const LLHost& sender,
+					 LLMsgData* decoded = NULL);
+
+	// Decodes the blocks of the message in buffer into arena without
+	// reporting anything or changing the current message, so that another
+	// thread can do it ahead of readMessage(). Returns NULL for messages
+	// that need readMessage() to decode them, such as unknown or short ones.
+	LLMsgData* predecode(const U8* buffer, S32 buffer_size, LLMsgDataArena* arena);
 
 	bool isTrusted() const;
 	bool isBanned(bool trusted_source) const;
@@ -111,17 +121,27 @@ private:
 	void getData(const char *blockname, const char *varname, void *datap, 
 				 S32 size = 0, S32 blocknum = 0, S32 max_size = S32_MAX);
 
+	static BOOL decodeMessageNumber(const U8* buffer, S32 buffer_size, U32& num);
 	BOOL decodeTemplate(const U8* buffer, S32 buffer_size,  // inputs
 						LLMessageTemplate** msg_template ); // outputs
 
 	void logRanOffEndOfPacket( const LLHost& host, const S32 where, const S32 wanted );
 
-	BOOL decodeData(const U8* buffer, const LLHost& sender );
+	// Reports running off the end of the packet, unless ran_off_end is
+	// given to be set instead
+	LLMsgData* decodeBlocks(const U8* buffer, S32 buffer_size,
+							const LLMessageTemplate* msg_template, LLMsgDataArena* arena,
+							const LLHost& sender, bool* ran_off_end = NULL);
+	BOOL decodeData(const U8* buffer, const LLHost& sender, LLMsgData* decoded );
 
 	S32	mReceiveSize;
 	LLMessageTemplate* mCurrentRMessageTemplate;
 	LLMsgData* mCurrentRMessageData;
 	message_template_number_map_t& mMessageNumbers;
+
+	// Holds mCurrentRMessageData's blocks until clearMessage(), unless it
+	// was predecoded
+	LLMsgDataArena mArena;
 };
 
 #endif // LL_LLTEMPLATEMESSAGEREADER_H
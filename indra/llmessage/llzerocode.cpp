@@ -0,0 +1,249 @@
+/**
+ * @file llzerocode.cpp
+ * @brief Zero-coding of template message packets.
+ *
+ * $LicenseInfo:firstyear=2024&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2024, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+
+#include "llzerocode.h"
+
+#include "llcircuit.h"
+#include "llmath.h"
+#include "llsimdmath.h"
+
+// Longest zero run one 0 [count] pair stands for
+static const S32 MAX_ZERO_RUN = 255;
+
+// The first zero byte at or after p, or end
+static inline const U8* find_zero(const U8* p, const U8* end)
+{
+	const __m128i zero = _mm_setzero_si128();
+	while (end - p >= 16)
+	{
+		U32 mask = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)p), zero));
+		if (mask)
+		{
+			return p + ll_lowest_set_bit(mask);
+		}
+		p += 16;
+	}
+	while (p < end && *p)
+	{
+		++p;
+	}
+	return p;
+}
+
+// The first non-zero byte at or after p, or end
+static inline const U8* find_non_zero(const U8* p, const U8* end)
+{
+	const __m128i zero = _mm_setzero_si128();
+	while (end - p >= 16)
+	{
+		U32 mask = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)p), zero)) ^ 0xffff;
+		if (mask)
+		{
+			return p + ll_lowest_set_bit(mask);
+		}
+		p += 16;
+	}
+	while (p < end && !*p)
+	{
+		++p;
+	}
+	return p;
+}
+
+S32 LLZeroCode::encode(const U8* in, S32 in_size, U8* out)
+{
+	if (in_size <= LL_PACKET_ID_SIZE)
+	{
+		memcpy(out, in, in_size);		/* Flawfinder: ignore */
+		return in_size;
+	}
+
+	// the packet id field goes as is
+	memcpy(out, in, LL_PACKET_ID_SIZE);		/* Flawfinder: ignore */
+	U8* outptr = out + LL_PACKET_ID_SIZE;
+
+	const U8* inptr = in + LL_PACKET_ID_SIZE;
+	const U8* in_end = in + in_size;
+	while (inptr < in_end)
+	{
+		// Copies 16 bytes at a time, then backs up to the first zero. out
+		// has room for twice what's left of in, so the overshoot fits.
+		const __m128i zero = _mm_setzero_si128();
+		while (in_end - inptr >= 16)
+		{
+			__m128i chunk = _mm_loadu_si128((const __m128i*)inptr);
+			_mm_storeu_si128((__m128i*)outptr, chunk);
+			U32 mask = _mm_movemask_epi8(_mm_cmpeq_epi8(chunk, zero));
+			if (mask)
+			{
+				S32 length = ll_lowest_set_bit(mask);
+				inptr += length;
+				outptr += length;
+				break;
+			}
+			inptr += 16;
+			outptr += 16;
+		}
+		while (inptr < in_end && *inptr)
+		{
+			*outptr++ = *inptr++;
+		}
+		if (inptr == in_end)
+		{
+			break;
+		}
+
+		const U8* run_start = inptr;
+		inptr = find_non_zero(inptr, in_end);
+		S32 run = (S32)(inptr - run_start);
+		for (; run >= MAX_ZERO_RUN; run -= MAX_ZERO_RUN)
+		{
+			*outptr++ = 0;
+			*outptr++ = (U8)MAX_ZERO_RUN;
+		}
+		if (run)
+		{
+			*outptr++ = 0;
+			*outptr++ = (U8)run;
+		}
+	}
+	return (S32)(outptr - out);
+}
+
+S32 LLZeroCode::encodedSize(const U8* in, S32 in_size)
+{
+	if (in_size <= LL_PACKET_ID_SIZE)
+	{
+		return in_size;
+	}
+
+	S32 size = LL_PACKET_ID_SIZE;
+	const U8* inptr = in + LL_PACKET_ID_SIZE;
+	const U8* in_end = in + in_size;
+	while (inptr < in_end)
+	{
+		const U8* zero = find_zero(inptr, in_end);
+		size += (S32)(zero - inptr);
+		if (zero == in_end)
+		{
+			break;
+		}
+
+		inptr = find_non_zero(zero, in_end);
+		S32 run = (S32)(inptr - zero);
+		size += 2 * ((run + MAX_ZERO_RUN - 1) / MAX_ZERO_RUN);
+	}
+	return size;
+}
+
+// Fails in exactly the places the byte at a time expansion in
+// LLMessageSystem::zeroCodeExpand() always has, but checks before writing.
+S32 LLZeroCode::expand(const U8* in, S32 in_size, U8* out, S32 out_size)
+{
+	if (in_size < LL_PACKET_ID_SIZE || out_size < LL_PACKET_ID_SIZE)
+	{
+		return -1;
+	}
+
+	memcpy(out, in, LL_PACKET_ID_SIZE);		/* Flawfinder: ignore */
+	S32 out_pos = LL_PACKET_ID_SIZE;
+
+	const U8* inptr = in + LL_PACKET_ID_SIZE;
+	const U8* in_end = in + in_size;
+	while (inptr < in_end)
+	{
+		// As in encode(), but only while out has room for the overshoot
+		const __m128i zero = _mm_setzero_si128();
+		while (in_end - inptr >= 16 && out_size - out_pos >= 16)
+		{
+			__m128i chunk = _mm_loadu_si128((const __m128i*)inptr);
+			_mm_storeu_si128((__m128i*)(out + out_pos), chunk);
+			U32 mask = _mm_movemask_epi8(_mm_cmpeq_epi8(chunk, zero));
+			if (mask)
+			{
+				S32 length = ll_lowest_set_bit(mask);
+				inptr += length;
+				out_pos += length;
+				break;
+			}
+			inptr += 16;
+			out_pos += 16;
+		}
+		while (inptr < in_end && *inptr)
+		{
+			if (out_pos >= out_size)
+			{
+				return -1;
+			}
+			out[out_pos++] = *inptr++;
+		}
+		if (inptr == in_end)
+		{
+			break;
+		}
+
+		if (out_pos >= out_size)
+		{
+			return -1;
+		}
+		out[out_pos++] = 0;
+		++inptr;
+
+		// 0 0 is a wrap: each further 0 stands for 256 zeroes
+		while (inptr < in_end && !*inptr)
+		{
+			if (out_pos + 1 > out_size - 256)
+			{
+				return -1;
+			}
+			memset(out + out_pos, 0, 256);
+			out_pos += 256;
+			++inptr;
+		}
+		if (inptr == in_end)
+		{
+			break;
+		}
+
+		S32 run = *inptr++;
+		if (out_pos > out_size - run)
+		{
+			return -1;
+		}
+		if (run <= 16 && out_size - out_pos >= 16)
+		{
+			_mm_storeu_si128((__m128i*)(out + out_pos), _mm_setzero_si128());
+		}
+		else
+		{
+			memset(out + out_pos, 0, run - 1);
+		}
+		out_pos += run - 1;
+	}
+	return out_pos;
+}
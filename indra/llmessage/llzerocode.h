@@ -0,0 +1,57 @@
+/**
+ * @file llzerocode.h
+ * @brief Zero-coding of template message packets.
+ *
+ * @Description:
+ * Zero-coded packets keep their LL_PACKET_ID_SIZE header as is; after it
+ * every run of zero bytes becomes a 0 followed by the run length, with runs
+ * longer than 255 split into 255s (so 300 zeroes are 0 255 0 45).
+ *
+ * The scans for the next zero and the next non-zero byte look at 16 bytes
+ * at a time with SSE2, so the non-zero stretches between runs are copied
+ * in bulk rather than byte by byte. Builds without SSE2 scan byte by byte.
+ * Either way the output is the same, byte for byte, as the loops this
+ * replaced in LLTemplateMessageBuilder and LLMessageSystem.
+ *
+ * $LicenseInfo:firstyear=2024&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2024, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#ifndef LL_LLZEROCODE_H
+#define LL_LLZEROCODE_H
+
+namespace LLZeroCode
+{
+	// Encodes in_size bytes of packet, header included, to out, which must
+	// have room for 2 * in_size bytes. Returns the encoded size, which is
+	// only worth sending if it's smaller than in_size.
+	S32 encode(const U8* in, S32 in_size, U8* out);
+
+	// What encode() would return, without writing anything
+	S32 encodedSize(const U8* in, S32 in_size);
+
+	// Expands in_size bytes of zero-coded packet to out. Returns the
+	// expanded size, or -1 if the packet is shorter than its header or
+	// would expand past out_size.
+	S32 expand(const U8* in, S32 in_size, U8* out, S32 out_size);
+}
+
+#endif // LL_LLZEROCODE_H
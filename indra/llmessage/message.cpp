@@ -55,6 +55,7 @@
 #include "llmd5.h"
 #include "llmessagebuilder.h"
 #include "llmessageconfig.h"
+#include "llmessagereceivethread.h"
 #include "lltemplatemessagedispatcher.h"
 #include "llpumpio.h"
 #include "lltemplatemessagebuilder.h"
@@ -70,6 +71,7 @@
 #include "lltransfermanager.h"
 #include "lluuid.h"
 #include "llxfermanager.h"
+#include "llzerocode.h"
 #include "llquaternion.h"
 #include "u64.h"
 #include "v3dmath.h"
@@ -89,6 +91,9 @@ static const S32 TRUST_TIME_WINDOW = 3;
 // *NOTE: I don't think it's important that the messgage system tracks
 // this since it must get set externally. 2004.08.25 Phoenix.
 static std::string g_shared_secret;
+
+static LLTrace::SampleStatHandle<> sReceiveQueueDepth("messagereceivequeue", "Packets waiting for checkMessages() in the receive thread's queue");
+static LLTrace::EventStatHandle<F64Milliseconds> sReceiveLatency("messagereceivelatency", "Time from reading a packet off the socket to checkMessages() picking it up");
 std::string get_shared_secret();
 
 class LLMessagePollInfo
@@ -318,6 +323,9 @@ void LLMessageSystem::loadTemplateFile(const std::string& filename, bool failure
 
 LLMessageSystem::~LLMessageSystem()
 {
+	// the thread reads with our templates and socket
+	stopReceiveThread();
+
 	mMessageTemplates.clear(); // don't delete templates.
 	for_each(mMessageNumbers.begin(), mMessageNumbers.end(), DeletePairedPointer());
 	mMessageNumbers.clear();
@@ -355,12 +363,23 @@ void LLMessageSystem::clearReceiveState()
 	mLastSender.invalidate();
 	mLastReceivingIF.invalidate();
 	mMessageReader->clearMessage();
+	if (mCurrentPacket)
+	{
+		// done with the data in its arena
+		mTemplateMessageReader->clearMessage();
+		mCurrentPacket.reset();
+	}
 	mLastMessageFromTrustedMessageService = false;
 }
 
 
 BOOL LLMessageSystem::poll(F32 seconds)
 {
+	if (mReceiveThread)
+	{
+		return mReceiveThread->waitForPacket(seconds);
+	}
+
 	S32 num_socks;
 	apr_status_t status;
 	status = apr_poll(&(mPollInfop->mPollFD), 1, &num_socks,(U64)(seconds*1000000.f));
@@ -378,6 +397,27 @@ BOOL LLMessageSystem::poll(F32 seconds)
 	}
 }
 
+void LLMessageSystem::startReceiveThread()
+{
+	if (mbError || mReceiveThread)
+	{
+		return;
+	}
+	LL_INFOS("Messaging") << "Starting message receive thread" << LL_ENDL;
+	mReceiveThread.reset(new LLMessageReceiveThread(mPacketRing, mSocket, mMessageNumbers));
+}
+
+void LLMessageSystem::stopReceiveThread()
+{
+	if (mReceiveThread)
+	{
+		// Whatever it still has queued is dropped, as though it had
+		// never been read off the socket.
+		LL_INFOS("Messaging") << "Stopping message receive thread" << LL_ENDL;
+		mReceiveThread.reset();
+	}
+}
+
 bool LLMessageSystem::isTrustedSender(const LLHost& host) const
 {
 	LLCircuitData* cdp = mCircuitInfo.findCircuit(host);
@@ -494,6 +534,11 @@ BOOL LLMessageSystem::checkMessages(LockMessageChecker&, S64 frame_count )
 		// we must be starting the message processing loop.  Reset the timers.
 		mCurrentMessageTime = totalTime();
 		mMessageCountTime = getMessageTimeSeconds();
+
+		if (mReceiveThread)
+		{
+			sample(sReceiveQueueDepth, mReceiveThread->getQueueDepth());
+		}
 	}
 
 	// loop until either no packets or a valid packet
@@ -510,13 +555,30 @@ BOOL LLMessageSystem::checkMessages(LockMessageChecker&, S64 frame_count )
 
 		U8* buffer = mTrueReceiveBuffer;
 		
-		mTrueReceiveSize = mPacketRing.receivePacket(mSocket, (char *)mTrueReceiveBuffer);
+		LLReceivedPacket* packet = NULL;
+		if (mReceiveThread)
+		{
+			mCurrentPacket = mReceiveThread->popPacket();
+			packet = mCurrentPacket.get();
+			mTrueReceiveSize = packet ? (S32)packet->mData.size() : 0;
+			if (packet)
+			{
+				memcpy(mTrueReceiveBuffer, packet->mData.data(), mTrueReceiveSize);	/* Flawfinder: ignore */
+				mLastSender = packet->mSender;
+				mLastReceivingIF = packet->mReceivingIF;
+				record(sReceiveLatency, F64Microseconds(F64(totalTime() - packet->mReceivedUsecs)));
+			}
+		}
+		else
+		{
+			mTrueReceiveSize = mPacketRing.receivePacket(mSocket, (char *)mTrueReceiveBuffer);
+			mLastSender = mPacketRing.getLastSender();
+			mLastReceivingIF = mPacketRing.getLastReceivingInterface();
+		}
 		// If you want to dump all received packets into SecondLife.log, uncomment this
 		//dumpPacketToLog();
 		
 		receive_size = mTrueReceiveSize;
-		mLastSender = mPacketRing.getLastSender();
-		mLastReceivingIF = mPacketRing.getLastReceivingInterface();
 		
 		if (receive_size < (S32) LL_MINIMUM_VALID_PACKET_SIZE)
 		{
@@ -557,7 +619,24 @@ BOOL LLMessageSystem::checkMessages(LockMessageChecker&, S64 frame_count )
 			}
 
 			// process the message as normal
-			mIncomingCompressedSize = zeroCodeExpand(&buffer, &receive_size);
+			if (packet && !packet->mExpanded.empty())
+			{
+				// the receive thread expanded it already: just do the accounting
+				mTotalBytesIn += receive_size;
+				mCompressedPacketsIn++;
+				mCompressedBytesIn += receive_size;
+				mIncomingCompressedSize = receive_size;
+				buffer[0] &= (~LL_ZERO_CODE_FLAG);
+
+				receive_size = (S32)packet->mExpanded.size();
+				memcpy(mEncodedRecvBuffer, packet->mExpanded.data(), receive_size);	/* Flawfinder: ignore */
+				buffer = mEncodedRecvBuffer;
+				mUncompressedBytesIn += receive_size;
+			}
+			else
+			{
+				mIncomingCompressedSize = zeroCodeExpand(&buffer, &receive_size);
+			}
 			mCurrentRecvPacketID = ntohl(*((U32*)(&buffer[1])));
 			host = getSender();
 
@@ -680,7 +759,8 @@ BOOL LLMessageSystem::checkMessages(LockMessageChecker&, S64 frame_count )
 			if( valid_packet )
 			{
 				logValidMsg(cdp, host, recv_reliable, recv_resent, (BOOL)(acks>0) );
-				valid_packet = mTemplateMessageReader->readMessage(buffer, host);
+				valid_packet = mTemplateMessageReader->readMessage(
+					buffer, host, packet ? packet->mDecoded.release() : NULL);
 			}
 
 			// It's possible that the circuit went away, because ANY message can disable the circuit
@@ -770,6 +850,9 @@ void LLMessageSystem::processAcks(LockMessageChecker&, F32 collect_time)
 		// Check the status of circuits
 		mCircuitInfo.updateWatchDogTimers(this);
 
+		// Resends, acks and denials go out together, a batch per syscall
+		mPacketRing.beginSendBatch();
+
 		//resend any necessary packets
 		mCircuitInfo.resendUnackedPackets(mUnackedListDepth, mUnackedListSize);
 
@@ -786,6 +869,8 @@ void LLMessageSystem::processAcks(LockMessageChecker&, F32 collect_time)
 			mDenyTrustedCircuitSet.clear();
 		}
 
+		mSendPacketFailureCount += mPacketRing.flushSendBatch();
+
 		if (mMaxMessageCounts >= 0)
 		{
 			if (mNumMessageCounts >= mMaxMessageCounts)
@@ -2756,54 +2841,7 @@ S32 LLMessageSystem::zeroCodeAdjustCurrentSendTotal()
 	// TODO: babbage: remove this horror
 	mMessageBuilder->setBuilt(FALSE);
 
-	S32 count = mSendSize;
-	
-	S32 net_gain = 0;
-	U8 num_zeroes = 0;
-	
-	U8 *inptr = (U8 *)mSendBuffer;
-
-// skip the packet id field
-
-	for (U32 ii = 0; ii < LL_PACKET_ID_SIZE; ++ii)
-	{
-		count--;
-		inptr++;
-	}
-
-// don't actually build, just test
-
-// sequential zero bytes are encoded as 0 [U8 count] 
-// with 0 0 [count] representing wrap (>256 zeroes)
-
-	while (count--)
-	{
-		if (!(*inptr))   // in a zero count
-		{
-			if (num_zeroes)
-			{
-				if (++num_zeroes > 254)
-				{
-					num_zeroes = 0;
-				}
-				net_gain--;   // subseqent zeroes save one
-			}
-			else
-			{
-				net_gain++;  // starting a zero count adds one
-				num_zeroes = 1;
-			}
-			inptr++;
-		}
-		else
-		{
-			if (num_zeroes)
-			{
-				num_zeroes = 0;
-			}
-			inptr++;
-		}
-	}
+	S32 net_gain = LLZeroCode::encodedSize(mSendBuffer, mSendSize) - mSendSize;
 	if (net_gain < 0)
 	{
 		return net_gain;
@@ -2814,7 +2852,11 @@ S32 LLMessageSystem::zeroCodeAdjustCurrentSendTotal()
 	}
 }
 
-
+// static
+S32 LLMessageSystem::zeroCodeExpand(const U8* in, S32 in_size, U8* out, S32 out_size)
+{
+	return LLZeroCode::expand(in, in_size, out, out_size);
+}
 
 S32 LLMessageSystem::zeroCodeExpand(U8** data, S32* data_size)
 {
@@ -2838,72 +2880,16 @@ S32 LLMessageSystem::zeroCodeExpand(U8** data, S32* data_size)
 	
 	*data[0] &= (~LL_ZERO_CODE_FLAG);
 
-	S32 count = (*data_size);  
-	
-	U8 *inptr = (U8 *)*data;
-	U8 *outptr = (U8 *)mEncodedRecvBuffer;
-
-// skip the packet id field
-
-	for (U32 ii = 0; ii < LL_PACKET_ID_SIZE; ++ii)
+	S32 expanded_size = LLZeroCode::expand(*data, *data_size, mEncodedRecvBuffer, MAX_BUFFER_SIZE);
+	if (expanded_size < 0)
 	{
-		count--;
-		*outptr++ = *inptr++;
+		LL_WARNS("Messaging") << "attempt to write past reasonable encoded buffer size" << LL_ENDL;
+		callExceptionFunc(MX_WROTE_PAST_BUFFER_SIZE);
+		expanded_size = 0;
 	}
 
-// reconstruct encoded packet, keeping track of net size gain
-
-// sequential zero bytes are encoded as 0 [U8 count] 
-// with 0 0 [count] representing wrap (>256 zeroes)
-
-	while (count--)
-	{
-		if (outptr > (&mEncodedRecvBuffer[MAX_BUFFER_SIZE-1]))
-		{
-			LL_WARNS("Messaging") << "attempt to write past reasonable encoded buffer size 1" << LL_ENDL;
-			callExceptionFunc(MX_WROTE_PAST_BUFFER_SIZE);
-			outptr = mEncodedRecvBuffer;					
-			break;
-		}
-		if (!((*outptr++ = *inptr++)))
-		{
-			while (((count--)) && (!(*inptr)))
-			{
-				*outptr++ = *inptr++;
-  				if (outptr > (&mEncodedRecvBuffer[MAX_BUFFER_SIZE-256]))
-  				{
-  					LL_WARNS("Messaging") << "attempt to write past reasonable encoded buffer size 2" << LL_ENDL;
-					callExceptionFunc(MX_WROTE_PAST_BUFFER_SIZE);
-					outptr = mEncodedRecvBuffer;
-					count = -1;
-					break;
-  				}
-				memset(outptr,0,255);
-				outptr += 255;
-			}
-			
-			if (count < 0)
-			{
-				break;
-			}
-
-			else
-			{
-  				if (outptr > (&mEncodedRecvBuffer[MAX_BUFFER_SIZE-(*inptr)]))
-				{
-  					LL_WARNS("Messaging") << "attempt to write past reasonable encoded buffer size 3" << LL_ENDL;
-					callExceptionFunc(MX_WROTE_PAST_BUFFER_SIZE);
-					outptr = mEncodedRecvBuffer;					
-				}
-				memset(outptr,0,(*inptr) - 1);
-				outptr += ((*inptr) - 1);
-				inptr++;
-			}
-		}		
-	}
-	
 	*data = mEncodedRecvBuffer;
-	*data_size = (S32)(outptr - mEncodedRecvBuffer);
+	*data_size = expanded_size;
 	mUncompressedBytesIn += *data_size;
 
 	return(in_size);
@@ -3326,7 +3312,7 @@ void LLMessageSystem::establishBidirectionalTrust(const LLHost &host, S64 frame_
 
 void LLMessageSystem::dumpPacketToLog()
 {
-	LL_WARNS("Messaging") << "Packet Dump from:" << mPacketRing.getLastSender() << LL_ENDL;
+	LL_WARNS("Messaging") << "Packet Dump from:" << mLastSender << LL_ENDL;
 	LL_WARNS("Messaging") << "Packet Size:" << mTrueReceiveSize << LL_ENDL;
 	char line_buffer[256];		/* Flawfinder: ignore */
 	S32 i;
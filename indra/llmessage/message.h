@@ -28,6 +28,7 @@
 #define LL_MESSAGE_H
 
 #include <cstring>
+#include <memory>
 #include <set>
 
 #if LL_LINUX
@@ -160,6 +161,8 @@ class LLQuaternion;
 class LLSD;
 class LLUUID;
 class LLMessageSystem;
+class LLMessageReceiveThread;
+struct LLReceivedPacket;
 class LLPumpIO;
 
 // message system exceptional condition handlers.
@@ -414,6 +417,13 @@ public:
 	bool addCircuitCode(U32 code, const LLUUID& session_id);
 
 	BOOL	poll(F32 seconds); // Number of seconds that we want to block waiting for data, returns if data was received
+
+	// Moves reading, ack splitting, zero-code expansion and block decoding
+	// of incoming packets off to a thread of their own; checkMessages()
+	// then picks up what it has queued.
+	void	startReceiveThread();
+	void	stopReceiveThread();
+	bool	isReceiveThreadRunning() const { return (bool)mReceiveThread; }
 	BOOL	checkMessages(LockMessageChecker&, S64 frame_count = 0 );
 	void	processAcks(LockMessageChecker&, F32 collect_time = 0.f);
 
@@ -539,6 +549,11 @@ public:
 	S32		zeroCodeExpand(U8 **data, S32 *data_size);
 	S32		zeroCodeAdjustCurrentSendTotal();
 
+	// Expands in to out without touching any message system state, for the
+	// receive thread. Returns the expanded size, or -1 wherever
+	// zeroCodeExpand() would complain about overrunning its buffer.
+	static S32 zeroCodeExpand(const U8* in, S32 in_size, U8* out, S32 out_size);
+
 	// Uses ping-based retry
 	S32 sendReliable(const LLHost &host);
 
@@ -904,6 +919,11 @@ private:
 	LLTemplateMessageReader* mTemplateMessageReader;
 	LLSDMessageReader* mLLSDMessageReader;
 
+	std::unique_ptr<LLMessageReceiveThread> mReceiveThread;
+	// The packet being read, when it came from the receive thread: its
+	// arena holds the current message's data
+	std::unique_ptr<LLReceivedPacket> mCurrentPacket;
+
 	friend class LLMessageHandlerBridge;
 	friend class LockMessageChecker;
 
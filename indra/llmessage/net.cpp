@@ -523,12 +523,30 @@ void end_net(S32& socket_out)
 }
 
 #if LL_LINUX
+static void get_destip(struct msghdr *msg, U32 *dstip)
+{
+	struct cmsghdr *cmsgptr;
+	for (cmsgptr = CMSG_FIRSTHDR(msg); cmsgptr != NULL; cmsgptr = CMSG_NXTHDR(msg, cmsgptr))
+	{
+		if( cmsgptr->cmsg_level == SOL_IP && cmsgptr->cmsg_type == IP_PKTINFO )
+		{
+			in_pktinfo *pktinfo = (in_pktinfo *)CMSG_DATA(cmsgptr);
+			if( pktinfo )
+			{
+				// Two choices. routed and specified. ipi_addr is routed, ipi_spec_dst is
+				// routed. We should stay with specified until we go to multiple
+				// interfaces
+				*dstip = pktinfo->ipi_spec_dst.s_addr;
+			}
+		}
+	}
+}
+
 static int recvfrom_destip( int socket, void *buf, int len, struct sockaddr *from, socklen_t *fromlen, U32 *dstip )
 {
 	int size;
 	struct iovec iov[1];
 	char cmsg[CMSG_SPACE(sizeof(struct in_pktinfo))];
-	struct cmsghdr *cmsgptr;
 	struct msghdr msg = {0};
 
 	iov[0].iov_base = buf;
@@ -549,20 +567,7 @@ static int recvfrom_destip( int socket, void *buf, int len, struct sockaddr *fro
 		return -1;
 	}
 
-	for (cmsgptr = CMSG_FIRSTHDR(&msg); cmsgptr != NULL; cmsgptr = CMSG_NXTHDR( &msg, cmsgptr))
-	{
-		if( cmsgptr->cmsg_level == SOL_IP && cmsgptr->cmsg_type == IP_PKTINFO )
-		{
-			in_pktinfo *pktinfo = (in_pktinfo *)CMSG_DATA(cmsgptr);
-			if( pktinfo )
-			{
-				// Two choices. routed and specified. ipi_addr is routed, ipi_spec_dst is
-				// routed. We should stay with specified until we go to multiple
-				// interfaces
-				*dstip = pktinfo->ipi_spec_dst.s_addr;
-			}
-		}
-	}
+	get_destip(&msg, dstip);
 
 	return size;
 }
@@ -658,6 +663,138 @@ BOOL send_packet(int hSocket, const char * sendBuffer, int size, U32 recipient,
 	return success;
 }
 
+#if LL_LINUX
+S32 receive_packets(int hSocket, LLNetDatagram* datagrams, S32 count)
+{
+	struct mmsghdr msgs[NET_BATCH_SIZE];
+	struct iovec iovs[NET_BATCH_SIZE];
+	struct sockaddr_in from[NET_BATCH_SIZE];
+	char cmsgs[NET_BATCH_SIZE][CMSG_SPACE(sizeof(struct in_pktinfo))];
+
+	count = llmin(count, NET_BATCH_SIZE);
+	memset(msgs, 0, sizeof(msgs[0]) * count);
+	for (S32 i = 0; i < count; ++i)
+	{
+		iovs[i].iov_base = datagrams[i].mData;
+		iovs[i].iov_len = NET_BUFFER_SIZE;
+		msgs[i].msg_hdr.msg_name = &from[i];
+		msgs[i].msg_hdr.msg_namelen = sizeof(from[i]);
+		msgs[i].msg_hdr.msg_iov = &iovs[i];
+		msgs[i].msg_hdr.msg_iovlen = 1;
+		msgs[i].msg_hdr.msg_control = cmsgs[i];
+		msgs[i].msg_hdr.msg_controllen = sizeof(cmsgs[i]);
+	}
+
+	gsnReceivingIFAddr = INVALID_HOST_IP_ADDRESS;
+	int received = recvmmsg(hSocket, msgs, count, MSG_DONTWAIT, NULL);
+	if (received <= 0)
+	{
+		// Same as receive_packet(): errors read as nothing waiting
+		return 0;
+	}
+
+	for (S32 i = 0; i < received; ++i)
+	{
+		LLNetDatagram& datagram = datagrams[i];
+		datagram.mSize = msgs[i].msg_len;
+		datagram.mAddress = from[i].sin_addr.s_addr;
+		datagram.mPort = ntohs(from[i].sin_port);
+		datagram.mReceivingIF = INVALID_HOST_IP_ADDRESS;
+		get_destip(&msgs[i].msg_hdr, &datagram.mReceivingIF);
+	}
+
+	// Keep get_sender() and friends answering for the last datagram
+	stSrcAddr = from[received - 1];
+	gsnReceivingIFAddr = datagrams[received - 1].mReceivingIF;
+	return received;
+}
+
+S32 send_packets(int hSocket, const LLNetDatagram* datagrams, S32 count)
+{
+	struct mmsghdr msgs[NET_BATCH_SIZE];
+	struct iovec iovs[NET_BATCH_SIZE];
+	struct sockaddr_in to[NET_BATCH_SIZE];
+
+	S32 failures = 0;
+	S32 sent = 0;
+	while (sent < count)
+	{
+		S32 batch = llmin(count - sent, NET_BATCH_SIZE);
+		memset(msgs, 0, sizeof(msgs[0]) * batch);
+		memset(to, 0, sizeof(to[0]) * batch);
+		for (S32 i = 0; i < batch; ++i)
+		{
+			const LLNetDatagram& datagram = datagrams[sent + i];
+			iovs[i].iov_base = datagram.mData;
+			iovs[i].iov_len = datagram.mSize;
+			to[i].sin_family = AF_INET;
+			to[i].sin_addr.s_addr = datagram.mAddress;
+			to[i].sin_port = htons(datagram.mPort);
+			msgs[i].msg_hdr.msg_name = &to[i];
+			msgs[i].msg_hdr.msg_namelen = sizeof(to[i]);
+			msgs[i].msg_hdr.msg_iov = &iovs[i];
+			msgs[i].msg_hdr.msg_iovlen = 1;
+		}
+
+		int ret = sendmmsg(hSocket, msgs, batch, 0);
+		if (ret <= 0)
+		{
+			// sendmmsg() stops at the first datagram that fails. Let
+			// send_packet() retry that one and report the error.
+			const LLNetDatagram& datagram = datagrams[sent];
+			if (!send_packet(hSocket, datagram.mData, datagram.mSize, datagram.mAddress, datagram.mPort))
+			{
+				++failures;
+			}
+			ret = 1;
+		}
+		sent += ret;
+	}
+	return failures;
+}
+#endif // LL_LINUX
+
 #endif
 
+//////////////////////////////////////////////////////////////////////////////////////////
+// Batched fallbacks for platforms without recvmmsg()/sendmmsg()
+//////////////////////////////////////////////////////////////////////////////////////////
+
+#if ! LL_LINUX
+
+S32 receive_packets(int hSocket, LLNetDatagram* datagrams, S32 count)
+{
+	S32 received = 0;
+	while (received < count)
+	{
+		LLNetDatagram& datagram = datagrams[received];
+		datagram.mSize = receive_packet(hSocket, datagram.mData);
+		if (datagram.mSize <= 0)
+		{
+			break;
+		}
+		datagram.mAddress = get_sender_ip();
+		datagram.mPort = get_sender_port();
+		datagram.mReceivingIF = get_receiving_interface_ip();
+		++received;
+	}
+	return received;
+}
+
+S32 send_packets(int hSocket, const LLNetDatagram* datagrams, S32 count)
+{
+	S32 failures = 0;
+	for (S32 i = 0; i < count; ++i)
+	{
+		const LLNetDatagram& datagram = datagrams[i];
+		if (!send_packet(hSocket, datagram.mData, datagram.mSize, datagram.mAddress, datagram.mPort))
+		{
+			++failures;
+		}
+	}
+	return failures;
+}
+
+#endif // ! LL_LINUX
+
 //EOF
@@ -45,6 +45,28 @@ S32		receive_packet(int hSocket, char * receiveBuffer);
 
 BOOL	send_packet(int hSocket, const char *sendBuffer, int size, U32 recipient, int nPort);	// Returns TRUE on success.
 
+// Most datagrams moved per system call by the batched functions below
+const S32 NET_BATCH_SIZE = 32;
+
+// One datagram for receive_packets()/send_packets(). When receiving, mData
+// must point at NET_BUFFER_SIZE bytes and the other members are filled in.
+struct LLNetDatagram
+{
+	char*	mData;
+	S32		mSize;
+	U32		mAddress;		// sender or recipient
+	U32		mPort;
+	U32		mReceivingIF;	// receive only, INVALID_HOST_IP_ADDRESS if unknown
+};
+
+// Receives up to count waiting datagrams, with one recvmmsg() on Linux and a
+// receive_packet() loop elsewhere. Never blocks. Returns how many arrived.
+S32		receive_packets(int hSocket, LLNetDatagram* datagrams, S32 count);
+
+// Sends count datagrams, with sendmmsg() on Linux and a send_packet() loop
+// elsewhere. Returns how many of them failed to send.
+S32		send_packets(int hSocket, const LLNetDatagram* datagrams, S32 count);
+
 //void	get_sender(char * tmp);
 LLHost	get_sender();
 U32		get_sender_port();
@@ -0,0 +1,415 @@
+/**
+ * @file   llpacketreplay_test.cpp
+ * @brief  Test for packet capture, and replaying captures through
+ *         LLMessageSystem.
+ *
+ * Test 3 is also a replay harness for real traffic: point
+ * LL_PACKET_REPLAY_FILE at a capture made with the viewer's
+ * PacketCaptureFile setting, and LL_PACKET_REPLAY_TEMPLATE at the
+ * message_template.msg it was made with.
+ *
+ * $LicenseInfo:firstyear=2024&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2024, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+
+#include "../llpacketcapture.h"
+
+#include <map>
+#include <set>
+#include <vector>
+
+#include "lldir.h"
+#include "llfile.h"
+#include "lltimer.h"
+#include "lluuid.h"
+#include "v3math.h"
+#include "message.h"
+#include "net.h"
+#include "stringize.h"
+
+#include "../test/countallocs.h"
+#include "../test/lltut.h"
+
+namespace
+{
+	const char* TEST_TEMPLATE =
+		"version 2.0\n"
+		"{\n"
+		"	TestMessage High 1 NotTrusted Unencoded\n"
+		"	{\n"
+		"		TestBlock1 Single\n"
+		"		{ Test1 U32 }\n"
+		"	}\n"
+		"}\n"
+		"{\n"
+		"	TestObjects Medium 1 NotTrusted Unencoded\n"
+		"	{\n"
+		"		ObjectData Variable\n"
+		"		{ ID U32 }\n"
+		"		{ Position LLVector3 }\n"
+		"	}\n"
+		"}\n";
+
+	void putU32(char* packet, S32& size, U32 value)
+	{
+		for (S32 shift = 0; shift < 32; shift += 8)
+		{
+			packet[size++] = char(U8(value >> shift));	// little-endian, like the message system
+		}
+	}
+
+	S32 putHeader(char* packet, U32 packet_id)
+	{
+		S32 size = 0;
+		packet[size++] = 0;		// no flags
+		for (S32 shift = 24; shift >= 0; shift -= 8)
+		{
+			packet[size++] = char(U8(packet_id >> shift));
+		}
+		packet[size++] = 0;		// no extra header
+		return size;
+	}
+
+	// Packets i of a test capture: mostly TestMessage, with a TestObjects
+	// of a few objects every fourth packet. Values follow from i.
+	S32 buildTestPacket(char* packet, U32 i)
+	{
+		S32 size = putHeader(packet, i + 1);
+		if (i % 4)
+		{
+			packet[size++] = 1;	// high frequency message 1
+			putU32(packet, size, i * 7);
+		}
+		else
+		{
+			packet[size++] = char(0xff);	// medium frequency message 1
+			packet[size++] = 1;
+			U8 objects = U8(1 + i % 5);
+			packet[size++] = char(objects);
+			for (U32 object = 0; object < objects; ++object)
+			{
+				putU32(packet, size, i * 10 + object);
+				for (S32 axis = 0; axis < 3; ++axis)
+				{
+					F32 coord = F32(i + axis);
+					U32 bits;
+					memcpy(&bits, &coord, sizeof(bits));
+					putU32(packet, size, bits);
+				}
+			}
+		}
+		return size;
+	}
+
+	// What the handlers make of a test capture's packets
+	void recordTestMessage(LLMessageSystem* msg, void** user_data)
+	{
+		U32 value = 0;
+		msg->getU32("TestBlock1", "Test1", value);
+		reinterpret_cast<std::vector<U32>*>(user_data)->push_back(value);
+	}
+
+	void recordTestObjects(LLMessageSystem* msg, void** user_data)
+	{
+		S32 objects = msg->getNumberOfBlocks("ObjectData");
+		for (S32 object = 0; object < objects; ++object)
+		{
+			U32 id = 0;
+			LLVector3 position;
+			msg->getU32("ObjectData", "ID", id, object);
+			msg->getVector3("ObjectData", "Position", position, object);
+			reinterpret_cast<std::vector<U32>*>(user_data)->push_back(id + U32(position.mV[VZ]));
+		}
+	}
+
+	void ignoreMessage(LLMessageSystem*, void**)
+	{
+	}
+
+	// Per message type numbers from a replay
+	struct MessageStats
+	{
+		MessageStats() : mCount(0), mSeconds(0.0), mAllocations(0) {}
+
+		S32		mCount;
+		F64		mSeconds;		// in the handler
+		size_t	mAllocations;	// since the previous message's handler
+	};
+
+	struct ReplayStats
+	{
+		ReplayStats() : mAllocsAtLastMessage(0) {}
+
+		std::map<std::string, MessageStats> mMessages;
+		size_t mAllocsAtLastMessage;
+	};
+
+	// Called after each message's handler, with the time the handler took
+	void timeMessage(const char* name, F32 seconds, void* data)
+	{
+		ReplayStats* stats = static_cast<ReplayStats*>(data);
+		MessageStats& message = stats->mMessages[name];
+		if (!message.mCount)
+		{
+			// so that messages without a handler warn only once
+			gMessageSystem->setHandlerFunc(name, ignoreMessage);
+		}
+		++message.mCount;
+		message.mSeconds += seconds;
+		message.mAllocations += CountAllocs::sCount - stats->mAllocsAtLastMessage;
+		stats->mAllocsAtLastMessage = CountAllocs::sCount;
+	}
+}
+
+namespace tut
+{
+	struct llpacketreplay_data
+	{
+		std::string mCaptureFile;
+		std::string mTemplateFile;
+
+		llpacketreplay_data()
+		{
+			std::string prefix(gDirUtilp->add(gDirUtilp->getTempDir(),
+											  "llpacketreplay_test_" + LLUUID::generateNewID().asString()));
+			mCaptureFile = prefix + ".pcap";
+			mTemplateFile = prefix + ".msg";
+			llofstream file(mTemplateFile.c_str());
+			file << TEST_TEMPLATE;
+		}
+
+		~llpacketreplay_data()
+		{
+			delete static_cast<LLMessageSystem*>(gMessageSystem);
+			gMessageSystem = NULL;
+			LLFile::remove(mCaptureFile);
+			LLFile::remove(mTemplateFile);
+		}
+
+		void newMessageSystem(const std::string& template_file)
+		{
+			delete static_cast<LLMessageSystem*>(gMessageSystem);
+			gMessageSystem = new LLMessageSystem(template_file, NET_USE_OS_ASSIGNED_PORT, 1, 0, 0, false, 5, 100);
+			ensure("message system", gMessageSystem->isOK());
+		}
+
+		// Stands in for the region: opens a trusted circuit to every sender
+		// in the capture. Returns the packet count.
+		S32 enableCapturedCircuits(const std::string& capture_file)
+		{
+			LLPacketReplay replay;
+			ensure("open " + capture_file, replay.open(capture_file));
+			std::set<LLHost> senders;
+			LLCapturedPacket packet;
+			S32 count = 0;
+			while (replay.read(packet))
+			{
+				senders.insert(packet.mSender);
+				++count;
+			}
+			for (const LLHost& sender : senders)
+			{
+				gMessageSystem->enableCircuit(sender, TRUE);
+			}
+			return count;
+		}
+
+		// Runs the whole capture through checkMessages(), returns the seconds
+		// it took
+		F64 replay(const std::string& capture_file)
+		{
+			ensure("start replay", gMessageSystem->mPacketRing.startReplay(capture_file));
+			LLTimer timer;
+			{
+				LockMessageChecker lmc(gMessageSystem);
+				while (lmc.checkMessages(0))
+					;
+			}
+			F64 elapsed = timer.getElapsedTimeF64();
+			gMessageSystem->mPacketRing.stopReplay();
+			return elapsed;
+		}
+	};
+	typedef test_group<llpacketreplay_data> llpacketreplay_test;
+	typedef llpacketreplay_test::object llpacketreplay_object;
+	tut::llpacketreplay_test llpacketreplay("LLPacketReplay");
+
+	template<> template<>
+	void llpacketreplay_object::test<1>()
+	{
+		set_test_name("capture file round trip");
+		LLHost sender(ip_string_to_u32("10.1.2.3"), 13000);
+		LLHost receiving_if(ip_string_to_u32("192.168.0.2"), 0);
+		{
+			LLPacketCapture capture;
+			ensure("open capture", capture.open(mCaptureFile));
+			char packet[NET_BUFFER_SIZE];
+			for (U32 i = 0; i < 3; ++i)
+			{
+				capture.write(packet, buildTestPacket(packet, i), sender, receiving_if);
+			}
+			capture.write(packet, 0, receiving_if, sender);
+			ensure_equals("captured", capture.getPacketCount(), 4);
+		}
+
+		LLPacketReplay replay;
+		ensure("open replay", replay.open(mCaptureFile));
+		for (S32 pass = 0; pass < 2; ++pass)
+		{
+			LLCapturedPacket packet;
+			U64 last_usecs = 0;
+			for (U32 i = 0; i < 3; ++i)
+			{
+				ensure(STRINGIZE("read packet " << i), replay.read(packet));
+				char expected[NET_BUFFER_SIZE];
+				S32 size = buildTestPacket(expected, i);
+				ensure_equals("size", packet.mData.size(), size_t(size));
+				ensure("data", !memcmp(&packet.mData[0], expected, size));
+				ensure_equals("sender", packet.mSender, sender);
+				ensure_equals("receiving interface", packet.mReceivingIF, receiving_if);
+				ensure("time", packet.mUsecs >= last_usecs);
+				last_usecs = packet.mUsecs;
+			}
+			ensure("read empty packet", replay.read(packet));
+			ensure("empty packet", packet.mData.empty());
+			ensure_equals("swapped sender", packet.mSender, receiving_if);
+			ensure("read past end", !replay.read(packet));
+			replay.rewind();
+		}
+
+		// not a capture
+		{
+			llofstream file(mCaptureFile.c_str());
+			file << "LLPKTCAX and more";
+		}
+		ensure("opened a file that isn't a capture", !replay.open(mCaptureFile));
+		ensure("opened a missing file", !replay.open(mCaptureFile + ".missing"));
+	}
+
+	template<> template<>
+	void llpacketreplay_object::test<2>()
+	{
+		set_test_name("capture loopback traffic, replay it through checkMessages()");
+		const S32 COUNT = 64;
+		std::vector<U32> received;
+
+		newMessageSystem(mTemplateFile);
+		gMessageSystem->setHandlerFunc("TestMessage", recordTestMessage, reinterpret_cast<void**>(&received));
+		gMessageSystem->setHandlerFunc("TestObjects", recordTestObjects, reinterpret_cast<void**>(&received));
+		S32 sender = -1;
+		int sender_port = NET_USE_OS_ASSIGNED_PORT;
+		ensure_equals("sender socket", start_net(sender, sender_port), 0);
+		gMessageSystem->enableCircuit(LLHost(ip_string_to_u32(LOOPBACK_ADDRESS_STRING), sender_port), FALSE);
+		ensure("start capture", gMessageSystem->mPacketRing.startCapture(mCaptureFile));
+
+		char packet[NET_BUFFER_SIZE];
+		for (U32 i = 0; i < COUNT; ++i)
+		{
+			ensure("send", send_packet(sender, packet, buildTestPacket(packet, i),
+									   ip_string_to_u32(LOOPBACK_ADDRESS_STRING),
+									   gMessageSystem->getListenPort()));
+		}
+		LLTimer timer;
+		{
+			LockMessageChecker lmc(gMessageSystem);
+			while (gMessageSystem->mPacketsIn < U32(COUNT) && timer.getElapsedTimeF64() < 5.0)
+			{
+				gMessageSystem->poll(0.01f);
+				while (lmc.checkMessages(0))
+					;
+			}
+		}
+		gMessageSystem->mPacketRing.stopCapture();
+		end_net(sender);
+		ensure_equals("packets in", gMessageSystem->mPacketsIn, U32(COUNT));
+		const std::vector<U32> live(received);
+
+		// Twice, to show the replay is the same every time
+		for (S32 pass = 0; pass < 2; ++pass)
+		{
+			received.clear();
+			newMessageSystem(mTemplateFile);
+			gMessageSystem->setHandlerFunc("TestMessage", recordTestMessage, reinterpret_cast<void**>(&received));
+			gMessageSystem->setHandlerFunc("TestObjects", recordTestObjects, reinterpret_cast<void**>(&received));
+			ensure_equals("captured packets", enableCapturedCircuits(mCaptureFile), COUNT);
+			replay(mCaptureFile);
+			ensure_equals("replayed packets", gMessageSystem->mPacketsIn, U32(COUNT));
+			ensure("replay differs from live traffic", received == live);
+		}
+	}
+
+	template<> template<>
+	void llpacketreplay_object::test<3>()
+	{
+		set_test_name("replay: messages/s, allocations and time per message type");
+		// A profile rather than a check, which test<2> already makes: runs
+		// for LL_BENCHMARKS, or to look into a capture of real traffic
+		const char* capture_env = getenv("LL_PACKET_REPLAY_FILE");
+		const char* template_env = getenv("LL_PACKET_REPLAY_TEMPLATE");
+		if (!capture_env && !benchmarking())
+		{
+			skip("set LL_BENCHMARKS or LL_PACKET_REPLAY_FILE to profile a replay");
+		}
+		std::string capture_file(capture_env ? capture_env : mCaptureFile);
+		std::string template_file(template_env ? template_env : mTemplateFile);
+		if (!capture_env)
+		{
+			LLPacketCapture capture;
+			ensure("open capture", capture.open(mCaptureFile));
+			LLHost sender(ip_string_to_u32(LOOPBACK_ADDRESS_STRING), 13000);
+			char packet[NET_BUFFER_SIZE];
+			for (U32 i = 0; i < 50000; ++i)
+			{
+				capture.write(packet, buildTestPacket(packet, i), sender, LLHost());
+			}
+		}
+
+		newMessageSystem(template_file);
+		S32 packets = enableCapturedCircuits(capture_file);
+		ReplayStats stats;
+		gMessageSystem->setTimingFunc(timeMessage, &stats);
+		stats.mAllocsAtLastMessage = CountAllocs::sCount;
+		size_t allocs_before = CountAllocs::sCount;
+		F64 elapsed = replay(capture_file);
+		size_t allocs = CountAllocs::sCount - allocs_before;
+		gMessageSystem->setTimingFunc(NULL);
+
+		S32 messages = 0;
+		for (const auto& entry : stats.mMessages)
+		{
+			messages += entry.second.mCount;
+		}
+		ensure("no messages replayed", messages > 0);
+		LL_INFOS("Benchmark") << "replayed " << packets << " packets, " << messages << " messages: "
+							  << S32(messages / elapsed) << " messages/s, "
+							  << F64(allocs) / messages << " allocations/message" << LL_ENDL;
+		for (const auto& entry : stats.mMessages)
+		{
+			const MessageStats& message = entry.second;
+			LL_INFOS("Benchmark") << "  " << entry.first << ": " << message.mCount << " messages, "
+								  << message.mSeconds * 1000000.0 / message.mCount << " us in the handler, "
+								  << F64(message.mAllocations) / message.mCount
+								  << " allocations per message" << LL_ENDL;
+		}
+	}
+}
@@ -0,0 +1,433 @@
+/**
+ * @file   llzerocode_test.cpp
+ * @brief  Test for LLZeroCode against the byte at a time zero-coding it
+ *         replaced.
+ *
+ * $LicenseInfo:firstyear=2024&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2024, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+
+#include "../llzerocode.h"
+
+#include <random>
+#include <vector>
+
+#include "llcircuit.h"
+#include "lltimer.h"
+#include "net.h"
+#include "stringize.h"
+
+#include "../test/lltut.h"
+
+namespace
+{
+	// The encoding loop from LLTemplateMessageBuilder's zero_code()
+	S32 reference_encode(const U8* in, S32 in_size, U8* out)
+	{
+		S32 count = in_size;
+		U8 num_zeroes = 0;
+		const U8* inptr = in;
+		U8* outptr = out;
+
+		for (U32 ii = 0; ii < LL_PACKET_ID_SIZE ; ++ii)
+		{
+			count--;
+			*outptr++ = *inptr++;
+		}
+
+		while (count--)
+		{
+			if (!(*inptr))
+			{
+				if (num_zeroes)
+				{
+					if (++num_zeroes > 254)
+					{
+						*outptr++ = num_zeroes;
+						num_zeroes = 0;
+					}
+				}
+				else
+				{
+					*outptr++ = 0;
+					num_zeroes = 1;
+				}
+				inptr++;
+			}
+			else
+			{
+				if (num_zeroes)
+				{
+					*outptr++ = num_zeroes;
+					num_zeroes = 0;
+				}
+				*outptr++ = *inptr++;
+			}
+		}
+
+		if (num_zeroes)
+		{
+			*outptr++ = num_zeroes;
+		}
+		return (S32)(outptr - out);
+	}
+
+	// The expansion loop from LLMessageSystem::zeroCodeExpand(), with
+	// offsets for pointers. It can write one byte past out_size before it
+	// notices, so out needs room for out_size + 1.
+	S32 reference_expand(const U8* in, S32 in_size, U8* out, S32 out_size)
+	{
+		if (in_size < LL_PACKET_ID_SIZE)
+		{
+			return -1;
+		}
+
+		const U8* inptr = in;
+		const U8* in_end = in + in_size;
+		S32 out_pos = 0;
+		for (U32 ii = 0; ii < LL_PACKET_ID_SIZE; ++ii)
+		{
+			out[out_pos++] = *inptr++;
+		}
+
+		while (inptr < in_end)
+		{
+			if (out_pos > out_size - 1)
+			{
+				return -1;
+			}
+			if (!(out[out_pos++] = *inptr++))
+			{
+				while (inptr < in_end && !*inptr)
+				{
+					out[out_pos++] = *inptr++;
+					if (out_pos > out_size - 256)
+					{
+						return -1;
+					}
+					memset(out + out_pos, 0, 255);
+					out_pos += 255;
+				}
+				if (inptr == in_end)
+				{
+					break;
+				}
+				if (out_pos > out_size - *inptr)
+				{
+					return -1;
+				}
+				memset(out + out_pos, 0, *inptr - 1);
+				out_pos += *inptr - 1;
+				inptr++;
+			}
+		}
+		return out_pos;
+	}
+
+	// Roughly what an ObjectUpdate looks like: a header, then blocks of
+	// ids and flags, floats, and mostly empty text and extra params.
+	void append_object_block(std::vector<U8>& packet, std::mt19937& random)
+	{
+		std::uniform_int_distribution<S32> byte(1, 255);
+		std::uniform_int_distribution<S32> length(0, 40);
+		// local id, state, full id
+		for (S32 i = 0; i < 21; ++i)
+		{
+			packet.push_back(U8(byte(random)));
+		}
+		// crc, pcode, material, click action, scale
+		packet.insert(packet.end(), 4, 0);
+		packet.push_back(9);
+		packet.push_back(3);
+		packet.push_back(0);
+		for (S32 i = 0; i < 12; ++i)
+		{
+			packet.push_back(U8(byte(random)));
+		}
+		// object data: position, velocity, acceleration, rotation, spin,
+		// with the moving parts usually zero
+		for (S32 i = 0; i < 12; ++i)
+		{
+			packet.push_back(U8(byte(random)));
+		}
+		packet.insert(packet.end(), 24, 0);
+		for (S32 i = 0; i < 12; ++i)
+		{
+			packet.push_back(U8(byte(random)));
+		}
+		packet.insert(packet.end(), 12, 0);
+		// parent, update flags, path and profile parameters
+		packet.insert(packet.end(), 4, 0);
+		for (S32 i = 0; i < 23; ++i)
+		{
+			packet.push_back(random() % 3 ? U8(byte(random)) : 0);
+		}
+		// texture entry, texture anim, name value, data, text, color,
+		// media url, particles, extra params, sound, joint
+		S32 texture_entry = length(random);
+		for (S32 i = 0; i < texture_entry; ++i)
+		{
+			packet.push_back(random() % 4 ? U8(byte(random)) : 0);
+		}
+		packet.insert(packet.end(), 100, 0);
+		for (S32 i = 0; i < 16; ++i)
+		{
+			packet.push_back(U8(byte(random)));
+		}
+		packet.insert(packet.end(), 40, 0);
+	}
+
+	std::vector<U8> object_update_packet(std::mt19937& random)
+	{
+		// flags, packet id, extra header size, message number
+		std::vector<U8> packet = { 0x80, 0, 0, 0, 1, 0, 0x0c };
+		for (S32 i = 0; i < 10; ++i)
+		{
+			packet.push_back(U8(random() & 0xff));
+		}
+		while (packet.size() < 1000)
+		{
+			append_object_block(packet, random);
+		}
+		return packet;
+	}
+
+	// Random bytes where about one in zero_odds is zero, with the
+	// occasional run long enough to need splitting
+	std::vector<U8> random_packet(std::mt19937& random, S32 size, S32 zero_odds)
+	{
+		std::vector<U8> packet;
+		packet.reserve(size);
+		while ((S32)packet.size() < size)
+		{
+			U32 r = random();
+			if (r % 50 == 0)
+			{
+				packet.insert(packet.end(), (r >> 8) % 700 + 1, 0);
+			}
+			else if (r % zero_odds == 0)
+			{
+				packet.push_back(0);
+			}
+			else
+			{
+				packet.push_back(U8((r >> 8) % 255 + 1));
+			}
+		}
+		packet.resize(size);
+		return packet;
+	}
+}
+
+namespace tut
+{
+	struct llzerocode_data
+	{
+		llzerocode_data() :
+			mRandom(20240901)
+		{
+		}
+
+		// Encodes both ways and checks they match, then that expanding
+		// gives the packet back. Returns the encoded size.
+		S32 checkRoundTrip(const std::vector<U8>& packet)
+		{
+			S32 size = (S32)packet.size();
+			std::vector<U8> encoded(2 * size + 16, 0xcc);
+			std::vector<U8> reference(2 * size + 16, 0xcc);
+			S32 encoded_size = LLZeroCode::encode(&packet[0], size, &encoded[0]);
+			S32 reference_size = reference_encode(&packet[0], size, &reference[0]);
+			std::string what = stringize("packet of ", size);
+			ensure_equals(what + " encoded size", encoded_size, reference_size);
+			ensure("encoded " + what + " differs",
+				   std::equal(reference.begin(), reference.begin() + reference_size, encoded.begin()));
+			ensure_equals(what + " encodedSize()", LLZeroCode::encodedSize(&packet[0], size), encoded_size);
+
+			std::vector<U8> expanded(size + 256, 0xcc);
+			ensure_equals(what + " expanded size",
+						  LLZeroCode::expand(&encoded[0], encoded_size, &expanded[0], (S32)expanded.size()),
+						  size);
+			ensure("expanded " + what + " differs", std::equal(packet.begin(), packet.end(), expanded.begin()));
+			return encoded_size;
+		}
+
+		// Expands arbitrary bytes both ways into out_size, checks they agree
+		// on whether it fits, and on the bytes when it does
+		void checkExpand(const std::vector<U8>& input, S32 out_size)
+		{
+			S32 size = (S32)input.size();
+			std::vector<U8> expanded(out_size + 1, 0xcc);
+			std::vector<U8> reference(out_size + 1, 0xcc);
+			S32 expanded_size = LLZeroCode::expand(&input[0], size, &expanded[0], out_size);
+			S32 reference_size = reference_expand(&input[0], size, &reference[0], out_size);
+			std::string what = stringize(size, " bytes into ", out_size);
+			ensure_equals(what, expanded_size, reference_size);
+			if (expanded_size >= 0)
+			{
+				ensure("expanding " + what + " differs",
+					   std::equal(reference.begin(), reference.begin() + reference_size, expanded.begin()));
+			}
+			ensure_equals("expanding " + what + " wrote past the end", expanded[out_size], U8(0xcc));
+		}
+
+		std::mt19937 mRandom;
+	};
+	typedef test_group<llzerocode_data> llzerocode_test;
+	typedef llzerocode_test::object llzerocode_object;
+	tut::llzerocode_test llzerocode("LLZeroCode");
+
+	template<> template<>
+	void llzerocode_object::test<1>()
+	{
+		set_test_name("runs at the edges");
+		// every run length around the 255 split, at every position
+		// relative to the 16 byte scans, and at the end of the packet
+		for (S32 run = 1; run <= 520; run += (run < 20 || (run > 240 && run < 270) || run > 500) ? 1 : 17)
+		{
+			for (S32 offset = 0; offset < 17; ++offset)
+			{
+				std::vector<U8> packet(LL_PACKET_ID_SIZE + offset, 0x41);
+				packet.insert(packet.end(), run, 0);
+				checkRoundTrip(packet);
+				packet.push_back(0x42);
+				checkRoundTrip(packet);
+			}
+		}
+
+		// nothing but the header, all zeroes, no zeroes
+		checkRoundTrip(std::vector<U8>(LL_PACKET_ID_SIZE, 0));
+		checkRoundTrip(std::vector<U8>(NET_BUFFER_SIZE / 2, 0));
+		std::vector<U8> packet(MTUBYTES, 0xff);
+		ensure_equals("no zeroes", checkRoundTrip(packet), (S32)MTUBYTES);
+	}
+
+	template<> template<>
+	void llzerocode_object::test<2>()
+	{
+		set_test_name("random packets round trip");
+		for (S32 i = 0; i < 20000; ++i)
+		{
+			S32 size = LL_PACKET_ID_SIZE + mRandom() % 1500;
+			S32 zero_odds = 1 + mRandom() % 8;
+			checkRoundTrip(random_packet(mRandom, size, zero_odds));
+		}
+		for (S32 i = 0; i < 200; ++i)
+		{
+			checkRoundTrip(object_update_packet(mRandom));
+		}
+	}
+
+	template<> template<>
+	void llzerocode_object::test<3>()
+	{
+		set_test_name("malformed and oversized input");
+		// short input
+		U8 out[NET_BUFFER_SIZE];
+		U8 header[LL_PACKET_ID_SIZE] = { 0x80, 0, 0, 0, 1, 0 };
+		for (S32 size = 0; size < LL_PACKET_ID_SIZE; ++size)
+		{
+			ensure_equals("short packet", LLZeroCode::expand(header, size, out, NET_BUFFER_SIZE), -1);
+		}
+
+		// arbitrary bytes, including 0 0 wraps, truncated runs and
+		// counts that overrun, into buffers of all sizes
+		for (S32 i = 0; i < 50000; ++i)
+		{
+			S32 size = LL_PACKET_ID_SIZE + mRandom() % 600;
+			S32 zero_odds = 1 + mRandom() % 6;
+			std::vector<U8> input = random_packet(mRandom, size, zero_odds);
+			S32 out_size = LL_PACKET_ID_SIZE + mRandom() % 3000;
+			checkExpand(input, out_size);
+			checkExpand(input, NET_BUFFER_SIZE);
+		}
+	}
+
+	template<> template<>
+	void llzerocode_object::test<4>()
+	{
+		set_test_name("encode and expand MB/s on ObjectUpdate-like packets");
+		// The earlier tests hold LLZeroCode to the byte at a time code; this
+		// one races them
+		if (!benchmarking())
+		{
+			skip("set LL_BENCHMARKS to time LLZeroCode");
+		}
+		const S32 PACKETS = 256;
+		const S32 PASSES = 200;
+		std::vector<std::vector<U8> > packets;
+		std::vector<std::vector<U8> > encoded;
+		size_t bytes = 0;
+		size_t encoded_bytes = 0;
+		for (S32 i = 0; i < PACKETS; ++i)
+		{
+			packets.push_back(object_update_packet(mRandom));
+			std::vector<U8> packet_encoded(2 * packets.back().size());
+			packet_encoded.resize(LLZeroCode::encode(&packets.back()[0], (S32)packets.back().size(),
+													 &packet_encoded[0]));
+			encoded.push_back(packet_encoded);
+			bytes += packets.back().size();
+			encoded_bytes += packet_encoded.size();
+		}
+		F64 mbytes = F64(bytes) * PASSES / (1024. * 1024.);
+
+		U8 out[2 * NET_BUFFER_SIZE];
+		S32 check = 0;
+		F64 seconds[4];
+		for (S32 method = 0; method < 4; ++method)
+		{
+			LLTimer timer;
+			for (S32 pass = 0; pass < PASSES; ++pass)
+			{
+				for (S32 i = 0; i < PACKETS; ++i)
+				{
+					const std::vector<U8>& packet = packets[i];
+					const std::vector<U8>& packet_encoded = encoded[i];
+					switch (method)
+					{
+					case 0:
+						check += reference_encode(&packet[0], (S32)packet.size(), out);
+						break;
+					case 1:
+						check += LLZeroCode::encode(&packet[0], (S32)packet.size(), out);
+						break;
+					case 2:
+						check += reference_expand(&packet_encoded[0], (S32)packet_encoded.size(), out, NET_BUFFER_SIZE);
+						break;
+					default:
+						check += LLZeroCode::expand(&packet_encoded[0], (S32)packet_encoded.size(), out, NET_BUFFER_SIZE);
+						break;
+					}
+				}
+			}
+			seconds[method] = timer.getElapsedTimeF64();
+		}
+		ensure("nothing encoded", check > 0);
+
+		LL_INFOS("Benchmark") << PACKETS << " packets averaging " << bytes / PACKETS << " bytes, "
+							   << encoded_bytes * 100 / bytes << "% after encoding" << LL_ENDL;
+		LL_INFOS("Benchmark") << "encode: " << S32(mbytes / seconds[0]) << " MB/s byte at a time, "
+							  << S32(mbytes / seconds[1]) << " MB/s LLZeroCode" << LL_ENDL;
+		LL_INFOS("Benchmark") << "expand: " << S32(mbytes / seconds[2]) << " MB/s byte at a time, "
+							  << S32(mbytes / seconds[3]) << " MB/s LLZeroCode" << LL_ENDL;
+	}
+}
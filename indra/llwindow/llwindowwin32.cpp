@@ -346,7 +346,8 @@ struct LLWindowWin32::LLWindowWin32Thread : public LL::ThreadPool
 {
     static const int MAX_QUEUE_SIZE = 2048;
 
-    LLThreadSafeQueue<MSG> mMessageQueue;
+    // read by the main thread only
+    LLThreadSafeQueue<MSG, LL::MPSCQueue<MSG>> mMessageQueue;
 
     LLWindowWin32Thread();
 
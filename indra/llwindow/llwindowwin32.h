@@ -251,8 +251,10 @@ protected:
 
 	struct LLWindowWin32Thread;
 	LLWindowWin32Thread* mWindowThread = nullptr;
-	LLThreadSafeQueue<std::function<void()>> mFunctionQueue;
-	LLThreadSafeQueue<std::function<void()>> mMouseQueue;
+	// posted from the window thread, drained by the main thread
+	typedef LLThreadSafeQueue<std::function<void()>, LL::MPSCQueue<std::function<void()>>> FunctionQueue;
+	FunctionQueue mFunctionQueue;
+	FunctionQueue mMouseQueue;
 	void post(const std::function<void()>& func);
 	void postMouseButtonEvent(const std::function<void()>& func);
 	void recreateWindow(RECT window_rect, DWORD dw_ex_style, DWORD dw_style);
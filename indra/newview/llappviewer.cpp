@@ -4269,6 +4269,7 @@ bool LLAppViewer::initCache()
 
 	const std::string cache_dir = gDirUtilp->getExpandedFilename(LL_PATH_CACHE, cache_dir_name);
     LLDiskCache::initParamSingleton(cache_dir, disk_cache_size, enable_cache_debug_info);
+    LLDiskCache::getInstance()->setPackThreshold(gSavedSettings.getU32("DiskCachePackThreshold"));
 
 	if (!read_only)
 	{
@@ -259,7 +259,7 @@ void LLFacePool::destroy()
 	}
 }
 
-void LLFacePool::dirtyTextures(const std::set<LLViewerFetchedTexture*>& textures)
+void LLFacePool::dirtyTextures(const std::unordered_set<LLViewerFetchedTexture*>& textures)
 {
 }
 
@@ -32,6 +32,8 @@
 #include "v3math.h"
 #include "llvertexbuffer.h"
 
+#include <unordered_set>
+
 class LLFace;
 class LLViewerTexture;
 class LLViewerFetchedTexture;
@@ -407,7 +409,7 @@ public:
 	BOOL isDead() { return mReferences.empty(); }
 	
 	virtual LLViewerTexture *getTexture();
-	virtual void dirtyTextures(const std::set<LLViewerFetchedTexture*>& textures);
+	virtual void dirtyTextures(const std::unordered_set<LLViewerFetchedTexture*>& textures);
 
 	virtual void enqueue(LLFace *face);
 	virtual BOOL addFace(LLFace *face);
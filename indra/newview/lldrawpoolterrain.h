@@ -58,7 +58,7 @@ public:
 	/*virtual*/ void renderShadow(S32 pass);
 
 	/*virtual*/ void prerender();
-	/*virtual*/ void dirtyTextures(const std::set<LLViewerFetchedTexture*>& textures);
+	/*virtual*/ void dirtyTextures(const std::unordered_set<LLViewerFetchedTexture*>& textures);
 	/*virtual*/ LLViewerTexture *getTexture();
 	/*virtual*/ LLViewerTexture *getDebugTexture();
 	/*virtual*/ LLColor3 getDebugColor() const; // For AGP debug display
@@ -66,6 +66,7 @@
 #include "bufferstream.h"
 #include "llcorehttputil.h"
 #include "hbxxh.h"
+#include "llinventorycache.h"
 #include "llstartup.h"
 
 //#define DIFF_INVENTORY_FILES
@@ -90,6 +91,8 @@ S32 LLInventoryModel::sPendingSystemFolders = 0;
 //BOOL decompress_file(const char* src_filename, const char* dst_filename);
 static const char PRODUCTION_CACHE_FORMAT_STRING[] = "%s.inv.llsd";
 static const char GRID_CACHE_FORMAT_STRING[] = "%s.%s.inv.llsd";
+// Appended to the above for the chunked cache, see LLInventoryCacheWriter
+static const char CHUNKED_CACHE_SUFFIX[] = ".chunks";
 static const char * const LOG_INV("Inventory");
 
 struct InventoryIDPtrLess
@@ -2337,12 +2340,23 @@ void LLInventoryModel::cache(
 		items,
 		INCLUDE_TRASH,
 		can_cache);
+	std::string inventory_filename = getInvCacheAddres(agent_id);
+	std::string gzip_filename = inventory_filename + ".gz";
+	std::string chunked_filename = inventory_filename + CHUNKED_CACHE_SUFFIX;
+	if (saveToChunkedFile(chunked_filename, categories, items))
+	{
+		// The gzipped cache is only read when there is no chunked one
+		LLFile::remove(gzip_filename, ENOENT);
+		return;
+	}
+
+	// Fall back on the gzipped cache, and don't leave an older chunked
+	// one to be loaded instead
+	LLFile::remove(chunked_filename, ENOENT);
     // Use temporary file to avoid potential conflicts with other
     // instances (even a 'read only' instance unzips into a file)
     std::string temp_file = gDirUtilp->getTempFilename();
 	saveToFile(temp_file, categories, items);
-    std::string gzip_filename = getInvCacheAddres(agent_id);
-	gzip_filename.append(".gz");
 	if(gzip_file(temp_file, gzip_filename))
 	{
 		LL_DEBUGS(LOG_INV) << "Successfully compressed " << temp_file << " to " << gzip_filename << LL_ENDL;
@@ -2704,26 +2718,34 @@ bool LLInventoryModel::loadSkeleton(
 		const S32 NO_VERSION = LLViewerInventoryCategory::VERSION_UNKNOWN;
 		std::string gzip_filename(inventory_filename);
 		gzip_filename.append(".gz");
-		LLFILE* fp = LLFile::fopen(gzip_filename, "rb");
+		std::string chunked_filename(inventory_filename + CHUNKED_CACHE_SUFFIX);
 		bool remove_inventory_file = false;
-		if(fp)
+		bool is_cache_obsolete = false;
+		bool loaded = false;
+		if (LLFile::isfile(chunked_filename))
 		{
-			fclose(fp);
-			fp = NULL;
-			if(gunzip_file(gzip_filename, inventory_filename))
-			{
-				// we only want to remove the inventory file if it was
-				// gzipped before we loaded, and we successfully
-				// gunziped it.
-				remove_inventory_file = true;
-			}
-			else
+			loaded = loadFromChunkedFile(chunked_filename, categories, items, categories_to_update, is_cache_obsolete);
+		}
+		else
+		{
+			// The gzipped cache of older viewers
+			if (LLFile::isfile(gzip_filename))
 			{
-				LL_INFOS(LOG_INV) << "Unable to gunzip " << gzip_filename << LL_ENDL;
+				if(gunzip_file(gzip_filename, inventory_filename))
+				{
+					// we only want to remove the inventory file if it was
+					// gzipped before we loaded, and we successfully
+					// gunziped it.
+					remove_inventory_file = true;
+				}
+				else
+				{
+					LL_INFOS(LOG_INV) << "Unable to gunzip " << gzip_filename << LL_ENDL;
+				}
 			}
+			loaded = loadFromFile(inventory_filename, categories, items, categories_to_update, is_cache_obsolete);
 		}
-		bool is_cache_obsolete = false;
-		if (loadFromFile(inventory_filename, categories, items, categories_to_update, is_cache_obsolete))
+		if (loaded)
 		{
 			// We were able to find a cache of files. So, use what we
 			// found to generate a set of categories we should add. We
@@ -2918,7 +2940,8 @@ bool LLInventoryModel::loadSkeleton(
 		{
 			// If out of date, remove the gzipped file too.
 			LL_WARNS(LOG_INV) << "Inv cache out of date, removing" << LL_ENDL;
-			LLFile::remove(gzip_filename);
+			LLFile::remove(gzip_filename, ENOENT);
+			LLFile::remove(chunked_filename, ENOENT);
 		}
 		categories.clear(); // will unref and delete entries
 	}
@@ -3505,6 +3528,150 @@ bool LLInventoryModel::saveToFile(const std::string& filename,
     return true;
 }
 
+// static
+bool LLInventoryModel::loadFromChunkedFile(const std::string& filename,
+										   LLInventoryModel::cat_array_t& categories,
+										   LLInventoryModel::item_array_t& items,
+										   LLInventoryModel::changed_items_t& cats_to_update,
+										   bool& is_cache_obsolete)
+{
+	LL_PROFILE_ZONE_NAMED("inventory load from chunked file");
+	LL_INFOS(LOG_INV) << "loading inventory from: (" << filename << ")" << LL_ENDL;
+
+	LLInventoryCacheReader reader;
+	if (!reader.open(filename))
+	{
+		// Not worth keeping
+		is_cache_obsolete = true;
+		return false;
+	}
+	if (reader.getCacheVersion() != sCurrentInvCacheVersion)
+	{
+		LL_WARNS(LOG_INV) << "Inventory cache is out of date" << LL_ENDL;
+		is_cache_obsolete = true;
+		return false;
+	}
+
+	// The records become categories and items on the "General" threads as
+	// well as this one. The dictionaries that takes are built here, since a
+	// worker asking for one first would wait on this thread, and this thread
+	// waits on the workers.
+	LLAssetType::lookup(LLAssetType::AT_NONE);
+	LLInventoryType::lookup(LLInventoryType::IT_NONE);
+	LLFolderType::lookup(LLFolderType::FT_NONE);
+	LLPointer<LLViewerInventoryItem> localized = new LLViewerInventoryItem;
+	localized->fromLLSD(LLSD::emptyMap());
+
+	// What each chunk holds, merged in file order once all are parsed
+	struct ChunkContents
+	{
+		cat_array_t mCategories;
+		item_array_t mItems;
+		changed_items_t mCatsToUpdate;
+	};
+	std::vector<ChunkContents> chunks(reader.getNumChunks());
+	bool intact = reader.parse([&chunks](U32 chunk, const LLSD& s_item)
+	{
+		ChunkContents& contents = chunks[chunk];
+		if (s_item.has("cat_id"))
+		{
+			LLPointer<LLViewerInventoryCategory> inv_cat = new LLViewerInventoryCategory(LLUUID::null);
+			if (inv_cat->importLLSD(s_item))
+			{
+				contents.mCategories.push_back(inv_cat);
+			}
+		}
+		else if (s_item.has("item_id"))
+		{
+			LLPointer<LLViewerInventoryItem> inv_item = new LLViewerInventoryItem;
+			if (inv_item->fromLLSD(s_item))
+			{
+				if (inv_item->getUUID().isNull())
+				{
+					LL_DEBUGS(LOG_INV) << "Ignoring inventory with null item id: "
+									   << inv_item->getName() << LL_ENDL;
+				}
+				else if (inv_item->getType() == LLAssetType::AT_UNKNOWN)
+				{
+					contents.mCatsToUpdate.insert(inv_item->getParentUUID());
+				}
+				else
+				{
+					contents.mItems.push_back(inv_item);
+				}
+			}
+		}
+	});
+	if (!intact)
+	{
+		// Categories whose items were lost would look complete
+		LL_WARNS(LOG_INV) << "Inventory cache is damaged" << LL_ENDL;
+		is_cache_obsolete = true;
+		return false;
+	}
+
+	size_t num_categories = categories.size();
+	size_t num_items = items.size();
+	for (const ChunkContents& contents : chunks)
+	{
+		num_categories += contents.mCategories.size();
+		num_items += contents.mItems.size();
+	}
+	categories.reserve(num_categories);
+	items.reserve(num_items);
+	for (ChunkContents& contents : chunks)
+	{
+		categories.insert(categories.end(), contents.mCategories.begin(), contents.mCategories.end());
+		items.insert(items.end(), contents.mItems.begin(), contents.mItems.end());
+		cats_to_update.insert(contents.mCatsToUpdate.begin(), contents.mCatsToUpdate.end());
+	}
+
+	is_cache_obsolete = false;
+	return true;
+}
+
+// static
+bool LLInventoryModel::saveToChunkedFile(const std::string& filename,
+										 const cat_array_t& categories,
+										 const item_array_t& items)
+{
+	LL_PROFILE_ZONE_NAMED("inventory save to chunked file");
+	LL_INFOS(LOG_INV) << "saving inventory to: (" << filename << ")" << LL_ENDL;
+
+	LLInventoryCacheWriter writer;
+	if (!writer.open(filename, sCurrentInvCacheVersion))
+	{
+		return false;
+	}
+
+	S32 cat_count = 0;
+	for (const LLPointer<LLViewerInventoryCategory>& cat : categories)
+	{
+		if (cat->getVersion() != LLViewerInventoryCategory::VERSION_UNKNOWN)
+		{
+			if (!writer.add(cat->exportLLSD()))
+			{
+				return false;
+			}
+			++cat_count;
+		}
+	}
+	for (const LLPointer<LLViewerInventoryItem>& item : items)
+	{
+		if (!writer.add(item->asLLSD()))
+		{
+			return false;
+		}
+	}
+	if (!writer.close())
+	{
+		return false;
+	}
+
+	LL_INFOS(LOG_INV) << "Inventory saved: " << cat_count << " categories, " << items.size() << " items." << LL_ENDL;
+	return true;
+}
+
 // message handling functionality
 // static
 void LLInventoryModel::registerCallbacks(LLMessageSystem* msg)
@@ -666,6 +666,16 @@ protected:
 	static bool saveToFile(const std::string& filename,
 						   const cat_array_t& categories,
 						   const item_array_t& items); 
+	// The chunked cache, compressed and parsed on several threads; see
+	// LLInventoryCacheWriter
+	static bool loadFromChunkedFile(const std::string& filename,
+									cat_array_t& categories,
+									item_array_t& items,
+									changed_items_t& cats_to_update,
+									bool& is_cache_obsolete);
+	static bool saveToChunkedFile(const std::string& filename,
+								  const cat_array_t& categories,
+								  const item_array_t& items);
 
 	//--------------------------------------------------------------------
 	// Message handling functionality
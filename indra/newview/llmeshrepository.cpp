@@ -112,6 +112,8 @@
 //   main     Main rendering thread, very sensitive to locking and other stalls
 //   repo     Overseeing worker thread associated with the LLMeshRepoThread class
 //   decom    Worker thread for mesh decomposition requests
+//   decodeN  "MeshDecode" thread pool unpacking LODs and skin info,
+//            highest LODRequest::mScore first
 //   core     HTTP worker thread:  does the work but doesn't intrude here
 //   uploadN  0-N temporary mesh upload threads (0-1 in practice)
 //
@@ -150,10 +152,14 @@
 //                               issue Byte-Range GET for LOD
 //                             ...
 //                             onCompleted() invoked for GET
-//                               data copied
-//                               lodReceived() invoked
-//                                 unpack data into LLVolume
-//                                 append LoadedMesh to mLoadedQ
+//                               processBody() invoked
+//                                 decodeMeshLOD() queues the body
+//                             ...
+//                                                 decode pool
+//                                                 lodReceived() invoked
+//                                                   unpack body into LLVolume
+//                                                   append LoadedMesh to mLoadedQ
+//                                                 data written to cache
 //                             ...
 //         notifyLoadedMeshes() invoked again
 //           scan mLoadedQ
@@ -168,6 +174,7 @@
 //   LLMeshRepoThread::mMutex
 //   LLMeshRepoThread::mHeaderMutex
 //   LLMeshRepoThread::mSignal (LLCondition)
+//   LLMeshRepoThread::mDecodeMutex
 //   LLPhysicsDecomp::mSignal (LLCondition)
 //   LLPhysicsDecomp::mMutex
 //   LLMeshUploadThread::mMutex
@@ -176,6 +183,7 @@
 //
 //   1.  LLMeshRepoThread::mMutex before LLMeshRepoThread::mHeaderMutex
 //   2.  LLMeshRepository::mMeshMutex before LLMeshRepoThread::mMutex
+//   3.  LLMeshRepoThread::mDecodeMutex is never held while taking another
 //   (There are more rules, haven't been extracted.)
 //
 // Data Member Access/Locking
@@ -224,9 +232,13 @@
 //     sLODPending                     mMeshMutex [4]  rw.main.mMeshMutex
 //     sLODProcessing                  Repo::mMutex    rw.any.Repo::mMutex
 //     sCacheBytesRead                 none            rw.repo.none, ro.main.none [1]
-//     sCacheBytesWritten              "
-//     sCacheReads                     "
-//     sCacheWrites                    "
+//     sCacheBytesWritten              none            rw.repo.none, rw.decode.none, ro.main.none [0] (stats only)
+//     sCacheReads                     none            rw.repo.none, ro.main.none [1]
+//     sCacheWrites                    none            rw.repo.none, rw.decode.none, ro.main.none [0] (stats only)
+//     sDecodeQueued                   atomic          rw.repo.none, rw.decode.none, ro.main.none
+//     sDecodeActive                   atomic          rw.decode.none, ro.main.none
+//     sDecodeCount                    Repo::mDecodeMutex  rw.decode.mDecodeMutex, ro.main.none [1]
+//     sDecodeLatencyMS                Repo::mDecodeMutex  rw.decode.mDecodeMutex, ro.main.none [1]
 //     mLoadingMeshes                  mMeshMutex [4]  rw.main.none, rw.any.mMeshMutex
 //     mSkinMap                        none            rw.main.none
 //     mDecompositionMap               none            rw.main.none
@@ -353,6 +365,10 @@ const U32 LARGE_MESH_FETCH_THRESHOLD = 1U << 21;		// Size at which requests goes
 const long SMALL_MESH_XFER_TIMEOUT = 120L;				// Seconds to complete xfer, small mesh downloads
 const long LARGE_MESH_XFER_TIMEOUT = 600L;				// Seconds to complete xfer, large downloads
 
+const size_t MESH_DECODE_THREADS = 2;					// "MeshDecode" in ThreadPoolSizes overrides this
+const F32 SKIN_DECODE_PRIORITY = F32_MAX;				// Skins are small and hold up whole avatars, decode them first
+const S32 CACHE_ZERO_CHECK_SIZE = 1024;					// Cached blocks starting with this many zeros were never written
+
 const U32 DOWNLOAD_RETRY_LIMIT = 8;
 const F32 DOWNLOAD_RETRY_DELAY = 0.5f; // seconds
 
@@ -391,6 +407,10 @@ U32 LLMeshRepository::sCacheBytesDecomps = 0;
 U32 LLMeshRepository::sCacheReads = 0;
 U32 LLMeshRepository::sCacheWrites = 0;
 U32 LLMeshRepository::sMaxLockHoldoffs = 0;
+LLAtomicS32 LLMeshRepository::sDecodeQueued(0);
+LLAtomicS32 LLMeshRepository::sDecodeActive(0);
+U32 LLMeshRepository::sDecodeCount = 0;
+F32 LLMeshRepository::sDecodeLatencyMS = 0.f;
 	
 LLDeadmanTimer LLMeshRepository::sQuiescentTimer(15.0, false);	// true -> gather cpu metrics
 
@@ -553,6 +573,71 @@ S32 LLMeshRepoThread::sRequestLowWater = REQUEST2_LOW_WATER_MIN;
 S32 LLMeshRepoThread::sRequestHighWater = REQUEST2_HIGH_WATER_MIN;
 S32 LLMeshRepoThread::sRequestWaterLevel = 0;
 
+// A LOD or skin info block waiting for the decode pool: either a
+// buffer read from the cache, or the requested range of an HTTP
+// response body, which is then decoded in place rather than copied.
+//
+// Thread:  repo creates, decode pool uses and releases
+class LLMeshBlock
+{
+public:
+	// Takes ownership of data, which must come from new[]
+	LLMeshBlock(U8* data, S32 size)
+		: mData(data),
+		  mBody(NULL),
+		  mSize(size)
+	{
+		LLUZipHelper::Segment segment = { data, (size_t)size };
+		mSegments.push_back(segment);
+	}
+
+	// Keeps a reference to body
+	LLMeshBlock(LLCore::BufferArray* body, S32 offset, S32 size)
+		: mData(NULL),
+		  mBody(body),
+		  mSize(size)
+	{
+		mBody->addRef();
+		size_t pos = offset;
+		size_t end = pos + size;
+		while (pos < end)
+		{
+			size_t len = 0;
+			const char* data = mBody->getContiguous(pos, &len);
+			if (!data)
+			{
+				break;
+			}
+			LLUZipHelper::Segment segment = { (const U8*)data, llmin(len, end - pos) };
+			mSegments.push_back(segment);
+			pos += segment.mSize;
+		}
+		mSize = (S32)(pos - offset);
+	}
+
+	~LLMeshBlock()
+	{
+		delete[] mData;
+		if (mBody)
+		{
+			mBody->release();
+		}
+	}
+
+	S32 getSize() const { return mSize; }
+	const LLUZipHelper::Segment* getSegments() const { return mSegments.data(); }
+	size_t getSegmentCount() const { return mSegments.size(); }
+
+private:
+	LLMeshBlock(const LLMeshBlock &);				// Not defined
+	void operator=(const LLMeshBlock &);			// Not defined
+
+	U8* mData;
+	LLCore::BufferArray* mBody;
+	S32 mSize;
+	std::vector<LLUZipHelper::Segment> mSegments;
+};
+
 // Base handler class for all mesh users of llcorehttp.
 // This is roughly equivalent to a Responder class in
 // traditional LL code.  The base is going to perform
@@ -560,7 +645,9 @@ S32 LLMeshRepoThread::sRequestWaterLevel = 0;
 // onCompleted() method.  Derived classes, one for each
 // type of HTTP action, define processData() and
 // processFailure() methods to customize handling and
-// error messages.
+// error messages.  Those that can work from the response
+// body as it is also define processBody(), which saves
+// copying the data out of it.
 //
 // LLCore::HttpHandler
 //   LLMeshHandlerBase
@@ -596,6 +683,8 @@ protected:
 	
 public:
 	virtual void onCompleted(LLCore::HttpHandle handle, LLCore::HttpResponse * response);
+	// Returns false to have the data copied out of the body and passed to processData()
+	virtual bool processBody(LLCore::BufferArray * /* body */, S32 /* body_offset */, S32 /* data_size */) { return false; }
 	virtual void processData(LLCore::BufferArray * body, S32 body_offset, U8 * data, S32 data_size) = 0;
 	virtual void processFailure(LLCore::HttpStatus status) = 0;
 	
@@ -640,9 +729,10 @@ class LLMeshLODHandler : public LLMeshHandlerBase
 {
 public:
 	LOG_CLASS(LLMeshLODHandler);
-	LLMeshLODHandler(const LLVolumeParams & mesh_params, S32 lod, U32 offset, U32 requested_bytes)
+	LLMeshLODHandler(const LLVolumeParams & mesh_params, S32 lod, U32 offset, U32 requested_bytes, F32 score)
 		: LLMeshHandlerBase(offset, requested_bytes),
-		  mLOD(lod)
+		  mLOD(lod),
+		  mScore(score)
 	{
 			mMeshParams = mesh_params;
 			LLMeshRepoThread::incActiveLODRequests();
@@ -654,11 +744,13 @@ protected:
 	void operator=(const LLMeshLODHandler &);					// Not defined
 	
 public:
+	virtual bool processBody(LLCore::BufferArray * body, S32 body_offset, S32 data_size);
 	virtual void processData(LLCore::BufferArray * body, S32 body_offset, U8 * data, S32 data_size);
 	virtual void processFailure(LLCore::HttpStatus status);
 
 public:
 	S32 mLOD;
+	F32 mScore;		// decode priority
 };
 
 
@@ -680,6 +772,7 @@ protected:
 	void operator=(const LLMeshSkinInfoHandler &);				// Not defined
 
 public:
+	virtual bool processBody(LLCore::BufferArray * body, S32 body_offset, S32 data_size);
 	virtual void processData(LLCore::BufferArray * body, S32 body_offset, U8 * data, S32 data_size);
 	virtual void processFailure(LLCore::HttpStatus status);
 
@@ -828,7 +921,8 @@ LLMeshRepoThread::LLMeshRepoThread()
   mHttpLargeOptions(),
   mHttpHeaders(),
   mHttpPolicyClass(LLCore::HttpRequest::DEFAULT_POLICY_ID),
-  mHttpLargePolicyClass(LLCore::HttpRequest::DEFAULT_POLICY_ID)
+  mHttpLargePolicyClass(LLCore::HttpRequest::DEFAULT_POLICY_ID),
+  mDecodeSequence(0)
 {
 	LLAppCoreHttp & app_core_http(LLAppViewer::instance()->getAppCoreHttp());
 
@@ -846,6 +940,10 @@ LLMeshRepoThread::LLMeshRepoThread()
 	mHttpHeaders->append(HTTP_OUT_HEADER_ACCEPT, HTTP_CONTENT_VND_LL_MESH);
 	mHttpPolicyClass = app_core_http.getPolicy(LLAppCoreHttp::AP_MESH2);
 	mHttpLargePolicyClass = app_core_http.getPolicy(LLAppCoreHttp::AP_LARGE_MESH);
+
+	// Closed by the destructor, jobs use this object
+	mDecodePool.reset(new LL::ThreadPool("MeshDecode", MESH_DECODE_THREADS, 1024 * 1024, false));
+	mDecodePool->start();
 }
 
 
@@ -856,6 +954,10 @@ LLMeshRepoThread::~LLMeshRepoThread()
 					   << ", Max Lock Holdoffs:  " << LLMeshRepository::sMaxLockHoldoffs
 					   << LL_ENDL;
 
+	// Runs or drops whatever is still queued, before the mutexes go away
+	mDecodePool->close();
+	mDecodePool.reset();
+
 	mHttpRequestSet.clear();
     mHttpHeaders.reset();
 
@@ -943,7 +1045,7 @@ void LLMeshRepoThread::run()
                     // failed to load before, wait a bit
                     incomplete.push_front(req);
                 }
-                else if (!fetchMeshLOD(req.mMeshParams, req.mLOD, req.canRetry()))
+                else if (!fetchMeshLOD(req.mMeshParams, req.mLOD, req.canRetry(), req.mScore))
                 {
                     if (req.canRetry())
                     {
@@ -1180,16 +1282,16 @@ void LLMeshRepoThread::loadMeshPhysicsShape(const LLUUID& mesh_id)
 	mPhysicsShapeRequests.insert(UUIDBasedRequest(mesh_id));
 }
 
-void LLMeshRepoThread::lockAndLoadMeshLOD(const LLVolumeParams& mesh_params, S32 lod)
+void LLMeshRepoThread::lockAndLoadMeshLOD(const LLVolumeParams& mesh_params, S32 lod, F32 score)
 {
 	if (!LLAppViewer::isExiting())
 	{
-		loadMeshLOD(mesh_params, lod);
+		loadMeshLOD(mesh_params, lod, score);
 	}
 }
 
 
-void LLMeshRepoThread::loadMeshLOD(const LLVolumeParams& mesh_params, S32 lod)
+void LLMeshRepoThread::loadMeshLOD(const LLVolumeParams& mesh_params, S32 lod, F32 score)
 { //could be called from any thread
 	const LLUUID& mesh_id = mesh_params.getSculptID();
 	LLMutexLock lock(mMutex);
@@ -1199,6 +1301,7 @@ void LLMeshRepoThread::loadMeshLOD(const LLVolumeParams& mesh_params, S32 lod)
 	{ //if we have the header, request LOD byte range
 
 		LODRequest req(mesh_params, lod);
+		req.mScore = score;
 		{
 			mLODReqQ.push(req);
 			LLMeshRepository::sLODProcessing++;
@@ -1376,12 +1479,9 @@ bool LLMeshRepoThread::fetchMeshSkinInfo(const LLUUID& mesh_id, bool can_retry)
 				}
 
 				if (!zero)
-				{ //attempt to parse
-					if (skinInfoReceived(mesh_id, buffer, size))
-					{						
-						delete[] buffer;
-						return true;
-					}
+				{ //parse on the decode pool, refetches if that fails
+					decodeSkinInfo(mesh_id, std::make_shared<LLMeshBlock>(buffer, size), offset, true);
+					return true;
 				}
 
 				delete[] buffer;
@@ -1732,7 +1832,7 @@ bool LLMeshRepoThread::fetchMeshHeader(const LLVolumeParams& mesh_params, bool c
 }
 
 //return false if failed to get mesh lod.
-bool LLMeshRepoThread::fetchMeshLOD(const LLVolumeParams& mesh_params, S32 lod, bool can_retry)
+bool LLMeshRepoThread::fetchMeshLOD(const LLVolumeParams& mesh_params, S32 lod, bool can_retry, F32 score)
 {
 	if (!mHeaderMutex)
 	{
@@ -1788,17 +1888,10 @@ bool LLMeshRepoThread::fetchMeshLOD(const LLVolumeParams& mesh_params, S32 lod,
 				}
 
 				if (!zero)
-				{ //attempt to parse
-					if (lodReceived(mesh_params, lod, buffer, size) == MESH_OK)
-					{
-						delete[] buffer;
-
-						std::string mid;
-						mesh_id.toString(mid);
-						LL_DEBUGS(LOG_MESH) << "Mesh/Cache: Mesh body for ID " << mid << " - was retrieved from the cache." << LL_ENDL;
-
-						return true;
-					}
+				{ //parse on the decode pool, refetches if that fails
+					LL_DEBUGS(LOG_MESH) << "Mesh/Cache: Mesh body for ID " << mesh_id << " - was retrieved from the cache." << LL_ENDL;
+					decodeMeshLOD(mesh_params, lod, score, std::make_shared<LLMeshBlock>(buffer, size), offset, true);
+					return true;
 				}
 
 				delete[] buffer;
@@ -1814,7 +1907,7 @@ bool LLMeshRepoThread::fetchMeshLOD(const LLVolumeParams& mesh_params, S32 lod,
 				mesh_id.toString(mid);
 				LL_DEBUGS(LOG_MESH) << "Mesh/Cache: Mesh body for ID " << mid << " - was retrieved from the simulator." << LL_ENDL;
 
-                LLMeshHandlerBase::ptr_t handler(new LLMeshLODHandler(mesh_params, lod, offset, size));
+                LLMeshHandlerBase::ptr_t handler(new LLMeshLODHandler(mesh_params, lod, offset, size, score));
 				LLCore::HttpHandle handle = getByteRange(http_url, offset, size, handler);
 				if (LLCORE_HTTP_HANDLE_INVALID == handle)
 				{
@@ -1933,15 +2026,15 @@ EMeshProcessingResult LLMeshRepoThread::headerReceived(const LLVolumeParams& mes
 	return MESH_OK;
 }
 
-EMeshProcessingResult LLMeshRepoThread::lodReceived(const LLVolumeParams& mesh_params, S32 lod, U8* data, S32 data_size)
+EMeshProcessingResult LLMeshRepoThread::lodReceived(const LLVolumeParams& mesh_params, S32 lod, const LLMeshBlock& block)
 {
-	if (data == NULL || data_size == 0)
+	if (block.getSize() <= 0)
 	{
 		return MESH_NO_DATA;
 	}
 
 	LLPointer<LLVolume> volume = new LLVolume(mesh_params, LLVolumeLODGroup::getVolumeScaleFromDetail(lod));
-	if (volume->unpackVolumeFaces(data, data_size))
+	if (volume->unpackVolumeFaces(block.getSegments(), block.getSegmentCount()))
 	{
 		if (volume->getNumFaces() > 0)
 		{
@@ -1963,15 +2056,16 @@ EMeshProcessingResult LLMeshRepoThread::lodReceived(const LLVolumeParams& mesh_p
 	return MESH_UNKNOWN;
 }
 
-bool LLMeshRepoThread::skinInfoReceived(const LLUUID& mesh_id, U8* data, S32 data_size)
+bool LLMeshRepoThread::skinInfoReceived(const LLUUID& mesh_id, const LLMeshBlock& block)
 {
 	LLSD skin;
+	S32 data_size = block.getSize();
 
 	if (data_size > 0)
 	{
         try
         {
-            U32 uzip_result = LLUZipHelper::unzip_llsd(skin, data, data_size);
+            U32 uzip_result = LLUZipHelper::unzip_llsd(skin, block.getSegments(), block.getSegmentCount());
             if (uzip_result != LLUZipHelper::ZR_OK)
             {
                 LL_WARNS(LOG_MESH) << "Mesh skin info parse error.  Not a valid mesh asset!  ID:  " << mesh_id
@@ -2092,6 +2186,149 @@ EMeshProcessingResult LLMeshRepoThread::physicsShapeReceived(const LLUUID& mesh_
 	return MESH_OK;
 }
 
+namespace
+{
+	// Make a cached block look unwritten so that the next fetch of it goes
+	// to the simulator
+	void invalidate_cached_block(const LLUUID& mesh_id, S32 offset, S32 size)
+	{
+		LLFileSystem file(mesh_id, LLAssetType::AT_MESH, LLFileSystem::READ_WRITE);
+		if (file.getSize() >= offset + size)
+		{
+			U8 zeros[CACHE_ZERO_CHECK_SIZE] = { 0 };
+			file.seek(offset);
+			file.write(zeros, llmin(size, CACHE_ZERO_CHECK_SIZE));
+		}
+	}
+
+	void write_cached_block(const LLUUID& mesh_id, const LLMeshBlock& block, S32 offset)
+	{
+		LLFileSystem file(mesh_id, LLAssetType::AT_MESH, LLFileSystem::READ_WRITE);
+		if (file.getSize() >= offset + block.getSize())
+		{
+			file.seek(offset);
+			for (size_t i = 0; i < block.getSegmentCount(); ++i)
+			{
+				const LLUZipHelper::Segment& segment = block.getSegments()[i];
+				file.write(segment.mData, (S32)segment.mSize);
+			}
+			LLMeshRepository::sCacheBytesWritten += block.getSize();
+			++LLMeshRepository::sCacheWrites;
+		}
+	}
+}
+
+void LLMeshRepoThread::decodeMeshLOD(const LLVolumeParams& mesh_params, S32 lod, F32 score, const std::shared_ptr<LLMeshBlock>& block, S32 offset, bool from_cache)
+{
+	queueDecode(score, [=]()
+	{
+		EMeshProcessingResult result = lodReceived(mesh_params, lod, *block);
+		if (result == MESH_OK)
+		{
+			if (!from_cache)
+			{
+				// good fetch from sim, write to cache
+				write_cached_block(mesh_params.getSculptID(), *block, offset);
+			}
+		}
+		else if (from_cache)
+		{
+			LL_WARNS(LOG_MESH) << "Cached mesh LOD failed to decode, fetching it again.  ID:  " << mesh_params.getSculptID()
+							   << ", Reason: " << result << " LOD: " << lod << LL_ENDL;
+			invalidate_cached_block(mesh_params.getSculptID(), offset, block->getSize());
+			lockAndLoadMeshLOD(mesh_params, lod, score);
+		}
+		else
+		{
+			LL_WARNS(LOG_MESH) << "Error during mesh LOD processing.  ID:  " << mesh_params.getSculptID()
+							   << ", Reason: " << result
+							   << " LOD: " << lod
+							   << " Data size: " << block->getSize()
+							   << " Not retrying."
+							   << LL_ENDL;
+			LLMutexLock lock(mMutex);
+			mUnavailableQ.push_back(LODRequest(mesh_params, lod));
+		}
+	});
+}
+
+void LLMeshRepoThread::decodeSkinInfo(const LLUUID& mesh_id, const std::shared_ptr<LLMeshBlock>& block, S32 offset, bool from_cache)
+{
+	queueDecode(SKIN_DECODE_PRIORITY, [=]()
+	{
+		if (skinInfoReceived(mesh_id, *block))
+		{
+			if (!from_cache)
+			{
+				write_cached_block(mesh_id, *block, offset);
+			}
+		}
+		else if (from_cache)
+		{
+			LL_WARNS(LOG_MESH) << "Cached mesh skin info failed to decode, fetching it again.  ID:  " << mesh_id << LL_ENDL;
+			invalidate_cached_block(mesh_id, offset, block->getSize());
+			LLMutexLock lock(mMutex);
+			loadMeshSkinInfo(mesh_id);
+		}
+		else
+		{
+			LL_WARNS(LOG_MESH) << "Error during mesh skin info processing.  ID:  " << mesh_id
+							   << ", Unknown reason.  Not retrying."
+							   << LL_ENDL;
+			LLMutexLock lock(mMutex);
+			mSkinUnavailableQ.emplace_back(mesh_id);
+		}
+	});
+}
+
+void LLMeshRepoThread::queueDecode(F32 priority, const std::function<void()>& work)
+{
+	{
+		LLMutexLock lock(&mDecodeMutex);
+		mDecodeQueue.push(DecodeJob{ priority, mDecodeSequence++, LLTimer::getTotalSeconds(), work });
+		++LLMeshRepository::sDecodeQueued;
+	}
+
+	if (!mDecodePool->getQueue().post([this]() { runNextDecode(); }))
+	{
+		// Pool closed, shutting down
+		runNextDecode();
+	}
+}
+
+// Threads:  decode pool
+void LLMeshRepoThread::runNextDecode()
+{
+	LL_PROFILE_ZONE_SCOPED;
+	DecodeJob job;
+	{
+		LLMutexLock lock(&mDecodeMutex);
+		if (mDecodeQueue.empty())
+		{
+			return;
+		}
+		job = mDecodeQueue.top();
+		mDecodeQueue.pop();
+		--LLMeshRepository::sDecodeQueued;
+		++LLMeshRepository::sDecodeActive;
+	}
+
+	if (!LLApp::isExiting())
+	{
+		job.mWork();
+	}
+	job.mWork = nullptr; // free the data now rather than under the lock
+
+	F32 latency_ms = (F32)((LLTimer::getTotalSeconds() - job.mQueuedTime) * 1000.0);
+	{
+		LLMutexLock lock(&mDecodeMutex);
+		--LLMeshRepository::sDecodeActive;
+		++LLMeshRepository::sDecodeCount;
+		LLMeshRepository::sDecodeLatencyMS = LLMeshRepository::sDecodeCount == 1 ? latency_ms
+			: lerp(LLMeshRepository::sDecodeLatencyMS, latency_ms, 0.05f);
+	}
+}
+
 LLMeshUploadThread::LLMeshUploadThread(LLMeshUploadThread::instance_list& data, LLVector3& scale, bool upload_textures,
 									   bool upload_skin, bool upload_joints, bool lock_scale_if_joint_position,
                                        const std::string & upload_url, bool do_upload,
@@ -3130,11 +3367,15 @@ void LLMeshHandlerBase::onCompleted(LLCore::HttpHandle handle, LLCore::HttpRespo
 				goto common_exit;
 			}
 			
-			// *TODO: Try to get rid of data copying and add interfaces
-			// that support BufferArray directly.  Introduce a two-phase
-			// handler, optional first that takes a body, fallback second
-			// that requires a temporary allocation and data copy.
+			// Handlers that can decode from the body itself get it
+			// as is, the others get a copy of the data.
 			body_offset = mOffset - offset;
+			if (processBody(body, body_offset, data_size - body_offset))
+			{
+				LLMeshRepository::sBytesReceived += data_size;
+				goto common_exit;
+			}
+
 			data = new(std::nothrow) U8[data_size - body_offset];
 			if (data)
 			{
@@ -3309,7 +3550,7 @@ LLMeshLODHandler::~LLMeshLODHandler()
 		if (! mProcessed)
 		{
 			LL_WARNS(LOG_MESH) << "Mesh LOD fetch canceled unexpectedly, retrying." << LL_ENDL;
-			gMeshRepo.mThread->lockAndLoadMeshLOD(mMeshParams, mLOD);
+			gMeshRepo.mThread->lockAndLoadMeshLOD(mMeshParams, mLOD, mScore);
 		}
 		LLMeshRepoThread::decActiveLODRequests();
 	}
@@ -3326,53 +3567,46 @@ void LLMeshLODHandler::processFailure(LLCore::HttpStatus status)
 	gMeshRepo.mThread->mUnavailableQ.push_back(LLMeshRepoThread::LODRequest(mMeshParams, mLOD));
 }
 
+bool LLMeshLODHandler::processBody(LLCore::BufferArray * body, S32 body_offset, S32 data_size)
+{
+	if (MESH_LOD_PROCESS_FAILED || data_size <= 0)
+	{
+		// processData() reports it
+		return false;
+	}
+
+	// The decode pool reads the requested block straight from the body
+	std::shared_ptr<LLMeshBlock> block = std::make_shared<LLMeshBlock>(body, body_offset, llmin(data_size, (S32)mRequestedBytes));
+	gMeshRepo.mThread->decodeMeshLOD(mMeshParams, mLOD, mScore, block, mOffset, false);
+	return true;
+}
+
 void LLMeshLODHandler::processData(LLCore::BufferArray * /* body */, S32 /* body_offset */,
 								   U8 * data, S32 data_size)
 {
 	if ((!MESH_LOD_PROCESS_FAILED)
 		&& ((data != NULL) == (data_size > 0))) // if we have data but no size or have size but no data, something is wrong
 	{
-		EMeshProcessingResult result = gMeshRepo.mThread->lodReceived(mMeshParams, mLOD, data, data_size);
-		if (result == MESH_OK)
+		// data belongs to onCompleted(), the decode pool gets its own copy
+		// of the requested block
+		data_size = llmin(data_size, (S32)mRequestedBytes);
+		U8* buffer = new(std::nothrow) U8[data_size];
+		if (buffer)
 		{
-			// good fetch from sim, write to cache
-			// <FS:Ansariel> Fix asset caching
-			//LLFileSystem file(mMeshParams.getSculptID(), LLAssetType::AT_MESH, LLFileSystem::WRITE);
-			LLFileSystem file(mMeshParams.getSculptID(), LLAssetType::AT_MESH, LLFileSystem::READ_WRITE);
-
-			S32 offset = mOffset;
-			S32 size = mRequestedBytes;
-
-			if (file.getSize() >= offset+size)
-			{
-				file.seek(offset);
-				file.write(data, size);
-				LLMeshRepository::sCacheBytesWritten += size;
-				++LLMeshRepository::sCacheWrites;
-			}
-		}
-		else
-		{
-			LL_WARNS(LOG_MESH) << "Error during mesh LOD processing.  ID:  " << mMeshParams.getSculptID()
-							   << ", Reason: " << result
-							   << " LOD: " << mLOD
-							   << " Data size: " << data_size
-							   << " Not retrying."
-							   << LL_ENDL;
-			LLMutexLock lock(gMeshRepo.mThread->mMutex);
-			gMeshRepo.mThread->mUnavailableQ.push_back(LLMeshRepoThread::LODRequest(mMeshParams, mLOD));
+			memcpy(buffer, data, data_size);
+			gMeshRepo.mThread->decodeMeshLOD(mMeshParams, mLOD, mScore, std::make_shared<LLMeshBlock>(buffer, data_size), mOffset, false);
+			return;
 		}
+		LL_WARNS(LOG_MESH) << "Failed to allocate " << data_size << " bytes to decode mesh LOD.  ID:  " << mMeshParams.getSculptID() << LL_ENDL;
 	}
-	else
-	{
-		LL_WARNS(LOG_MESH) << "Error during mesh LOD processing.  ID:  " << mMeshParams.getSculptID()
-						   << ", Unknown reason.  Not retrying."
-						   << " LOD: " << mLOD
-						   << " Data size: " << data_size
-						   << LL_ENDL;
-		LLMutexLock lock(gMeshRepo.mThread->mMutex);
-		gMeshRepo.mThread->mUnavailableQ.push_back(LLMeshRepoThread::LODRequest(mMeshParams, mLOD));
-	}
+
+	LL_WARNS(LOG_MESH) << "Error during mesh LOD processing.  ID:  " << mMeshParams.getSculptID()
+					   << ", Unknown reason.  Not retrying."
+					   << " LOD: " << mLOD
+					   << " Data size: " << data_size
+					   << LL_ENDL;
+	LLMutexLock lock(gMeshRepo.mThread->mMutex);
+	gMeshRepo.mThread->mUnavailableQ.push_back(LLMeshRepoThread::LODRequest(mMeshParams, mLOD));
 }
 
 LLMeshSkinInfoHandler::~LLMeshSkinInfoHandler()
@@ -3393,37 +3627,43 @@ void LLMeshSkinInfoHandler::processFailure(LLCore::HttpStatus status)
 		gMeshRepo.mThread->mSkinUnavailableQ.emplace_back(mMeshID);
 }
 
+bool LLMeshSkinInfoHandler::processBody(LLCore::BufferArray * body, S32 body_offset, S32 data_size)
+{
+	if (MESH_SKIN_INFO_PROCESS_FAILED || data_size <= 0)
+	{
+		// processData() reports it
+		return false;
+	}
+
+	std::shared_ptr<LLMeshBlock> block = std::make_shared<LLMeshBlock>(body, body_offset, llmin(data_size, (S32)mRequestedBytes));
+	gMeshRepo.mThread->decodeSkinInfo(mMeshID, block, mOffset, false);
+	return true;
+}
+
 void LLMeshSkinInfoHandler::processData(LLCore::BufferArray * /* body */, S32 /* body_offset */,
 										U8 * data, S32 data_size)
 {
 	if ((!MESH_SKIN_INFO_PROCESS_FAILED)
-		&& ((data != NULL) == (data_size > 0)) // if we have data but no size or have size but no data, something is wrong
-		&& gMeshRepo.mThread->skinInfoReceived(mMeshID, data, data_size))
+		&& ((data != NULL) == (data_size > 0))) // if we have data but no size or have size but no data, something is wrong
 	{
-		// good fetch from sim, write to cache
-		// <FS:Ansariel> Fix asset caching
-		//LLFileSystem file(mMeshID, LLAssetType::AT_MESH, LLFileSystem::WRITE);
-		LLFileSystem file(mMeshID, LLAssetType::AT_MESH, LLFileSystem::READ_WRITE);
-
-		S32 offset = mOffset;
-		S32 size = mRequestedBytes;
-
-		if (file.getSize() >= offset+size)
+		// data belongs to onCompleted(), the decode pool gets its own copy
+		// of the requested block
+		data_size = llmin(data_size, (S32)mRequestedBytes);
+		U8* buffer = new(std::nothrow) U8[data_size];
+		if (buffer)
 		{
-			LLMeshRepository::sCacheBytesWritten += size;
-			++LLMeshRepository::sCacheWrites;
-			file.seek(offset);
-			file.write(data, size);
+			memcpy(buffer, data, data_size);
+			gMeshRepo.mThread->decodeSkinInfo(mMeshID, std::make_shared<LLMeshBlock>(buffer, data_size), mOffset, false);
+			return;
 		}
+		LL_WARNS(LOG_MESH) << "Failed to allocate " << data_size << " bytes to decode mesh skin info.  ID:  " << mMeshID << LL_ENDL;
 	}
-	else
-	{
-		LL_WARNS(LOG_MESH) << "Error during mesh skin info processing.  ID:  " << mMeshID
-						   << ", Unknown reason.  Not retrying."
-						   << LL_ENDL;
-		LLMutexLock lock(gMeshRepo.mThread->mMutex);
-		gMeshRepo.mThread->mSkinUnavailableQ.emplace_back(mMeshID);
-	}
+
+	LL_WARNS(LOG_MESH) << "Error during mesh skin info processing.  ID:  " << mMeshID
+					   << ", Unknown reason.  Not retrying."
+					   << LL_ENDL;
+	LLMutexLock lock(gMeshRepo.mThread->mMutex);
+	gMeshRepo.mThread->mSkinUnavailableQ.emplace_back(mMeshID);
 }
 
 LLMeshDecompositionHandler::~LLMeshDecompositionHandler()
@@ -3956,7 +4196,7 @@ void LLMeshRepository::notifyLoadedMeshes()
 			while (!mPendingRequests.empty() && push_count > 0)
 			{
 				LLMeshRepoThread::LODRequest& request = mPendingRequests.front();
-				mThread->loadMeshLOD(request.mMeshParams, request.mLOD);
+				mThread->loadMeshLOD(request.mMeshParams, request.mLOD, request.mScore);
 				mPendingRequests.erase(mPendingRequests.begin());
 				LLMeshRepository::sLODPending--;
 				push_count--;
@@ -40,6 +40,12 @@
 #include "httpheaders.h"
 #include "httphandler.h"
 #include "llthread.h"
+#include "llatomic.h"
+#include "threadpool.h"
+
+#include <functional>
+#include <memory>
+#include <queue>
 
 #define LLCONVEXDECOMPINTER_STATIC 1
 
@@ -47,6 +53,7 @@
 #include "lluploadfloaterobservers.h"
 
 class LLVOVolume;
+class LLMeshBlock;
 class LLMutex;
 class LLCondition;
 class LLMeshRepository;
@@ -390,16 +397,26 @@ public:
 
 	virtual void run();
 
-	void lockAndLoadMeshLOD(const LLVolumeParams& mesh_params, S32 lod);
-	void loadMeshLOD(const LLVolumeParams& mesh_params, S32 lod);
+	// score keeps a refetch where the original request was in the queue
+	void lockAndLoadMeshLOD(const LLVolumeParams& mesh_params, S32 lod, F32 score);
+	void loadMeshLOD(const LLVolumeParams& mesh_params, S32 lod, F32 score = 0.f);
 
 	bool fetchMeshHeader(const LLVolumeParams& mesh_params, bool can_retry = true);
-	bool fetchMeshLOD(const LLVolumeParams& mesh_params, S32 lod, bool can_retry = true);
+	bool fetchMeshLOD(const LLVolumeParams& mesh_params, S32 lod, bool can_retry = true, F32 score = 0.f);
 	EMeshProcessingResult headerReceived(const LLVolumeParams& mesh_params, U8* data, S32 data_size);
-	EMeshProcessingResult lodReceived(const LLVolumeParams& mesh_params, S32 lod, U8* data, S32 data_size);
-	bool skinInfoReceived(const LLUUID& mesh_id, U8* data, S32 data_size);
+	EMeshProcessingResult lodReceived(const LLVolumeParams& mesh_params, S32 lod, const LLMeshBlock& block);
+	bool skinInfoReceived(const LLUUID& mesh_id, const LLMeshBlock& block);
 	bool decompositionReceived(const LLUUID& mesh_id, U8* data, S32 data_size);
 	EMeshProcessingResult physicsShapeReceived(const LLUUID& mesh_id, U8* data, S32 data_size);
+
+	// Unpack a LOD or skin info block on the decode pool instead of the
+	// repo thread. offset is where the block lives in the cache file: a
+	// block read from the cache is discarded and fetched again if it fails
+	// to decode, a block received from the simulator is written there once
+	// decoded.
+	void decodeMeshLOD(const LLVolumeParams& mesh_params, S32 lod, F32 score, const std::shared_ptr<LLMeshBlock>& block, S32 offset, bool from_cache);
+	void decodeSkinInfo(const LLUUID& mesh_id, const std::shared_ptr<LLMeshBlock>& block, S32 offset, bool from_cache);
+
 	bool hasPhysicsShapeInHeader(const LLUUID& mesh_id);
     bool hasSkinInfoInHeader(const LLUUID& mesh_id);
     bool hasHeader(const LLUUID& mesh_id);
@@ -447,6 +464,37 @@ private:
 	LLCore::HttpHandle getByteRange(const std::string & url, 
 									size_t offset, size_t len, 
 									const LLCore::HttpHandler::ptr_t &handler);
+
+	// Decode work waits in mDecodeQueue, most important first, and each
+	// task posted to mDecodePool runs whichever job is on top at the time.
+	struct DecodeJob
+	{
+		F32 mPriority;
+		U64 mSequence;
+		F64 mQueuedTime;
+		std::function<void()> mWork;
+	};
+
+	struct CompareDecodePriority
+	{
+		// std::priority_queue pops the greatest: highest priority, then oldest
+		bool operator()(const DecodeJob& lhs, const DecodeJob& rhs) const
+		{
+			if (lhs.mPriority != rhs.mPriority)
+			{
+				return lhs.mPriority < rhs.mPriority;
+			}
+			return lhs.mSequence > rhs.mSequence;
+		}
+	};
+
+	void queueDecode(F32 priority, const std::function<void()>& work);
+	void runNextDecode();
+
+	LLMutex mDecodeMutex;
+	std::priority_queue<DecodeJob, std::vector<DecodeJob>, CompareDecodePriority> mDecodeQueue;
+	U64 mDecodeSequence;
+	std::unique_ptr<LL::ThreadPool> mDecodePool;
 };
 
 
@@ -618,6 +666,10 @@ public:
 	static U32 sCacheReads;						
 	static U32 sCacheWrites;
 	static U32 sMaxLockHoldoffs;				// Maximum sequential locking failures
+	static LLAtomicS32 sDecodeQueued;			// LOD and skin info blocks waiting for a decode thread
+	static LLAtomicS32 sDecodeActive;			// Blocks being decoded
+	static U32 sDecodeCount;					// Blocks decoded
+	static F32 sDecodeLatencyMS;				// Moving average of queued-to-decoded time
 	
 	static LLDeadmanTimer sQuiescentTimer;		// Time-to-complete-mesh-downloads after significant events
 
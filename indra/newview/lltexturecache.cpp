@@ -54,6 +54,7 @@ const F32 TEXTURE_CACHE_LRU_SIZE = .10f; // % amount for LRU list (low overhead
 const S32 TEXTURE_FAST_CACHE_ENTRY_OVERHEAD = sizeof(S32) * 4; //w, h, c, level
 const S32 TEXTURE_FAST_CACHE_DATA_SIZE = 16 * 16 * 4;
 const S32 TEXTURE_FAST_CACHE_ENTRY_SIZE = TEXTURE_FAST_CACHE_DATA_SIZE + TEXTURE_FAST_CACHE_ENTRY_OVERHEAD;
+const S32 TEXTURE_FAST_CACHE_GROW_ENTRIES = 4096; // the mapping grows by ~4MB at a time
 const F32 TEXTURE_LAZY_PURGE_TIME_LIMIT = .004f; // 4ms. Would be better to autoadjust, but there is a major cache rework in progress.
 const F32 TEXTURE_PRUNING_MAX_TIME = 15.f;
 
@@ -798,10 +799,7 @@ LLTextureCache::LLTextureCache(bool threaded)
 	  mHeaderAPRFile(NULL),
 	  mReadOnly(TRUE), //do not allow to change the texture cache until setReadOnly() is called.
 	  mTexturesSizeTotal(0),
-	  mDoPurge(FALSE),
-	  mFastCachep(NULL),
-	  mFastCachePoolp(NULL),
-	  mFastCachePadBuffer(NULL)
+	  mDoPurge(FALSE)
 {
     mHeaderAPRFilePoolp = new LLVolatileAPRPool(); // is_local = true, because this pool is for headers, headers are under own mutex
 }
@@ -810,10 +808,8 @@ LLTextureCache::~LLTextureCache()
 {
 	clearDeleteList() ;
 	writeUpdatedEntries() ;
-	delete mFastCachep;
-	delete mFastCachePoolp;
+	closeFastCache();
 	delete mHeaderAPRFilePoolp;
-	ll_aligned_free_16(mFastCachePadBuffer);
 }
 
 //////////////////////////////////////////////////////////////////////////////
@@ -1036,7 +1032,7 @@ S64 LLTextureCache::initCache(ELLPath location, S64 max_size, BOOL texture_cache
 	purgeTextures(true); // calc mTexturesSize and make some room in the texture cache if we need it
 
 	llassert_always(getPending() == 0) ; //should not start accessing the texture cache before initialized.
-	openFastCache(true);
+	openFastCache();
 
 	return max_size; // unused cache space
 }
@@ -1133,21 +1129,19 @@ S32 LLTextureCache::openAndReadEntry(const LLUUID& id, Entry& entry, bool create
 			}
 			else if (!mFreeList.empty())
 			{
-				idx = *(mFreeList.begin());
-				mFreeList.erase(mFreeList.begin());
+				idx = mFreeList.popFront();
 			}
 			else
 			{
-				// Look for a still valid entry in the LRU
-				for (std::set<LLUUID>::iterator iter2 = mLRU.begin(); iter2 != mLRU.end();)
+				// Look for a still valid entry in the LRU, oldest first
+				while (!mLRU.empty())
 				{
-					std::set<LLUUID>::iterator curiter2 = iter2++;
-					LLUUID oldid = *curiter2;
 					// Erase entry from LRU regardless
-					mLRU.erase(curiter2);
+					S32 lru_idx = mLRU.popFront();
+					LLUUID oldid = mLRUIDs[lru_idx];
 					// Look up entry and use it if it is valid
 					id_map_t::iterator iter3 = mHeaderIDMap.find(oldid);
-					if (iter3 != mHeaderIDMap.end() && iter3->second >= 0)
+					if (iter3 != mHeaderIDMap.end() && iter3->second == lru_idx)
 					{
 						idx = iter3->second;
 						removeCachedTexture(oldid) ;//remove the existing cached texture to release the entry index.
@@ -1169,7 +1163,7 @@ S32 LLTextureCache::openAndReadEntry(const LLUUID& id, Entry& entry, bool create
 	else
 	{
 		// Remove this entry from the LRU if it exists
-		mLRU.erase(id);
+		mLRU.remove(idx);
 		// Read the entry
 		idx_entry_map_t::iterator iter = mUpdatedEntryMap.find(idx) ;
 		if(iter != mUpdatedEntryMap.end())
@@ -1327,6 +1321,8 @@ U32 LLTextureCache::openAndReadEntries(std::vector<Entry>& entries)
 
 	mHeaderIDMap.clear();
 	mTexturesSizeMap.clear();
+	mHeaderIDMap.reserve(num_entries);
+	mTexturesSizeMap.reserve(num_entries);
 	mFreeList.clear();
 	mTexturesSizeTotal = 0;
 
@@ -1366,7 +1362,7 @@ U32 LLTextureCache::openAndReadEntries(std::vector<Entry>& entries)
 		}
 		else
 		{
-			mFreeList.insert(idx);
+			mFreeList.pushBack(idx);
 		}
 	}
 	closeHeaderEntriesFile();
@@ -1451,6 +1447,7 @@ void LLTextureCache::readHeaderCache()
 	mHeaderMutex.lock();
 
 	mLRU.clear(); // always clear the LRU
+	mLRUIDs.clear();
 
 	readEntriesHeader();
 	
@@ -1472,7 +1469,8 @@ void LLTextureCache::readHeaderCache()
 		{
 			U32 empty_entries = 0;
 			typedef std::pair<U32, S32> lru_data_t;
-			std::set<lru_data_t> lru;
+			std::vector<lru_data_t> lru;
+			lru.reserve(num_entries);
 			std::set<U32> purge_list;
 			for (U32 i=0; i<num_entries; i++)
 			{
@@ -1484,7 +1482,7 @@ void LLTextureCache::readHeaderCache()
 				}
 				else
 				{
-					lru.insert(std::make_pair(entry.mTime, i));
+					lru.push_back(std::make_pair(entry.mTime, (S32)i));
 					if (entry.mBodySize > 0)
 					{
 						if (entry.mBodySize > entry.mImageSize)
@@ -1496,6 +1494,8 @@ void LLTextureCache::readHeaderCache()
 					}
 				}
 			}
+			// Oldest first
+			std::sort(lru.begin(), lru.end());
 			if (num_entries - empty_entries > sCacheMaxEntries)
 			{
 				// Special case: cache size was reduced, need to remove entries
@@ -1504,7 +1504,7 @@ void LLTextureCache::readHeaderCache()
 				// We can exit the following loop with the given condition, since if we'd reach the end of the lru set we'd have:
 				// purge_list.size() = lru.size() = num_entries - empty_entries = entries_to_purge + sCacheMaxEntries >= entries_to_purge
 				// So, it's certain that iter will never reach lru.end() first.
-				std::set<lru_data_t>::iterator iter = lru.begin();
+				std::vector<lru_data_t>::iterator iter = lru.begin();
 				while (purge_list.size() < entries_to_purge)
 				{
 					purge_list.insert(iter->second);
@@ -1514,9 +1514,11 @@ void LLTextureCache::readHeaderCache()
 
 			{
 				S32 lru_entries = (S32)((F32)sCacheMaxEntries * TEXTURE_CACHE_LRU_SIZE);
-				for (std::set<lru_data_t>::iterator iter = lru.begin(); iter != lru.end(); ++iter)
+				mLRUIDs.resize(num_entries);
+				for (std::vector<lru_data_t>::iterator iter = lru.begin(); iter != lru.end(); ++iter)
 				{
-					mLRU.insert(entries[iter->second].mID);
+					mLRU.pushBack(iter->second);
+					mLRUIDs[iter->second] = entries[iter->second].mID;
 // 					LL_INFOS() << "LRU: " << iter->first << " : " << iter->second << LL_ENDL;
 					if (--lru_entries <= 0)
 						break;
@@ -1599,11 +1601,22 @@ void LLTextureCache::purgeAllTextures(bool purge_directories)
             PeekMessage(&msg, 0, 0, 0, PM_NOREMOVE | PM_NOYIELD);
 #endif
 		}
+		// The fast cache can't be deleted while it is mapped on Windows
+		bool fast_cache_open;
+		{
+			LLMutexLock lock(&mFastCacheMutex);
+			fast_cache_open = mFastCacheFile.isOpen();
+		}
+		closeFastCache();
 		gDirUtilp->deleteFilesInDir(mTexturesDirName, mask); // headers, fast cache
 		if (purge_directories)
 		{
 			LLFile::rmdir(mTexturesDirName);
 		}
+		else if (fast_cache_open)
+		{
+			openFastCache();
+		}
 	}
 	mHeaderIDMap.clear();
 	mTexturesSizeMap.clear();
@@ -1989,7 +2002,7 @@ LLTextureCache::handle_t LLTextureCache::writeToCache(const LLUUID& id,
 //called in the main thread
 LLPointer<LLImageRaw> LLTextureCache::readFromFastCache(const LLUUID& id, S32& discardlevel)
 {
-	U32 offset;
+	S32 idx;
 	{
 		LLMutexLock lock(&mHeaderMutex);
 		id_map_t::const_iterator iter = mHeaderIDMap.find(id);
@@ -1998,47 +2011,37 @@ LLPointer<LLImageRaw> LLTextureCache::readFromFastCache(const LLUUID& id, S32& d
 			return NULL; //not in the cache
 		}
 
-		offset = iter->second;
+		idx = iter->second;
 	}
-	offset *= TEXTURE_FAST_CACHE_ENTRY_SIZE;
 
-	U8* data;
-	S32 head[4];
+	LLPointer<LLImageRaw> raw;
 	{
 		LLMutexLock lock(&mFastCacheMutex);
 
-		openFastCache();
-
-		mFastCachep->seek(APR_SET, offset);		
-	
-		if(mFastCachep->read(head, TEXTURE_FAST_CACHE_ENTRY_OVERHEAD) != TEXTURE_FAST_CACHE_ENTRY_OVERHEAD)
+		const U8* src = getFastCacheEntry(idx, false);
+		if (!src)
 		{
-			//cache corrupted or under thread race condition
-			closeFastCache(); 
-			return NULL;
+			return NULL; //never written
 		}
-		
-		S32 image_size = head[0] * head[1] * head[2];
-        if(image_size <= 0
-           || image_size > TEXTURE_FAST_CACHE_DATA_SIZE
-           || head[3] < 0) //invalid
+
+		S32 head[4];
+		memcpy(head, src, TEXTURE_FAST_CACHE_ENTRY_OVERHEAD);
+		if (head[0] <= 0 || head[1] <= 0 || head[2] <= 0 || head[2] > 4
+			|| head[0] * head[1] * head[2] > TEXTURE_FAST_CACHE_DATA_SIZE
+			|| head[3] < 0) //invalid
 		{
-			closeFastCache();
 			return NULL;
 		}
-		discardlevel = head[3];
-		
-		data = (U8*)ll_aligned_malloc_16(image_size);
-		if(mFastCachep->read(data, image_size) != image_size)
+
+		// Straight from the mapping into the image buffer
+		raw = new LLImageRaw(head[0], head[1], head[2]);
+		if (raw->isBufferInvalid())
 		{
-			ll_aligned_free_16(data);
-			closeFastCache();
 			return NULL;
 		}
-
-		closeFastCache();
+		memcpy(raw->getData(), src + TEXTURE_FAST_CACHE_ENTRY_OVERHEAD, head[0] * head[1] * head[2]);
+		discardlevel = head[3];
 	}
-	LLPointer<LLImageRaw> raw = new LLImageRaw(data, head[0], head[1], head[2], true);
 
 	return raw;
 }
@@ -2088,85 +2091,75 @@ bool LLTextureCache::writeToFastCache(LLUUID image_id, S32 id, LLPointer<LLImage
 		}
 	}
 	
-	//copy data
-	memcpy(mFastCachePadBuffer, &w, sizeof(S32));
-	memcpy(mFastCachePadBuffer + sizeof(S32), &h, sizeof(S32));
-	memcpy(mFastCachePadBuffer + sizeof(S32) * 2, &c, sizeof(S32));
-	memcpy(mFastCachePadBuffer + sizeof(S32) * 3, &discardlevel, sizeof(S32));
-
-	S32 copy_size = w * h * c;
-	if(copy_size > 0) //valid
-	{
-		copy_size = llmin(copy_size, TEXTURE_FAST_CACHE_ENTRY_SIZE - TEXTURE_FAST_CACHE_ENTRY_OVERHEAD);
-		memcpy(mFastCachePadBuffer + TEXTURE_FAST_CACHE_ENTRY_OVERHEAD, raw->getData(), copy_size);
-	}
-	S32 offset = id * TEXTURE_FAST_CACHE_ENTRY_SIZE;
+	S32 head[4] = { w, h, c, discardlevel };
+	S32 copy_size = llclamp(w * h * c, 0, TEXTURE_FAST_CACHE_DATA_SIZE);
 
 	{
 		LLMutexLock lock(&mFastCacheMutex);
 
-		openFastCache();
-
-		mFastCachep->seek(APR_SET, offset);	
-		
-		//no need to do this assertion check. When it fails, let it fail quietly.
+		//no need to assert on failure, let it fail quietly.
 		//this failure could happen because other viewer removes the fast cache file when clearing cache.
-		//--> llassert_always(mFastCachep->write(mFastCachePadBuffer, TEXTURE_FAST_CACHE_ENTRY_SIZE) == TEXTURE_FAST_CACHE_ENTRY_SIZE);
-		mFastCachep->write(mFastCachePadBuffer, TEXTURE_FAST_CACHE_ENTRY_SIZE);
-
-		closeFastCache(true);
+		U8* dst = getFastCacheEntry(id, true);
+		if (dst)
+		{
+			// Header last, so that an entry interrupted by a crash reads as the old image or as invalid
+			memset(dst, 0, TEXTURE_FAST_CACHE_ENTRY_OVERHEAD);
+			memcpy(dst + TEXTURE_FAST_CACHE_ENTRY_OVERHEAD, raw->getData(), copy_size);
+			memcpy(dst, head, TEXTURE_FAST_CACHE_ENTRY_OVERHEAD);
+		}
 	}
 
 	return true;
 }
 
-void LLTextureCache::openFastCache(bool first_time)
+void LLTextureCache::openFastCache()
 {
-	if(!mFastCachep)
+	LLMutexLock lock(&mFastCacheMutex);
+
+	mFastCacheFile.close();
+	if (mReadOnly)
 	{
-		if(first_time)
+		// Use whatever the writing viewer left, if anything
+		if (LLFile::isfile(mFastCacheFileName))
 		{
-			if(!mFastCachePadBuffer)
-			{
-				mFastCachePadBuffer = (U8*)ll_aligned_malloc_16(TEXTURE_FAST_CACHE_ENTRY_SIZE);
-			}
-			mFastCachePoolp = new LLVolatileAPRPool(); // is_local= true by default, so not thread safe by default
-			if (LLAPRFile::isExist(mFastCacheFileName, mFastCachePoolp))
-			{
-				mFastCachep = new LLAPRFile(mFastCacheFileName, APR_READ|APR_WRITE|APR_BINARY, mFastCachePoolp) ;				
-			}
-			else
-			{
-				mFastCachep = new LLAPRFile(mFastCacheFileName, APR_CREATE|APR_READ|APR_WRITE|APR_BINARY, mFastCachePoolp) ;
-			}
-		}
-		else
-		{
-			mFastCachep = new LLAPRFile(mFastCacheFileName, APR_READ|APR_WRITE|APR_BINARY, mFastCachePoolp) ;
+			mFastCacheFile.open(mFastCacheFileName, 0, true);
 		}
-
-		mFastCacheTimer.reset();
 	}
-	return;
+	else if (!mFastCacheFile.open(mFastCacheFileName, (size_t)TEXTURE_FAST_CACHE_GROW_ENTRIES * TEXTURE_FAST_CACHE_ENTRY_SIZE))
+	{
+		LL_WARNS("TextureCache") << "Unable to map the fast cache " << mFastCacheFileName << LL_ENDL;
+	}
 }
 	
-void LLTextureCache::closeFastCache(bool forced)
+void LLTextureCache::closeFastCache()
 {	
-	static const F32 timeout = 10.f ; //seconds
+	LLMutexLock lock(&mFastCacheMutex);
+	mFastCacheFile.close();
+}
 
-	if(!mFastCachep)
+// mFastCacheMutex must be locked. Returns NULL if the entry is out of the
+// mapping and can't be or shouldn't be mapped.
+U8* LLTextureCache::getFastCacheEntry(S32 idx, bool grow)
+{
+	if (idx < 0 || idx >= (S32)sCacheMaxEntries || !mFastCacheFile.isOpen())
 	{
-		return ;
+		return NULL;
 	}
 
-	if(!forced && mFastCacheTimer.getElapsedTimeF32() < timeout)
+	size_t entry_end = (size_t)(idx + 1) * TEXTURE_FAST_CACHE_ENTRY_SIZE;
+	if (entry_end > mFastCacheFile.getSize())
 	{
-		return ;
+		if (!grow || mFastCacheFile.isReadOnly())
+		{
+			return NULL;
+		}
+		size_t num_entries = llmin((size_t)sCacheMaxEntries, (size_t)(idx / TEXTURE_FAST_CACHE_GROW_ENTRIES + 1) * TEXTURE_FAST_CACHE_GROW_ENTRIES);
+		if (!mFastCacheFile.resize(num_entries * TEXTURE_FAST_CACHE_ENTRY_SIZE))
+		{
+			return NULL;
+		}
 	}
-
-	delete mFastCachep;
-	mFastCachep = NULL;
-	return;
+	return mFastCacheFile.getData() + (size_t)idx * TEXTURE_FAST_CACHE_ENTRY_SIZE;
 }
 	
 bool LLTextureCache::writeComplete(handle_t handle, bool abort)
@@ -2246,7 +2239,7 @@ void LLTextureCache::removeEntry(S32 idx, Entry& entry, std::string& filename)
 		entry.mBodySize = 0;
 		mHeaderIDMap.erase(entry.mID);
 		mTexturesSizeMap.erase(entry.mID);		
-		mFreeList.insert(idx);	
+		mFreeList.pushBack(idx);	
 	}
 
 	if (file_maybe_exists)
@@ -28,9 +28,12 @@
 #define LL_LLTEXTURECACHE_H
 
 #include "lldir.h"
+#include "llindexlist.h"
+#include "llmappedfile.h"
 #include "llstl.h"
 #include "llstring.h"
 #include "lluuid.h"
+#include "lluuidhashmap.h"
 
 #include "llworkerthread.h"
 
@@ -186,8 +189,9 @@ private:
 	void lockHeaders() { mHeaderMutex.lock(); }
 	void unlockHeaders() { mHeaderMutex.unlock(); }
 	
-	void openFastCache(bool first_time = false);
-	void closeFastCache(bool forced = false);
+	void openFastCache();
+	void closeFastCache();
+	U8* getFastCacheEntry(S32 idx, bool grow); // mFastCacheMutex must be locked
 	bool writeToFastCache(LLUUID image_id, S32 cache_id, LLPointer<LLImageRaw> raw, S32 discardlevel);	
 
 private:
@@ -197,7 +201,6 @@ private:
 	LLMutex mListMutex;
 	LLMutex mFastCacheMutex;
 	LLAPRFile* mHeaderAPRFile;
-	LLVolatileAPRPool* mFastCachePoolp;
 
 	// mLocalAPRFilePoolp is not thread safe and is meant only for workers
 	// howhever mHeaderEntriesFileName is accessed not from workers' threads
@@ -221,18 +224,19 @@ private:
 	std::string mHeaderDataFileName;
 	std::string mFastCacheFileName;
 	EntriesInfo mHeaderEntriesInfo;
-	std::set<S32> mFreeList; // deleted entries
-	std::set<LLUUID> mLRU;
-	typedef std::map<LLUUID, S32> id_map_t;
+	LLIndexList mFreeList; // deleted entries
+	LLIndexList mLRU; // oldest entries at startup, reused first when the cache is full
+	std::vector<LLUUID> mLRUIDs; // id of each entry in mLRU, by entry index
+	typedef LLUUIDHashMap<S32> id_map_t;
 	id_map_t mHeaderIDMap;
 
-	LLAPRFile*   mFastCachep;
-	LLFrameTimer mFastCacheTimer;
-	U8*          mFastCachePadBuffer;
+	// Fixed size records indexed like the header entries, mapped so that
+	// reads and writes are a memcpy under mFastCacheMutex.
+	LLMappedFile mFastCacheFile;
 
 	// BODIES (TEXTURES minus headers)
 	std::string mTexturesDirName;
-	typedef std::map<LLUUID,S32> size_map_t;
+	typedef LLUUIDHashMap<S32> size_map_t;
 	size_map_t mTexturesSizeMap;
 	S64 mTexturesSizeTotal;
 	LLAtomicBool mDoPurge;
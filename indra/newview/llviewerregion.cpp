@@ -640,6 +640,7 @@ LLViewerRegion::LLViewerRegion(const U64 &handle,
 	mProductName("unknown"),
 	mViewerAssetUrl(""),
 	mCacheLoaded(FALSE),
+	mCacheLoading(false),
 	mCacheDirty(FALSE),
 	mReleaseNotesRequested(FALSE),
 	mCapabilitiesState(CAPABILITIES_STATE_INIT),
@@ -794,20 +795,42 @@ void LLViewerRegion::loadObjectCache()
 	if(LLVOCache::instanceExists())
 	{
         LLVOCache & vocache = LLVOCache::instance();
-		vocache.readFromCache(mHandle, mImpl->mCacheID, mImpl->mCacheMap);
         vocache.readGenericExtrasFromCache(mHandle, mImpl->mCacheID, mImpl->mGLTFOverridesLLSD);
 
-		if (mImpl->mCacheMap.empty())
-		{
-			mCacheDirty = TRUE;
-		}
+		// The region file is read on the object cache thread. The region may
+		// be gone by the time it is done, so look it up again.
+		mCacheLoading = true;
+		U64 handle = mHandle;
+		LLUUID cache_id = mImpl->mCacheID;
+		vocache.readFromCacheAsync(mHandle, mImpl->mCacheID,
+			[handle, cache_id](LLVOCacheEntry::vocache_entry_map_t& cache_entry_map)
+			{
+				LLViewerRegion* regionp = LLWorld::getInstance()->getRegionFromHandle(handle);
+				if (regionp && regionp->mCacheLoading && regionp->mImpl->mCacheID == cache_id)
+				{
+					regionp->onObjectCacheLoaded(cache_entry_map);
+				}
+			});
 	}
 }
 
+void LLViewerRegion::onObjectCacheLoaded(LLVOCacheEntry::vocache_entry_map_t& cache_entry_map)
+{
+	mCacheLoading = false;
+	mImpl->mCacheMap.insert(cache_entry_map.begin(), cache_entry_map.end());
+	if (mImpl->mCacheMap.empty())
+	{
+		mCacheDirty = TRUE;
+	}
+
+	// The simulator waits for the handshake reply before sending objects
+	sendRegionHandshakeReply(getHost());
+}
+
 
 void LLViewerRegion::saveObjectCache()
 {
-	if (!mCacheLoaded)
+	if (!mCacheLoaded || mCacheLoading)
 	{
 		return;
 	}
@@ -3042,12 +3065,22 @@ void LLViewerRegion::unpackRegionHandshake()
 
 	// Now that we have the name, we can load the cache file
 	// off disk.
+	bool reply_now = mCacheLoaded || !LLVOCache::instanceExists();
 	loadObjectCache();
 
 	// After loading cache, signal that simulator can start
-	// sending data.
+	// sending data. When the cache is being loaded, that
+	// happens in onObjectCacheLoaded().
+	if (reply_now && !mCacheLoading)
+	{
+		sendRegionHandshakeReply(msg->getSender());
+	}
+}
+
+void LLViewerRegion::sendRegionHandshakeReply(const LLHost& host)
+{
 	// TODO: Send all upstream viewer->sim handshake info here.
-	LLHost host = msg->getSender();
+	LLMessageSystem* msg = gMessageSystem;
 	msg->newMessage("RegionHandshakeReply");
 	msg->nextBlock("AgentData");
 	msg->addUUID("AgentID", gAgent.getID());
@@ -3672,6 +3705,11 @@ void LLViewerRegion::applyCacheMiscExtras(LLViewerObject* obj)
     auto iter = mImpl->mGLTFOverridesLLSD.find(local_id);
     if (iter != mImpl->mGLTFOverridesLLSD.end())
     {
+        if (!iter->second.decode())
+        {
+            mImpl->mGLTFOverridesLLSD.erase(iter);
+            return;
+        }
         llassert(iter->second.mGLTFMaterial.size() == iter->second.mSides.size());
 
         for (auto& side : iter->second.mGLTFMaterial)
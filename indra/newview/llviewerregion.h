@@ -433,6 +433,8 @@ private:
 	void addCacheMiss(U32 id, LLViewerRegion::eCacheMissType miss_type);
 	void decodeBoundingInfo(LLVOCacheEntry* entry);
 	bool isNonCacheableObjectCreated(U32 local_id);	
+	void onObjectCacheLoaded(std::map<U32, LLPointer<LLVOCacheEntry> >& cache_entry_map);
+	void sendRegionHandshakeReply(const LLHost& host);
 
 public:
     void applyCacheMiscExtras(LLViewerObject* obj);
@@ -558,6 +560,7 @@ public:
 	// Regions can have order 10,000 objects, so assume
 	// a structure of size 2^14 = 16,000
 	BOOL									mCacheLoaded;
+	bool                                    mCacheLoading; // waiting for the object cache thread
 	BOOL                                    mCacheDirty;
 	BOOL	mAlive;					// can become false if circuit disconnects
 	BOOL	mSimulatorFeaturesReceived;
@@ -363,8 +363,9 @@ public:
 	S32 getOriginalWidth() { return mOrigWidth; }
 	S32 getOriginalHeight() { return mOrigHeight; }
 
-	BOOL isInImageList() const {return mInImageList ;}
-	void setInImageList(BOOL flag) {mInImageList = flag ;}
+	BOOL isInImageList() const {return mImageListIndex >= 0 ;}
+	S32 getImageListIndex() const {return mImageListIndex ;}
+	void setImageListIndex(S32 index) {mImageListIndex = index ;}
 
 	LLFrameTimer* getLastPacketTimer() {return &mLastPacketTimer;}
 
@@ -511,7 +512,7 @@ protected:
 	LLFrameTimer mLastPacketTimer;		// Time since last packet.
 	LLFrameTimer mStopFetchingTimer;	// Time since mDecodePriority == 0.f.
 
-	BOOL  mInImageList;				// TRUE if image is in list (in which case don't reset priority!)
+	S32   mImageListIndex;			// position in the texture list's mImageList, -1 if not in it (if in, don't reset priority!)
 	// This needs to be atomic, since it is written both in the main thread
 	// and in the GL image worker thread... HB
 	LLAtomicBool  mNeedsCreateTexture;	
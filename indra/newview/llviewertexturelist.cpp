@@ -92,6 +92,7 @@ LLTextureKey::LLTextureKey(LLUUID id, ETexListType tex_type)
 
 LLViewerTextureList::LLViewerTextureList() 
 	: mForceResetTextureStats(FALSE),
+	mNextUpdateHandle(0),
 	mInitialized(FALSE)
 {
 }
@@ -357,7 +358,13 @@ void LLViewerTextureList::shutdown()
 	mFastCacheList.clear();
 	
 	mUUIDMap.clear();
+	mTextures.clear();
+	mNextUpdateHandle = 0;
 	
+	for (LLViewerFetchedTexture* image : mImageList)
+	{
+		image->setImageListIndex(-1);
+	}
 	mImageList.clear();
 
 	mInitialized = FALSE ; //prevent loading textures again.
@@ -643,22 +650,32 @@ LLViewerFetchedTexture* LLViewerTextureList::createImage(const LLUUID &image_id,
 void LLViewerTextureList::findTexturesByID(const LLUUID &image_id, std::vector<LLViewerFetchedTexture*> &output)
 {
     LL_PROFILE_ZONE_SCOPED_CATEGORY_TEXTURE;
-    LLTextureKey search_key(image_id, TEX_LIST_STANDARD);
-    uuid_map_t::iterator iter = mUUIDMap.lower_bound(search_key);
-    while (iter != mUUIDMap.end() && iter->first.textureId == image_id)
+    uuid_map_t::const_iterator iter = mUUIDMap.find(image_id);
+    if (iter != mUUIDMap.end())
     {
-        output.push_back(iter->second);
-        iter++;
+        for (S32 handle : iter->second.mHandle)
+        {
+            if (handle >= 0)
+            {
+                output.push_back(mTextures[handle]);
+            }
+        }
     }
 }
 
+S32 LLViewerTextureList::findHandle(const LLTextureKey& search_key) const
+{
+    uuid_map_t::const_iterator iter = mUUIDMap.find(search_key.textureId);
+    return iter != mUUIDMap.end() ? iter->second.mHandle[search_key.textureType] : -1;
+}
+
 LLViewerFetchedTexture *LLViewerTextureList::findImage(const LLTextureKey &search_key)
 {
     LL_PROFILE_ZONE_SCOPED_CATEGORY_TEXTURE;
-    uuid_map_t::iterator iter = mUUIDMap.find(search_key);
-    if (iter == mUUIDMap.end())
+    S32 handle = findHandle(search_key);
+    if (handle < 0)
         return NULL;
-    return iter->second;
+    return mTextures[handle];
 }
 
 LLViewerFetchedTexture *LLViewerTextureList::findImage(const LLUUID &image_id, ETexListType tex_type)
@@ -678,12 +695,9 @@ void LLViewerTextureList::addImageToList(LLViewerFetchedTexture *image)
 	}
 	else
 	{
-	if((mImageList.insert(image)).second != true) 
-	{
-			LL_WARNS() << "Error happens when insert image " << image->getID()  << " into mImageList!" << LL_ENDL ;
+		image->setImageListIndex((S32)mImageList.size());
+		mImageList.push_back(image);
 	}
-	image->setInImageList(TRUE) ;
-}
 }
 
 void LLViewerTextureList::removeImageFromList(LLViewerFetchedTexture *image)
@@ -693,47 +707,46 @@ void LLViewerTextureList::removeImageFromList(LLViewerFetchedTexture *image)
 	llassert_always(mInitialized) ;
 	llassert(image);
 
-	S32 count = 0;
 	if (image->isInImageList())
 	{
-		count = mImageList.erase(image) ;
-		if(count != 1) 
-	    {
-			LL_INFOS() << "Image  " << image->getID() 
-				<< " had mInImageList set but mImageList.erase() returned " << count
+		S32 index = image->getImageListIndex();
+		if (index >= (S32)mImageList.size() || mImageList[index] != image)
+		{
+			LL_WARNS() << "Image  " << image->getID()
+				<< " is not at its index " << index << " in mImageList"
 				<< LL_ENDL;
+			llassert(false);
+		}
+		else
+		{
+			// Move the last image into the hole
+			mImageList[index] = mImageList.back();
+			mImageList[index]->setImageListIndex(index);
+			mImageList.pop_back();
 		}
 	}
 	else
 	{	// Something is wrong, image is expected in list or callers should check first
 		LL_INFOS() << "Calling removeImageFromList() for " << image->getID() 
-			<< " but doesn't have mInImageList set"
+			<< " but it isn't in mImageList"
 			<< " ref count is " << image->getNumRefs()
 			<< LL_ENDL;
-		uuid_map_t::iterator iter = mUUIDMap.find(LLTextureKey(image->getID(), (ETexListType)image->getTextureListType()));
-		if(iter == mUUIDMap.end())
+		LLViewerFetchedTexture* found = findImage(LLTextureKey(image->getID(), (ETexListType)image->getTextureListType()));
+		if (!found)
 		{
 			LL_INFOS() << "Image  " << image->getID() << " is also not in mUUIDMap!" << LL_ENDL ;
 		}
-		else if (iter->second != image)
+		else if (found != image)
 		{
 			LL_INFOS() << "Image  " << image->getID() << " was in mUUIDMap but with different pointer" << LL_ENDL ;
-	}
+		}
 		else
-	{
+		{
 			LL_INFOS() << "Image  " << image->getID() << " was in mUUIDMap with same pointer" << LL_ENDL ;
 		}
-		count = mImageList.erase(image) ;
-        llassert(count != 0);
-		if(count != 0) 
-		{	// it was in the list already?
-			LL_WARNS() << "Image  " << image->getID() 
-				<< " had mInImageList false but mImageList.erase() returned " << count
-				<< LL_ENDL;
-		}
 	}
       
-	image->setInImageList(FALSE) ;
+	image->setImageListIndex(-1);
 }
 
 void LLViewerTextureList::addImage(LLViewerFetchedTexture *new_image, ETexListType tex_type)
@@ -755,7 +768,16 @@ void LLViewerTextureList::addImage(LLViewerFetchedTexture *new_image, ETexListTy
 	sNumImages++;
 
 	addImageToList(new_image);
-	mUUIDMap[key] = new_image;
+	S32& handle = mUUIDMap[image_id].mHandle[tex_type];
+	if (handle >= 0)
+	{
+		mTextures[handle] = new_image;
+	}
+	else
+	{
+		handle = (S32)mTextures.size();
+		mTextures.push_back(new_image);
+	}
 	new_image->setTextureListType(tex_type);
 }
 
@@ -770,7 +792,23 @@ void LLViewerTextureList::deleteImage(LLViewerFetchedTexture *image)
 			mCallbackList.erase(image);
 		}
 		LLTextureKey key(image->getID(), (ETexListType)image->getTextureListType());
-		llverify(mUUIDMap.erase(key) == 1);
+		S32 handle = findHandle(key);
+		llassert(handle >= 0);
+		if (handle >= 0)
+		{
+			// Move the last texture into the hole
+			LLViewerFetchedTexture* last = mTextures.back();
+			mUUIDMap[last->getID()].mHandle[last->getTextureListType()] = handle;
+			mTextures[handle] = last;
+			mTextures.pop_back();
+
+			TextureHandles& handles = mUUIDMap[key.textureId];
+			handles.mHandle[key.textureType] = -1;
+			if (handles.mHandle[TEX_LIST_STANDARD] < 0 && handles.mHandle[TEX_LIST_SCALE] < 0)
+			{
+				mUUIDMap.erase(key.textureId);
+			}
+		}
 		sNumImages--;
 		removeImageFromList(image);
 	}
@@ -883,77 +921,126 @@ static void touch_texture(LLViewerFetchedTexture* tex, F32 vsize)
 
 extern BOOL gCubeSnapshot;
 
-void LLViewerTextureList::updateImageDecodePriority(LLViewerFetchedTexture* imagep)
+void LLViewerTextureList::TextureStatsBatch::clear()
 {
-    if (imagep->isInDebug() || imagep->isUnremovable())
-    {
-        //update_counter--;
-        return; //is in debug, ignore.
-    }
+    mTextures.clear();
+    mTexture.clear();
+    mPixelArea.clear();
+    mScale.clear();
+    mDistance.clear();
+    mOnScreen.clear();
+    mMaterial.clear();
+    mVirtualSize.clear();
+}
 
+void LLViewerTextureList::gatherTextureStats(LLViewerFetchedTexture* imagep, TextureStatsBatch& batch)
+{
     llassert(!gCubeSnapshot);
 
-    static LLCachedControl<F32> bias_distance_scale(gSavedSettings, "TextureBiasDistanceScale", 1.f);
+    U32 index = (U32)batch.mTextures.size();
+    batch.mTextures.push_back(imagep);
 
-    LL_PROFILE_ZONE_SCOPED_CATEGORY_TEXTURE
+    for (U32 i = 0; i < LLRender::NUM_TEXTURE_CHANNELS; ++i)
     {
-        for (U32 i = 0; i < LLRender::NUM_TEXTURE_CHANNELS; ++i)
+        for (U32 fi = 0; fi < imagep->getNumFaces(i); ++fi)
         {
-            for (U32 fi = 0; fi < imagep->getNumFaces(i); ++fi)
-            {
-                LLFace* face = (*(imagep->getFaceList(i)))[fi];
+            LLFace* face = (*(imagep->getFaceList(i)))[fi];
 
-                if (face && face->getViewerObject() && face->getTextureEntry())
-                {
-                    F32 vsize = face->getPixelArea();
-
-                    // scale desired texture resolution higher or lower depending on texture scale
-                    const LLTextureEntry* te = face->getTextureEntry();
-                    F32 min_scale = te ? llmin(fabsf(te->getScaleS()), fabsf(te->getScaleT())) : 1.f;
-                    min_scale = llmax(min_scale*min_scale, 0.1f);
+            if (face && face->getViewerObject() && face->getTextureEntry())
+            {
+                const LLTextureEntry* te = face->getTextureEntry();
+                LLDrawable* drawable = face->getDrawable();
+
+                // the area of the last pass; calcPixelArea() updates it for the next
+                batch.mPixelArea.push_back(face->getPixelArea());
+                bool on_screen = true;
+#if !LL_DARWIN
+                F32 radius;
+                F32 cos_angle_to_view_dir;
+                BOOL in_frustum = face->calcPixelArea(cos_angle_to_view_dir, radius);
+                on_screen = in_frustum && drawable->isVisible();
+#endif
+                batch.mTexture.push_back(index);
+                batch.mScale.push_back(llmin(fabsf(te->getScaleS()), fabsf(te->getScaleT())));
+                batch.mDistance.push_back(drawable->mDistanceWRTCamera);
+                batch.mOnScreen.push_back(on_screen);
+
+                // if a GLTF material is present, ignore that face
+                // as far as this texture stats go, but update the GLTF material 
+                // stats
+                LLFetchedGLTFMaterial* mat = (LLFetchedGLTFMaterial*)te->getGLTFRenderMaterial();
+                llassert(mat == nullptr || dynamic_cast<LLFetchedGLTFMaterial*>(te->getGLTFRenderMaterial()) != nullptr);
+                batch.mMaterial.push_back(mat);
+            }
+        }
+    }
+}
 
-                    vsize /= min_scale;
+//static
+void LLViewerTextureList::calcVirtualSizes(TextureStatsBatch& batch, F32 bias, F32 bias_distance_scale)
+{
+    LL_PROFILE_ZONE_SCOPED_CATEGORY_TEXTURE;
+    const size_t count = batch.mPixelArea.size();
+    batch.mVirtualSize.resize(count);
+
+    // no branches in the loop but the select, so it vectorizes
+    const F32* area = batch.mPixelArea.data();
+    const F32* scale = batch.mScale.data();
+    const F32* distance = batch.mDistance.data();
+    const U8* on_screen = batch.mOnScreen.data();
+    F32* vsize = batch.mVirtualSize.data();
+    for (size_t i = 0; i < count; ++i)
+    {
+        // scale desired texture resolution higher or lower depending on texture scale
+        F32 min_scale = llmax(scale[i] * scale[i], 0.1f);
+        F32 size = area[i] / min_scale;
 
 #if LL_DARWIN
-                    vsize /= 1.f + LLViewerTexture::sDesiredDiscardBias*(1.f+face->getDrawable()->mDistanceWRTCamera*bias_distance_scale);
+        size /= 1.f + bias * (1.f + distance[i] * bias_distance_scale);
 #else
-                    vsize /= LLViewerTexture::sDesiredDiscardBias;
-                    vsize /= llmax(1.f, (LLViewerTexture::sDesiredDiscardBias-1.f) * (1.f + face->getDrawable()->mDistanceWRTCamera * bias_distance_scale));
-
-                    F32 radius;
-                    F32 cos_angle_to_view_dir;
-                    BOOL in_frustum = face->calcPixelArea(cos_angle_to_view_dir, radius);
-                    if (!in_frustum || !face->getDrawable()->isVisible())
-                    { // further reduce by discard bias when off screen or occluded
-                        vsize /= LLViewerTexture::sDesiredDiscardBias;
-                    }
+        size /= bias;
+        size /= llmax(1.f, (bias - 1.f) * (1.f + distance[i] * bias_distance_scale));
+        // further reduce by discard bias when off screen or occluded
+        size /= on_screen[i] ? 1.f : bias;
 #endif
-                    // if a GLTF material is present, ignore that face
-                    // as far as this texture stats go, but update the GLTF material 
-                    // stats
-                    LLFetchedGLTFMaterial* mat = te ? (LLFetchedGLTFMaterial*)te->getGLTFRenderMaterial() : nullptr;
-                    llassert(mat == nullptr || dynamic_cast<LLFetchedGLTFMaterial*>(te->getGLTFRenderMaterial()) != nullptr);
-                    if (mat)
-                    {
-                        touch_texture(mat->mBaseColorTexture, vsize);
-                        touch_texture(mat->mNormalTexture, vsize);
-                        touch_texture(mat->mMetallicRoughnessTexture, vsize);
-                        touch_texture(mat->mEmissiveTexture, vsize);
-                    }
-                    else
-                    {
-                        imagep->addTextureStats(vsize);
-                    }
-                }
-            }
+        vsize[i] = size;
+    }
+}
+
+//static
+void LLViewerTextureList::applyTextureStats(const TextureStatsBatch& batch)
+{
+    for (size_t i = 0; i < batch.mVirtualSize.size(); ++i)
+    {
+        F32 vsize = batch.mVirtualSize[i];
+        LLFetchedGLTFMaterial* mat = batch.mMaterial[i];
+        if (mat)
+        {
+            touch_texture(mat->mBaseColorTexture, vsize);
+            touch_texture(mat->mNormalTexture, vsize);
+            touch_texture(mat->mMetallicRoughnessTexture, vsize);
+            touch_texture(mat->mEmissiveTexture, vsize);
+        }
+        else
+        {
+            batch.mTextures[batch.mTexture[i]]->addTextureStats(vsize);
         }
     }
+}
+
+void LLViewerTextureList::updateImageDecodePriority(LLViewerFetchedTexture* imagep)
+{
+    if (imagep->isInDebug() || imagep->isUnremovable())
+    {
+        //update_counter--;
+        return; //is in debug, ignore.
+    }
 
     //imagep->setDebugText(llformat("%.3f - %d", sqrtf(imagep->getMaxVirtualSize()), imagep->getBoostLevel()));
 
     F32 lazy_flush_timeout = 30.f; // stop decoding
     F32 max_inactive_time = 20.f; // actually delete
-    S32 min_refs = 3; // 1 for mImageList, 1 for mUUIDMap, 1 for local reference
+    S32 min_refs = 3; // 1 for mImageList, 1 for mTextures, 1 for local reference
 
     //
     // Flush formatted images using a lazy flush
@@ -1112,61 +1199,82 @@ F32 LLViewerTextureList::updateImagesFetchTextures(F32 max_time)
     LL_PROFILE_ZONE_SCOPED_CATEGORY_TEXTURE;
     typedef std::vector<LLPointer<LLViewerFetchedTexture> > entries_list_t;
     entries_list_t entries;
+    std::vector<U32> entry_handles;
 
     // update N textures at beginning of mImageList
     U32 update_count = 0;
     static const S32 MIN_UPDATE_COUNT = gSavedSettings.getS32("TextureFetchUpdateMinCount");       // default: 32
     // WIP -- dumb code here
     //update MIN_UPDATE_COUNT or 5% of other textures, whichever is greater
-    update_count = llmax((U32) MIN_UPDATE_COUNT, (U32) mUUIDMap.size()/20);
-    update_count = llmin(update_count, (U32) mUUIDMap.size());
+    update_count = llmax((U32) MIN_UPDATE_COUNT, (U32) mTextures.size()/20);
+    update_count = llmin(update_count, (U32) mTextures.size());
     
     {
         LL_PROFILE_ZONE_NAMED_CATEGORY_TEXTURE("vtluift - copy");
 
-        // copy entries out of UUID map for updating
+        // copy entries out of the texture list for updating
         entries.reserve(update_count);
-        uuid_map_t::iterator iter = mUUIDMap.upper_bound(mLastUpdateKey);
+        entry_handles.reserve(update_count);
+        U32 handle = mNextUpdateHandle;
         while (update_count-- > 0)
         {
-            if (iter == mUUIDMap.end())
+            if (handle >= mTextures.size())
             {
-                iter = mUUIDMap.begin();
+                handle = 0;
             }
             
-            if (iter->second->getGLTexture())
+            if (mTextures[handle]->getGLTexture())
             {
-                entries.push_back(iter->second);
+                entries.push_back(mTextures[handle]);
+                entry_handles.push_back(handle);
             }
-            ++iter;
+            ++handle;
         }
     }
 
     LLTimer timer;
 
-    LLPointer<LLViewerTexture> last_imagep = nullptr;
+    // Textures whose faces are gathered and sized together; the time is
+    // checked after each batch
+    const size_t BATCH_SIZE = 32;
+    static LLCachedControl<F32> bias_distance_scale(gSavedSettings, "TextureBiasDistanceScale", 1.f);
 
-    for (auto& imagep : entries)
+    for (size_t start = 0; start < entries.size(); start += BATCH_SIZE)
     {
-        if (imagep->getNumRefs() > 1) // make sure this image hasn't been deleted before attempting to update (may happen as a side effect of some other image updating)
+        size_t end = llmin(start + BATCH_SIZE, entries.size());
 
+        mStatsBatch.clear();
+        for (size_t i = start; i < end; ++i)
         {
-            updateImageDecodePriority(imagep);
-            imagep->updateFetch();
+            LLViewerFetchedTexture* imagep = entries[i];
+            if (imagep->getNumRefs() > 1 && !imagep->isInDebug() && !imagep->isUnremovable())
+            {
+                gatherTextureStats(imagep, mStatsBatch);
+            }
         }
+        calcVirtualSizes(mStatsBatch, LLViewerTexture::sDesiredDiscardBias, bias_distance_scale);
+        applyTextureStats(mStatsBatch);
+
+        for (size_t i = start; i < end; ++i)
+        {
+            LLViewerFetchedTexture* imagep = entries[i];
+            if (imagep->getNumRefs() > 1) // make sure this image hasn't been deleted before attempting to update (may happen as a side effect of some other image updating)
+            {
+                updateImageDecodePriority(imagep);
+                imagep->updateFetch();
+            }
 
-        last_imagep = imagep;
+            // Textures deleted meanwhile have moved others around, so this
+            // only roughly picks up after the last one next time
+            mNextUpdateHandle = entry_handles[i] + 1;
+        }
 
         if (timer.getElapsedTimeF32() > max_time)
         {
             break;
         }
     }
-
-    if (last_imagep)
-    {
-        mLastUpdateKey = LLTextureKey(last_imagep->getID(), (ETexListType)last_imagep->getTextureListType());
-    }
+    mStatsBatch.clear();
 
 	return timer.getElapsedTimeF32();
 }
@@ -1201,7 +1309,7 @@ void LLViewerTextureList::decodeAllImages(F32 max_time)
 	{
 		LLViewerFetchedTexture* imagep = *iter++;
 		image_list.push_back(imagep);
-		imagep->setInImageList(FALSE) ;
+		imagep->setImageListIndex(-1);
 	}
 
 	llassert_always(image_list.size() == mImageList.size()) ;
@@ -32,8 +32,11 @@
 #include "llgl.h"
 #include "llviewertexture.h"
 #include "llui.h"
+#include "lluuidhashmap.h"
 #include <list>
 #include <set>
+#include <unordered_set>
+#include <vector>
 #include "lluiimage.h"
 
 const U32 LL_IMAGE_REZ_LOSSLESS_CUTOFF = 128;
@@ -47,6 +50,7 @@ const BOOL GL_TEXTURE_NO = FALSE;
 const BOOL IMMEDIATE_YES = TRUE;
 const BOOL IMMEDIATE_NO = FALSE;
 
+class LLFetchedGLTFMaterial;
 class LLImageJ2C;
 class LLMessageSystem;
 class LLTextureView;
@@ -134,7 +138,7 @@ public:
 
 	void handleIRCallback(void **data, const S32 number);
 
-	S32 getNumImages()					{ return mImageList.size(); }
+	S32 getNumImages()					{ return (S32)mImageList.size(); }
 
 	// Local UI images
     // Local UI images
@@ -146,7 +150,35 @@ public:
 	void setDebugFetching(LLViewerFetchedTexture* tex, S32 debug_level);
 
 private:
-    // do some book keeping on the specified texture
+    // The faces of a batch of textures, one array per input to the virtual
+    // size each face asks of its texture. The faces are visited once to
+    // fill the arrays, then the sizes are worked out in one pass over them.
+    struct TextureStatsBatch
+    {
+        void clear();
+
+        // Per texture
+        std::vector<LLViewerFetchedTexture*> mTextures;
+
+        // Per face
+        std::vector<U32> mTexture;                      // index in mTextures
+        std::vector<F32> mPixelArea;
+        std::vector<F32> mScale;                        // smaller of the texture entry's scales
+        std::vector<F32> mDistance;                     // of the face's drawable to the camera
+        std::vector<U8> mOnScreen;                      // in the frustum and not occluded
+        std::vector<LLFetchedGLTFMaterial*> mMaterial;  // takes the size instead of the texture
+        std::vector<F32> mVirtualSize;                  // calcVirtualSizes() output
+    };
+
+    // adds the faces of the specified texture to batch
+    void gatherTextureStats(LLViewerFetchedTexture* imagep, TextureStatsBatch& batch);
+    // touches nothing but batch, so may run anywhere
+    static void calcVirtualSizes(TextureStatsBatch& batch, F32 bias, F32 bias_distance_scale);
+    // passes the virtual sizes on to the textures
+    static void applyTextureStats(const TextureStatsBatch& batch);
+
+    // do some book keeping on the specified texture, once its faces' stats
+    // have been applied
     // - updates decode priority
     // - updates desired discard level
     // - cleans up textures that haven't been referenced in awhile
@@ -215,16 +247,33 @@ public:
 	image_list_t mFastCacheList;
 
 	// Note: just raw pointers because they are never referenced, just compared against
-	std::set<LLViewerFetchedTexture*> mDirtyTextureList;
+	std::unordered_set<LLViewerFetchedTexture*> mDirtyTextureList;
 	
 	BOOL mForceResetTextureStats;
     
 private:
-    typedef std::map< LLTextureKey, LLPointer<LLViewerFetchedTexture> > uuid_map_t;
+    // Where an id's texture of each ETexListType is in mTextures, -1 if none
+    struct TextureHandles
+    {
+        TextureHandles() { mHandle[TEX_LIST_STANDARD] = mHandle[TEX_LIST_SCALE] = -1; }
+        S32 mHandle[TEX_LIST_SCALE + 1];
+    };
+    typedef LLUUIDHashMap<TextureHandles> uuid_map_t;
+    typedef std::vector<LLPointer<LLViewerFetchedTexture> > texture_list_t;
+
+    // handle of search_key's texture in mTextures, -1 if none
+    S32 findHandle(const LLTextureKey& search_key) const;
+
+    // Every texture added, packed so updateImagesFetchTextures() walks them
+    // in order, found through the hashed ids of mUUIDMap
     uuid_map_t mUUIDMap;
-    LLTextureKey mLastUpdateKey;
+    texture_list_t mTextures;
+    U32 mNextUpdateHandle;
+    // Kept to reuse its arrays from frame to frame
+    TextureStatsBatch mStatsBatch;
 	
-    typedef std::set < LLPointer<LLViewerFetchedTexture> > image_priority_list_t;
+    // Packed too; each texture knows its own index in it
+    typedef texture_list_t image_priority_list_t;
 	image_priority_list_t mImageList;
 
 	// simply holds on to LLViewerFetchedTexture references to stop them from being purged too soon
@@ -723,6 +723,10 @@ public:
 				addText(xpos, ypos, llformat("%d/%d Mesh LOD Pending/Processing", LLMeshRepository::sLODPending, LLMeshRepository::sLODProcessing));
 				ypos += y_inc;
 
+				addText(xpos, ypos, llformat("%d/%d Mesh Decodes Queued/Active, %.1f ms Latency", LLMeshRepository::sDecodeQueued.CurrentValue(),
+					LLMeshRepository::sDecodeActive.CurrentValue(), LLMeshRepository::sDecodeLatencyMS));
+				ypos += y_inc;
+
 				addText(xpos, ypos, llformat("%.3f/%.3f MB Mesh Cache Read/Write ", LLMeshRepository::sCacheBytesRead/(1024.f*1024.f), LLMeshRepository::sCacheBytesWritten/(1024.f*1024.f)));
                 ypos += y_inc;
 
@@ -33,6 +33,7 @@
 #include "llviewerregion.h"
 #include "llagentcamera.h"
 #include "llsdserialize.h"
+#include "threadpool.h"
 
 //static variables
 U32 LLVOCacheEntry::sMinFrameRange = 0;
@@ -55,98 +56,6 @@ BOOL check_write(LLAPRFile* apr_file, void* src, S32 n_bytes)
 	return apr_file->write(src, n_bytes) == n_bytes ;
 }
 
-bool LLGLTFOverrideCacheEntry::fromLLSD(const LLSD& data)
-{
-    LL_PROFILE_ZONE_SCOPED_CATEGORY_NETWORK;
-    
-    llassert(data.has("local_id"));
-    llassert(data.has("object_id"));
-    llassert(data.has("region_handle_x") && data.has("region_handle_y"));
-
-    if (!data.has("local_id"))
-    {
-        return false;
-    }
-
-    if (data.has("region_handle_x") && data.has("region_handle_y"))
-    {
-        // TODO start requiring this once server sends this for all messages
-        U32 region_handle_y = data["region_handle_y"].asInteger();
-        U32 region_handle_x = data["region_handle_x"].asInteger();
-        mRegionHandle = to_region_handle(region_handle_x, region_handle_y);
-    }
-    else
-    {
-        return false;
-    }
-
-    mLocalId = data["local_id"].asInteger();
-    mObjectId = data["object_id"];
-
-    // message should be interpreted thusly:
-    ///  sides is a list of face indices
-    //   gltf_llsd is a list of corresponding GLTF override LLSD
-    //   any side not represented in "sides" has no override
-    if (data.has("sides") && data.has("gltf_llsd"))
-    {
-        LLSD const& sides = data.get("sides");
-        LLSD const& gltf_llsd = data.get("gltf_llsd");
-
-        if (sides.isArray() && gltf_llsd.isArray() &&
-            sides.size() != 0 &&
-            sides.size() == gltf_llsd.size())
-        {
-            for (int i = 0; i < sides.size(); ++i)
-            {
-                S32 side_idx = sides[i].asInteger();
-                mSides[side_idx] = gltf_llsd[i];
-                LLGLTFMaterial* override_mat = new LLGLTFMaterial();
-                override_mat->applyOverrideLLSD(gltf_llsd[i]);
-                mGLTFMaterial[side_idx] = override_mat;
-            }
-        }
-        else
-        {
-            LL_WARNS_IF(sides.size() != 0, "GLTF") << "broken override cache entry" << LL_ENDL;
-        }
-    }
-
-    llassert(mSides.size() == mGLTFMaterial.size());
-#ifdef SHOW_ASSERT
-    for (auto const & side : mSides)
-    {
-        // check that mSides and mGLTFMaterial have exactly the same keys present
-        llassert(mGLTFMaterial.count(side.first) == 1);
-    }
-#endif
-
-    return true;
-}
-
-LLSD LLGLTFOverrideCacheEntry::toLLSD() const
-{
-    LL_PROFILE_ZONE_SCOPED_CATEGORY_NETWORK;
-    LLSD data;
-    U32 region_handle_x, region_handle_y;
-    from_region_handle(mRegionHandle, &region_handle_x, &region_handle_y);
-    data["region_handle_y"] = LLSD::Integer(region_handle_y);
-    data["region_handle_x"] = LLSD::Integer(region_handle_x);
-
-    data["object_id"] = mObjectId;
-    data["local_id"] = (LLSD::Integer) mLocalId;
-
-    llassert(mSides.size() == mGLTFMaterial.size());
-    for (auto const & side : mSides)
-    {
-        // check that mSides and mGLTFMaterial have exactly the same keys present
-        llassert(mGLTFMaterial.count(side.first) == 1);
-        data["sides"].append(LLSD::Integer(side.first));
-        data["gltf_llsd"].append(side.second);
-    }
-
-    return data;
-}
-
 //---------------------------------------------------------------------------
 // LLVOCacheEntry
 //---------------------------------------------------------------------------
@@ -200,7 +109,7 @@ LLVOCacheEntry::LLVOCacheEntry(LLAPRFile* apr_file)
 {
 	S32 size = -1;
 	BOOL success;
-    static U8 data_buffer[ENTRY_HEADER_SIZE];
+    U8 data_buffer[ENTRY_HEADER_SIZE];
 
 	mDP.assignBuffer(mBuffer, 0);
 
@@ -1127,16 +1036,26 @@ LLVOCache::LLVOCache(bool read_only) :
 	mReadOnly(read_only),
 	mNumEntries(0),
 	mCacheSize(1),
-    mEnabled(true)
+    mEnabled(true),
+	mWriteInProgress(false),
+	mWritingHandle(0)
 {
 #ifndef LL_TEST
 	mEnabled = gSavedSettings.getBOOL("ObjectCacheEnabled");
 #endif
 	mLocalAPRFilePoolp = new LLVolatileAPRPool() ;
+
+	// One thread, so that the reads and writes of a region happen in the
+	// order they were queued.
+	mThreadPool.reset(new LL::ThreadPool("VOCache", 1, 1024 * 1024, false));
+	mThreadPool->start();
 }
 
 LLVOCache::~LLVOCache()
 {
+	// Finishes the queued writes
+	mThreadPool->close();
+
 	if(mEnabled)
 	{
 		writeCacheHeader();
@@ -1221,6 +1140,7 @@ void LLVOCache::removeCache(ELLPath location, bool started)
 	std::string mask = "*";
 	std::string cache_dir = gDirUtilp->getExpandedFilename(location, object_cache_dirname);
 	LL_INFOS() << "Removing cache at " << cache_dir << LL_ENDL;
+	dropAllPendingWrites();
 	gDirUtilp->deleteFilesInDir(cache_dir, mask); //delete all files
 	LLFile::rmdir(cache_dir);
 
@@ -1244,6 +1164,7 @@ void LLVOCache::removeCache()
 
 	std::string mask = "*";
 	LL_INFOS() << "Removing object cache at " << mObjectCacheDirName << LL_ENDL;
+	dropAllPendingWrites();
 	gDirUtilp->deleteFilesInDir(mObjectCacheDirName, mask); 
 
 	clearCacheInMemory() ;
@@ -1287,6 +1208,8 @@ void LLVOCache::removeEntry(U64 handle)
 
 void LLVOCache::clearCacheInMemory()
 {
+	dropAllPendingWrites();
+
 	if(!mHeaderEntryQueue.empty()) 
 	{
 		for(header_entry_queue_t::iterator iter = mHeaderEntryQueue.begin(); iter != mHeaderEntryQueue.end(); ++iter)
@@ -1328,6 +1251,8 @@ void LLVOCache::removeFromCache(HeaderEntryInfo* entry)
 		return ;
 	}
 
+	dropPendingWrites(entry->mHandle);
+
 	std::string filename;
 	getObjectCacheFilename(entry->mHandle, filename);
 	LLAPRFile::remove(filename, mLocalAPRFilePoolp);
@@ -1494,55 +1419,98 @@ void LLVOCache::readFromCache(U64 handle, const LLUUID& id, LLVOCacheEntry::voca
 		return ;
 	}
 
-	bool success = true ;
+	if(!readCacheFile(handle, id, cache_entry_map, mLocalAPRFilePoolp))
 	{
-		std::string filename;
-		LLUUID cache_id;
-		getObjectCacheFilename(handle, filename);
-		LLAPRFile apr_file(filename, APR_READ|APR_BINARY, mLocalAPRFilePoolp);
-	
-		success = check_read(&apr_file, cache_id.mData, UUID_BYTES);
-	
-		if(success)
-		{		
-			if(cache_id != id)
+		if(cache_entry_map.empty())
+		{
+			removeEntry(iter->second) ;
+		}
+	}
+
+	return ;
+}
+
+void LLVOCache::readFromCacheAsync(U64 handle, const LLUUID& id, const read_callback_t& callback)
+{
+	if(!mEnabled || !mInitialized || mHandleEntryMap.find(handle) == mHandleEntryMap.end())
+	{
+		LLVOCacheEntry::vocache_entry_map_t cache_entry_map;
+		readFromCache(handle, id, cache_entry_map);
+		callback(cache_entry_map);
+		return;
+	}
+
+	typedef std::pair<bool, LLVOCacheEntry::vocache_entry_map_t> read_result_t;
+	LL::WorkQueue::ptr_t main_queue = LL::WorkQueue::getInstance("mainloop");
+	LL::WorkQueue::ptr_t cache_queue = LL::WorkQueue::getInstance("VOCache");
+	bool posted = main_queue && cache_queue && main_queue->postTo(
+		cache_queue,
+		[this, handle, id]() // on the object cache thread
+		{
+			read_result_t result;
+			// LLAPRFile uses the thread safe global pool when given none
+			result.first = readCacheFile(handle, id, result.second, nullptr);
+			return result;
+		},
+		[handle, callback](read_result_t result) // back on the main thread
+		{
+			if(!result.first && result.second.empty() && LLVOCache::instanceExists())
 			{
-				LL_INFOS() << "Cache ID doesn't match for this region, discarding"<< LL_ENDL;
-				success = false ;
+				LLVOCache::instance().removeEntry(handle);
 			}
+			callback(result.second);
+		});
+
+	if(!posted)
+	{
+		LLVOCacheEntry::vocache_entry_map_t cache_entry_map;
+		readFromCache(handle, id, cache_entry_map);
+		callback(cache_entry_map);
+	}
+}
+
+bool LLVOCache::readCacheFile(U64 handle, const LLUUID& id, LLVOCacheEntry::vocache_entry_map_t& cache_entry_map, LLVolatileAPRPool* pool)
+{
+	LL_PROFILE_ZONE_SCOPED;
+	bool success = true ;
+	std::string filename;
+	LLUUID cache_id;
+	getObjectCacheFilename(handle, filename);
+	LLAPRFile apr_file(filename, APR_READ|APR_BINARY, pool);
+
+	success = check_read(&apr_file, cache_id.mData, UUID_BYTES);
+
+	if(success)
+	{		
+		if(cache_id != id)
+		{
+			LL_INFOS() << "Cache ID doesn't match for this region, discarding"<< LL_ENDL;
+			success = false ;
+		}
+
+		if(success)
+		{
+			S32 num_entries;  // if removal was enabled during write num_entries might be wrong
+			success = check_read(&apr_file, &num_entries, sizeof(S32)) ;
 
 			if(success)
 			{
-				S32 num_entries;  // if removal was enabled during write num_entries might be wrong
-				success = check_read(&apr_file, &num_entries, sizeof(S32)) ;
-	
-				if(success)
+				for (S32 i = 0; i < num_entries && apr_file.eof() != APR_EOF; i++)
 				{
-					for (S32 i = 0; i < num_entries && apr_file.eof() != APR_EOF; i++)
+					LLPointer<LLVOCacheEntry> entry = new LLVOCacheEntry(&apr_file);
+					if (!entry->getLocalID())
 					{
-						LLPointer<LLVOCacheEntry> entry = new LLVOCacheEntry(&apr_file);
-						if (!entry->getLocalID())
-						{
-							LL_WARNS() << "Aborting cache file load for " << filename << ", cache file corruption!" << LL_ENDL;
-							success = false ;
-							break ;
-						}
-						cache_entry_map[entry->getLocalID()] = entry;
+						LL_WARNS() << "Aborting cache file load for " << filename << ", cache file corruption!" << LL_ENDL;
+						success = false ;
+						break ;
 					}
+					cache_entry_map[entry->getLocalID()] = entry;
 				}
 			}
-		}		
-	}
-	
-	if(!success)
-	{
-		if(cache_entry_map.empty())
-		{
-			removeEntry(iter->second) ;
 		}
-	}
+	}		
 
-	return ;
+	return success;
 }
 
 void LLVOCache::readGenericExtrasFromCache(U64 handle, const LLUUID& id, LLVOCacheEntry::vocache_gltf_overrides_map_t& cache_extras_entry_map)
@@ -1561,64 +1529,7 @@ void LLVOCache::readGenericExtrasFromCache(U64 handle, const LLUUID& id, LLVOCac
         return;
     }
 
-    std::string filename(getObjectCacheExtrasFilename(handle));
-    llifstream in(filename, std::ios::in | std::ios::binary);
-
-    std::string line;
-    std::getline(in, line);
-    if(!in.good()) {
-        LL_WARNS() << "Failed reading extras cache for handle " << handle << LL_ENDL;
-        return;
-    }
-
-    if(!LLUUID::validate(line))
-    {
-        LL_WARNS() << "Failed reading extras cache for handle" << handle << ". invalid uuid line: '" << line << "'" << LL_ENDL;
-        return;
-    }
-
-    LLUUID cache_id(line);
-    if(cache_id != id)
-    {
-        LL_INFOS() << "Cache ID doesn't match for this region, discarding" << LL_ENDL;
-        return;
-    }
-
-    U32 num_entries;  // if removal was enabled during write num_entries might be wrong
-    std::getline(in, line);
-    if(!in.good()) {
-        LL_WARNS() << "Failed reading extras cache for handle " << handle << LL_ENDL;
-        return;
-    }
-    try {
-        num_entries = std::stol(line);
-    }
-    catch(std::logic_error&)  // either invalid_argument or out_of_range
-    {
-        LL_WARNS() << "Failed reading extras cache for handle " << handle << ". unreadable num_entries" << LL_ENDL;
-        return;
-    }
-
-    LL_DEBUGS("GLTF") << "Beginning reading extras cache for handle " << handle << ", " << num_entries << " entries" << LL_ENDL;
-
-    LLSD entry_llsd;
-    for (U32 i = 0; i < num_entries && !in.eof(); i++)
-    {
-        static const U32 max_size = 4096;
-        bool success = LLSDSerialize::deserialize(entry_llsd, in, max_size);
-        // check bool(in) this time since eof is not a failure condition here
-        if(!success || !in) {
-            LL_WARNS() << "Failed reading extras cache for handle " << handle << ", entry number " << i << LL_ENDL;
-            return;
-        }
-
-        LLGLTFOverrideCacheEntry entry;
-        entry.fromLLSD(entry_llsd);
-        U32 local_id = entry_llsd["local_id"].asInteger();
-        cache_extras_entry_map[local_id] = entry;
-    }
-
-    LL_DEBUGS("GLTF") << "Completed reading extras cache for handle " << handle << ", " << num_entries << " entries" << LL_ENDL;
+    LLVOCacheExtrasFile::read(getObjectCacheExtrasFilename(handle), handle, id, cache_extras_entry_map);
 }
 
 void LLVOCache::purgeEntries(U32 size)
@@ -1692,71 +1603,133 @@ void LLVOCache::writeToCache(U64 handle, const LLUUID& id, const LLVOCacheEntry:
 		return ; //nothing changed, no need to update.
 	}
 
-	//write to cache file
+	// Serialize here, the object cache thread writes the file
+	std::shared_ptr<PendingWrite> write = std::make_shared<PendingWrite>();
+	write->mCacheID = id;
+	write->mNumEntries = 0;
+	write->mData.reserve(cache_entry_map.size() * (ENTRY_HEADER_SIZE + 256));
+
 	bool success = true ;
+	for (LLVOCacheEntry::vocache_entry_map_t::const_iterator iter = cache_entry_map.begin(); iter != cache_entry_map.end(); ++iter)
 	{
-		std::string filename;
-		getObjectCacheFilename(handle, filename);
-		LLAPRFile apr_file(filename, APR_CREATE|APR_WRITE|APR_BINARY|APR_TRUNCATE, mLocalAPRFilePoolp);
-	
-		success = check_write(&apr_file, (void*)id.mData, UUID_BYTES);
-	
-		if(success)
+		if (!removal_enabled || iter->second->isValid())
 		{
-			S32 num_entries = cache_entry_map.size(); // if removal is enabled num_entries might be wrong
-			success = check_write(&apr_file, &num_entries, sizeof(S32));
-            if (success)
-            {
-                const S32 buffer_size = 32768; //should be large enough for couple MAX_ENTRY_BODY_SIZE
-                U8 data_buffer[buffer_size]; // generaly entries are fairly small, so collect them and drop onto disk in one go
-                S32 size_in_buffer = 0;
-
-                // This can have a lot of entries, so might be better to dump them into buffer first and write in one go.
-                for (LLVOCacheEntry::vocache_entry_map_t::const_iterator iter = cache_entry_map.begin(); success && iter != cache_entry_map.end(); ++iter)
-                {
-                    if (!removal_enabled || iter->second->isValid())
-                    {
-                        S32 size = iter->second->writeToBuffer(data_buffer + size_in_buffer);
-
-                        if (size > ENTRY_HEADER_SIZE) // body is minimum of 1
-                        {
-                            size_in_buffer += size;
-                        }
-                        else
-                        {
-                            success = false;
-                            break;
-                        }
-
-                        // Make sure we have space in buffer for next element
-                        if (buffer_size - size_in_buffer < MAX_ENTRY_BODY_SIZE + ENTRY_HEADER_SIZE)
-                        {
-                            success = check_write(&apr_file, (void*)data_buffer, size_in_buffer);
-                            size_in_buffer = 0;
-                            if (!success)
-                            {
-                                break;
-                            }
-                        }
-                    }
-                }
-
-                if (success && size_in_buffer > 0)
-                {
-                    // final write
-                    success = check_write(&apr_file, (void*)data_buffer, size_in_buffer);
-                    size_in_buffer = 0;
-                }
-            }
+			size_t offset = write->mData.size();
+			write->mData.resize(offset + ENTRY_HEADER_SIZE + MAX_ENTRY_BODY_SIZE);
+			S32 size = iter->second->writeToBuffer(&write->mData[offset]);
+			if (size <= ENTRY_HEADER_SIZE) // body is minimum of 1
+			{
+				success = false;
+				break;
+			}
+			write->mData.resize(offset + size);
+			write->mNumEntries++;
 		}
 	}
 
 	if(!success)
 	{
 		removeEntry(entry) ;
+		return ;
 	}
 
-	return ;
+	queueCacheWrite(handle, write);
+}
+
+void LLVOCache::queueCacheWrite(U64 handle, const std::shared_ptr<PendingWrite>& write)
+{
+	{
+		LLMutexLock lock(&mPendingWritesMutex);
+		std::shared_ptr<PendingWrite>& pending = mPendingWrites[handle];
+		bool queued = pending != nullptr;
+		pending = write;
+		if (queued)
+		{
+			// The task already queued for this region hasn't started yet,
+			// it will write this newer data instead.
+			LL_DEBUGS("ObjectCache") << "Coalesced cache write for handle " << handle << LL_ENDL;
+			return;
+		}
+	}
+
+	LL::WorkQueue::ptr_t main_queue = LL::WorkQueue::getInstance("mainloop");
+	LL::WorkQueue::ptr_t cache_queue = LL::WorkQueue::getInstance("VOCache");
+	bool posted = main_queue && cache_queue && main_queue->postTo(
+		cache_queue,
+		[this, handle]() // on the object cache thread
+		{
+			std::shared_ptr<PendingWrite> write;
+			{
+				LLMutexLock lock(&mPendingWritesMutex);
+				pending_write_map_t::iterator iter = mPendingWrites.find(handle);
+				if (iter == mPendingWrites.end())
+				{
+					// Dropped since, the region was removed from the cache
+					return true;
+				}
+				write = iter->second;
+				mPendingWrites.erase(iter);
+				mWriteInProgress = true;
+				mWritingHandle = handle;
+			}
+			bool success = writeCacheFile(handle, *write, nullptr);
+			{
+				LLMutexLock lock(&mPendingWritesMutex);
+				mWriteInProgress = false;
+			}
+			mWriteDone.notify_all();
+			return success;
+		},
+		[handle](bool success) // back on the main thread
+		{
+			if (!success && LLVOCache::instanceExists())
+			{
+				LLVOCache::instance().removeEntry(handle);
+			}
+		});
+
+	if (!posted)
+	{
+		// No main loop to report back to, or shutting down
+		dropPendingWrites(handle);
+		if (!writeCacheFile(handle, *write, mLocalAPRFilePoolp))
+		{
+			removeEntry(handle);
+		}
+	}
+}
+
+void LLVOCache::dropPendingWrites(U64 handle)
+{
+	LLMutexLock lock(&mPendingWritesMutex);
+	mPendingWrites.erase(handle);
+	// A region file is small: blocking on it beats the write recreating
+	// the file right after it was removed
+	mWriteDone.wait(mPendingWritesMutex, [this, handle]() { return !mWriteInProgress || mWritingHandle != handle; });
+}
+
+void LLVOCache::dropAllPendingWrites()
+{
+	LLMutexLock lock(&mPendingWritesMutex);
+	mPendingWrites.clear();
+	mWriteDone.wait(mPendingWritesMutex, [this]() { return !mWriteInProgress; });
+}
+
+bool LLVOCache::writeCacheFile(U64 handle, const PendingWrite& write, LLVolatileAPRPool* pool)
+{
+	LL_PROFILE_ZONE_SCOPED;
+	std::string filename;
+	getObjectCacheFilename(handle, filename);
+	LLAPRFile apr_file(filename, APR_CREATE|APR_WRITE|APR_BINARY|APR_TRUNCATE, pool);
+
+	S32 num_entries = write.mNumEntries;
+	bool success = check_write(&apr_file, (void*)write.mCacheID.mData, UUID_BYTES) &&
+				   check_write(&apr_file, &num_entries, sizeof(S32));
+	if (success && !write.mData.empty())
+	{
+		success = check_write(&apr_file, (void*)write.mData.data(), write.mData.size());
+	}
+	return success;
 }
 
 void LLVOCache::writeGenericExtrasToCache(U64 handle, const LLUUID& id, const LLVOCacheEntry::vocache_gltf_overrides_map_t& cache_extras_entry_map, BOOL dirty_cache, bool removal_enabled)
@@ -1774,46 +1747,5 @@ void LLVOCache::writeGenericExtrasToCache(U64 handle, const LLUUID& id, const LL
         return;
     }
 
-    std::string filename(getObjectCacheExtrasFilename(handle));
-    llofstream out(filename, std::ios::out | std::ios::binary);
-    if(!out.good())
-    {
-        LL_WARNS() << "Failed writing extras cache for handle " << handle << LL_ENDL;
-        return;
-        // TODO - clean up broken cache file
-    }
-
-    out << id << '\n';
-    if(!out.good())
-    {
-        LL_WARNS() << "Failed writing extras cache for handle " << handle << LL_ENDL;
-        return;
-        // TODO - clean up broken cache file
-    }
-
-    U32 num_entries = cache_extras_entry_map.size();
-    out << num_entries << '\n';
-    if(!out.good())
-    {
-        LL_WARNS() << "Failed writing extras cache for handle " << handle << LL_ENDL;
-        return;
-        // TODO - clean up broken cache file
-    }
-
-    for (auto const & entry : cache_extras_entry_map)
-    {
-        S32 local_id = entry.first;
-        LLSD entry_llsd = entry.second.toLLSD();
-        entry_llsd["local_id"] = local_id;
-        LLSDSerialize::serialize(entry_llsd, out, LLSDSerialize::LLSD_XML);
-        out << '\n';
-        if(!out.good())
-        {
-            LL_WARNS() << "Failed writing extras cache for handle " << handle << LL_ENDL;
-            return;
-            // TODO - clean up broken cache file
-        }
-    }
-
-    LL_DEBUGS("GLTF") << "Completed writing extras cache for handle " << handle << ", " << num_entries << " entries" << LL_ENDL;
+    LLVOCacheExtrasFile::write(getObjectCacheExtrasFilename(handle), id, cache_extras_entry_map);
 }
@@ -32,27 +32,19 @@
 #include "lldir.h"
 #include "llvieweroctree.h"
 #include "llapr.h"
-#include "llgltfmaterial.h"
+#include "llmutex.h"
+#include "llvocacheextras.h"
+#include "threadpool_fwd.h"
 
+#include <condition_variable>
+#include <functional>
+#include <memory>
 #include <unordered_map>
 
 //---------------------------------------------------------------------------
 // Cache entries
 class LLCamera;
 
-class LLGLTFOverrideCacheEntry
-{
-public:
-    bool fromLLSD(const LLSD& data);
-    LLSD toLLSD() const;
-
-    LLUUID mObjectId;
-    U32    mLocalId = 0;
-    std::unordered_map<S32, LLSD> mSides; //override LLSD per side
-    std::unordered_map<S32, LLPointer<LLGLTFMaterial> > mGLTFMaterial; //GLTF material per side
-    U64 mRegionHandle = 0;
-};
-
 class LLVOCacheEntry 
 :	public LLViewerOctreeEntryData
 {
@@ -167,7 +159,7 @@ public:
 	typedef std::set<LLVOCacheEntry*>                      vocache_entry_set_t;
 	typedef std::set<LLVOCacheEntry*, CompareVOCacheEntry> vocache_entry_priority_list_t;
 
-    typedef std::unordered_map<U32, LLGLTFOverrideCacheEntry>  vocache_gltf_overrides_map_t;
+    typedef LLVOCacheExtrasFile::entry_map_t  vocache_gltf_overrides_map_t;
 
 	S32                         mLastCameraUpdated;
 protected:
@@ -284,12 +276,28 @@ private:
 	typedef std::set<HeaderEntryInfo*, header_entry_less> header_entry_queue_t;
 	typedef std::map<U64, HeaderEntryInfo*> handle_entry_map_t;
 
+	// Region objects serialized on the main thread, waiting to be written
+	// by the object cache thread
+	struct PendingWrite
+	{
+		LLUUID mCacheID;
+		S32 mNumEntries;
+		std::vector<U8> mData;
+	};
+	typedef std::map<U64, std::shared_ptr<PendingWrite> > pending_write_map_t;
+
 public:
 	// We need this init to be separate from constructor, since we might construct cache, purge it, then init.
 	void initCache(ELLPath location, U32 size, U32 cache_version);
 	void removeCache(ELLPath location, bool started = false) ;
 
 	void readFromCache(U64 handle, const LLUUID& id, LLVOCacheEntry::vocache_entry_map_t& cache_entry_map) ;
+
+	// Reads the region cache file on the object cache thread, then calls
+	// callback on the main thread with the entries (empty if there was no
+	// usable cache). Writes to the same region queued earlier land first.
+	typedef std::function<void(LLVOCacheEntry::vocache_entry_map_t& cache_entry_map)> read_callback_t;
+	void readFromCacheAsync(U64 handle, const LLUUID& id, const read_callback_t& callback);
     void readGenericExtrasFromCache(U64 handle, const LLUUID& id, LLVOCacheEntry::vocache_gltf_overrides_map_t& cache_extras_entry_map);
 
 	void writeToCache(U64 handle, const LLUUID& id, const LLVOCacheEntry::vocache_entry_map_t& cache_entry_map, BOOL dirty_cache, bool removal_enabled);
@@ -312,6 +320,15 @@ private:
 	void removeEntry(HeaderEntryInfo* entry) ;
 	void purgeEntries(U32 size);
 	BOOL updateEntry(const HeaderEntryInfo* entry);
+
+	// Region cache file access, safe to call from the object cache thread
+	bool readCacheFile(U64 handle, const LLUUID& id, LLVOCacheEntry::vocache_entry_map_t& cache_entry_map, LLVolatileAPRPool* pool);
+	bool writeCacheFile(U64 handle, const PendingWrite& write, LLVolatileAPRPool* pool);
+	void queueCacheWrite(U64 handle, const std::shared_ptr<PendingWrite>& write);
+	// Forgets the writes queued for handle, and waits for the one the object
+	// cache thread may be in the middle of, so that the file can be removed.
+	void dropPendingWrites(U64 handle);
+	void dropAllPendingWrites();
 	
 private:
 	bool                 mEnabled;
@@ -323,6 +340,13 @@ private:
 	std::string          mHeaderFileName ;
 	std::string          mObjectCacheDirName;
 	LLVolatileAPRPool*   mLocalAPRFilePoolp ; 	
+	std::unique_ptr<LL::ThreadPool> mThreadPool;
+	LLMutex              mPendingWritesMutex;
+	pending_write_map_t  mPendingWrites;
+	// Region the object cache thread is writing, if mWriteInProgress
+	bool                 mWriteInProgress;
+	U64                  mWritingHandle;
+	std::condition_variable_any mWriteDone;
 	header_entry_queue_t mHeaderEntryQueue;
 	handle_entry_map_t   mHandleEntryMap;	
 };
@@ -0,0 +1,383 @@
+/**
+ * @file llvocacheextras.cpp
+ * @brief GLTF override entries of the object cache, and the region extras
+ *        file that holds them.
+ *
+ * $LicenseInfo:firstyear=2024&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2024, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include "llviewerprecompiledheaders.h"
+#include "llvocacheextras.h"
+
+#include "hbxxh.h"
+#include "llfile.h"
+#include "llmemorystream.h"
+#include "llregionhandle.h"
+#include "llsdserialize.h"
+
+static const U32 EXTRAS_FILE_MAGIC = 0x43454c53; // "SLEC"
+static const U32 EXTRAS_FILE_VERSION = 1;
+
+bool LLGLTFOverrideCacheEntry::fromLLSD(const LLSD& data)
+{
+    LL_PROFILE_ZONE_SCOPED_CATEGORY_NETWORK;
+    
+    llassert(data.has("local_id"));
+    llassert(data.has("object_id"));
+    llassert(data.has("region_handle_x") && data.has("region_handle_y"));
+
+    if (!data.has("local_id"))
+    {
+        return false;
+    }
+
+    if (data.has("region_handle_x") && data.has("region_handle_y"))
+    {
+        // TODO start requiring this once server sends this for all messages
+        U32 region_handle_y = data["region_handle_y"].asInteger();
+        U32 region_handle_x = data["region_handle_x"].asInteger();
+        mRegionHandle = to_region_handle(region_handle_x, region_handle_y);
+    }
+    else
+    {
+        return false;
+    }
+
+    mLocalId = data["local_id"].asInteger();
+    mObjectId = data["object_id"];
+
+    // message should be interpreted thusly:
+    ///  sides is a list of face indices
+    //   gltf_llsd is a list of corresponding GLTF override LLSD
+    //   any side not represented in "sides" has no override
+    if (data.has("sides") && data.has("gltf_llsd"))
+    {
+        LLSD const& sides = data.get("sides");
+        LLSD const& gltf_llsd = data.get("gltf_llsd");
+
+        if (sides.isArray() && gltf_llsd.isArray() &&
+            sides.size() != 0 &&
+            sides.size() == gltf_llsd.size())
+        {
+            for (int i = 0; i < sides.size(); ++i)
+            {
+                S32 side_idx = sides[i].asInteger();
+                mSides[side_idx] = gltf_llsd[i];
+                LLGLTFMaterial* override_mat = new LLGLTFMaterial();
+                override_mat->applyOverrideLLSD(gltf_llsd[i]);
+                mGLTFMaterial[side_idx] = override_mat;
+            }
+        }
+        else
+        {
+            LL_WARNS_IF(sides.size() != 0, "GLTF") << "broken override cache entry" << LL_ENDL;
+        }
+    }
+
+    llassert(mSides.size() == mGLTFMaterial.size());
+#ifdef SHOW_ASSERT
+    for (auto const & side : mSides)
+    {
+        // check that mSides and mGLTFMaterial have exactly the same keys present
+        llassert(mGLTFMaterial.count(side.first) == 1);
+    }
+#endif
+
+    return true;
+}
+
+LLSD LLGLTFOverrideCacheEntry::toLLSD() const
+{
+    LL_PROFILE_ZONE_SCOPED_CATEGORY_NETWORK;
+    LLSD data;
+    if (isEncoded())
+    {
+        LLMemoryStream str(mEncodedData, mEncodedSize);
+        LLSDSerialize::fromBinary(data, str, mEncodedSize);
+        return data;
+    }
+
+    U32 region_handle_x, region_handle_y;
+    from_region_handle(mRegionHandle, &region_handle_x, &region_handle_y);
+    data["region_handle_y"] = LLSD::Integer(region_handle_y);
+    data["region_handle_x"] = LLSD::Integer(region_handle_x);
+
+    data["object_id"] = mObjectId;
+    data["local_id"] = (LLSD::Integer) mLocalId;
+
+    llassert(mSides.size() == mGLTFMaterial.size());
+    for (auto const & side : mSides)
+    {
+        // check that mSides and mGLTFMaterial have exactly the same keys present
+        llassert(mGLTFMaterial.count(side.first) == 1);
+        data["sides"].append(LLSD::Integer(side.first));
+        data["gltf_llsd"].append(side.second);
+    }
+
+    return data;
+}
+
+bool LLGLTFOverrideCacheEntry::decode()
+{
+    if (!isEncoded())
+    {
+        return true;
+    }
+    LL_PROFILE_ZONE_SCOPED_CATEGORY_NETWORK;
+
+    LLSD data;
+    bool success = (U32)HBXXH64::digest(mEncodedData, mEncodedSize) == mEncodedChecksum;
+    if (success)
+    {
+        LLMemoryStream str(mEncodedData, mEncodedSize);
+        success = LLSDSerialize::fromBinary(data, str, mEncodedSize) > 0;
+    }
+
+    mEncodedData = nullptr;
+    mEncodedSize = 0;
+    mEncodedFile.reset();
+
+    if (!success)
+    {
+        LL_WARNS("GLTF") << "Corrupt extras cache entry for local id " << mLocalId << LL_ENDL;
+        return false;
+    }
+    return fromLLSD(data);
+}
+
+// static
+void LLVOCacheExtrasFile::read(const std::string& filename, U64 handle, const LLUUID& id, entry_map_t& cache_extras_entry_map)
+{
+    std::shared_ptr<LLMappedFile> file = std::make_shared<LLMappedFile>();
+    if (!file->open(filename, 0, true))
+    {
+        LL_WARNS() << "Failed reading extras cache for handle " << handle << LL_ENDL;
+        return;
+    }
+
+    const FileHeader* header = (const FileHeader*)file->getData();
+    if (file->getSize() < sizeof(FileHeader) || header->mMagic != EXTRAS_FILE_MAGIC)
+    {
+        // Written by an older viewer, as a series of LLSD XML documents
+        file.reset();
+        readLegacy(filename, handle, id, cache_extras_entry_map);
+        return;
+    }
+
+    if (header->mVersion != EXTRAS_FILE_VERSION)
+    {
+        LL_INFOS() << "Extras cache version mismatch for handle " << handle << ", discarding" << LL_ENDL;
+        return;
+    }
+
+    if (header->mCacheID != id)
+    {
+        LL_INFOS() << "Cache ID doesn't match for this region, discarding" << LL_ENDL;
+        return;
+    }
+
+    const U32 num_entries = header->mNumEntries;
+    const size_t file_size = file->getSize();
+    if (num_entries > (file_size - sizeof(FileHeader)) / sizeof(IndexEntry))
+    {
+        LL_WARNS() << "Failed reading extras cache for handle " << handle << ". truncated index" << LL_ENDL;
+        return;
+    }
+
+    const IndexEntry* index = (const IndexEntry*)(header + 1);
+    if ((U32)HBXXH64::digest(index, num_entries * sizeof(IndexEntry)) != header->mIndexChecksum)
+    {
+        LL_WARNS() << "Failed reading extras cache for handle " << handle << ". bad index checksum" << LL_ENDL;
+        return;
+    }
+
+    LL_DEBUGS("GLTF") << "Beginning reading extras cache for handle " << handle << ", " << num_entries << " entries" << LL_ENDL;
+
+    // Only the index is read here, each entry is decoded when it is first
+    // applied to its object (see LLViewerRegion::applyCacheMiscExtras()).
+    cache_extras_entry_map.reserve(cache_extras_entry_map.size() + num_entries);
+    for (U32 i = 0; i < num_entries; i++)
+    {
+        const IndexEntry& index_entry = index[i];
+        if (!index_entry.mSize || (size_t)index_entry.mOffset + index_entry.mSize > file_size)
+        {
+            LL_WARNS() << "Failed reading extras cache for handle " << handle << ", entry number " << i << LL_ENDL;
+            continue;
+        }
+
+        LLGLTFOverrideCacheEntry& entry = cache_extras_entry_map[index_entry.mLocalID];
+        entry = LLGLTFOverrideCacheEntry();
+        entry.mLocalId = index_entry.mLocalID;
+        entry.mObjectId = index_entry.mObjectID;
+        entry.mRegionHandle = handle;
+        entry.mEncodedFile = file;
+        entry.mEncodedData = file->getData() + index_entry.mOffset;
+        entry.mEncodedSize = index_entry.mSize;
+        entry.mEncodedChecksum = index_entry.mChecksum;
+    }
+
+    LL_DEBUGS("GLTF") << "Completed reading extras cache for handle " << handle << ", " << num_entries << " entries" << LL_ENDL;
+}
+
+// static
+void LLVOCacheExtrasFile::readLegacy(const std::string& filename, U64 handle, const LLUUID& id, entry_map_t& cache_extras_entry_map)
+{
+    llifstream in(filename, std::ios::in | std::ios::binary);
+
+    std::string line;
+    std::getline(in, line);
+    if(!in.good()) {
+        LL_WARNS() << "Failed reading extras cache for handle " << handle << LL_ENDL;
+        return;
+    }
+
+    if(!LLUUID::validate(line))
+    {
+        LL_WARNS() << "Failed reading extras cache for handle" << handle << ". invalid uuid line: '" << line << "'" << LL_ENDL;
+        return;
+    }
+
+    LLUUID cache_id(line);
+    if(cache_id != id)
+    {
+        LL_INFOS() << "Cache ID doesn't match for this region, discarding" << LL_ENDL;
+        return;
+    }
+
+    U32 num_entries;  // if removal was enabled during write num_entries might be wrong
+    std::getline(in, line);
+    if(!in.good()) {
+        LL_WARNS() << "Failed reading extras cache for handle " << handle << LL_ENDL;
+        return;
+    }
+    try {
+        num_entries = std::stol(line);
+    }
+    catch(std::logic_error&)  // either invalid_argument or out_of_range
+    {
+        LL_WARNS() << "Failed reading extras cache for handle " << handle << ". unreadable num_entries" << LL_ENDL;
+        return;
+    }
+
+    LL_DEBUGS("GLTF") << "Beginning reading legacy extras cache for handle " << handle << ", " << num_entries << " entries" << LL_ENDL;
+
+    LLSD entry_llsd;
+    for (U32 i = 0; i < num_entries && !in.eof(); i++)
+    {
+        static const U32 max_size = 4096;
+        bool success = LLSDSerialize::deserialize(entry_llsd, in, max_size);
+        // check bool(in) this time since eof is not a failure condition here
+        if(!success || !in) {
+            LL_WARNS() << "Failed reading extras cache for handle " << handle << ", entry number " << i << LL_ENDL;
+            return;
+        }
+
+        LLGLTFOverrideCacheEntry entry;
+        entry.fromLLSD(entry_llsd);
+        U32 local_id = entry_llsd["local_id"].asInteger();
+        cache_extras_entry_map[local_id] = entry;
+    }
+
+    LL_DEBUGS("GLTF") << "Completed reading legacy extras cache for handle " << handle << ", " << num_entries << " entries" << LL_ENDL;
+}
+
+// static
+bool LLVOCacheExtrasFile::write(const std::string& filename, const LLUUID& id, const entry_map_t& cache_extras_entry_map)
+{
+    // Build the index and payload in memory first: entries that were never
+    // decoded still point into the mapping of the file being replaced.
+    const U32 num_entries = cache_extras_entry_map.size();
+    std::vector<IndexEntry> index;
+    index.reserve(num_entries);
+    std::ostringstream payload;
+    const U32 payload_offset = sizeof(FileHeader) + num_entries * sizeof(IndexEntry);
+
+    for (auto const & entry : cache_extras_entry_map)
+    {
+        std::string encoded;
+        if (entry.second.isEncoded())
+        {
+            encoded.assign((const char*)entry.second.mEncodedData, entry.second.mEncodedSize);
+        }
+        else
+        {
+            LLSD entry_llsd = entry.second.toLLSD();
+            entry_llsd["local_id"] = (LLSD::Integer)entry.first;
+            std::ostringstream str;
+            LLSDSerialize::toBinary(entry_llsd, str);
+            encoded = str.str();
+        }
+
+        IndexEntry index_entry;
+        index_entry.mLocalID = entry.first;
+        index_entry.mOffset = payload_offset + (U32)payload.tellp();
+        index_entry.mSize = encoded.size();
+        index_entry.mChecksum = (U32)HBXXH64::digest(encoded.data(), encoded.size());
+        index_entry.mObjectID = entry.second.mObjectId;
+        index.push_back(index_entry);
+
+        payload << encoded;
+    }
+
+    FileHeader header;
+    header.mMagic = EXTRAS_FILE_MAGIC;
+    header.mVersion = EXTRAS_FILE_VERSION;
+    header.mCacheID = id;
+    header.mNumEntries = num_entries;
+    header.mIndexChecksum = (U32)HBXXH64::digest(index.data(), index.size() * sizeof(IndexEntry));
+
+    std::string temp_filename(filename + ".tmp");
+    {
+        llofstream out(temp_filename, std::ios::out | std::ios::binary | std::ios::trunc);
+        out.write((const char*)&header, sizeof(header));
+        out.write((const char*)index.data(), index.size() * sizeof(IndexEntry));
+        const std::string payload_data = payload.str();
+        out.write(payload_data.data(), payload_data.size());
+        if (!out.good())
+        {
+            LL_WARNS() << "Failed writing extras cache " << filename << LL_ENDL;
+            out.close();
+            LLFile::remove(temp_filename);
+            return false;
+        }
+    }
+
+#if LL_WINDOWS
+    // Windows won't rename over an existing file, nor delete one that is still
+    // mapped, but it lets a mapped file be renamed out of the way.
+    std::string old_filename(filename + ".old");
+    LLFile::remove(old_filename, ENOENT);
+    LLFile::rename(filename, old_filename, ENOENT);
+#endif
+    if (LLFile::rename(temp_filename, filename) != 0)
+    {
+        LL_WARNS() << "Failed writing extras cache " << filename << LL_ENDL;
+        LLFile::remove(temp_filename);
+        return false;
+    }
+#if LL_WINDOWS
+    LLFile::remove(old_filename, ENOENT);
+#endif
+
+    LL_DEBUGS("GLTF") << "Completed writing extras cache " << filename << ", " << num_entries << " entries" << LL_ENDL;
+    return true;
+}
@@ -0,0 +1,103 @@
+/**
+ * @file llvocacheextras.h
+ * @brief GLTF override entries of the object cache, and the region extras
+ *        file that holds them.
+ *
+ * $LicenseInfo:firstyear=2024&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2024, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#ifndef LL_LLVOCACHEEXTRAS_H
+#define LL_LLVOCACHEEXTRAS_H
+
+#include "lluuid.h"
+#include "llgltfmaterial.h"
+#include "llmappedfile.h"
+#include "llsd.h"
+
+#include <memory>
+#include <string>
+#include <unordered_map>
+
+class LLGLTFOverrideCacheEntry
+{
+public:
+    bool fromLLSD(const LLSD& data);
+    LLSD toLLSD() const;
+
+    // Entries read from a binary extras file keep pointing at their record in
+    // the mapped file until decode() turns it into mSides and mGLTFMaterial.
+    bool isEncoded() const { return mEncodedData != nullptr; }
+    bool decode();
+
+    LLUUID mObjectId;
+    U32    mLocalId = 0;
+    std::unordered_map<S32, LLSD> mSides; //override LLSD per side
+    std::unordered_map<S32, LLPointer<LLGLTFMaterial> > mGLTFMaterial; //GLTF material per side
+    U64 mRegionHandle = 0;
+
+    std::shared_ptr<LLMappedFile> mEncodedFile; // keeps mEncodedData mapped
+    const U8* mEncodedData = nullptr; // binary LLSD, as written by toLLSD()
+    U32 mEncodedSize = 0;
+    U32 mEncodedChecksum = 0;
+};
+
+// The extras (.slec) file of one region in the object cache. LLVOCache
+// decides when and which file; this only knows what is in it.
+class LLVOCacheExtrasFile
+{
+public:
+    typedef std::unordered_map<U32, LLGLTFOverrideCacheEntry> entry_map_t;
+
+    // Adds the entries of filename to entries, if it was written for the
+    // region with cache id id. Binary files only have their index read, see
+    // LLGLTFOverrideCacheEntry::decode(). Files written by older viewers, as
+    // a series of LLSD XML documents, are parsed in full.
+    static void read(const std::string& filename, U64 handle, const LLUUID& id, entry_map_t& entries);
+
+    // Replaces filename with entries in the binary format
+    static bool write(const std::string& filename, const LLUUID& id, const entry_map_t& entries);
+
+private:
+    static void readLegacy(const std::string& filename, U64 handle, const LLUUID& id, entry_map_t& entries);
+
+    // File layout: FileHeader, then mNumEntries IndexEntry, then the binary
+    // LLSD of each entry.
+    struct FileHeader
+    {
+        U32 mMagic;
+        U32 mVersion;
+        LLUUID mCacheID;
+        U32 mNumEntries;
+        U32 mIndexChecksum;
+    };
+
+    struct IndexEntry
+    {
+        U32 mLocalID;
+        U32 mOffset;
+        U32 mSize;
+        U32 mChecksum;
+        LLUUID mObjectID;
+    };
+};
+
+#endif // LL_LLVOCACHEEXTRAS_H
@@ -1352,9 +1352,9 @@ void LLPipeline::enableShadows(const bool enable_shadows)
 class LLOctreeDirtyTexture : public OctreeTraveler
 {
 public:
-	const std::set<LLViewerFetchedTexture*>& mTextures;
+	const std::unordered_set<LLViewerFetchedTexture*>& mTextures;
 
-	LLOctreeDirtyTexture(const std::set<LLViewerFetchedTexture*>& textures) : mTextures(textures) { }
+	LLOctreeDirtyTexture(const std::unordered_set<LLViewerFetchedTexture*>& textures) : mTextures(textures) { }
 
 	virtual void visit(const OctreeNode* node)
 	{
@@ -1385,7 +1385,7 @@ public:
 };
 
 // Called when a texture changes # of channels (causes faces to move to alpha pool)
-void LLPipeline::dirtyPoolObjectTextures(const std::set<LLViewerFetchedTexture*>& textures)
+void LLPipeline::dirtyPoolObjectTextures(const std::unordered_set<LLViewerFetchedTexture*>& textures)
 {
     LL_PROFILE_ZONE_SCOPED_CATEGORY_PIPELINE;
 	assertInitialized();
@@ -228,7 +228,7 @@ public:
 		);
 
 	// Something about these textures has changed.  Dirty them.
-	void        dirtyPoolObjectTextures(const std::set<LLViewerFetchedTexture*>& textures);
+	void        dirtyPoolObjectTextures(const std::unordered_set<LLViewerFetchedTexture*>& textures);
 
 	void        resetDrawOrders();
 
@@ -0,0 +1,259 @@
+/**
+ * @file llvocacheextras_test.cpp
+ * @date 2024-05-14
+ * @brief Test the object cache extras file
+ *
+ * $LicenseInfo:firstyear=2024&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2024, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+// Dependencies
+#include "linden_common.h"
+#include "llregionhandle.h"
+#include "llsdserialize.h"
+#include "v4color.h"
+#include "../test/namedtempfile.h"
+// Class to test
+#include "../llvocacheextras.h"
+// Tut header
+#include "../test/lltut.h"
+
+// -------------------------------------------------------------------------------------------
+// TUT
+// -------------------------------------------------------------------------------------------
+namespace tut
+{
+    // Test wrapper declaration
+    struct vocacheextras_test
+    {
+        typedef LLVOCacheExtrasFile::entry_map_t entry_map_t;
+
+        static const U32 REGION_X = 141;
+        static const U32 REGION_Y = 81;
+
+        U64 mRegionHandle;
+        LLUUID mCacheID;
+
+        vocacheextras_test()
+        :   mRegionHandle(to_region_handle(REGION_X * 256, REGION_Y * 256)),
+            mCacheID(LLUUID::generateNewID())
+        {
+        }
+
+        // Override LLSD as sent by the simulator, for num_sides faces
+        static LLSD makeEntryLLSD(U32 local_id, const LLUUID& object_id, S32 num_sides)
+        {
+            LLSD data;
+            data["local_id"] = (LLSD::Integer)local_id;
+            data["object_id"] = object_id;
+            data["region_handle_x"] = (LLSD::Integer)(REGION_X * 256);
+            data["region_handle_y"] = (LLSD::Integer)(REGION_Y * 256);
+            for (S32 side = 0; side < num_sides; ++side)
+            {
+                LLSD gltf_llsd;
+                gltf_llsd["bc"] = LLColor4(1.f, 0.5f, 0.f, 1.f).getValue();
+                data["sides"].append(side);
+                data["gltf_llsd"].append(gltf_llsd);
+            }
+            return data;
+        }
+
+        static void fillEntries(entry_map_t& entries)
+        {
+            for (U32 local_id = 1; local_id <= 3; ++local_id)
+            {
+                LLSD data = makeEntryLLSD(local_id, LLUUID::generateNewID(), local_id + 1);
+                ensure("fromLLSD succeeds", entries[local_id].fromLLSD(data));
+            }
+        }
+
+        // Each decoded entry must match the one it was written from
+        static void ensureSameEntries(const std::string& msg, const entry_map_t& expected, entry_map_t& actual)
+        {
+            ensure_equals(msg + " entry count", actual.size(), expected.size());
+            for (auto const & expected_entry : expected)
+            {
+                ensure(msg + " has local id", actual.count(expected_entry.first) == 1);
+                LLGLTFOverrideCacheEntry& entry = actual[expected_entry.first];
+                ensure(msg + " decode succeeds", entry.decode());
+                ensure_equals(msg + " local id", entry.mLocalId, expected_entry.first);
+                ensure_equals(msg + " object id", entry.mObjectId, expected_entry.second.mObjectId);
+                ensure_equals(msg + " sides count", entry.mSides.size(), expected_entry.second.mSides.size());
+                ensure_equals(msg + " materials count", entry.mGLTFMaterial.size(), expected_entry.second.mGLTFMaterial.size());
+                for (auto const & side : expected_entry.second.mSides)
+                {
+                    ensure_equals(msg + " side override", entry.mSides[side.first], side.second);
+                }
+            }
+        }
+    };
+    typedef test_group<vocacheextras_test> vocacheextras_t;
+    typedef vocacheextras_t::object vocacheextras_object_t;
+    tut::vocacheextras_t tut_vocacheextras("LLVOCacheExtras");
+
+    template<> template<>
+    void vocacheextras_object_t::test<1>()
+    {
+        set_test_name("LLGLTFOverrideCacheEntry LLSD round trip");
+
+        LLSD data = makeEntryLLSD(42, LLUUID::generateNewID(), 7);
+        LLGLTFOverrideCacheEntry entry;
+        ensure("fromLLSD succeeds", entry.fromLLSD(data));
+        ensure_equals("local id", entry.mLocalId, 42);
+        ensure_equals("region handle", entry.mRegionHandle, mRegionHandle);
+        ensure_equals("sides count", entry.mSides.size(), 7);
+        ensure_equals("materials count", entry.mGLTFMaterial.size(), 7);
+        ensure("not encoded", !entry.isEncoded());
+        ensure_equals("side override", entry.mSides[3]["bc"].size(), 4);
+
+        // sides may come back in another order
+        LLSD out = entry.toLLSD();
+        ensure_equals("toLLSD() local id", out["local_id"].asInteger(), 42);
+        ensure_equals("toLLSD() object id", out["object_id"].asUUID(), entry.mObjectId);
+        ensure_equals("toLLSD() region x", out["region_handle_x"].asInteger(), REGION_X * 256);
+        ensure_equals("toLLSD() region y", out["region_handle_y"].asInteger(), REGION_Y * 256);
+        ensure_equals("toLLSD() sides count", out["sides"].size(), 7);
+
+        LLSD no_local_id(data);
+        no_local_id.erase("local_id");
+        ensure("fromLLSD needs local_id", !LLGLTFOverrideCacheEntry().fromLLSD(no_local_id));
+    }
+
+    template<> template<>
+    void vocacheextras_object_t::test<2>()
+    {
+        set_test_name("binary file round trip, decoded on demand");
+
+        NamedExtTempFile file("slec", "");
+        entry_map_t entries;
+        fillEntries(entries);
+        ensure("write succeeds", LLVOCacheExtrasFile::write(file.getName(), mCacheID, entries));
+
+        entry_map_t read_entries;
+        LLVOCacheExtrasFile::read(file.getName(), mRegionHandle, mCacheID, read_entries);
+        ensure_equals("entry count", read_entries.size(), entries.size());
+        for (auto const & entry : read_entries)
+        {
+            ensure("entry not decoded yet", entry.second.isEncoded());
+            ensure_equals("object id from index", entry.second.mObjectId, entries[entry.first].mObjectId);
+            ensure_equals("region handle", entry.second.mRegionHandle, mRegionHandle);
+            ensure("no sides before decode", entry.second.mSides.empty());
+        }
+
+        // Undecoded entries are copied as is when the file is written again
+        ensure("rewrite succeeds", LLVOCacheExtrasFile::write(file.getName(), mCacheID, read_entries));
+        entry_map_t reread_entries;
+        LLVOCacheExtrasFile::read(file.getName(), mRegionHandle, mCacheID, reread_entries);
+
+        ensureSameEntries("read", entries, read_entries);
+        ensureSameEntries("reread", entries, reread_entries);
+    }
+
+    template<> template<>
+    void vocacheextras_object_t::test<3>()
+    {
+        set_test_name("files of other regions or damaged files are ignored");
+
+        NamedExtTempFile file("slec", "");
+        entry_map_t entries;
+        fillEntries(entries);
+        ensure("write succeeds", LLVOCacheExtrasFile::write(file.getName(), mCacheID, entries));
+
+        entry_map_t other_entries;
+        LLVOCacheExtrasFile::read(file.getName(), mRegionHandle, LLUUID::generateNewID(), other_entries);
+        ensure("cache id mismatch", other_entries.empty());
+
+        // Flip the last payload byte: the index still reads, decoding fails
+        {
+            std::fstream stream(file.getName(), std::ios::in | std::ios::out | std::ios::binary);
+            stream.seekg(-1, std::ios::end);
+            char last = stream.get();
+            stream.seekp(-1, std::ios::end);
+            stream.put(last ^ 0xff);
+        }
+        entry_map_t damaged_entries;
+        LLVOCacheExtrasFile::read(file.getName(), mRegionHandle, mCacheID, damaged_entries);
+        ensure_equals("index still read", damaged_entries.size(), entries.size());
+        S32 failed = 0;
+        for (auto& entry : damaged_entries)
+        {
+            if (!entry.second.decode())
+            {
+                ++failed;
+            }
+            ensure("entry released", !entry.second.isEncoded());
+        }
+        ensure_equals("one damaged entry", failed, 1);
+
+        entry_map_t missing_entries;
+        LLVOCacheExtrasFile::read(file.getName() + ".missing", mRegionHandle, mCacheID, missing_entries);
+        ensure("missing file", missing_entries.empty());
+    }
+
+    template<> template<>
+    void vocacheextras_object_t::test<4>()
+    {
+        set_test_name("migrating a legacy LLSD XML file");
+
+        entry_map_t entries;
+        fillEntries(entries);
+
+        // Written the way older viewers did: cache id line, entry count line,
+        // then one LLSD XML document per entry
+        const LLUUID cache_id(mCacheID);
+        NamedExtTempFile file("slec", [&entries, &cache_id](std::ostream& out)
+        {
+            out << cache_id << '\n';
+            out << entries.size() << '\n';
+            for (auto const & entry : entries)
+            {
+                LLSD entry_llsd = entry.second.toLLSD();
+                entry_llsd["local_id"] = (LLSD::Integer)entry.first;
+                LLSDSerialize::serialize(entry_llsd, out, LLSDSerialize::LLSD_XML);
+                out << '\n';
+            }
+        });
+
+        entry_map_t other_entries;
+        LLVOCacheExtrasFile::read(file.getName(), mRegionHandle, LLUUID::generateNewID(), other_entries);
+        ensure("legacy cache id mismatch", other_entries.empty());
+
+        entry_map_t legacy_entries;
+        LLVOCacheExtrasFile::read(file.getName(), mRegionHandle, mCacheID, legacy_entries);
+        ensure_equals("legacy entry count", legacy_entries.size(), entries.size());
+        for (auto const & entry : legacy_entries)
+        {
+            ensure("legacy entries are parsed in full", !entry.second.isEncoded());
+        }
+        ensureSameEntries("legacy", entries, legacy_entries);
+
+        // The next write replaces it with the binary format
+        ensure("write succeeds", LLVOCacheExtrasFile::write(file.getName(), mCacheID, legacy_entries));
+        entry_map_t migrated_entries;
+        LLVOCacheExtrasFile::read(file.getName(), mRegionHandle, mCacheID, migrated_entries);
+        ensure_equals("migrated entry count", migrated_entries.size(), entries.size());
+        for (auto const & entry : migrated_entries)
+        {
+            ensure("migrated entries are binary", entry.second.isEncoded());
+        }
+        ensureSameEntries("migrated", entries, migrated_entries);
+    }
+}
@@ -0,0 +1,79 @@
+/**
+ * @file   countallocs.h
+ * @brief  Replace the global operator new and delete of a test program to
+ *         count its heap allocations.
+ *
+ * $LicenseInfo:firstyear=2024&license=viewerlgpl$
+ * Copyright (c) 2024, Linden Research, Inc.
+ * $/LicenseInfo$
+ */
+
+#if ! defined(LL_COUNTALLOCS_H)
+#define LL_COUNTALLOCS_H
+
+#include "stdtypes.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+/**
+ * Include this in exactly one .cpp file of a test program: it defines the
+ * global operator new and delete for the whole program. Tests compare the
+ * counters before and after the code they measure.
+ *
+ * llcommon replaces operator new itself when built with Tracy. Then nothing
+ * is replaced here and the counters stay at 0, so checks on them belong
+ * under #if ! TRACY_ENABLE.
+ */
+namespace CountAllocs
+{
+    // Allocations made by this thread, and the bytes they asked for
+    inline thread_local size_t sCount = 0;
+    inline thread_local size_t sBytes = 0;
+
+    // Bytes held right now, by all threads
+    inline std::atomic<S64> sLiveBytes(0);
+}
+
+#if ! TRACY_ENABLE
+namespace CountAllocs
+{
+    // Each block starts with its size. 16 bytes keep the rest aligned for
+    // anything operator new has to hold.
+    const size_t HEADER_SIZE = 16;
+
+    inline void* alloc(size_t size)
+    {
+        ++sCount;
+        sBytes += size;
+        sLiveBytes += (S64)size;
+        char* block = (char*)malloc(size + HEADER_SIZE);
+        if (!block)
+        {
+            throw std::bad_alloc();
+        }
+        *(size_t*)block = size;
+        return block + HEADER_SIZE;
+    }
+
+    inline void release(void* ptr)
+    {
+        if (ptr)
+        {
+            char* block = (char*)ptr - HEADER_SIZE;
+            sLiveBytes -= (S64)*(size_t*)block;
+            free(block);
+        }
+    }
+}
+
+void* operator new(size_t size)                     { return CountAllocs::alloc(size); }
+void* operator new[](size_t size)                   { return CountAllocs::alloc(size); }
+void operator delete(void* ptr) noexcept            { CountAllocs::release(ptr); }
+void operator delete[](void* ptr) noexcept          { CountAllocs::release(ptr); }
+void operator delete(void* ptr, size_t) noexcept    { CountAllocs::release(ptr); }
+void operator delete[](void* ptr, size_t) noexcept  { CountAllocs::release(ptr); }
+#endif // ! TRACY_ENABLE
+
+#endif /* ! defined(LL_COUNTALLOCS_H) */
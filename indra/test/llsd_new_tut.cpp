@@ -30,6 +30,7 @@
 #include "linden_common.h"
 #include "lltut.h"
 
+#include "llformat.h"
 #include "llsdtraits.h"
 #include "llstring.h"
 
@@ -811,6 +812,95 @@ namespace tut
 		ensure("type is a string", v.isString());
 	}
 
+	template<> template<>
+	void SDTestObject::test<15>()
+		// maps behave as the std::map they used to be
+	{
+		SDCleanupCheck check;
+
+		{
+			// references to values survive the map growing and shrinking
+			LLSD m;
+			LLSD& first = m["first"];
+			first = 1;
+			std::vector<std::string> keys;
+			for (S32 i = 0; i < 1000; ++i)
+			{
+				// long keys, shuffled
+				keys.push_back(llformat("key number %04d, which is long", (i * 379) % 1000));
+				m[keys.back()] = i;
+			}
+			first = 2;
+			ensure_equals("reference held while growing", m["first"].asInteger(), 2);
+			for (S32 i = 0; i < 1000; i += 2)
+			{
+				m.erase(keys[i]);
+			}
+			LLSD& second = m["second"];
+			for (S32 i = 0; i < 1000; i += 2)
+			{
+				m[keys[i]] = -i;
+			}
+			second = 3;
+			ensure_equals("reference held while reusing", m["second"].asInteger(), 3);
+			ensure_equals("first", m["first"].asInteger(), 2);
+			ensure_equals("size", m.size(), (size_t)1002);
+			for (S32 i = 0; i < 1000; ++i)
+			{
+				ensure_equals(keys[i], m[keys[i]].asInteger(), (i % 2) ? i : -i);
+			}
+
+			// in key order
+			std::string previous;
+			size_t count = 0;
+			for (LLSD::map_const_iterator it = m.beginMap(); it != m.endMap(); ++it)
+			{
+				ensure("ordered", count == 0 || previous < it->first);
+				previous = it->first;
+				++count;
+			}
+			ensure_equals("iterated", count, m.size());
+
+			// as std::map::insert(), leaves an existing entry alone
+			m.insert("first", 4);
+			ensure_equals("insert existing", m["first"].asInteger(), 2);
+			m.insert("third", 5);
+			ensure_equals("insert new", m["third"].asInteger(), 5);
+
+			// iterators modify in place, and convert to const ones
+			LLSD::map_iterator it = m.beginMap();
+			LLSD::map_const_iterator cit = it;
+			it->second = "changed";
+			ensure_equals("modified through iterator", cit->second.asString(), "changed");
+			ensure_equals("iterator end", m.endMap() - m.beginMap(), (ptrdiff_t)m.size());
+		}
+
+		{
+			// copies share until written
+			LLSD original;
+			original["a"] = 1;
+			original["b"]["c"] = 2;
+			LLSD copy = original;
+			copy["a"] = 3;
+			copy.erase("b");
+			copy["d"] = 4;
+			ensure_equals("original a", original["a"].asInteger(), 1);
+			ensure_equals("original b", original["b"]["c"].asInteger(), 2);
+			ensure("original d", !original.has("d"));
+			ensure_equals("copy size", copy.size(), (size_t)2);
+			ensure_equals("original size", original.size(), (size_t)2);
+		}
+
+		{
+			LLSD empty = LLSD::emptyMap();
+			ensure("empty", empty.beginMap() == empty.endMap());
+			LLSD scalar = 1;
+			const LLSD& const_scalar = scalar;
+			ensure("scalar", const_scalar.beginMap() == const_scalar.endMap());
+			ensure("missing", !empty.has("x") && empty.get("x").isUndefined());
+		}
+	}
+
 	/* TO DO:
 		conversion of undefined to UUID, Date, URI and Binary
 		conversion of undefined to map and array
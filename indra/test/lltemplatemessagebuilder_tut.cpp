@@ -31,16 +31,57 @@
 
 #include "llapr.h"
 #include "llmessagetemplate.h"
+#include "llmessagetemplateparser.h"
 #include "llmath.h"
+#include "llmsgdataarena.h"
 #include "llquaternion.h"
 #include "lltemplatemessagebuilder.h"
 #include "lltemplatemessagereader.h"
 #include "message_prehash.h"
+#include "lltimer.h"
 #include "u64.h"
 #include "v3dmath.h"
 #include "v3math.h"
 #include "v4math.h"
 
+namespace
+{
+	// ObjectUpdate as scripts/messages/message_template.msg has it
+	const char* OBJECT_UPDATE_TEMPLATE =
+		"{ ObjectUpdate High 12 Trusted Zerocoded"
+		"  { RegionData Single { RegionHandle U64 } { TimeDilation U16 } }"
+		"  { ObjectData Variable"
+		"    { ID U32 } { State U8 } { FullID LLUUID } { CRC U32 } { PCode U8 }"
+		"    { Material U8 } { ClickAction U8 } { Scale LLVector3 } { ObjectData Variable 1 }"
+		"    { ParentID U32 } { UpdateFlags U32 }"
+		"    { PathCurve U8 } { ProfileCurve U8 } { PathBegin U16 } { PathEnd U16 }"
+		"    { PathScaleX U8 } { PathScaleY U8 } { PathShearX U8 } { PathShearY U8 }"
+		"    { PathTwist S8 } { PathTwistBegin S8 } { PathRadiusOffset S8 } { PathTaperX S8 }"
+		"    { PathTaperY S8 } { PathRevolutions U8 } { PathSkew S8 }"
+		"    { ProfileBegin U16 } { ProfileEnd U16 } { ProfileHollow U16 }"
+		"    { TextureEntry Variable 2 } { TextureAnim Variable 1 } { NameValue Variable 2 }"
+		"    { Data Variable 2 } { Text Variable 1 } { TextColor Fixed 4 } { MediaURL Variable 1 }"
+		"    { PSBlock Variable 1 } { ExtraParams Variable 1 }"
+		"    { Sound LLUUID } { OwnerID LLUUID } { Gain F32 } { Flags U8 } { Radius F32 }"
+		"    { JointType U8 } { JointPivot LLVector3 } { JointAxisOrAnchor LLVector3 }"
+		"  }"
+		" }";
+
+	// What an object update handler does: read the IDs of each object
+	void readObjectIDs(LLMessageSystem*, void** user_data)
+	{
+		LLTemplateMessageReader* reader = reinterpret_cast<LLTemplateMessageReader*>(user_data);
+		S32 count = reader->getNumberOfBlocks(_PREHASH_ObjectData);
+		for (S32 i = 0; i < count; ++i)
+		{
+			U32 local_id;
+			LLUUID full_id;
+			reader->getU32(_PREHASH_ObjectData, _PREHASH_ID, local_id, i);
+			reader->getUUID(_PREHASH_ObjectData, _PREHASH_FullID, full_id, i);
+		}
+	}
+}
+
 namespace tut
 {	
 	static LLTemplateMessageBuilder::message_template_name_map_t nameMap;
@@ -967,5 +1008,114 @@ namespace tut
 		ensure_equals("Ensure unchanged buffer ", strlen(outBuffer), 0);
 		delete reader;
 	}
-}
 
+	template<> template<>
+	void LLTemplateMessageBuilderTestObject::test<46>()
+		// arena chunks, alignment and reuse
+	{
+		LLMsgDataArena arena(256);
+		ensure_equals("no chunk before the first allocation", arena.getChunkCount(), 0);
+		U8* first = (U8*)arena.allocate(3, 1);
+		U8* second = (U8*)arena.allocate(8, 8);
+		ensure("alignment", ((uintptr_t)second % 8) == 0);
+		ensure("bump", second > first && second < first + 16);
+		ensure_equals("bytes used", arena.getBytesUsed(), 11);
+
+		// overflow into a second chunk, then a dedicated one
+		arena.allocate(241);
+		ensure_equals("second chunk", arena.getChunkCount(), 2);
+		arena.allocate(1000);
+		ensure_equals("oversized chunk", arena.getChunkCount(), 3);
+
+		// reset drops the oversized chunk and starts over in the first
+		arena.reset();
+		ensure_equals("chunks kept", arena.getChunkCount(), 2);
+		ensure_equals("bytes after reset", arena.getBytesUsed(), 0);
+		ensure("reused", arena.allocate(3, 1) == first);
+		ensure("same layout", arena.allocate(8, 8) == second);
+		arena.allocate(241);
+		ensure_equals("second chunk reused", arena.getChunkCount(), 2);
+	}
+
+	template<> template<>
+	void LLTemplateMessageBuilderTestObject::test<47>()
+		// decoded messages per second, replaying ObjectUpdate packets
+	{
+		defaultTemplate();
+		LLTemplateTokenizer tokens(OBJECT_UPDATE_TEMPLATE);
+		LLMessageTemplate* object_update = LLTemplateParser::parseMessage(tokens);
+		ensure("parsed ObjectUpdate", object_update != NULL);
+
+		// A few dozen packets of three prims each, which is about what
+		// fits in one.
+		const S32 PACKETS = 32;
+		const S32 OBJECTS_PER_PACKET = 3;
+		const U32 bufferSize = 4096;
+		std::vector<std::vector<U8> > packets;
+		nameMap[_PREHASH_ObjectUpdate] = object_update;
+		LLTemplateMessageBuilder builder(nameMap);
+		U8 bytes[256];
+		for (S32 i = 0; i < (S32)sizeof(bytes); ++i)
+		{
+			bytes[i] = U8(i * 7);
+		}
+		for (S32 p = 0; p < PACKETS; ++p)
+		{
+			builder.newMessage(_PREHASH_ObjectUpdate);
+			builder.nextBlock(_PREHASH_RegionData);
+			builder.addU64(_PREHASH_RegionHandle, (U64(256000) << 32) | 256000);
+			builder.addU16(_PREHASH_TimeDilation, 65535);
+			for (S32 o = 0; o < OBJECTS_PER_PACKET; ++o)
+			{
+				builder.nextBlock(_PREHASH_ObjectData);
+				const LLMessageBlock* block = object_update->mMemberBlocks[const_cast<char*>(_PREHASH_ObjectData)];
+				for (LLMessageBlock::message_variable_map_t::const_iterator iter = block->mMemberVariables.begin();
+					 iter != block->mMemberVariables.end(); ++iter)
+				{
+					const LLMessageVariable* var = *iter;
+					S32 size = var->getSize();
+					if (var->getType() == MVT_VARIABLE)
+					{
+						// a prim's terse data, texture entry and extra params
+						size = var->getName() == _PREHASH_ObjectData ? 60
+							: var->getName() == _PREHASH_TextureEntry ? 64
+							: var->getName() == _PREHASH_ExtraParams ? 1 : 0;
+					}
+					builder.addBinaryData(var->getName(), bytes + (p + o) % 64, size);
+				}
+			}
+			U8 buffer[bufferSize];
+			memset(buffer, 0, LL_PACKET_ID_SIZE);
+			U32 size = builder.buildMessage(buffer, bufferSize, 0);
+			packets.push_back(std::vector<U8>(buffer, buffer + size));
+		}
+
+		numberMap[12] = object_update;
+		LLTemplateMessageReader reader(numberMap);
+		object_update->setHandlerFunc(readObjectIDs, reinterpret_cast<void**>(&reader));
+
+		// Every replay has to validate and read. The rate only gets logged,
+		// over enough replays to mean something, with LL_BENCHMARKS.
+		const S32 REPLAYS = benchmarking() ? 2000 : 10;
+		LLTimer timer;
+		for (S32 r = 0; r < REPLAYS; ++r)
+		{
+			for (S32 p = 0; p < PACKETS; ++p)
+			{
+				ensure("validated", reader.validateMessage(&packets[p][0], packets[p].size(), LLHost(), true));
+				ensure("read", reader.readMessage(&packets[p][0], LLHost()));
+				reader.clearMessage();
+			}
+		}
+		F64 elapsed = timer.getElapsedTimeF64();
+		if (benchmarking())
+		{
+			LL_INFOS("Benchmark") << "ObjectUpdate decode: " << S32(REPLAYS * PACKETS / elapsed)
+								  << " messages/s, " << packets[0].size() << " bytes each" << LL_ENDL;
+		}
+
+		numberMap.erase(12);
+		nameMap.erase(_PREHASH_ObjectUpdate);
+		delete object_update;
+	}
+}
@@ -30,6 +30,7 @@
 #define LL_LLTUT_H
 
 #include "is_approx_equal_fraction.h" // instead of llmath.h
+#include <cstdlib>
 #include <cstring>
 
 class LLDate;
@@ -154,6 +155,15 @@ namespace tut
 	{
 		ensure_not_equals(NULL, actual, expected);
 	}
+
+	// Whether LL_BENCHMARKS is set. Timings only mean something on a quiet
+	// machine, so a build runs benchmarks small and quiet, or skips them;
+	// set LL_BENCHMARKS to run them at full size and log the numbers.
+	inline bool benchmarking()
+	{
+		const char* env = getenv("LL_BENCHMARKS");
+		return env && *env;
+	}
 }
 
 #endif // LL_LLTUT_H